@@ -0,0 +1,74 @@
+#pragma once
+// BarrelCache.hpp
+// Thread-safe LRU cache of mapped barrels with a byte budget.
+//
+// Entries are charged by their mapped size, so a few large head-term barrels
+// and many small ones share the same budget fairly. The cache is split into
+// shards with their own lock and LRU list; a lookup only locks one shard for a
+// hash probe and a list splice. Evicting a barrel just drops the cache's
+// reference - searches still holding it keep the mapping until they finish.
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "BinaryBarrel.hpp"
+
+class BarrelCache {
+public:
+    explicit BarrelCache(size_t capacity_bytes, size_t num_shards = 8);
+
+    // Barrels are keyed by (barrel set generation, barrel id) so a reload
+    // never sees barrels mapped from the previous files.
+    // Returns false on a miss. A hit may return nullptr: the barrel is known
+    // to be missing and won't be retried until the next reload.
+    bool lookup(uint64_t generation, int barrel_id, std::shared_ptr<const BinaryBarrel>& out);
+
+    // Add a barrel (or nullptr for a missing one) and evict least recently
+    // used entries of the shard until it fits its share of the budget.
+    // If another thread inserted the same key first, that entry is kept and returned.
+    std::shared_ptr<const BinaryBarrel> insert(uint64_t generation, int barrel_id,
+                                               std::shared_ptr<const BinaryBarrel> barrel);
+
+    // Drop one entry (its barrel set is gone)
+    void erase(uint64_t generation, int barrel_id);
+
+    // Drop every entry (after the barrel files were rewritten)
+    void clear();
+
+    struct Stats {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+        size_t capacity_bytes = 0;
+    };
+    Stats get_stats() const;
+
+private:
+    struct Entry {
+        uint64_t key;
+        size_t charge;
+        std::shared_ptr<const BinaryBarrel> barrel;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<Entry> lru;  // Front = most recently used
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+        size_t bytes = 0;
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+    };
+
+    static uint64_t make_key(uint64_t generation, int barrel_id);
+    Shard& shard_for(uint64_t key);
+
+    size_t capacity_bytes_;
+    size_t shard_capacity_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
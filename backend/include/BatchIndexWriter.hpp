@@ -5,11 +5,14 @@
 #include <thread>
 #include <atomic>
 #include <chrono>
+#include <deque>
+#include <functional>
 #include "forward_index.hpp"
 #include "inverted_index.hpp"
 #include "lexicon.hpp"
 #include "DocumentMetadata.hpp"
 #include "doc_url_mapper.hpp"
+#include "MemorySegment.hpp"
 #include "json.hpp"
 
 using json = nlohmann::json;
@@ -24,8 +27,14 @@ struct PendingDocument {
     std::chrono::steady_clock::time_point enqueue_time;
 };
 
+// Flushing a batch publishes it first (documents become searchable through
+// the publisher, typically SearchService::add_documents) and then hands it to
+// a persistence thread that writes the lexicon, forward index, delta log,
+// metadata and URL files in the background, in batch order.
 class BatchIndexWriter {
 public:
+    using PublishFn = std::function<void(std::vector<SegmentDocument>)>;
+
     BatchIndexWriter(
         Lexicon& lexicon,
         ForwardIndexBuilder& forward_builder,
@@ -41,23 +50,32 @@ public:
     // Thread-safe: Add document to batch queue
     void enqueue_document(PendingDocument doc);
     
-    // Force immediate flush (blocking)
+    // Set before documents are enqueued. Called from flush threads.
+    void set_publisher(PublishFn publisher);
+    
+    // Force immediate flush. Returns once the queued documents are published;
+    // their files are written asynchronously.
     void flush_now();
     
     // Get statistics
     struct Stats {
         size_t documents_queued = 0;
-        size_t documents_indexed = 0;
+        size_t documents_indexed = 0;       // Published (searchable)
+        size_t documents_persisted = 0;     // Written to the index files
         size_t batches_flushed = 0;
-        double avg_batch_time_ms = 0.0;
+        double avg_batch_time_ms = 0.0;     // Time to persist a batch
         size_t current_queue_size = 0;
+        size_t pending_persist_batches = 0;
     };
     Stats get_stats() const;
     
 private:
     void writer_thread();
+    void persist_thread();
     void flush_batch(std::vector<PendingDocument>& batch);
+    void persist_batch(const std::vector<PendingDocument>& batch);
     void update_indices(const std::vector<PendingDocument>& batch);
+    static SegmentDocument make_segment_document(const PendingDocument& doc);
     
     Lexicon& lexicon_;
     ForwardIndexBuilder& forward_builder_;
@@ -72,6 +90,15 @@ private:
     std::thread writer_thread_;
     std::atomic<bool> shutdown_{false};
     
+    PublishFn publisher_;
+    
+    // Published batches waiting to be written, oldest first
+    std::deque<std::vector<PendingDocument>> persist_queue_;
+    mutable std::mutex persist_mutex_;
+    std::condition_variable persist_cv_;
+    std::thread persist_thread_;
+    bool persist_shutdown_ = false;
+    
     size_t batch_size_;
     std::chrono::seconds flush_interval_;
     
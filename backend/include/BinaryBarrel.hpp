@@ -0,0 +1,151 @@
+#pragma once
+// BinaryBarrel.hpp
+// Binary inverted barrel format (inverted_barrel_<id>.bin) and its mmap reader.
+//
+// The serving path maps the file and decodes postings straight out of it, one
+// block at a time - nothing is parsed into an intermediate tree. Each posting
+// list is cut into blocks of BLOCK_SIZE postings; every block has a skip entry
+// (last doc id + offsets) and is compressed with PostingCodec:
+//
+//   BarrelHeader
+//   BarrelTermEntry  x num_terms    (sorted by word_id, binary searched)
+//   BarrelBlockEntry x num_blocks   (each term's blocks are contiguous)
+//   data section     x data_bytes   (block payloads + decoder padding)
+//
+// Block postings payload:  doc id gaps | frequencies | position counts
+// Block positions payload: zigzag gaps of all positions in the block
+// All integers are little-endian.
+//
+// The header records the collection statistics BM25F scores the barrel's
+// postings with (document count, average title / body length) and every term
+// its IDF, all as of when the barrel was written: a posting's score needs no
+// lookups beyond the term entry.
+//
+// Terms and blocks also carry score upper bounds (max RankingScorer score of any
+// posting in them) for top-k pruning, computed with those same statistics and
+// the document metadata present then; barrels written without a scorer store
+// +inf, which simply disables pruning for them.
+
+#include <string>
+#include <cstdint>
+#include <vector>
+#include <functional>
+#include "MappedFile.hpp"
+#include "inverted_index.hpp"
+
+namespace barrel_format {
+    constexpr char MAGIC[4] = {'D', 'S', 'A', 'B'};
+    constexpr uint32_t VERSION = 4;
+    constexpr uint32_t BLOCK_SIZE = 128;
+}
+
+struct BarrelHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t num_terms;
+    uint32_t block_size;
+    uint64_t num_postings;
+    uint64_t num_blocks;
+    uint64_t data_bytes;
+    uint32_t num_documents;     // Collection statistics (CollectionStats)
+    float avg_title_length;
+    float avg_body_length;
+    uint32_t reserved;
+};
+
+struct BarrelTermEntry {
+    int32_t word_id;
+    uint32_t doc_count;
+    uint32_t first_block;
+    uint32_t num_blocks;
+    float max_score;            // Upper bound over all postings of the term
+    float idf;
+};
+
+struct BarrelBlockEntry {
+    int32_t last_doc_id;        // Skip pointer: largest doc id in the block
+    uint32_t count;             // Postings in the block
+    uint32_t num_positions;     // Positions of all postings in the block
+    float max_score;            // Upper bound over the block's postings
+    uint64_t postings_offset;   // Offsets into the data section
+    uint64_t positions_offset;
+};
+
+// One decoded block. Positions are decoded separately so callers that only
+// need doc ids / frequencies can skip them.
+struct PostingBlock {
+    uint32_t count = 0;
+    int32_t doc_ids[barrel_format::BLOCK_SIZE];
+    int32_t frequencies[barrel_format::BLOCK_SIZE];
+    uint32_t position_starts[barrel_format::BLOCK_SIZE + 1];  // Offsets into the block's positions
+};
+
+// View of one word's compressed posting list inside a mapped barrel.
+// Only valid while the owning BinaryBarrel is alive.
+struct PostingListView {
+    const BarrelBlockEntry* blocks = nullptr;
+    const uint8_t* data = nullptr;
+    uint32_t num_blocks = 0;
+    uint32_t size = 0;           // Total postings
+    uint64_t num_positions = 0;  // Total positions over all blocks
+    float max_score = 0.0f;
+    float idf = 0.0f;
+
+    // Decode doc ids, frequencies and position offsets of block b
+    void decode_block(uint32_t b, PostingBlock& out) const;
+
+    // Decode all positions of block b (blocks[b].num_positions values)
+    void decode_positions(uint32_t b, int32_t* out) const;
+};
+
+// Score of one posting with the term's IDF and the collection statistics the
+// barrel is written with; used to compute the upper bounds
+using PostingScoreFn = std::function<double(int word_id, float idf, const CollectionStats& collection,
+                                            const InvertedEntry& entry)>;
+
+// What a barrel is written with
+struct BarrelScoring {
+    CollectionStats collection;
+
+    // IDF of a word with num_postings postings in this barrel (nullptr: from
+    // num_postings and collection.num_documents, right when the barrel holds
+    // all of the collection's postings of its words)
+    std::function<float(int word_id, uint32_t num_postings)> idf;
+
+    PostingScoreFn score;   // nullptr: unbounded, no pruning
+};
+
+class BinaryBarrel {
+public:
+    // Map a barrel file and validate its layout
+    bool open(const std::string& path);
+
+    // Look up a word's postings (binary search over the term directory)
+    bool find(int word_id, PostingListView& out) const;
+
+    // Decode the whole barrel back into a BarrelMap (used by merges / JSON export)
+    void to_barrel_map(BarrelMap& out) const;
+
+    // Statistics the barrel's postings are scored with
+    CollectionStats collection() const;
+
+    size_t num_terms() const { return header_ ? header_->num_terms : 0; }
+    size_t size_bytes() const { return file_.size(); }
+
+    // Serialize a barrel. Writes to <path>.tmp and renames, so readers that
+    // still have the old file mapped keep a consistent view.
+    static bool write(const std::string& path, const BarrelMap& barrel,
+                      const BarrelScoring& scoring = BarrelScoring());
+
+private:
+    // Block counts, payloads (decoder padding included) and each term's block
+    // range fit the file
+    static bool valid_directories(const BarrelHeader& header, const BarrelTermEntry* terms,
+                                  const BarrelBlockEntry* blocks, const uint8_t* data);
+
+    MappedFile file_;
+    const BarrelHeader* header_ = nullptr;
+    const BarrelTermEntry* terms_ = nullptr;
+    const BarrelBlockEntry* blocks_ = nullptr;
+    const uint8_t* data_ = nullptr;
+};
@@ -0,0 +1,14 @@
+#pragma once
+// Checksum.hpp
+// CRC-32 (IEEE 802.3 polynomial, same values as zlib's crc32) for detecting
+// torn or corrupted records in the on-disk index files.
+
+#include <cstdint>
+#include <cstddef>
+
+namespace checksum {
+
+// Pass the previous result as crc to checksum data in several pieces
+uint32_t crc32(const void* data, size_t size, uint32_t crc = 0);
+
+} // namespace checksum
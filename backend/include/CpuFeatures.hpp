@@ -0,0 +1,63 @@
+#pragma once
+// CpuFeatures.hpp
+// Runtime CPU feature detection for the SIMD code paths.
+// SIMD kernels are compiled with per-function target attributes, so the binary
+// still runs on older CPUs; callers check these flags once and fall back to the
+// scalar code otherwise. Non-x86 builds always take the scalar paths.
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define DSA_HAVE_X86_SIMD 1
+#else
+#define DSA_HAVE_X86_SIMD 0
+#endif
+
+namespace cpu {
+
+inline bool has_ssse3() {
+#if DSA_HAVE_X86_SIMD
+    static const bool supported = __builtin_cpu_supports("ssse3");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+inline bool has_sse2() {
+#if DSA_HAVE_X86_SIMD
+    static const bool supported = __builtin_cpu_supports("sse2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+// AVX2 together with FMA (every AVX2 CPU so far has both, but they are separate bits)
+inline bool has_avx2_fma() {
+#if DSA_HAVE_X86_SIMD
+    static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+// Hardware float16 <-> float32 conversion (vcvtph2ps / vcvtps2ph)
+inline bool has_f16c() {
+#if DSA_HAVE_X86_SIMD
+    static const bool supported = __builtin_cpu_supports("f16c");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+inline bool has_avx512f() {
+#if DSA_HAVE_X86_SIMD
+    static const bool supported = __builtin_cpu_supports("avx512f");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+} // namespace cpu
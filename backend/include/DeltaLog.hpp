@@ -0,0 +1,98 @@
+#pragma once
+// DeltaLog.hpp
+// Append-only binary log of documents added since the last full build
+// (barrels/inverted_delta.log). Replaces rewriting inverted_delta.json on every
+// flush: writers append one record per document, readers remember how far they
+// got and only replay the new tail.
+//
+//   DeltaLogHeader                       (magic, version, log id)
+//   record*  = u32 payload length | u32 CRC-32 of payload | payload
+//   payload  = i32 doc_id | u32 num_postings |
+//              (i32 word_id | i32 frequency | u32 num_positions | i32 positions[])*
+//
+// A crash can leave a partially written last record; its length or CRC won't
+// match, so readers stop before it and the next writer truncates it away.
+// Once a prefix of the log has been written to an on-disk segment it is cut
+// off (compact), which gives the log a new log id - readers seeing a different
+// id replay it from the start.
+// All integers are little-endian.
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace delta_log_format {
+    constexpr char MAGIC[4] = {'D', 'S', 'A', 'L'};
+    constexpr uint32_t VERSION = 1;
+}
+
+struct DeltaLogHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t log_id;
+};
+
+struct DeltaPosting {
+    int word_id;
+    int frequency;
+    std::vector<int> positions;
+};
+
+struct DeltaDocument {
+    int doc_id;
+    std::vector<DeltaPosting> postings;
+};
+
+// How far a reader has replayed a log
+struct DeltaLogCursor {
+    uint64_t log_id = 0;   // 0 = nothing read yet
+    uint64_t offset = 0;   // End of the last record applied
+};
+
+class DeltaLog {
+public:
+    explicit DeltaLog(std::string path);
+
+    // Create the log if needed and make it appendable: an incomplete tail left
+    // by a crash is truncated, and a legacy inverted_delta.json next to the log
+    // is imported into it. Idempotent; append() calls it on first use.
+    bool open();
+
+    // Append documents and flush. Thread-safe for one DeltaLog instance. A
+    // failed append leaves the log as it was before.
+    bool append(const std::vector<DeltaDocument>& documents);
+
+    // Start a new, empty log (after its contents were merged into the barrels)
+    bool reset();
+
+    // Drop the records before `flushed` (they are in a segment now), keeping
+    // whatever was appended after it. On success tail points at the first kept
+    // record in the new log. Fails if the log was replaced since flushed was read.
+    bool compact(const DeltaLogCursor& flushed, DeltaLogCursor& tail);
+
+    const std::string& path() const { return path_; }
+
+    struct ReplayResult {
+        bool ok = false;         // Log exists and has a valid header
+        bool restarted = false;  // Log id changed: out holds the whole log, drop earlier state
+        size_t bytes_ignored = 0;
+    };
+
+    // Read the records after cursor and advance it. Stops at the first
+    // incomplete or corrupted record.
+    static ReplayResult replay(const std::string& path, DeltaLogCursor& cursor,
+                               std::vector<DeltaDocument>& out);
+
+    // Entries of the old {"word_id": [[doc_id, frequency, [positions]], ...]}
+    // inverted_delta.json, grouped per document. False if it can't be read.
+    static bool load_legacy_json(const std::string& json_path, std::vector<DeltaDocument>& out);
+
+private:
+    bool recover();
+    bool write_new_log(const std::string& records, uint64_t* log_id = nullptr);
+
+    std::string path_;
+    std::mutex mutex_;
+    bool recovered_ = false;
+};
@@ -0,0 +1,169 @@
+#pragma once
+// DocStatsStore.hpp
+// Per-document stats the ranker reads for every posting it scores: document
+// and title length and title frequencies, indexed by doc id. Columnar instead of a map of
+// maps: one length per doc id, and the title frequencies of all documents in
+// CSR form (an offset per doc id into one array of word id / frequency pairs,
+// sorted by word id within a document). A lookup is an array read plus a scan
+// of the document's few title words, with no hashing.
+//
+// doc_stats.bin holds the same columns and is mapped, not parsed:
+//
+//   DocStatsFileHeader                              (80 bytes)
+//   lengths   int32 x (max_doc_id + 1)              MISSING for doc ids without a document
+//   titles    int32 x (max_doc_id + 1)              title lengths (body: length - title)
+//   offsets   uint32 x (max_doc_id + 2)             title entries of d: [offsets[d], offsets[d + 1])
+//   entries   TitleFrequency x num_entries
+//
+// Sections start on 64-byte boundaries. All integers are little-endian.
+// The header records what the file was built from (size, modification time
+// and CRC-32 of forward_index.jsonl) so a stale file can be told apart from a
+// current one, and a CRC-32 of everything after it, checked on load.
+// Stores are immutable once built; adding documents makes a new one.
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "MappedFile.hpp"
+
+namespace doc_stats_format {
+    constexpr char MAGIC[4] = {'D', 'S', 'A', 'D'};
+    constexpr uint32_t VERSION = 3;
+    constexpr int32_t MISSING = -1;
+
+    // The file the stats were built from
+    struct Source {
+        uint64_t size = 0;
+        int64_t mtime = 0;     // File clock ticks
+        uint32_t crc = 0;      // CRC-32 of the content
+
+        bool same_file(const Source& other) const { return size == other.size && mtime == other.mtime; }
+    };
+
+    // Size and mtime of path, and its CRC-32 when with_crc (which reads all of
+    // it). False if it can't be read.
+    bool read_source(const std::string& path, bool with_crc, Source& source);
+}
+
+struct DocStatsFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t num_documents;
+    int32_t max_doc_id;
+    uint64_t num_entries;
+    uint64_t lengths_offset;
+    uint64_t offsets_offset;
+    uint64_t entries_offset;
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint32_t source_crc;
+    uint32_t payload_crc;   // Bytes from lengths_offset to the end of the file
+    uint64_t title_lengths_offset;
+};
+static_assert(sizeof(DocStatsFileHeader) == 80, "DocStatsFileHeader must stay 80 bytes");
+
+class DocStatsStore {
+public:
+    struct TitleFrequency {
+        int32_t word_id;
+        int32_t frequency;
+    };
+
+    // Documents for build() / with_documents(), in any order
+    class Builder {
+    public:
+        // Title frequencies in any order. Adding a doc id again replaces it.
+        void add(int doc_id, int doc_length, int title_length, std::vector<TitleFrequency> title_frequencies);
+        size_t size() const { return rows_.size(); }
+
+    private:
+        friend class DocStatsStore;
+        struct Row {
+            int doc_id;
+            int doc_length;
+            int title_length;
+            std::vector<TitleFrequency> title_frequencies;
+        };
+        std::vector<Row> rows_;
+    };
+
+    DocStatsStore() = default;
+
+    DocStatsStore(const DocStatsStore&) = delete;
+    DocStatsStore& operator=(const DocStatsStore&) = delete;
+
+    static std::shared_ptr<DocStatsStore> build(Builder documents);
+
+    // This store plus the documents it doesn't hold yet (stats of documents it
+    // holds are left as they are)
+    std::shared_ptr<DocStatsStore> with_documents(Builder documents) const;
+
+    // Map doc_stats.bin. False (and an empty store) if it is missing, in
+    // another format version, or fails its checksum.
+    bool load(const std::string& path);
+
+    // source: what the stats were built from, recorded in the header
+    bool save(const std::string& path, const doc_stats_format::Source& source) const;
+
+    // What the loaded file was built from (all zero for stores built in memory)
+    const doc_stats_format::Source& source() const { return source_; }
+
+    bool contains(int doc_id) const {
+        return doc_id >= 0 && doc_id <= max_doc_id_ && lengths_[doc_id] != doc_stats_format::MISSING;
+    }
+
+    // 0 for unknown documents
+    int doc_length(int doc_id) const { return contains(doc_id) ? lengths_[doc_id] : 0; }
+    int title_length(int doc_id) const { return contains(doc_id) ? title_lengths_[doc_id] : 0; }
+
+    // 0 if the word isn't in the document's title (or the document is unknown)
+    int title_frequency(int doc_id, int word_id) const {
+        if (doc_id < 0 || doc_id > max_doc_id_) return 0;
+        const TitleFrequency* entry = entries_ + offsets_[doc_id];
+        const TitleFrequency* end = entries_ + offsets_[doc_id + 1];
+        // A title is a handful of words: a linear scan beats a binary search
+        while (entry != end && entry->word_id < word_id) ++entry;
+        return entry != end && entry->word_id == word_id ? entry->frequency : 0;
+    }
+
+    size_t size() const { return num_documents_; }
+
+    // Sums over all documents, for average field lengths
+    uint64_t total_length() const { return total_length_; }
+    uint64_t total_title_length() const { return total_title_length_; }
+    int max_doc_id() const { return max_doc_id_; }
+    bool is_mapped() const { return file_.is_open(); }
+
+    // Bytes of the columns (mapped or owned)
+    size_t data_bytes() const;
+
+private:
+    // Point the columns at the owned vectors
+    void adopt_owned();
+
+    // total_length_ / total_title_length_ from the columns
+    void sum_lengths();
+
+    MappedFile file_;
+
+    // Owned columns when not mapped
+    std::vector<int32_t> owned_lengths_;
+    std::vector<int32_t> owned_title_lengths_;
+    std::vector<uint32_t> owned_offsets_;
+    std::vector<TitleFrequency> owned_entries_;
+
+    static constexpr uint32_t EMPTY_OFFSETS[1] = {0};
+
+    const int32_t* lengths_ = nullptr;
+    const int32_t* title_lengths_ = nullptr;
+    const uint32_t* offsets_ = EMPTY_OFFSETS;
+    const TitleFrequency* entries_ = nullptr;
+    int max_doc_id_ = -1;
+    size_t num_documents_ = 0;
+    size_t num_entries_ = 0;
+    uint64_t total_length_ = 0;
+    uint64_t total_title_length_ = 0;
+    doc_stats_format::Source source_;
+};
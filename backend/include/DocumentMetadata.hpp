@@ -41,6 +41,12 @@ public:
     // Get citation count (returns 0 if not found)
     int get_cited_by_count(int doc_id) const;
     
+    // Call fn(const DocMetadata&) for every document, in no particular order
+    template <typename Fn>
+    void for_each(Fn&& fn) const {
+        for (const auto& [doc_id, meta] : metadata_) fn(meta);
+    }
+
     // Get total number of documents with metadata
     size_t size() const { return metadata_.size(); }
     
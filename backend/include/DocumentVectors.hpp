@@ -0,0 +1,151 @@
+#pragma once
+// DocumentVectors.hpp
+// Document embedding matrix (document_vectors.bin) and its mmap reader.
+//
+// Rows are indexed by doc id, row-major, each padded to a multiple of 64
+// bytes so every row starts on a cache line (the mapping itself is page
+// aligned). Looking up a document is an index computation, not a hash probe:
+//
+//   VectorFileHeader                          (64 bytes)
+//   matrix     num_rows x row_stride elements (at matrix_offset, 64-aligned)
+//   scales     float x num_rows               (int8 only)
+//   row table  int32 x (max_doc_id + 1)       (only if ROW_TABLE is set)
+//
+// Elements are float32, float16 (IEEE binary16) or int8. An int8 row stores
+// round(x / scale) with scale = max |x| / 127 per row, so its values are
+// q * scale. float16 halves the matrix and int8 quarters it; similarities
+// move by around 1e-5 and 1e-3 respectively, which SemanticScorer can undo for
+// the final results by re-scoring them against a float32 file.
+//
+// Without a row table row i belongs to doc id i; ids the writer had no vector
+// for are all-zero rows, which score 0 like a missing document. When the ids
+// are too sparse for that (more than half the rows would be padding) the
+// matrix holds only the present documents and the row table maps doc id ->
+// row, -1 for none. Rows are unit length (scripts/build_semantic_vectors.py
+// normalizes them). All integers are little-endian.
+//
+// Files in the original record format (int32 count, then int32 doc id + dim
+// floats per document) still load, by reading them into an owned buffer laid
+// out the same way.
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "MappedFile.hpp"
+
+namespace vector_format {
+    constexpr char MAGIC[4] = {'D', 'S', 'A', 'V'};
+    constexpr uint32_t VERSION = 1;
+    constexpr size_t ROW_ALIGNMENT = 64;
+
+    constexpr uint32_t FLAG_ROW_TABLE = 1;
+
+    // Element type of a vector file (also used by WordEmbeddings)
+    enum class Encoding : uint32_t { Float32 = 0, Float16 = 1, Int8 = 2 };
+
+    size_t element_size(Encoding encoding);
+    const char* encoding_name(Encoding encoding);
+    bool parse_encoding(const std::string& name, Encoding& encoding);
+
+    // Elements per row: dim rounded up to a multiple of 64 bytes
+    uint32_t padded_stride(uint32_t dim, Encoding encoding);
+
+    // Store / decode one row of dim elements (unit-length floats in, scale
+    // returned for int8 and 1 otherwise)
+    float encode_row(const float* values, uint32_t dim, Encoding encoding, void* out);
+    void decode_row(const void* row, float scale, uint32_t dim, Encoding encoding, float* out);
+}
+
+// A document and its similarity (dot product) to a query, as returned by the
+// nearest-neighbour searches
+struct VectorMatch {
+    int doc_id;
+    double similarity;
+};
+
+struct VectorFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t dim;
+    uint32_t row_stride;        // Elements per row (dim rounded up to 64 bytes)
+    uint32_t num_rows;
+    uint32_t num_documents;     // Documents that have a vector
+    int32_t max_doc_id;
+    uint32_t flags;
+    uint64_t matrix_offset;
+    uint64_t row_table_offset;  // 0 without FLAG_ROW_TABLE
+    uint32_t encoding;          // vector_format::Encoding (0, float32, in older files)
+    uint32_t reserved;
+    uint64_t scales_offset;     // int8 only, else 0
+};
+static_assert(sizeof(VectorFileHeader) == 64, "VectorFileHeader must stay 64 bytes");
+
+class DocumentVectors {
+public:
+    DocumentVectors() = default;
+
+    DocumentVectors(const DocumentVectors&) = delete;
+    DocumentVectors& operator=(const DocumentVectors&) = delete;
+
+    // Map (or, for the old format, read) the file. dim must match the file's.
+    bool load(const std::string& path, uint32_t dim);
+    void close();
+
+    // Write source's vectors to path in the given encoding, same layout
+    static bool write(const std::string& path, const DocumentVectors& source,
+                      vector_format::Encoding encoding, std::string& error);
+
+    bool is_loaded() const { return matrix_ != nullptr; }
+    bool is_mapped() const { return file_.is_open(); }
+    vector_format::Encoding encoding() const { return encoding_; }
+
+    // Row of doc_id, -1 if it has none
+    int64_t row_index(int doc_id) const {
+        if (doc_id < 0 || doc_id > max_doc_id_) return -1;
+        return row_table_ ? row_table_[doc_id] : doc_id;
+    }
+
+    // Float32 files only: vector of doc_id (dim floats, 64-byte aligned),
+    // nullptr if it has none
+    const float* row_for(int doc_id) const {
+        int64_t row = row_index(doc_id);
+        if (row < 0 || encoding_ != vector_format::Encoding::Float32) return nullptr;
+        return reinterpret_cast<const float*>(row_data(static_cast<uint32_t>(row)));
+    }
+
+    // query . row in any encoding (query has dim floats)
+    double dot(const float* query, uint32_t row) const;
+
+    // Row decoded to dim floats
+    void decode(uint32_t row, float* out) const;
+
+    // Row access in storage order, for scans over the whole matrix
+    const uint8_t* row_data(uint32_t index) const { return matrix_ + static_cast<size_t>(index) * row_bytes_; }
+    float row_scale(uint32_t index) const { return scales_ ? scales_[index] : 1.0f; }
+    uint32_t num_rows() const { return num_rows_; }
+    uint32_t dim() const { return dim_; }
+    int32_t max_doc_id() const { return max_doc_id_; }
+
+    size_t num_documents() const { return num_documents_; }
+
+    // Bytes of vector data (matrix + scales + row table)
+    size_t data_bytes() const;
+
+private:
+    bool load_legacy(const std::string& path, uint32_t dim);
+
+    MappedFile file_;
+    std::vector<float> owned_matrix_;      // Old format only (over-allocated for alignment)
+    std::vector<int32_t> owned_row_table_;
+
+    const uint8_t* matrix_ = nullptr;
+    const float* scales_ = nullptr;        // Int8 only
+    const int32_t* row_table_ = nullptr;   // nullptr: row == doc id
+    vector_format::Encoding encoding_ = vector_format::Encoding::Float32;
+    uint32_t dim_ = 0;
+    size_t row_bytes_ = 0;
+    uint32_t num_rows_ = 0;
+    int32_t max_doc_id_ = -1;
+    size_t num_documents_ = 0;
+};
@@ -0,0 +1,119 @@
+#pragma once
+// HnswIndex.hpp
+// Approximate nearest-neighbour graph (HNSW) over the document vectors
+// (document_vectors.hnsw), for semantic retrieval of documents that share no
+// words with the query.
+//
+// build_hnsw builds the graph offline from document_vectors.bin; the server
+// maps it and walks it with the rows of a DocumentVectors, so the file holds
+// the topology only:
+//
+//   HnswFileHeader                                     (64 bytes)
+//   node rows     uint32 x num_nodes                   row in the vector file
+//   node doc ids  int32 x num_nodes
+//   node levels   uint8 x num_nodes                    (padded to 4 bytes)
+//   upper index   uint32 x num_nodes                   first upper block of the node
+//   level 0       num_nodes x (1 + max_neighbors0) uint32   (at level0_offset, 64-aligned)
+//   upper levels  num_upper_blocks x (1 + max_neighbors) uint32   (at upper_offset)
+//
+// Each neighbour list is a count followed by a fixed number of slots, so
+// finding one is an index computation. A node on level L > 0 owns L upper
+// blocks, for levels 1..L, starting at its upper index. Rows that are all
+// zero (doc ids without a vector) are not in the graph. All integers are
+// little-endian.
+//
+// A graph is only valid with the vector file it was built from, or a
+// quantized copy of it (quantize_vectors keeps the rows): load() checks the
+// dimension, row count and max doc id.
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "DocumentVectors.hpp"
+#include "MappedFile.hpp"
+
+namespace hnsw_format {
+    constexpr char MAGIC[4] = {'D', 'S', 'A', 'H'};
+    constexpr uint32_t VERSION = 1;
+    constexpr uint32_t MAX_LEVEL = 16;
+}
+
+struct HnswFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t dim;
+    uint32_t num_nodes;
+    uint32_t vector_rows;       // num_rows of the vector file the graph was built from
+    int32_t vector_max_doc_id;
+    uint32_t max_neighbors;     // M: neighbour slots on the upper levels
+    uint32_t max_neighbors0;    // Neighbour slots on level 0 (2 * M)
+    uint32_t max_level;
+    uint32_t entry_point;       // Node the searches start from (on max_level)
+    uint32_t ef_construction;   // Build setting, informational
+    uint32_t num_upper_blocks;
+    uint64_t level0_offset;
+    uint64_t upper_offset;
+};
+static_assert(sizeof(HnswFileHeader) == 64, "HnswFileHeader must stay 64 bytes");
+
+class HnswIndex {
+public:
+    struct BuildOptions {
+        uint32_t max_neighbors;     // M
+        uint32_t ef_construction;   // Beam width while inserting
+        uint32_t seed;              // Level assignment
+
+        BuildOptions() : max_neighbors(16), ef_construction(200), seed(42) {}
+        BuildOptions(uint32_t max_neighbors, uint32_t ef_construction, uint32_t seed = 42)
+            : max_neighbors(max_neighbors), ef_construction(ef_construction), seed(seed) {}
+    };
+
+    HnswIndex() = default;
+
+    HnswIndex(const HnswIndex&) = delete;
+    HnswIndex& operator=(const HnswIndex&) = delete;
+
+    // Build the graph over every non-zero row of vectors and write it to path
+    static bool build(const DocumentVectors& vectors, const BuildOptions& options,
+                      const std::string& path, std::string& error);
+
+    // Map the graph built for vectors
+    bool load(const std::string& path, const DocumentVectors& vectors);
+    void close();
+
+    bool is_loaded() const { return file_.is_open(); }
+
+    // Approximate best k documents for query (unit length, dim floats) by dot
+    // product with their rows in vectors (the ones passed to load(), or a file
+    // with the same rows), best first. ef is the beam width on level 0 (raised
+    // to k); larger finds more of the true top k, slower.
+    std::vector<VectorMatch> search(const DocumentVectors& vectors, const float* query,
+                                 size_t k, size_t ef) const;
+
+    uint32_t num_nodes() const { return num_nodes_; }
+    uint32_t max_level() const { return max_level_; }
+
+private:
+    // Neighbour list of node on level: count, then the node numbers
+    const uint32_t* neighbors(uint32_t node, uint32_t level) const {
+        if (level == 0) return level0_ + static_cast<size_t>(node) * (1 + max_neighbors0_);
+        return upper_ + (static_cast<size_t>(upper_index_[node]) + level - 1) * (1 + max_neighbors_);
+    }
+
+    MappedFile file_;
+
+    const uint32_t* node_rows_ = nullptr;
+    const int32_t* node_doc_ids_ = nullptr;
+    const uint8_t* node_levels_ = nullptr;
+    const uint32_t* upper_index_ = nullptr;
+    const uint32_t* level0_ = nullptr;
+    const uint32_t* upper_ = nullptr;
+
+    uint32_t num_nodes_ = 0;
+    uint32_t vector_rows_ = 0;
+    uint32_t max_neighbors_ = 0;
+    uint32_t max_neighbors0_ = 0;
+    uint32_t max_level_ = 0;
+    uint32_t entry_point_ = 0;
+};
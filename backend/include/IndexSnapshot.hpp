@@ -0,0 +1,121 @@
+#pragma once
+// IndexSnapshot.hpp
+// Immutable view of everything a search reads: lexicon, on-disk segments, delta
+// index, document stats, metadata and URLs. SearchService publishes the current
+// snapshot through an atomic shared_ptr; a search grabs it once and works on it
+// without locks, while reloads build a new snapshot on the side and swap it in.
+// Old snapshots (and their barrel mappings) live until the last search using
+// them finishes.
+//
+// Parts are held by shared_ptr so a reload that only changes the delta index
+// can reuse the lexicon, metadata, etc. of the previous snapshot. Documents
+// added since startup live in the delta MemorySegment, whose stats, metadata
+// and words take precedence over the base structures loaded from disk.
+//
+// Ranking reads a document's stats once per query word; get_doc_stats()
+// resolves where they live once per document.
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <atomic>
+#include "LexiconWithTrie.hpp"
+#include "BinaryBarrel.hpp"
+#include "BarrelCache.hpp"
+#include "MemorySegment.hpp"
+#include "DocStatsStore.hpp"
+#include "doc_url_mapper.hpp"
+#include "DocumentMetadata.hpp"
+#include "StaticScores.hpp"
+
+// Barrels of one on-disk segment. Barrels are mapped on first use and kept in
+// the shared BarrelCache; every BarrelSet gets a fresh generation so a reload
+// never reuses mappings of files that were rewritten since.
+class BarrelSet {
+public:
+    static constexpr int NUM_BARRELS = 100;
+
+    BarrelSet(std::string barrels_dir, std::shared_ptr<BarrelCache> cache);
+    ~BarrelSet();
+
+    BarrelSet(const BarrelSet&) = delete;
+    BarrelSet& operator=(const BarrelSet&) = delete;
+
+    // nullptr if the barrel file is missing or invalid. Hold on to the result
+    // while reading from it: the cache may evict it concurrently.
+    std::shared_ptr<const BinaryBarrel> get(int barrel_id) const;
+
+    uint64_t generation() const { return generation_; }
+    const std::string& dir() const { return barrels_dir_; }
+
+    // The segment was merged away: delete its barrel files once the last
+    // snapshot using it is gone
+    void retire() const { retired_ = true; }
+
+    // Delete the barrel files in barrels_dir, and the directory if that
+    // leaves it empty. Mappings still held by running searches stay valid.
+    static void remove_files(const std::string& barrels_dir);
+
+private:
+    std::string barrels_dir_;
+    uint64_t generation_;
+    std::shared_ptr<BarrelCache> cache_;
+    mutable std::atomic<bool> retired_{false};
+};
+
+// Stats of one document, wherever they live
+class DocStatsRef {
+public:
+    int doc_length() const {
+        return delta_ ? delta_->doc_length : store_->doc_length(doc_id_);
+    }
+    int title_length() const {
+        return delta_ ? delta_->title_length : store_->title_length(doc_id_);
+    }
+    int title_frequency(int word_id) const;
+
+private:
+    friend struct IndexSnapshot;
+    DocStatsRef(const DocStats* delta, const DocStatsStore* store, int doc_id)
+        : delta_(delta), store_(store), doc_id_(doc_id) {}
+
+    const DocStats* delta_;        // Segment stats, or nullptr for the base store
+    const DocStatsStore* store_;
+    int doc_id_;
+};
+
+struct IndexSnapshot {
+    uint64_t generation = 0;
+
+    std::shared_ptr<const LexiconWithTrie> lexicon;
+    std::shared_ptr<const DocURLMapper> doc_urls;
+    std::shared_ptr<const DocumentMetadata> metadata;
+    std::shared_ptr<const StaticScores> static_scores;  // Of metadata
+    std::shared_ptr<const DocStatsStore> doc_stats;
+    std::shared_ptr<const MemorySegment> delta;
+    DeltaLogCursor delta_cursor;  // How much of the delta log `delta` contains
+    std::vector<std::shared_ptr<const BarrelSet>> segments;  // Disjoint documents, oldest first
+
+    // -1 if the word is unknown
+    int get_word_index(const std::string& word) const;
+
+    // Up to k words of the lexicon and the delta starting with prefix, in
+    // lexicographic order
+    std::vector<std::string> autocomplete(const std::string& prefix, int k) const;
+
+    // Array reads, no hashing (unless the delta segment has stats)
+    DocStatsRef get_doc_stats(int doc_id) const;
+    const DocMetadata* get_metadata(int doc_id) const;
+    StaticScore get_static_score(int doc_id) const;
+    const std::string& get_url(int doc_id) const;
+
+    // BM25F statistics over every document with stats: the collection as it
+    // is now, for the delta and for barrels written from here on
+    CollectionStats collection_stats() const;
+
+    // Documents containing the word, over all segments and the delta (opens
+    // the barrels it is in)
+    uint32_t document_frequency(int word_id) const;
+};
@@ -0,0 +1,145 @@
+#pragma once
+// IvfPqIndex.hpp
+// Compressed document vectors for semantic search when even quantized
+// document vectors don't fit: an inverted file (IVF) of k-means lists with
+// 4-bit product-quantized (PQ) residuals (document_vectors.ivfpq), a few dozen
+// bytes per document instead of 300-1200.
+//
+// Each document is assigned to its nearest list centroid c; the residual
+// x - c is split into num_subspaces subvectors and each one is replaced by the
+// nearest of 16 codewords trained for that subspace. Since
+//
+//   q . x  ~=  q . c  +  sum over subspaces j of  q_j . codeword_j[code_j]
+//
+// one table of 16 entries per subspace, computed once per query, scores any
+// document in any list with num_subspaces lookups. A search scores the
+// centroids, scans the nprobe best lists with 8-bit copies of the tables
+// (vector_kernels::pq4_scan, a byte shuffle per subspace for 16 documents),
+// and re-scores the best candidates with the float tables.
+//
+//   IvfPqFileHeader                                   (80 bytes)
+//   centroids   float x num_lists x dim              (64-aligned, like every section)
+//   codebooks   float x num_subspaces x 16 x sub_dim (sub_dim = dim / num_subspaces)
+//   list blocks uint32 x (num_lists + 1)             first block of each list, then the total
+//   doc ids     int32 x blocks x 32                  -1 for padding
+//   doc slots   uint32 x (max_doc_id + 1)            block * 32 + position, NO_SLOT for none
+//   codes       blocks x num_subspaces x 16 bytes    vector_kernels::pq4_scan layout
+//
+// A list's documents sit in consecutive blocks of 32 (the last one padded).
+// The file doesn't depend on document_vectors.bin once built (build_ivfpq).
+// All integers are little-endian.
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "DocumentVectors.hpp"
+#include "MappedFile.hpp"
+
+namespace ivfpq_format {
+    constexpr char MAGIC[4] = {'D', 'S', 'A', 'P'};
+    constexpr uint32_t VERSION = 1;
+    constexpr uint32_t CODEWORDS = 16;              // 4-bit codes
+    constexpr uint32_t NO_SLOT = 0xFFFFFFFF;
+}
+
+struct IvfPqFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t dim;
+    uint32_t num_lists;
+    uint32_t num_subspaces;
+    uint32_t num_documents;
+    int32_t max_doc_id;
+    uint32_t reserved;
+    uint64_t centroids_offset;
+    uint64_t codebooks_offset;
+    uint64_t lists_offset;
+    uint64_t doc_ids_offset;
+    uint64_t slots_offset;
+    uint64_t codes_offset;  // Codes run to the end of the file
+};
+static_assert(sizeof(IvfPqFileHeader) == 80, "IvfPqFileHeader must stay 80 bytes");
+
+class IvfPqIndex {
+public:
+    struct TrainOptions {
+        uint32_t num_lists;         // 0: about 4 * sqrt(documents)
+        uint32_t num_subspaces;     // Must divide the dimension; code bytes per document = half of it
+        uint32_t iterations;        // k-means iterations, for the lists and each codebook
+        uint32_t sample_size;       // Documents the k-means runs on
+        uint32_t seed;
+
+        TrainOptions() : num_lists(0), num_subspaces(50), iterations(20), sample_size(100000), seed(42) {}
+        TrainOptions(uint32_t num_lists, uint32_t num_subspaces, uint32_t iterations = 20,
+                     uint32_t sample_size = 100000, uint32_t seed = 42)
+            : num_lists(num_lists), num_subspaces(num_subspaces), iterations(iterations),
+              sample_size(sample_size), seed(seed) {}
+    };
+
+    // The recall / speed knobs of a search
+    struct SearchOptions {
+        uint32_t nprobe;            // Lists scanned; more finds more of the true top k, slower
+        uint32_t rerank_factor;     // k * this candidates from the 8-bit scan get float scores
+
+        SearchOptions() : nprobe(16), rerank_factor(4) {}
+        SearchOptions(uint32_t nprobe, uint32_t rerank_factor = 4)
+            : nprobe(nprobe), rerank_factor(rerank_factor) {}
+    };
+
+    IvfPqIndex() = default;
+
+    IvfPqIndex(const IvfPqIndex&) = delete;
+    IvfPqIndex& operator=(const IvfPqIndex&) = delete;
+
+    // Train on vectors and encode all of them into path. Uses every core.
+    static bool build(const DocumentVectors& vectors, const TrainOptions& options,
+                      const std::string& path, std::string& error);
+
+    bool load(const std::string& path, uint32_t dim);
+    void close();
+
+    bool is_loaded() const { return file_.is_open(); }
+
+    // Approximate best k documents for query (unit length, dim floats), best
+    // first, with their estimated similarities
+    std::vector<VectorMatch> search(const float* query, size_t k, const SearchOptions& options) const;
+
+    // Estimated similarity of query to each of doc_ids (0 for documents
+    // that aren't in the index)
+    void score(const float* query, const int* doc_ids, size_t count, double* scores) const;
+
+    uint32_t num_lists() const { return num_lists_; }
+    uint32_t num_subspaces() const { return num_subspaces_; }
+    size_t num_documents() const { return num_documents_; }
+    uint32_t dim() const { return dim_; }
+
+    // Bytes of the mapped file
+    size_t data_bytes() const { return file_.size(); }
+
+private:
+    // Float table (num_subspaces x 16) of q_j . codeword_j[c]
+    void compute_tables(const float* query, std::vector<float>& tables) const;
+
+    // q . residual of the document in slot, from the float tables
+    double residual_score(uint32_t slot, const std::vector<float>& tables) const;
+
+    // List holding slot
+    uint32_t list_of(uint32_t slot) const;
+
+    MappedFile file_;
+
+    const float* centroids_ = nullptr;
+    const float* codebooks_ = nullptr;
+    const uint32_t* list_blocks_ = nullptr;
+    const int32_t* doc_ids_ = nullptr;
+    const uint32_t* slots_ = nullptr;
+    const uint8_t* codes_ = nullptr;
+
+    uint32_t dim_ = 0;
+    uint32_t sub_dim_ = 0;
+    uint32_t num_lists_ = 0;
+    uint32_t num_subspaces_ = 0;
+    int32_t max_doc_id_ = -1;
+    size_t num_documents_ = 0;
+};
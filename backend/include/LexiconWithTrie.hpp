@@ -26,6 +26,7 @@ public:
     std::string get_word(int index) const;
     size_t size() const;
     bool contains_word(const std::string& word) const;
+    bool is_significant_word(const std::string& word) const;
 
     // Autocomplete functionality
     std::vector<std::string> autocomplete(const std::string& prefix, int k) const;
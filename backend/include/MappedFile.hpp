@@ -0,0 +1,35 @@
+#pragma once
+// MappedFile.hpp
+// Read-only memory-mapped file (RAII wrapper around mmap / MapViewOfFile).
+// Lets the serving path read binary index files straight out of the page cache
+// without copying or parsing them.
+
+#include <string>
+#include <cstddef>
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // Map the whole file read-only. Returns false if it can't be opened or is empty.
+    bool open(const std::string& path);
+    void close();
+
+    bool is_open() const { return data_ != nullptr; }
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_handle_ = nullptr;
+    void* mapping_handle_ = nullptr;
+#endif
+};
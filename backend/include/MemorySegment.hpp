@@ -0,0 +1,110 @@
+#pragma once
+// MemorySegment.hpp
+// In-memory index of the documents added since the last full build: the ones
+// replayed from the delta log at startup plus everything BatchIndexWriter
+// publishes afterwards. Besides the postings it carries the doc stats,
+// metadata and new lexicon words of published documents, so they are
+// searchable (and suggested by autocomplete) before any of the JSON files on
+// disk have been rewritten.
+//
+// Segments are immutable once published. Adding documents builds a new
+// segment (cost proportional to the segment, not the corpus) that the next
+// IndexSnapshot points to. Once documents are flushed to an on-disk segment
+// their postings are dropped here; stats, metadata and words stay.
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "DeltaLog.hpp"
+#include "DocumentMetadata.hpp"
+#include "LexiconWithTrie.hpp"
+#include "RankingScorer.hpp"
+#include "Trie.hpp"
+
+// Struct for Delta Index entries
+struct DeltaEntry {
+    int doc_id;
+    int frequency;
+    std::vector<int> positions;
+};
+
+// In-memory document stats for fast lookup
+struct DocStats {
+    int doc_length;
+    int title_length;
+    std::unordered_map<int, int> title_frequencies; // word_id -> title_freq
+};
+
+using DeltaIndex = std::unordered_map<int, std::vector<DeltaEntry>>;
+using DocStatsMap = std::unordered_map<int, DocStats>;
+
+// One document to add to a segment
+struct SegmentDocument {
+    DeltaDocument index;               // Doc id + postings
+
+    // Word of each posting ("" if unknown), so words added to the lexicon after
+    // startup can be queried. Empty for documents replayed from the delta log.
+    std::vector<std::string> words;
+
+    // Distinct tokens of the document, lowercased: the words the lexicon will
+    // gain from it, offered for autocomplete once it is published
+    std::vector<std::string> vocabulary;
+
+    bool has_stats = false;            // Otherwise the snapshot's doc stats are used
+    DocStats stats{};
+    bool has_metadata = false;         // Otherwise the snapshot's metadata is used
+    DocMetadata metadata;
+    StaticScore static_score;          // Of metadata, with has_metadata
+};
+
+class MemorySegment {
+public:
+    // This segment plus documents. Documents it already holds are skipped;
+    // words the served lexicon knows aren't duplicated.
+    std::shared_ptr<const MemorySegment> with_documents(std::vector<SegmentDocument> documents,
+                                                        const LexiconWithTrie& lexicon) const;
+
+    // This segment without the postings of documents (now in an on-disk
+    // segment). They still count as contained, so replaying them is a no-op.
+    std::shared_ptr<const MemorySegment> without_postings(const std::unordered_set<int>& doc_ids) const;
+
+    // nullptr if not in the segment. Sorted by doc id.
+    const std::vector<DeltaEntry>* postings(int word_id) const;
+    const DocStats* stats(int doc_id) const;
+    const DocMetadata* metadata(int doc_id) const;
+    const StaticScore* static_score(int doc_id) const;
+
+    // -1 if the segment added no such word
+    int word_id(const std::string& word) const;
+
+    // Up to k words of published documents the served lexicon lacks, starting
+    // with prefix, in lexicographic order
+    std::vector<std::string> autocomplete(const std::string& prefix, int k) const;
+
+    bool contains(int doc_id) const { return known_ids_.count(doc_id) > 0; }
+    size_t num_documents() const { return doc_ids_.size(); }  // With postings here
+    size_t num_words() const { return postings_.size(); }
+
+    // Documents with stats here, and the sums of their lengths
+    size_t num_stats() const { return stats_.size(); }
+    uint64_t total_length() const { return total_length_; }
+    uint64_t total_title_length() const { return total_title_length_; }
+
+private:
+    DeltaIndex postings_;
+    std::unordered_set<int> doc_ids_;
+    std::unordered_set<int> known_ids_;  // doc_ids_ plus flushed documents
+    DocStatsMap stats_;
+    uint64_t total_length_ = 0;
+    uint64_t total_title_length_ = 0;
+    std::unordered_map<int, DocMetadata> metadata_;
+    std::unordered_map<int, StaticScore> static_scores_;
+    std::unordered_map<std::string, int> words_;
+
+    // Overlay on the lexicon's trie. Shared between segments and only
+    // copied when documents bring new words, so that costs the words added
+    // since startup, not the vocabulary.
+    std::shared_ptr<const Trie> suggestions_;
+};
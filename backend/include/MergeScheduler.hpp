@@ -0,0 +1,123 @@
+#pragma once
+// MergeScheduler.hpp
+// Background maintenance of the on-disk segments (LSM-style, size-tiered):
+//
+//  - Flush: once the delta log holds flush_documents documents (or its oldest
+//    one waited max_delta_age), they are written as a new small segment, the
+//    manifest is replaced and the flushed prefix is cut off the log.
+//  - Merge: segments are grouped into size tiers (tier_base_bytes, then
+//    merge_factor times larger per tier). When a tier holds merge_factor
+//    segments, they are merged into one segment of the next tier.
+//
+// Segments are immutable: both steps write a new directory, save the manifest
+// and hand it to the publisher (SearchService::publish_segments), which swaps
+// it into the served snapshot. A merge also names the segments it replaced;
+// their files are deleted once no snapshot reads them any more (right away
+// without a publisher). Queries never wait for any of this. Reads and
+// writes are throttled to io_bytes_per_sec so merges don't starve searches of
+// disk bandwidth.
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "BinaryBarrel.hpp"
+#include "DeltaLog.hpp"
+#include "SegmentManifest.hpp"
+
+class MergeScheduler {
+public:
+    struct Options {
+        size_t flush_documents = 100;
+        std::chrono::seconds max_delta_age{600};
+        size_t merge_factor = 4;
+        uint64_t tier_base_bytes = 4ull * 1024 * 1024;
+        uint64_t io_bytes_per_sec = 32ull * 1024 * 1024;
+        std::chrono::seconds poll_interval{5};
+    };
+
+    // merged_dirs: directories (under barrels_dir) of the segments a merge
+    // replaced, for the publisher to delete once unused
+    using PublishFn = std::function<void(const SegmentManifest& manifest,
+                                         const std::unordered_set<int>& flushed_doc_ids,
+                                         const std::vector<std::string>& merged_dirs)>;
+    // Collection statistics, IDFs and scores to write a new segment with
+    using ScoringFn = std::function<BarrelScoring()>;
+
+    // log: the instance documents are appended through, so compaction can't
+    // race an append. scoring is asked once per flush / merge, so every new
+    // segment is scored (and bounded) with the statistics current then
+    // (nullptr: local statistics, unbounded, no pruning on it).
+    MergeScheduler(std::string barrels_dir, DeltaLog& log, PublishFn publisher,
+                   ScoringFn scoring, Options options);
+    MergeScheduler(std::string barrels_dir, DeltaLog& log, PublishFn publisher,
+                   ScoringFn scoring = nullptr);
+
+    ~MergeScheduler();
+
+    MergeScheduler(const MergeScheduler&) = delete;
+    MergeScheduler& operator=(const MergeScheduler&) = delete;
+
+    struct Stats {
+        size_t flushes = 0;
+        size_t merges = 0;
+        size_t documents_flushed = 0;
+        size_t segments = 0;
+        size_t pending_documents = 0;   // In the delta log, not in a segment yet
+        uint64_t bytes_written = 0;
+        uint64_t throttled_ms = 0;
+    };
+    Stats get_stats() const;
+
+private:
+    void scheduler_thread();
+
+    // Read new delta log records into pending_
+    void poll_delta();
+    bool flush_delta();
+
+    // Merge one full tier; false if no tier is full
+    bool merge_tier();
+    size_t tier_of(uint64_t bytes) const;
+
+    // Write all barrels of a new segment directory; fill produces one barrel
+    // and returns the bytes it read. False (and nothing left behind) on error
+    // or shutdown.
+    bool write_segment(const std::string& dir, const std::function<uint64_t(int, BarrelMap&)>& fill,
+                       uint64_t& bytes);
+    bool commit(SegmentManifest next, const std::unordered_set<int>& flushed_doc_ids,
+                const std::vector<std::string>& merged_dirs = {});
+
+    // Sleep so that I/O stays within the budget
+    void throttle(uint64_t bytes, std::chrono::steady_clock::time_point started);
+
+    // Segment files left behind by a crash between writing and committing
+    void remove_orphans();
+
+    std::string new_segment_dir();
+
+    std::string barrels_dir_;
+    DeltaLog& log_;
+    PublishFn publisher_;
+    ScoringFn scoring_;
+    Options options_;
+
+    // Owned by the scheduler thread
+    SegmentManifest manifest_;
+    DeltaLogCursor cursor_;                  // End of the records in pending_
+    std::vector<DeltaDocument> pending_;
+    std::chrono::steady_clock::time_point pending_since_;
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::atomic<bool> shutdown_{false};
+
+    mutable std::mutex stats_mutex_;
+    Stats stats_{};
+};
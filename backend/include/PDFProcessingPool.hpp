@@ -7,22 +7,17 @@
 #include <functional>
 #include <future>
 #include "BatchIndexWriter.hpp"
+#include "PDFProcessor.hpp"
+#include "TokenizerWorkerPool.hpp"
 #include "lexicon.hpp"
 
-struct ProcessedPDF {
-    int doc_id;
-    std::string title;
-    std::vector<std::string> tokens;
-    bool success = false;
-    std::string error;
-};
-
 class PDFProcessingPool {
 public:
     explicit PDFProcessingPool(
         size_t num_threads,
         BatchIndexWriter& batch_writer,
-        Lexicon& lexicon
+        Lexicon& lexicon,
+        TokenizerWorkerPool& tokenizer_workers
     );
     
     ~PDFProcessingPool();
@@ -39,6 +34,8 @@ public:
         size_t queue_size = 0;
         size_t completed_tasks = 0;
         size_t failed_tasks = 0;
+        size_t native_extractions = 0;    // Tokenized in-process
+        size_t fallback_extractions = 0;  // Needed the Python tokenizer
     };
     Stats get_stats() const;
     
@@ -51,6 +48,7 @@ private:
     
     void worker_thread();
     void process_pdf(Task& task);
+    ProcessedPDF extract_native(const std::string& pdf_path, int doc_id);
     ProcessedPDF call_python_tokenizer(const std::string& pdf_path, int doc_id);
     std::map<int, WordStats> build_doc_stats(
         const std::vector<std::string>& tokens
@@ -58,6 +56,7 @@ private:
     
     BatchIndexWriter& batch_writer_;
     Lexicon& lexicon_;
+    TokenizerWorkerPool& tokenizer_workers_;
     
     std::vector<std::thread> workers_;
     std::queue<Task> task_queue_;
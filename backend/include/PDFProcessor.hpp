@@ -7,13 +7,15 @@
 #include "inverted_index.hpp"
 #include "DocumentMetadata.hpp"
 #include "doc_url_mapper.hpp"
+#include "TokenizerWorkerPool.hpp"
 
+// Tokenizer output; shared with PDFProcessingPool, which leaves doc_stats empty
 struct ProcessedPDF {
-    int doc_id;
+    int doc_id = -1;
     std::string title;
     std::vector<std::string> tokens;
     std::map<int, WordStats> doc_stats;
-    bool success;
+    bool success = false;
     std::string error;
 };
 
@@ -24,15 +26,13 @@ public:
         ForwardIndexBuilder& forward_builder,
         InvertedIndexBuilder& inverted_builder,
         DocumentMetadata& metadata,
-        DocURLMapper& url_mapper
+        DocURLMapper& url_mapper,
+        TokenizerWorkerPool& tokenizer_workers
     );
 
     // Process a single uploaded PDF and add to indices
     bool process_and_index(const std::string& pdf_path, int& assigned_doc_id);
     
-    // Check and merge delta barrel if needed
-    void check_and_merge_delta();
-    
     // Clean up old temporary files
     static void cleanup_temp_files();
 
@@ -42,11 +42,12 @@ private:
     InvertedIndexBuilder& inverted_builder_;
     DocumentMetadata& metadata_;
     DocURLMapper& url_mapper_;
+    TokenizerWorkerPool& tokenizer_workers_;
 
     // Get next available doc_id
     int get_next_doc_id();
     
-    // Call Python tokenizer
+    // Native extraction, falling back to the tokenizer workers
     ProcessedPDF tokenize_pdf(const std::string& pdf_path, int doc_id);
     
     // Build doc stats from tokens
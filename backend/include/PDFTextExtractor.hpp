@@ -0,0 +1,39 @@
+#pragma once
+// PDFTextExtractor.hpp
+// In-process replacement for scripts/tokenize_single_pdf.py: reads the text of
+// an uploaded PDF and tokenizes it without starting a Python interpreter.
+//
+// Covers what the uploads usually are - unencrypted PDFs whose content streams
+// are uncompressed or FlateDecode, with simple fonts or fonts carrying a
+// ToUnicode CMap (classic xref tables and PDF 1.5 object streams alike).
+// Anything else (encryption, other stream filters, CID fonts without a
+// ToUnicode map, text that only decodes to fragments) makes extract() fail
+// with a reason, and the caller falls back to the Python tokenizer.
+//
+// Output follows the script: title from the document info, else the first
+// reasonable line of page 1, else the file name; body tokens from the first
+// MAX_PAGES pages, lowercased [a-z0-9]+ runs, cut at MAX_TOKENS and then
+// stripped of single-character tokens.
+
+#include <string>
+#include <vector>
+
+class PDFTextExtractor {
+public:
+    static constexpr int MAX_PAGES = 20;
+    static constexpr size_t MAX_TOKENS = 5000;
+
+    struct Result {
+        std::string title;
+        std::vector<std::string> tokens;
+        int pages = 0;                 // Pages read (at most MAX_PAGES)
+    };
+
+    // False with error set when the PDF needs the fallback tokenizer
+    static bool extract(const std::string& pdf_path, Result& out, std::string& error);
+
+    // tokenize_fast() of the script: append the lowercased [a-z0-9]+ runs of
+    // text to tokens, stopping once it holds max_tokens
+    static void tokenize(const std::string& text, std::vector<std::string>& tokens,
+                         size_t max_tokens = MAX_TOKENS);
+};
@@ -0,0 +1,35 @@
+#pragma once
+// PositionalMatch.hpp
+// Phrase and proximity tests over the positions of a document's postings.
+//
+// A posting's positions are its title positions followed by its body
+// positions; each run is sorted and both start at 0, so the split is the
+// word's title frequency. Matches never cross from one field to the other.
+// Every test is a two-pointer merge over the sorted runs: linear in the
+// number of positions.
+
+#include <cstddef>
+
+namespace positional {
+
+// Positions of one word in one document, by field
+struct TermPositions {
+    const int* title = nullptr;
+    size_t num_title = 0;
+    const int* body = nullptr;
+    size_t num_body = 0;
+
+    // positions as stored in a posting; title_frequency of them are the title's
+    static TermPositions split(const int* positions, size_t count, int title_frequency);
+};
+
+// The words occur in this order at consecutive positions of one field
+bool phrase(const TermPositions* terms, size_t num_terms);
+
+// b occurs right after a somewhere (a two-word phrase)
+bool adjacent(const TermPositions& a, const TermPositions& b);
+
+// a and b occur at most distance positions apart, in either order, in one field
+bool near(const TermPositions& a, const TermPositions& b, int distance);
+
+} // namespace positional
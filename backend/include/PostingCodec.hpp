@@ -0,0 +1,48 @@
+#pragma once
+// PostingCodec.hpp
+// Integer compression for posting lists.
+//
+// Values are packed with Stream VByte (Lemire, Kurz, Rupp): a run of control
+// bytes (2 bits per value = byte length - 1) followed by the data bytes. Keeping
+// the lengths apart from the data lets the decoder expand 4 values with a single
+// SSSE3 shuffle; CPUs without SSSE3 use the scalar decoder.
+//
+// Sorted doc ids are delta coded before packing (prefix sum on decode), position
+// lists are zigzag delta coded because title and body positions both restart at 0.
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace posting_codec {
+
+// The SIMD decoder loads 16 bytes at a time, so it may read up to this many
+// bytes past the end of a stream. Writers must pad their buffers accordingly.
+constexpr size_t DECODE_PADDING = 16;
+
+// Append the encoding of n values to out. Returns bytes written.
+size_t encode(const uint32_t* in, size_t n, std::vector<uint8_t>& out);
+
+// Decode n values into out. Returns bytes consumed.
+size_t decode(const uint8_t* in, size_t n, uint32_t* out);
+
+// Bytes decode() consumes for n values, read off their control bytes alone
+size_t encoded_size(const uint8_t* in, size_t n);
+
+// Turn sorted values into gaps (first gap relative to base) and back
+void delta_encode(uint32_t* values, size_t n, uint32_t base);
+void prefix_sum(uint32_t* values, size_t n, uint32_t base);
+
+inline uint32_t zigzag_encode(int32_t v) {
+    return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31);
+}
+
+inline int32_t zigzag_decode(uint32_t v) {
+    return static_cast<int32_t>(v >> 1) ^ -static_cast<int32_t>(v & 1);
+}
+
+// The portable decoder and prefix sum (the tests check the SIMD ones against them)
+size_t decode_scalar(const uint8_t* in, size_t n, uint32_t* out);
+void prefix_sum_scalar(uint32_t* values, size_t n, uint32_t base);
+
+} // namespace posting_codec
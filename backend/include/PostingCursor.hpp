@@ -0,0 +1,62 @@
+#pragma once
+// PostingCursor.hpp
+// Forward-only iterator over one compressed posting list, for document-at-a-time
+// query evaluation. Blocks are decoded only when the cursor lands in them and
+// positions only when asked for, so skipping (next_geq / shallow_seek) over
+// blocks that can't matter costs just a look at their skip entries. Skips
+// gallop over the skip entries, and search a decoded block with SIMD compares
+// (PostingIntersect).
+
+#include <climits>
+#include <vector>
+#include "BinaryBarrel.hpp"
+
+class PostingCursor {
+public:
+    static constexpr int END = INT_MAX;
+
+    explicit PostingCursor(const PostingListView& list);
+
+    // Current doc id, END once exhausted
+    int doc() const { return doc_; }
+    uint32_t size() const { return list_.size; }
+    float max_score() const { return list_.max_score; }
+    float idf() const { return list_.idf; }
+
+    void next();
+
+    // Advance to the first posting with doc id >= target
+    void next_geq(int target);
+
+    // Move only the block pointer to the block that would contain target,
+    // without decoding anything. Returns false if no block can contain it.
+    bool shallow_seek(int target);
+    float block_max_score() const { return list_.blocks[shallow_block_].max_score; }
+    int block_last_doc() const { return list_.blocks[shallow_block_].last_doc_id; }
+
+    // Doc ids of the decoded block from the current posting on
+    const int32_t* block_docs() const { return block_.doc_ids + index_; }
+    size_t block_remaining() const { return doc_ == END ? 0 : block_.count - index_; }
+
+    // Data of the current posting
+    int frequency() const { return block_.frequencies[index_]; }
+    const int* positions();
+    size_t num_positions() const {
+        return block_.position_starts[index_ + 1] - block_.position_starts[index_];
+    }
+
+private:
+    void load_block(uint32_t b);
+
+    // First block from `from` on whose last doc id is >= target (num_blocks if none)
+    uint32_t first_block_reaching(uint32_t from, int target) const;
+
+    PostingListView list_;
+    PostingBlock block_;
+    std::vector<int32_t> positions_;
+    uint32_t block_index_ = 0;    // Decoded block
+    uint32_t shallow_block_ = 0;  // Block examined by shallow_seek
+    uint32_t index_ = 0;          // Position inside the decoded block
+    bool positions_loaded_ = false;
+    int doc_ = END;
+};
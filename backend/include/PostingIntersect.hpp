@@ -0,0 +1,55 @@
+#pragma once
+// PostingIntersect.hpp
+// Search and intersection over sorted doc ids, for AND queries.
+//
+// gallop() finds the first element not below a target by doubling steps from
+// where the last search stopped, then binary searching the last step: cost
+// grows with the log of the distance skipped, not the length of the list, so a
+// rare term can drive a common one. lower_bound() and intersect() work on the
+// decoded doc ids of a posting block (at most BLOCK_SIZE) with AVX2 compares,
+// 8 doc ids at a time; CPUs without AVX2 use the scalar code.
+
+#include <cstddef>
+#include <cstdint>
+
+namespace posting_intersect {
+
+// First i in [from, n) for which below(i) is false, where below(i) is true
+// for a prefix of the range (elements smaller than the target)
+template <typename Below>
+size_t gallop(size_t from, size_t n, Below below) {
+    if (from >= n || !below(from)) return from;
+    size_t low = from;  // below(low) holds
+    size_t step = 1;
+    while (low + step < n && below(low + step)) {
+        low += step;
+        step *= 2;
+    }
+    size_t high = low + step < n ? low + step : n;  // below(high) fails, or high == n
+    while (high - low > 1) {
+        size_t mid = low + (high - low) / 2;
+        if (below(mid)) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return high;
+}
+
+// Index of the first of the sorted values[0, n) that is >= target (n if none)
+size_t lower_bound(const int32_t* values, size_t n, int32_t target);
+
+// Values in both sorted, duplicate-free arrays a and b, in order, into out.
+// Returns how many. out may be a (written no faster than a is read).
+size_t intersect(const int32_t* a, size_t na, const int32_t* b, size_t nb, int32_t* out);
+
+// The portable versions the two fall back to without AVX2 (the tests check
+// the AVX2 ones against them)
+size_t lower_bound_scalar(const int32_t* values, size_t n, int32_t target);
+size_t intersect_scalar(const int32_t* a, size_t na, const int32_t* b, size_t nb, int32_t* out);
+
+// Whether lower_bound / intersect use the AVX2 versions on this machine
+bool simd_enabled();
+
+} // namespace posting_intersect
@@ -0,0 +1,57 @@
+#pragma once
+// QueryParser.hpp
+// Turns what was typed in the search box into a query tree:
+//
+//   machine learning           both words, anywhere in the document
+//   "machine learning"         the words as a phrase: consecutive, in one field
+//   neural NEAR/3 network      both words, at most 3 positions apart (either
+//                              order), in one field
+//   neural OR network          either word
+//   learning -machine          learning, in documents without machine
+//   (graph OR tree) search     parentheses group
+//   title:graph  title:"neural network"  title:(a OR b)
+//                              only matches in the title
+//
+// Words are lowercased and split at anything that isn't a letter or digit, as
+// before. OR and NEAR/k only count as operators in capitals; NEAR/k joins the
+// word before it and the word after it. A minus excludes what follows only at
+// the start of a word ("state-of-the-art" is still four words). An unclosed
+// quote or parenthesis runs to the end of the query. Words next to each other
+// are ANDed, and AND binds tighter than OR.
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct QueryNode {
+    enum class Kind {
+        Word,      // words[first]
+        Phrase,    // words[first, first + count) at consecutive positions
+        Near,      // words[first] and words[first + 1], at most distance apart
+        And,       // Every child; Not children exclude
+        Or,        // Any child
+        Not        // children[0] must not match (only meaningful under And)
+    };
+
+    Kind kind = Kind::And;
+    size_t first = 0;
+    size_t count = 0;
+    int distance = 0;
+    bool title_only = false;   // Word / Phrase / Near: match in the title only
+    std::vector<QueryNode> children;
+};
+
+struct ParsedQuery {
+    std::vector<std::string> words;   // Every word in the query, in order
+    std::vector<bool> excluded;       // Per word: under a minus (not scored)
+    QueryNode root;                   // And or Or
+
+    // Words that score, in order (the excluded ones left out)
+    std::vector<std::string> scoring_words() const;
+
+    // Only words, phrases and NEARs ANDed together: no OR, minus, title: or
+    // nested groups
+    bool is_plain_conjunction() const;
+};
+
+ParsedQuery parse_query(const std::string& query);
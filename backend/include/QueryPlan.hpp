@@ -0,0 +1,99 @@
+#pragma once
+// QueryPlan.hpp
+// Execution of a parsed query tree over one segment's postings (or the delta).
+//
+// The tree is compiled into a tree of iterators over doc ids: words and
+// phrases are posting iterators, AND nodes leapfrog their children, OR nodes
+// take the smallest doc id of theirs. AND children are ordered by cost (an
+// upper bound on how many documents they can match), so the rarest one
+// proposes candidates and the others only confirm them; excluded (minus)
+// children are checked last, and only on documents that matched the rest.
+// Phrases and NEARs align their words' postings like an AND and then test the
+// positions (PositionalMatch).
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "MemorySegment.hpp"
+#include "PostingCursor.hpp"
+#include "QueryParser.hpp"
+
+namespace query_plan {
+
+constexpr int END = PostingCursor::END;
+
+// Postings of one word, in doc id order
+class TermSource {
+public:
+    virtual ~TermSource() = default;
+
+    // Current doc id, END once exhausted; next_geq(target) moves to the first
+    // posting >= target (never backwards)
+    virtual int doc() const = 0;
+    virtual void next_geq(int target) = 0;
+    virtual size_t size() const = 0;
+
+    // Data of the current posting
+    virtual int frequency() const = 0;
+    virtual const int* positions() = 0;
+    virtual size_t num_positions() const = 0;
+};
+
+// A compressed on-disk posting list
+class CursorSource : public TermSource {
+public:
+    explicit CursorSource(const PostingListView& list) : cursor_(list) {}
+
+    int doc() const override { return cursor_.doc(); }
+    void next_geq(int target) override { cursor_.next_geq(target); }
+    size_t size() const override { return cursor_.size(); }
+    int frequency() const override { return cursor_.frequency(); }
+    const int* positions() override { return cursor_.positions(); }
+    size_t num_positions() const override { return cursor_.num_positions(); }
+
+private:
+    PostingCursor cursor_;
+};
+
+// A delta posting list (sorted by doc id); skips gallop
+class DeltaSource : public TermSource {
+public:
+    explicit DeltaSource(const std::vector<DeltaEntry>& entries) : entries_(entries) {}
+
+    int doc() const override { return index_ < entries_.size() ? entries_[index_].doc_id : END; }
+    void next_geq(int target) override;
+    size_t size() const override { return entries_.size(); }
+    int frequency() const override { return entries_[index_].frequency; }
+    const int* positions() override { return entries_[index_].positions.data(); }
+    size_t num_positions() const override { return entries_[index_].positions.size(); }
+
+private:
+    const std::vector<DeltaEntry>& entries_;
+    size_t index_ = 0;
+};
+
+class PlanNode {
+public:
+    virtual ~PlanNode() = default;
+
+    // First matching doc id >= target, END if none. Targets never decrease;
+    // a target at or below the last answer gets the same answer again.
+    virtual int next_geq(int target) = 0;
+
+    // Upper bound on the number of matching documents
+    virtual size_t cost() const = 0;
+};
+
+// Postings of query word i here (nullptr: no document here has it)
+using OpenSource = std::function<std::unique_ptr<TermSource>(size_t word)>;
+// Title frequency of query word i in a document
+using TitleFrequency = std::function<int(int doc_id, size_t word)>;
+
+// Words with ignored[i] set (ones the index never keeps, like stopwords) are
+// left out of the plan. Returns nullptr if nothing can match. The plan keeps
+// a reference to title_frequency.
+std::unique_ptr<PlanNode> build_plan(const QueryNode& root, const std::vector<bool>& ignored,
+                                     const OpenSource& open_source, const TitleFrequency& title_frequency);
+
+} // namespace query_plan
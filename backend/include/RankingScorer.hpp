@@ -2,12 +2,36 @@
 // RankingScorer.hpp
 // Multi-factor ranking system based on frequency, position, title, and metadata
 // Supports configurable weightages for different ranking factors
+//
+// The frequency factor is BM25F: a word's title and body frequencies are each
+// normalized by the field's length against the collection average, weighted
+// per field, summed, saturated and multiplied by the word's IDF. IDF and the
+// average lengths are collection statistics, written into each barrel when it
+// is built, so scoring a posting reads them off the term directory.
+//
+// The metadata and date factors depend on the document only; they are
+// computed once per document (static_score, kept in a StaticScores column)
+// instead of once per posting.
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <cmath>
 #include "DocumentMetadata.hpp"
 
+// Collection statistics BM25F normalizes with
+struct CollectionStats {
+    uint32_t num_documents = 0;
+    float avg_title_length = 0.0f;
+    float avg_body_length = 0.0f;
+};
+
+// Query-independent part of a document's score
+struct StaticScore {
+    float metadata_score = 0.0f;   // Citations
+    float date_boost = 1.0f;       // Multiplies the whole score
+};
+
 // Structure to hold scoring components for a document
 struct ScoreComponents {
     double frequency_score;
@@ -27,43 +51,63 @@ public:
     
     // Calculate final score for a document
     // Parameters:
-    //   - weighted_frequency: title_freq * 3 + body_freq
+    //   - idf: the word's inverse document frequency (inverse_document_frequency)
+    //   - collection: average field lengths the idf was computed with
     //   - title_frequency: frequency in title (0 if not in title)
-    //   - positions: vector of positions where word appears
-    //   - doc_id: document ID for metadata lookup
-    //   - doc_length: total length of document (for relative position calculation)
-    //   - metadata: pointer to DocumentMetadata (can be nullptr)
-    ScoreComponents calculate_score(
-        int weighted_frequency,
+    //   - positions, num_positions: where the word appears, read in place (e.g.
+    //     straight from a mapped barrel); title ones first, the rest are the
+    //     body frequency
+    //   - doc_length, title_length: tokens in the document and in its title
+    //   - static_score: the document's static score, already computed
+    ScoreComponents calculate_document_score(
+        float idf,
+        const CollectionStats& collection,
         int title_frequency,
-        const std::vector<int>& positions,
-        int doc_id,
+        const int* positions,
+        size_t num_positions,
         int doc_length,
-        const DocumentMetadata* metadata = nullptr
+        int title_length,
+        const StaticScore& static_score
     ) const;
-    
+
+    // Static score of a document (nullptr: one without metadata)
+    StaticScore static_score(const DocMetadata* doc_metadata) const;
+
+    // BM25 IDF of a word in document_frequency of num_documents documents
+    // (never negative, however common the word)
+    static float inverse_document_frequency(uint32_t document_frequency, uint32_t num_documents);
+
+    // BM25F score of one word in one document
+    double calculate_bm25f(float idf, int title_frequency, int body_frequency,
+                           int title_length, int body_length, const CollectionStats& collection) const;
+
     // Configure weights (optional - uses defaults if not called)
     void set_weights(double freq_weight, double pos_weight, double title_weight, double meta_weight);
     
     // Get current weights
     void get_weights(double& freq_weight, double& pos_weight, double& title_weight, double& meta_weight) const;
 
+    // BM25F parameters (optional - uses defaults if not called): field
+    // weights, length normalization per field (0: none, 1: full) and k1
+    void set_bm25f(double title_weight, double body_weight, double title_b, double body_b, double k1);
+
 private:
     // Weight configuration
     double weight_frequency_;  // Weight for frequency component (default: 0.4)
     double weight_position_;    // Weight for position component (default: 0.2)
     double weight_title_;      // Weight for title boost (default: 0.3)
     double weight_metadata_;   // Weight for metadata component (default: 0.1)
+
+    // BM25F parameters
+    double bm25f_title_weight_;  // A title occurrence counts like 3 body ones (default: 3.0)
+    double bm25f_body_weight_;   // (default: 1.0)
+    double bm25f_title_b_;       // Titles vary little in length (default: 0.3)
+    double bm25f_body_b_;        // (default: 0.75)
+    double bm25f_k1_;            // Frequency saturation (default: 1.2)
     
     // Helper methods
-    double calculate_frequency_score(int weighted_frequency) const;
-    double calculate_position_score(const std::vector<int>& positions, int doc_length) const;
+    double calculate_position_score(const int* positions, size_t num_positions, int doc_length) const;
     double calculate_title_boost(int title_frequency) const;
-    double calculate_metadata_score(int doc_id, const DocumentMetadata* metadata) const;
+    double calculate_metadata_score(const DocMetadata* doc_metadata) const;
     double calculate_date_boost(int publication_year) const;
 };
-
-
-
-
-
@@ -5,72 +5,107 @@
 #include <fstream>
 #include <iostream>
 #include <map>
-#include "LexiconWithTrie.hpp"
-#include "doc_url_mapper.hpp"
-#include "DocumentMetadata.hpp"
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <unordered_set>
+#include "IndexSnapshot.hpp"
+#include "SegmentManifest.hpp"
 #include "RankingScorer.hpp"
 #include "SemanticScorer.hpp"
 
 using json = nlohmann::json;
 
-// Struct for Delta Index entries
-struct DeltaEntry {
-    int doc_id;
-    int frequency;
-    std::vector<int> positions;
+// How search() finds candidates
+enum class SearchMode {
+    Lexical,    // Documents matching every known query word, re-ranked semantically
+    Semantic,   // Documents nearest the query by embedding, ranked by similarity
+    Hybrid      // Both, with lexical and semantic scores blended
 };
 
-// In-memory document stats for fast lookup
-struct DocStats {
-    int doc_length;
-    std::unordered_map<int, int> title_frequencies; // word_id -> title_freq
-};
+bool parse_search_mode(const std::string& name, SearchMode& mode);
+const char* search_mode_name(SearchMode mode);
 
 class SearchService {
 public:
-    SearchService(); 
+    // barrel_cache_bytes: budget for mapped barrels kept in the cache
+    explicit SearchService(size_t barrel_cache_bytes = DEFAULT_BARREL_CACHE_BYTES);
+    ~SearchService();
+
+    static constexpr size_t DEFAULT_BARREL_CACHE_BYTES = 256 * 1024 * 1024;
 
-    // Returns a raw JSON string of results
-    std::string search(std::string query);
+    // Returns a raw JSON string of results. Semantic and hybrid modes fall
+    // back to lexical when no document vectors are loaded. nprobe: IVF-PQ
+    // lists those modes scan (0: the default; see SemanticScorer::nearest).
+    std::string search(std::string query, SearchMode mode = SearchMode::Lexical, size_t nprobe = 0);
     
     // Returns autocomplete suggestions as JSON string
     std::string autocomplete(const std::string& prefix, int limit = 10);
     
-    // Reload indices after dynamic uploads
-    void reload_delta_index();
-    void reload_metadata();
+    // Make freshly indexed documents searchable right away by adding them to
+    // the in-memory segment. Nothing is read from disk; documents already in
+    // the segment are ignored.
+    void add_documents(std::vector<SegmentDocument> documents);
+
+    // Serve a new set of on-disk segments (after a flush or merge). Flushed
+    // documents are dropped from the in-memory segment in the same snapshot.
+    // The files of merged_dirs go when the last snapshot using them does.
+    void publish_segments(const SegmentManifest& manifest, const std::unordered_set<int>& flushed_doc_ids,
+                          const std::vector<std::string>& merged_dirs = {});
+
+    // What a new segment is written with: the served collection's statistics
+    // and IDFs, and the scores the ranker gives its postings with them
+    BarrelScoring barrel_scoring() const;
+
+    // Snapshot currently served (never null)
+    std::shared_ptr<const IndexSnapshot> snapshot() const;
+
+    BarrelCache::Stats barrel_cache_stats() const;
+
+    // A stale doc_stats.bin is being rebuilt (the old stats serve meanwhile)
+    bool doc_stats_rebuilding() const { return doc_stats_rebuilding_; }
 
 private:
-    LexiconWithTrie lexicon_trie_;
-    DocURLMapper doc_url_mapper;
-    DocumentMetadata document_metadata_;
+    // Published with std::atomic_load / std::atomic_store only
+    std::shared_ptr<const IndexSnapshot> snapshot_;
+
+    // Serializes snapshot updates; searches never take it
+    std::mutex reload_mutex_;
+
+    // Shared by all snapshots; entries are keyed by barrel set generation
+    std::shared_ptr<BarrelCache> barrel_cache_;
+
     RankingScorer ranking_scorer_;
-    std::unordered_map<int, json> barrel_cache_;
-    
-    // In-memory document statistics for O(1) lookup
-    std::unordered_map<int, DocStats> doc_stats_cache_;
 
-    // DYNAMIC SEARCH: Holds the small "new" index in RAM
-    std::unordered_map<int, std::vector<DeltaEntry>> delta_index_;
-    
-    // Semantic search components
+    // Semantic search components (loaded once, read-only afterwards)
     bool semantic_search_enabled_;
     SemanticScorer semantic_scorer_;
 
-    // Helpers
-    json& get_barrel(int barrel_id);
-    
-    // Load all document stats into memory
-    void load_document_stats();
-    
-    // Binary cache methods for fast loading
-    bool load_doc_stats_from_cache(const std::string& cache_path);
-    void build_doc_stats_cache(const std::string& cache_path);
-    bool is_cache_valid(const std::string& cache_path, const std::string& source_path);
-    
-    void load_delta_index();
-    
-    // Fast memory-based lookups (replacing disk I/O)
-    int get_title_frequency(int doc_id, int word_id);
-    int get_document_length(int doc_id);
-};
\ No newline at end of file
+    void publish(std::shared_ptr<const IndexSnapshot> next);
+
+    // Rebuilds a stale doc_stats.bin and publishes the result
+    std::thread doc_stats_rebuild_;
+    std::atomic<bool> doc_stats_rebuilding_{false};
+    bool doc_stats_stale_ = false;  // Set by load_document_stats()
+
+    // Document lengths and title frequencies (mapped doc_stats.bin, built from
+    // forward_index.jsonl when missing; flags doc_stats_stale_ when outdated)
+    std::shared_ptr<const DocStatsStore> load_document_stats();
+    void start_doc_stats_rebuild();
+
+    // Binary cache methods for fast loading (nullptr on failure)
+    std::shared_ptr<const DocStatsStore> load_doc_stats_from_cache(const std::string& cache_path);
+    std::shared_ptr<const DocStatsStore> build_doc_stats_cache(const std::string& cache_path);
+    bool is_cache_valid(const DocStatsStore& cache, const std::string& source_path);
+
+    // doc_stats plus the documents at the end of forward_index.jsonl it lacks
+    std::shared_ptr<const DocStatsStore> with_recent_documents(std::shared_ptr<const DocStatsStore> doc_stats);
+
+    // Apply the delta log records appended since next.delta_cursor.
+    // Returns true if the log was replaced since, i.e. segments may have changed.
+    bool load_delta_index(IndexSnapshot& next);
+
+    // Point next at the manifest's segments, reusing barrel sets it already has
+    void load_segments(IndexSnapshot& next, const SegmentManifest& manifest);
+};
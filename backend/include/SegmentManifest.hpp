@@ -0,0 +1,36 @@
+#pragma once
+// SegmentManifest.hpp
+// List of the immutable on-disk segments that make up the main index
+// (barrels/segments.json). Each segment is a directory of NUM_BARRELS binary
+// barrels holding a disjoint set of documents: the base build lives in the
+// barrels directory itself ("."), flushed deltas and merge results in
+// segments/seg_<id>. Segments are never modified; flushing or merging writes
+// new directories and then replaces the manifest atomically (tmp + rename),
+// so a crash leaves either the old or the new segment set.
+//
+// The manifest also records how much of the delta log is already in a
+// segment. On startup the log is replayed from there, so documents flushed
+// just before a crash (log not yet compacted) aren't indexed twice.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "DeltaLog.hpp"
+
+struct SegmentInfo {
+    std::string dir;        // Relative to the barrels directory
+    uint64_t bytes = 0;     // Total size of its barrel files
+};
+
+struct SegmentManifest {
+    std::vector<SegmentInfo> segments;  // Oldest first
+    uint64_t next_segment_id = 1;
+    DeltaLogCursor flushed;             // Delta log records already in segments
+
+    // Missing file: the base barrels only. False if the file exists but can't
+    // be read; out then holds the base barrels only as well.
+    static bool load(const std::string& barrels_dir, SegmentManifest& out);
+    bool save(const std::string& barrels_dir) const;
+
+    static std::string path(const std::string& barrels_dir);
+};
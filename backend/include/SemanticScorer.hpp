@@ -5,14 +5,30 @@
 #include <unordered_map>
 #include <fstream>
 #include <cstring>
+#include "DocumentVectors.hpp"
+#include "HnswIndex.hpp"
+#include "IvfPqIndex.hpp"
+#include "WordEmbeddings.hpp"
 
 /**
  * SemanticScorer: Handles semantic similarity using pre-trained word embeddings.
  * 
  * Uses GloVe embeddings (300-dim) to compute:
  * - Document vectors (average of word embeddings, normalized)
- * - Query vectors (average of query word embeddings)
- * - Cosine similarity between query and documents
+ * - Query vectors (average of query word embeddings, normalized)
+ * - Cosine similarity between query and documents (a dot product, since
+ *   every stored vector is unit length)
+ *
+ * Document vectors and word embeddings may be stored as float16 or int8
+ * (see DocumentVectors.hpp). With quantized document vectors, a float32
+ * document_vectors.bin can be mapped as well so the final results can be
+ * re-scored exactly.
+ *
+ * nearest() retrieves documents by similarity alone, through the HNSW graph
+ * (document_vectors.hnsw, see HnswIndex.hpp) when one is loaded, otherwise
+ * the IVF-PQ index (document_vectors.ivfpq, see IvfPqIndex.hpp). The IVF-PQ
+ * index can also stand in for the document vectors entirely, with estimated
+ * similarities, when those are too large to keep around.
  */
 class SemanticScorer {
 public:
@@ -23,33 +39,99 @@ public:
     bool load_document_vectors(const std::string& doc_vectors_path);
     bool load_word_embeddings(const std::string& word_embeddings_path);
 
-    // Compute semantic similarity score (0.0 to 1.0)
-    // Returns 0.0 if document or query not found
-    double compute_similarity(int doc_id, const std::vector<std::string>& query_words) const;
+    // Float32 document vectors used by rescore_exact(). Only worth loading
+    // when the main document vectors are quantized.
+    bool load_exact_vectors(const std::string& doc_vectors_path);
+
+    // Query vector: average of the known query words' embeddings, normalized.
+    // Empty if none of the words has an embedding. Compute it once per query.
+    std::vector<float> compute_query_vector(const std::vector<std::string>& query_words) const;
+
+    // Batch scoring: scores[i] = similarity (0.0 to 1.0) of doc_ids[i] to a
+    // vector from compute_query_vector(). Both sides are unit length, so each
+    // score is a single dot product. 0.0 for unknown documents or an empty query.
+    void compute_similarities(const std::vector<float>& query_vec,
+                              const int* doc_ids, size_t count, double* scores) const;
+
+    // Same as compute_similarities(), but against the float32 vectors from
+    // load_exact_vectors() when they are loaded (meant for the few final
+    // results after scoring all candidates against quantized vectors).
+    // Without document vectors both are IVF-PQ estimates.
+    void rescore_exact(const std::vector<float>& query_vec,
+                       const int* doc_ids, size_t count, double* scores) const;
+    bool has_exact_vectors() const { return exact_vectors_.is_loaded(); }
+
+    // HNSW graph for nearest(); must have been built from the loaded document
+    // vectors (or their float32 original). Call after load_document_vectors().
+    bool load_ann_index(const std::string& hnsw_path);
+    bool has_ann_index() const { return ann_index_.is_loaded(); }
+
+    // IVF-PQ index for nearest() when there is no graph. Without document
+    // vectors, scoring falls back to its estimates.
+    bool load_ivfpq_index(const std::string& ivfpq_path);
+    bool has_ivfpq_index() const { return ivfpq_index_.is_loaded(); }
+
+    // Up to k documents most similar to query_vec, best first, with exact
+    // similarities when load_exact_vectors() was used. Approximate through the
+    // HNSW graph when it is loaded, then the IVF-PQ index (nprobe lists, 0 for
+    // IVFPQ_NPROBE), otherwise a scan of every document.
+    std::vector<VectorMatch> nearest(const std::vector<float>& query_vec, size_t k, size_t nprobe = 0) const;
 
     // Check if semantic scoring is available
-    bool is_loaded() const { return vectors_loaded_ && embeddings_loaded_; }
+    bool is_loaded() const { return (vectors_loaded_ || ivfpq_index_.is_loaded()) && embeddings_loaded_; }
 
     // Get number of loaded documents
-    size_t num_documents() const { return document_vectors_.size(); }
+    size_t num_documents() const {
+        return vectors_loaded_ ? document_vectors_.num_documents() : ivfpq_index_.num_documents();
+    }
+
+    vector_format::Encoding document_encoding() const { return document_vectors_.encoding(); }
+    vector_format::Encoding word_encoding() const { return word_embeddings_.encoding(); }
+    size_t document_vector_bytes() const { return document_vectors_.data_bytes(); }
+    size_t word_embedding_bytes() const { return word_embeddings_.data_bytes(); }
 
 private:
     static constexpr int EMBEDDING_DIM = 300;
+
+    // HNSW beam width for nearest() (at least k is used)
+    static constexpr size_t ANN_EF_SEARCH = 128;
+
+    // IVF-PQ lists scanned by nearest() by default, and how many times k
+    // candidates it returns for re-scoring when there are vectors to do it
+    static constexpr size_t IVFPQ_NPROBE = 16;
+    static constexpr size_t ANN_RESCORE_FACTOR = 4;
     
-    // Document vectors: doc_id -> 300-dim float vector
-    std::unordered_map<int, std::vector<float>> document_vectors_;
+    // Document vectors: mmapped doc_id-indexed matrix (see DocumentVectors.hpp)
+    DocumentVectors document_vectors_;
+
+    // Float32 copy for exact re-scoring (optional)
+    DocumentVectors exact_vectors_;
+
+    // Graph over document_vectors_ for nearest() (optional)
+    HnswIndex ann_index_;
+
+    // Compressed vectors for nearest() without a graph, and for scoring
+    // without document vectors (optional)
+    IvfPqIndex ivfpq_index_;
     
-    // Word embeddings: word -> 300-dim float vector
-    std::unordered_map<std::string, std::vector<float>> word_embeddings_;
+    // Word embeddings: word -> 300-dim vector, contiguous storage
+    WordEmbeddings word_embeddings_;
 
     bool vectors_loaded_;
     bool embeddings_loaded_;
 
-    // Compute query vector from query words
-    std::vector<float> compute_query_vector(const std::vector<std::string>& query_words) const;
+    // Clamp a dot product of unit vectors to [0, 1]
+    static double clamp_similarity(double dot_product);
+
+    // nearest() without a graph: every document vector, best k kept
+    std::vector<VectorMatch> scan_nearest(const float* query, size_t k) const;
+
+    void score_against(const DocumentVectors& vectors, const std::vector<float>& query_vec,
+                       const int* doc_ids, size_t count, double* scores) const;
 
-    // Cosine similarity between two vectors
-    double cosine_similarity(const std::vector<float>& a, const std::vector<float>& b) const;
+    // Scoring from the IVF-PQ index when there are no document vectors
+    void score_estimated(const std::vector<float>& query_vec,
+                         const int* doc_ids, size_t count, double* scores) const;
 
     // Normalize vector to unit length
     void normalize_vector(std::vector<float>& vec) const;
@@ -0,0 +1,29 @@
+#pragma once
+// StaticScores.hpp
+// Column of every document's static score (RankingScorer::static_score),
+// indexed by doc id. Built once from the metadata so scoring a posting reads
+// one array entry instead of hashing into DocumentMetadata and redoing the
+// citation and date math. Immutable once built; documents added later keep
+// theirs in the delta MemorySegment.
+
+#include <memory>
+#include <vector>
+#include "DocumentMetadata.hpp"
+#include "RankingScorer.hpp"
+
+class StaticScores {
+public:
+    static std::shared_ptr<const StaticScores> build(const DocumentMetadata& metadata, const RankingScorer& scorer);
+
+    // Score of a document without metadata outside the column
+    StaticScore get(int doc_id) const {
+        if (doc_id < 0 || static_cast<size_t>(doc_id) >= scores_.size()) return missing_;
+        return scores_[doc_id];
+    }
+
+    size_t size() const { return scores_.size(); }
+
+private:
+    std::vector<StaticScore> scores_;
+    StaticScore missing_;
+};
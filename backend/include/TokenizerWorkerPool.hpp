@@ -0,0 +1,132 @@
+#pragma once
+// TokenizerWorkerPool.hpp
+// Long-lived Python tokenizer processes (scripts/tokenizer_worker.py) for the
+// PDFs the in-process extractor can't read. Each worker imports the PDF
+// library once and then serves requests over its stdin/stdout, so an upload
+// pays neither interpreter startup nor a temp JSON round trip.
+//
+// Protocol (all integers little-endian), one frame per message:
+//   frame    = u32 payload length | payload
+//   request  = u8 op | ...
+//              OP_TOKENIZE: u32 path length | path
+//              OP_PING
+//   response = u8 status | ...
+//              STATUS_OK:    u32 title length | title | u32 count | (u16 length | token)*
+//              STATUS_ERROR: u32 message length | message
+//              STATUS_PONG
+//
+// Workers are started in the background when the pool is created and checked
+// with a ping every health_check_interval while idle. One that crashes, hangs
+// past request_timeout or answers garbage is killed and replaced. A worker
+// that can't even start (no Python, no PDF library) is retried only when a
+// request needs it.
+//
+// On Windows the script is run once per request instead (no worker processes).
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tokenizer_protocol {
+    constexpr uint8_t OP_TOKENIZE = 1;
+    constexpr uint8_t OP_PING = 2;
+
+    constexpr uint8_t STATUS_OK = 0;
+    constexpr uint8_t STATUS_ERROR = 1;
+    constexpr uint8_t STATUS_PONG = 2;
+
+    constexpr uint32_t MAX_FRAME_BYTES = 64 * 1024 * 1024;
+}
+
+class TokenizerWorkerPool {
+public:
+    struct Options {
+        size_t num_workers = 2;
+        std::string python_exe;            // Empty: venv python if present, else python3
+        std::string script = "scripts/tokenizer_worker.py";
+        std::chrono::seconds request_timeout{120};
+        std::chrono::seconds startup_timeout{30};
+        std::chrono::seconds health_check_interval{30};
+    };
+
+    TokenizerWorkerPool();
+    explicit TokenizerWorkerPool(Options options);
+    ~TokenizerWorkerPool();
+
+    TokenizerWorkerPool(const TokenizerWorkerPool&) = delete;
+    TokenizerWorkerPool& operator=(const TokenizerWorkerPool&) = delete;
+
+    struct Result {
+        std::string title;
+        std::vector<std::string> tokens;
+    };
+
+    // Blocks until a worker is free. False with error set if the script
+    // couldn't tokenize the PDF or no worker could run it.
+    bool tokenize(const std::string& pdf_path, Result& out, std::string& error);
+
+    struct WorkerStats {
+        int pid = -1;
+        bool alive = false;
+        size_t requests = 0;
+        size_t failures = 0;
+        size_t restarts = 0;
+        double avg_latency_ms = 0.0;
+        double max_latency_ms = 0.0;
+        double last_latency_ms = 0.0;
+    };
+    struct Stats {
+        size_t requests = 0;
+        size_t failures = 0;
+        size_t restarts = 0;
+        size_t health_checks = 0;
+        std::vector<WorkerStats> workers;
+    };
+    Stats get_stats() const;
+
+private:
+    struct Worker {
+        int pid = -1;
+        int to_child = -1;      // Worker's stdin
+        int from_child = -1;    // Worker's stdout
+    };
+
+    enum class CallResult { Ok, SendFailed, Failed };
+
+    // Take an idle worker (SIZE_MAX on shutdown) / hand it back
+    size_t acquire();
+    void release(size_t index);
+
+    bool start_worker(size_t index, std::string& error);
+    void stop_worker(Worker& worker, bool graceful);
+    void replace_worker(size_t index);
+
+    // One request/response exchange with the worker's process
+    CallResult call(Worker& worker, const std::string& request, std::string& response,
+                    std::chrono::steady_clock::duration timeout, std::string& error);
+    bool ping(Worker& worker, std::chrono::steady_clock::duration timeout, std::string& error);
+
+    void monitor_thread();
+    void record(size_t index, double latency_ms, bool ok);
+
+#ifdef _WIN32
+    bool run_script_once(const std::string& pdf_path, Result& out, std::string& error);
+#endif
+
+    Options options_;
+    std::vector<Worker> workers_;          // A worker's fields belong to whoever acquired it
+
+    std::vector<size_t> idle_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::atomic<bool> shutdown_{false};
+    std::thread monitor_;
+
+    mutable std::mutex stats_mutex_;
+    Stats stats_{};
+};
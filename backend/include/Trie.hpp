@@ -24,6 +24,9 @@ public:
     Trie();
     ~Trie();
 
+    // Deep copy, so a copy can take more words while the original is in use
+    Trie(const Trie& other);
+
     // Insert a word into the trie
     void insert(const std::string& word);
 
@@ -31,6 +34,9 @@ public:
     // Returns up to k words in lexicographic order
     std::vector<std::string> autocomplete(const std::string& prefix, int k) const;
 
+    // Whether the word was inserted
+    bool contains(const std::string& word) const;
+
     // Check if the trie is empty
     bool empty() const;
 
@@ -42,5 +48,7 @@ private:
 
     // Helper function to collect all words from a subtree
     void collect_words(TrieNode* node, std::vector<std::string>& results, int max_count) const;
+
+    static std::unique_ptr<TrieNode> copy_node(const TrieNode& node);
 };
 
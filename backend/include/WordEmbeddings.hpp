@@ -0,0 +1,70 @@
+#pragma once
+// WordEmbeddings.hpp
+// Word -> embedding table (word_embeddings.bin) used to build query vectors.
+//
+// Vectors sit in one contiguous buffer, row per word, in the file's encoding
+// (float32 / float16 / int8, see vector_format in DocumentVectors.hpp); a
+// lookup decodes the word's row to floats. Two file formats load:
+//
+//   original:  int32 count | (int32 length | word | dim float32)*
+//              raw GloVe vectors, normalized on load
+//   encoded:   WordFileHeader | (uint32 length | word | [float scale] | dim elements)*
+//              written by quantize_vectors, already normalized; the scale is
+//              only present for int8
+//
+// All integers are little-endian.
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "DocumentVectors.hpp"
+
+namespace word_format {
+    constexpr char MAGIC[4] = {'D', 'S', 'A', 'W'};
+    constexpr uint32_t VERSION = 1;
+}
+
+struct WordFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t dim;
+    uint32_t encoding;          // vector_format::Encoding
+    uint32_t num_words;
+    uint32_t reserved;
+};
+
+class WordEmbeddings {
+public:
+    bool load(const std::string& path, uint32_t dim);
+
+    // Write source's vectors to path in the encoded format
+    static bool write(const std::string& path, const WordEmbeddings& source,
+                      vector_format::Encoding encoding, std::string& error);
+
+    // Decode word's unit-length vector into out (dim floats). False if unknown.
+    bool lookup(const std::string& word, float* out) const;
+
+    size_t size() const { return rows_.size(); }
+    uint32_t dim() const { return dim_; }
+    vector_format::Encoding encoding() const { return encoding_; }
+
+    // Bytes of vector data (not counting the words themselves)
+    size_t data_bytes() const { return data_.size() + scales_.size() * sizeof(float); }
+
+private:
+    bool load_original(std::ifstream& file, uint32_t dim);
+    bool load_encoded(std::ifstream& file, uint32_t dim, const std::string& path);
+
+    // Row for word: a new one, or its existing row for repeated words (the
+    // last occurrence wins, as in the old hash map)
+    uint32_t insert_row(std::string word);
+
+    std::unordered_map<std::string, uint32_t> rows_;
+    std::vector<uint8_t> data_;
+    std::vector<float> scales_;            // Int8 only, one per row
+    vector_format::Encoding encoding_ = vector_format::Encoding::Float32;
+    uint32_t dim_ = 0;
+    size_t row_bytes_ = 0;
+};
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <iostream>
 #include <fstream>
 #include "json.hpp" 
@@ -32,8 +33,11 @@ public:
     // Loads the frozen lexicon (word -> id mapping)
     bool load_lexicon(const std::string& filepath);
 
-    // Main logic: Reads dataset, calculates TF, positions, and doc length
-    void build_index(const std::string& dataset_path);
+    // Main logic: Reads dataset, calculates TF, positions, and doc length.
+    // A reader thread hands batches of lines to num_threads workers (0: one per
+    // core) and the calling thread writes their results back in dataset order,
+    // so the output is the same for any thread count.
+    void build_index(const std::string& dataset_path, size_t num_threads = 0);
 
     // Saves the resulting JSON to disk (compact format)
     void save_to_file(const std::string& output_path);
@@ -42,7 +46,12 @@ public:
     void append_document(const std::string& output_path, int doc_id, const std::map<int, WordStats>& doc_stats);
 
 private:
-    std::map<std::string, int> lexicon_; // Stores frozen WordIDs
+    // One dataset line to its "data" object (compact JSON); empty if it has no
+    // lexicon words. False if the line isn't a document. Only reads lexicon_,
+    // so workers call it concurrently.
+    bool index_line(const std::string& line, std::string& data_json) const;
+
+    std::unordered_map<std::string, int> lexicon_; // Stores frozen WordIDs
     json forward_index_json_;            // Final JSON object
     int total_docs_ = 0;                 // Document counter
 };
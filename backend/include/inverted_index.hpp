@@ -9,6 +9,10 @@
 #include <filesystem>
 #include "json.hpp" 
 #include "forward_index.hpp"
+#include "DocumentMetadata.hpp"
+#include "RankingScorer.hpp"
+#include "StaticScores.hpp"
+#include "DeltaLog.hpp"
 
 using json = nlohmann::json;
 
@@ -17,6 +21,11 @@ struct InvertedEntry {
     int doc_id;
     int frequency; // How many times the word appears
     std::vector<int> positions; // Where the word appears
+
+    // Build-time only (not stored in barrels): inputs for the score upper bounds
+    int title_frequency = 0;
+    int doc_length = 0;
+    int title_length = 0;
 };
 
 // Using alias for clarity
@@ -27,19 +36,63 @@ class InvertedIndexBuilder {
 public:
     InvertedIndexBuilder(int total_barrels);
 
-    void build(const std::string& forward_index_path, const std::string& output_dir);
+    // Inverts the forward index in bounded memory: postings are buffered up
+    // to the memory budget, then sorted by barrel and word and spilled to a run
+    // file. The runs are k-way merged into the barrels, several barrels at once.
+    // Each merge holds one barrel in memory. The barrels are staged in
+    // <output_dir>/staging and replace the old ones only once all are built.
+    // False if any barrel could not be built; the old barrels, segments and
+    // delta log are then left as they were.
+    bool build(const std::string& forward_index_path, const std::string& output_dir);
+
+    // Bytes of postings buffered before a run is spilled (default 512 MB);
+    // also bounds the barrels merged at once by default
+    void set_memory_budget(size_t bytes) { memory_budget_ = bytes; }
+
+    // Where the run files go (default <output_dir>/runs); removed after the build
+    void set_run_dir(const std::string& dir) { run_dir_ = dir; }
+
+    // Barrels merged and written concurrently (0: as many as the largest
+    // barrel fits into the memory budget, at most one per core)
+    void set_merge_threads(size_t threads) { merge_threads_ = threads; }
+
+    // Metadata used to compute the per-term / per-block score upper bounds.
+    // Without it the barrels are written unbounded (no top-k pruning).
+    bool load_metadata(const std::string& metadata_path);
 
+    // Also write the legacy inverted_barrel_<id>.json files next to the binary ones
+    void set_json_export(bool enabled) { export_json_ = enabled; }
+
+    // Dynamic uploads go to the append-only delta log (barrels/inverted_delta.log).
+    // MergeScheduler moves them into on-disk segments in the background.
     void update_delta_barrel(int doc_id, const std::map<int, WordStats>& doc_stats);
-    void merge_delta_to_main(const std::string& output_dir);
+    bool append_delta(const std::vector<DeltaDocument>& documents);
+    DeltaLog& delta_log() { return delta_log_; }
+
+    // Delta postings of one document, title positions first
+    static DeltaDocument make_delta_document(int doc_id, const std::map<int, WordStats>& doc_stats);
 
 private:
     int total_barrels_;
+    bool export_json_ = false;
+    size_t memory_budget_ = size_t{512} << 20;
+    std::string run_dir_;
+    size_t merge_threads_ = 0;
+
+    DeltaLog delta_log_{"data/processed/barrels/inverted_delta.log"};
+
+    DocumentMetadata metadata_;
+    bool has_metadata_ = false;
+    RankingScorer ranking_scorer_;
+    std::shared_ptr<const StaticScores> static_scores_;  // Of metadata_
+    CollectionStats collection_;  // Of the forward index being built
 
     // Decides which barrel a word goes into
     int get_barrel_id(int word_id);
 
-    // Saves one barrel to a file
-    void save_barrel(int barrel_id, const BarrelMap& barrel_data, const std::string& output_dir);
+    // Saves one barrel to a file (binary, plus JSON when export is enabled)
+    bool save_barrel(int barrel_id, const BarrelMap& barrel_data, const std::string& output_dir);
+    void save_barrel_json(int barrel_id, const BarrelMap& barrel_data, const std::string& output_dir);
 };
 
 #endif // INVERTED_INDEX_HPP
\ No newline at end of file
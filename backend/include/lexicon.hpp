@@ -40,6 +40,9 @@ public:
     size_t size() const;
     bool contains_word(const std::string& word) const;
 
+    // Words the lexicon would never keep (stopwords, short tokens, numbers) are not significant
+    bool is_significant_word(const std::string& word) const;
+
     // Dynamic Update for new PDF content
     void update_from_tokens(const std::vector<std::string>& tokens, const std::string& save_path);
 
@@ -57,7 +60,6 @@ private:
     // Helperss
     void load_default_stopwords();
     void load_stopwords_from_file(const std::string& path);
-    bool is_significant_word(const std::string& word) const;
     std::vector<std::string> parse_tokens_from_jsonl_line(const std::string& json_line) const;
     std::string json_escape(const std::string& str) const;
 };
\ No newline at end of file
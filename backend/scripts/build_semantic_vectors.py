@@ -108,6 +108,68 @@ def compute_document_vector(
     return doc_vector.astype(np.float32)
 
 
+VECTOR_FILE_MAGIC = b"DSAV"
+VECTOR_FILE_VERSION = 1
+ROW_ALIGNMENT = 64
+FLAG_ROW_TABLE = 1
+ENCODING_FLOAT32 = 0  # float16 / int8 copies come from the quantize_vectors tool
+
+
+def save_document_matrix(doc_vectors: Dict[int, np.ndarray], path: str, dim: int = 300):
+    """
+    Write document vectors as a 64-byte aligned, doc_id-indexed matrix:
+      header (64 bytes) | num_rows x row_stride float32 | optional int32 row table
+    Row i is doc i (missing ids are zero rows) unless more than half the rows
+    would be padding; then only present docs are stored and the row table maps
+    doc_id -> row (-1 for none).
+    """
+    doc_ids = sorted(doc_vectors.keys())
+    max_doc_id = doc_ids[-1] if doc_ids else -1
+    floats_per_line = ROW_ALIGNMENT // 4
+    row_stride = (dim + floats_per_line - 1) // floats_per_line * floats_per_line
+
+    use_row_table = (max_doc_id + 1) > 2 * len(doc_ids)
+    num_rows = len(doc_ids) if use_row_table else max_doc_id + 1
+
+    matrix = np.zeros((num_rows, row_stride), dtype="<f4")
+    row_table = np.full(max_doc_id + 1, -1, dtype="<i4") if use_row_table else None
+    for row, doc_id in enumerate(doc_ids):
+        if use_row_table:
+            row_table[doc_id] = row
+        else:
+            row = doc_id
+        matrix[row, :dim] = doc_vectors[doc_id]
+
+    header_size = 64
+    matrix_offset = header_size
+    row_table_offset = matrix_offset + matrix.nbytes if use_row_table else 0
+    header = struct.pack(
+        "<4sIIIIIiIQQIIQ",
+        VECTOR_FILE_MAGIC,
+        VECTOR_FILE_VERSION,
+        dim,
+        row_stride,
+        num_rows,
+        len(doc_ids),
+        max_doc_id,
+        FLAG_ROW_TABLE if use_row_table else 0,
+        matrix_offset,
+        row_table_offset,
+        ENCODING_FLOAT32,
+        0,  # reserved
+        0,  # scales_offset (int8 files only)
+    )
+    assert len(header) == header_size
+
+    tmp_path = path + ".tmp"
+    with open(tmp_path, "wb") as f:
+        f.write(header)
+        f.write(matrix.tobytes())
+        if use_row_table:
+            f.write(row_table.tobytes())
+    os.replace(tmp_path, path)
+
+
 def save_binary_vectors(
     doc_vectors: Dict[int, np.ndarray],
     word_embeddings: Dict[str, np.ndarray],
@@ -117,19 +179,12 @@ def save_binary_vectors(
 ):
     """
     Save vectors in binary format for C++:
-    - Document vectors: [num_docs (int32)] [doc_id (int32)] [vector (300 floats)] ...
+    - Document vectors: doc_id-indexed matrix the server maps directly
+      (layout in include/DocumentVectors.hpp)
     - Word embeddings: [num_words (int32)] [word_len (int32)] [word (bytes)] [vector (300 floats)] ...
     """
     print(f"Saving document vectors to {doc_output_path}...")
-    with open(doc_output_path, "wb") as f:
-        # Write number of documents
-        f.write(struct.pack("i", len(doc_vectors)))
-        # Write each document vector
-        for doc_id in sorted(doc_vectors.keys()):
-            vector = doc_vectors[doc_id]
-            f.write(struct.pack("i", doc_id))  # doc_id
-            f.write(vector.tobytes())  # 300 floats = 1200 bytes
-
+    save_document_matrix(doc_vectors, doc_output_path, dim)
     print(f"Saved {len(doc_vectors)} document vectors")
 
     print(f"Saving word embeddings to {word_output_path}...")
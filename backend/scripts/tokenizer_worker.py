@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+"""
+Persistent PDF tokenizer worker for the C++ TokenizerWorkerPool.
+
+Imports the PDF library once, then serves requests framed on stdin/stdout until
+stdin closes. Protocol (little-endian), see include/TokenizerWorkerPool.hpp:
+
+    frame    = u32 payload length | payload
+    request  = u8 op (1 = tokenize: u32 path length | path, 2 = ping)
+    response = u8 status (0 = ok: u32 title length | title | u32 count | (u16 length | token)*,
+                          1 = error: u32 message length | message,
+                          2 = pong)
+
+Usage:
+    python tokenizer_worker.py
+"""
+
+import os
+import struct
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from tokenize_single_pdf import extract_text_streaming  # noqa: E402  (imports the PDF library)
+
+OP_TOKENIZE = 1
+OP_PING = 2
+
+STATUS_OK = 0
+STATUS_ERROR = 1
+STATUS_PONG = 2
+
+MAX_FRAME_BYTES = 64 * 1024 * 1024
+
+
+def read_exact(stream, size: int) -> bytes:
+    data = b""
+    while len(data) < size:
+        chunk = stream.read(size - len(data))
+        if not chunk:
+            return b""
+        data += chunk
+    return data
+
+
+def write_frame(out, payload: bytes) -> None:
+    out.write(struct.pack("<I", len(payload)) + payload)
+    out.flush()
+
+
+def string32(text: str) -> bytes:
+    data = text.encode("utf-8", errors="replace")
+    return struct.pack("<I", len(data)) + data
+
+
+def tokenize(path: str) -> bytes:
+    if not os.path.exists(path):
+        return bytes([STATUS_ERROR]) + string32(f"PDF not found: {path}")
+
+    title, tokens = extract_text_streaming(path)
+    if not title or not tokens:
+        return bytes([STATUS_ERROR]) + string32("Could not extract text from PDF")
+
+    parts = [bytes([STATUS_OK]), string32(title), struct.pack("<I", len(tokens))]
+    for token in tokens:
+        data = token.encode("utf-8")[:0xFFFF]
+        parts.append(struct.pack("<H", len(data)) + data)
+    return b"".join(parts)
+
+
+def main():
+    # Frames get the real stdout; anything else printed (by us or the PDF
+    # library) goes to stderr so it can't corrupt the stream
+    out = os.fdopen(os.dup(sys.stdout.fileno()), "wb")
+    os.dup2(sys.stderr.fileno(), sys.stdout.fileno())
+    sys.stdout = sys.stderr
+    stdin = sys.stdin.buffer
+
+    while True:
+        header = read_exact(stdin, 4)
+        if not header:
+            return
+        (length,) = struct.unpack("<I", header)
+        if length == 0 or length > MAX_FRAME_BYTES:
+            print(f"[Worker] Bad frame length {length}, exiting", file=sys.stderr)
+            return
+        payload = read_exact(stdin, length)
+        if not payload:
+            return
+
+        op = payload[0]
+        if op == OP_PING:
+            write_frame(out, bytes([STATUS_PONG]))
+        elif op == OP_TOKENIZE and len(payload) >= 5:
+            (path_length,) = struct.unpack("<I", payload[1:5])
+            path = payload[5:5 + path_length].decode("utf-8", errors="replace")
+            try:
+                response = tokenize(path)
+            except Exception as e:
+                response = bytes([STATUS_ERROR]) + string32(f"Tokenizer error: {e}")
+            write_frame(out, response)
+        else:
+            write_frame(out, bytes([STATUS_ERROR]) + string32(f"Unknown request {op}"))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,100 @@
+#include "BarrelCache.hpp"
+#include <algorithm>
+
+BarrelCache::BarrelCache(size_t capacity_bytes, size_t num_shards)
+    : capacity_bytes_(capacity_bytes) {
+    num_shards = std::max<size_t>(1, num_shards);
+    shard_capacity_ = capacity_bytes_ / num_shards;
+    for (size_t i = 0; i < num_shards; ++i) {
+        shards_.push_back(std::make_unique<Shard>());
+    }
+}
+
+uint64_t BarrelCache::make_key(uint64_t generation, int barrel_id) {
+    return (generation << 32) | static_cast<uint32_t>(barrel_id);
+}
+
+BarrelCache::Shard& BarrelCache::shard_for(uint64_t key) {
+    // Consecutive barrel ids land on different shards
+    return *shards_[static_cast<uint32_t>(key) % shards_.size()];
+}
+
+bool BarrelCache::lookup(uint64_t generation, int barrel_id, std::shared_ptr<const BinaryBarrel>& out) {
+    uint64_t key = make_key(generation, barrel_id);
+    Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        shard.misses++;
+        return false;
+    }
+
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    shard.hits++;
+    out = it->second->barrel;
+    return true;
+}
+
+std::shared_ptr<const BinaryBarrel> BarrelCache::insert(uint64_t generation, int barrel_id,
+                                                        std::shared_ptr<const BinaryBarrel> barrel) {
+    uint64_t key = make_key(generation, barrel_id);
+    Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto existing = shard.index.find(key);
+    if (existing != shard.index.end()) {
+        shard.lru.splice(shard.lru.begin(), shard.lru, existing->second);
+        return existing->second->barrel;
+    }
+
+    size_t charge = barrel ? barrel->size_bytes() : 0;
+    shard.lru.push_front({key, charge, barrel});
+    shard.index[key] = shard.lru.begin();
+    shard.bytes += charge;
+
+    // Evict from the cold end; the new entry stays even if it alone exceeds the share
+    while (shard.bytes > shard_capacity_ && shard.lru.size() > 1) {
+        Entry& victim = shard.lru.back();
+        shard.bytes -= victim.charge;
+        shard.index.erase(victim.key);
+        shard.lru.pop_back();
+        shard.evictions++;
+    }
+    return barrel;
+}
+
+void BarrelCache::erase(uint64_t generation, int barrel_id) {
+    uint64_t key = make_key(generation, barrel_id);
+    Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) return;
+    shard.bytes -= it->second->charge;
+    shard.lru.erase(it->second);
+    shard.index.erase(it);
+}
+
+void BarrelCache::clear() {
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->lru.clear();
+        shard->index.clear();
+        shard->bytes = 0;
+    }
+}
+
+BarrelCache::Stats BarrelCache::get_stats() const {
+    Stats stats;
+    stats.capacity_bytes = capacity_bytes_;
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        stats.hits += shard->hits;
+        stats.misses += shard->misses;
+        stats.evictions += shard->evictions;
+        stats.entries += shard->lru.size();
+        stats.bytes += shard->bytes;
+    }
+    return stats;
+}
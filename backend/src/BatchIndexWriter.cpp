@@ -2,6 +2,7 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <cctype>
 
 BatchIndexWriter::BatchIndexWriter(
     Lexicon& lexicon,
@@ -21,6 +22,7 @@ BatchIndexWriter::BatchIndexWriter(
     last_flush_time_(std::chrono::steady_clock::now())
 {
     writer_thread_ = std::thread(&BatchIndexWriter::writer_thread, this);
+    persist_thread_ = std::thread(&BatchIndexWriter::persist_thread, this);
     std::cout << "[BatchIndexWriter] Started with batch_size=" << batch_size 
               << ", flush_interval=" << flush_interval.count() << "s\n";
 }
@@ -33,14 +35,31 @@ BatchIndexWriter::~BatchIndexWriter() {
     }
     
     // Flush remaining documents
-    std::lock_guard<std::mutex> lock(queue_mutex_);
-    if (!queue_.empty()) {
-        std::cout << "[BatchIndexWriter] Flushing " << queue_.size() 
-                  << " remaining documents on shutdown\n";
-        flush_batch(queue_);
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (!queue_.empty()) {
+            std::cout << "[BatchIndexWriter] Flushing " << queue_.size() 
+                      << " remaining documents on shutdown\n";
+            flush_batch(queue_);
+        }
+    }
+    
+    // Persistence thread writes everything still queued before exiting
+    {
+        std::lock_guard<std::mutex> lock(persist_mutex_);
+        persist_shutdown_ = true;
+    }
+    persist_cv_.notify_all();
+    if (persist_thread_.joinable()) {
+        persist_thread_.join();
     }
 }
 
+void BatchIndexWriter::set_publisher(PublishFn publisher) {
+    std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+    publisher_ = std::move(publisher);
+}
+
 void BatchIndexWriter::enqueue_document(PendingDocument doc) {
     doc.enqueue_time = std::chrono::steady_clock::now();
     
@@ -80,12 +99,18 @@ void BatchIndexWriter::flush_now() {
     
     std::cout << "[BatchIndexWriter] flush_now() starting synchronous flush..." << std::endl;
     flush_batch(batch);
-    std::cout << "[BatchIndexWriter] flush_now() completed! Files written to disk." << std::endl;
+    std::cout << "[BatchIndexWriter] flush_now() completed! Documents published, files being written." << std::endl;
 }
 
 BatchIndexWriter::Stats BatchIndexWriter::get_stats() const {
-    std::lock_guard<std::mutex> lock(stats_mutex_);
-    return stats_;
+    Stats stats;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats = stats_;
+    }
+    std::lock_guard<std::mutex> lock(persist_mutex_);
+    stats.pending_persist_batches = persist_queue_.size();
+    return stats;
 }
 
 void BatchIndexWriter::writer_thread() {
@@ -128,10 +153,124 @@ void BatchIndexWriter::writer_thread() {
     }
 }
 
+SegmentDocument BatchIndexWriter::make_segment_document(const PendingDocument& doc) {
+    SegmentDocument segment_doc;
+    segment_doc.index = InvertedIndexBuilder::make_delta_document(doc.doc_id, doc.doc_stats);
+    
+    // Words come from the tokens at their positions, so the lexicon (written
+    // concurrently by the persistence thread) isn't touched here
+    segment_doc.words.reserve(segment_doc.index.postings.size());
+    for (const auto& posting : segment_doc.index.postings) {
+        const WordStats& stats = doc.doc_stats.at(posting.word_id);
+        std::string word;
+        if (!stats.body_positions.empty() &&
+            stats.body_positions[0] < static_cast<int>(doc.tokens.size())) {
+            word = doc.tokens[stats.body_positions[0]];
+            std::transform(word.begin(), word.end(), word.begin(),
+                         [](unsigned char c) { return std::tolower(c); });
+        }
+        segment_doc.words.push_back(std::move(word));
+    }
+    
+    for (std::string token : doc.tokens) {
+        std::transform(token.begin(), token.end(), token.begin(),
+                     [](unsigned char c) { return std::tolower(c); });
+        segment_doc.vocabulary.push_back(std::move(token));
+    }
+    std::sort(segment_doc.vocabulary.begin(), segment_doc.vocabulary.end());
+    segment_doc.vocabulary.erase(std::unique(segment_doc.vocabulary.begin(), segment_doc.vocabulary.end()),
+                                 segment_doc.vocabulary.end());
+    
+    // Same length and title frequencies update_indices writes to the forward index
+    segment_doc.has_stats = true;
+    segment_doc.stats.doc_length = 0;
+    segment_doc.stats.title_length = 0;
+    for (const auto& [word_id, stats] : doc.doc_stats) {
+        segment_doc.stats.doc_length += stats.title_frequency + stats.body_frequency;
+        segment_doc.stats.title_length += stats.title_frequency;
+        if (stats.title_frequency > 0) {
+            segment_doc.stats.title_frequencies[word_id] = stats.title_frequency;
+        }
+    }
+    
+    segment_doc.has_metadata = true;
+    segment_doc.metadata.doc_id = doc.doc_id;
+    segment_doc.metadata.publication_year = 2024;
+    segment_doc.metadata.publication_month = 1;
+    segment_doc.metadata.title = doc.title;
+    segment_doc.metadata.url = doc.url;
+    return segment_doc;
+}
+
 void BatchIndexWriter::flush_batch(std::vector<PendingDocument>& batch) {
     auto start = std::chrono::steady_clock::now();
     
-    std::cout << "[BatchIndexWriter] Flushing batch of " << batch.size() << " documents...\n";
+    std::cout << "[BatchIndexWriter] Publishing batch of " << batch.size() << " documents...\n";
+    
+    if (publisher_) {
+        std::vector<SegmentDocument> documents;
+        documents.reserve(batch.size());
+        for (const auto& doc : batch) {
+            documents.push_back(make_segment_document(doc));
+        }
+        publisher_(std::move(documents));
+    }
+    
+    auto end = std::chrono::steady_clock::now();
+    auto duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    
+    double total_latency = 0;
+    for (const auto& doc : batch) {
+        auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(
+            end - doc.enqueue_time
+        ).count();
+        total_latency += latency;
+    }
+    double avg_latency = total_latency / batch.size();
+    
+    size_t published = batch.size();
+    size_t pending;
+    {
+        std::lock_guard<std::mutex> lock(persist_mutex_);
+        persist_queue_.push_back(std::move(batch));
+        pending = persist_queue_.size();
+    }
+    batch.clear();
+    persist_cv_.notify_one();
+    
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.documents_indexed += published;
+    }
+    
+    std::cout << "[BatchIndexWriter] ✅ Batch searchable in " << duration_ms << "ms "
+              << "(avg latency: " << avg_latency << "ms, "
+              << pending << " batches waiting to be written)\n";
+    
+    last_flush_time_ = std::chrono::steady_clock::now();
+}
+
+void BatchIndexWriter::persist_thread() {
+    while (true) {
+        std::unique_lock<std::mutex> lock(persist_mutex_);
+        persist_cv_.wait(lock, [this]() {
+            return persist_shutdown_ || !persist_queue_.empty();
+        });
+        if (persist_queue_.empty()) return;  // Shut down and drained
+        
+        // Stays in the queue while written so pending counts include it
+        std::vector<PendingDocument> batch = std::move(persist_queue_.front());
+        lock.unlock();
+        
+        persist_batch(batch);
+        
+        lock.lock();
+        persist_queue_.pop_front();
+    }
+}
+
+void BatchIndexWriter::persist_batch(const std::vector<PendingDocument>& batch) {
+    auto start = std::chrono::steady_clock::now();
     
     try {
         update_indices(batch);
@@ -139,30 +278,19 @@ void BatchIndexWriter::flush_batch(std::vector<PendingDocument>& batch) {
         auto end = std::chrono::steady_clock::now();
         auto duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
         
-        double total_latency = 0;
-        for (const auto& doc : batch) {
-            auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(
-                end - doc.enqueue_time
-            ).count();
-            total_latency += latency;
-        }
-        double avg_latency = total_latency / batch.size();
-        
         std::lock_guard<std::mutex> lock(stats_mutex_);
-        stats_.documents_indexed += batch.size();
+        stats_.documents_persisted += batch.size();
         stats_.batches_flushed++;
         stats_.avg_batch_time_ms = 
             (stats_.avg_batch_time_ms * (stats_.batches_flushed - 1) + duration_ms) / 
             stats_.batches_flushed;
         
-        std::cout << "[BatchIndexWriter] ✅ Batch complete in " << duration_ms << "ms "
-                  << "(" << (duration_ms / batch.size()) << "ms/doc, "
-                  << "avg latency: " << avg_latency << "ms)\n";
-        
-        last_flush_time_ = std::chrono::steady_clock::now();
+        std::cout << "[BatchIndexWriter] ✅ Batch of " << batch.size() << " written in " << duration_ms << "ms "
+                  << "(" << (duration_ms / batch.size()) << "ms/doc)\n";
         
     } catch (const std::exception& e) {
-        std::cerr << "[BatchIndexWriter] ❌ Batch flush failed: " << e.what() << "\n";
+        // Still searchable until restart, but not durable
+        std::cerr << "[BatchIndexWriter] ❌ Batch persistence failed: " << e.what() << "\n";
     }
 }
 
@@ -196,14 +324,16 @@ void BatchIndexWriter::update_indices(const std::vector<PendingDocument>& batch)
         }
         
         int total_tokens = 0;
+        int title_tokens = 0;
         for (const auto& [_, stats] : doc.doc_stats) {
             total_tokens += stats.title_frequency + stats.body_frequency;
+            title_tokens += stats.title_frequency;
         }
         
         json doc_json;
         doc_json["doc_length"] = total_tokens;
-        doc_json["title_length"] = 0;
-        doc_json["body_length"] = total_tokens;
+        doc_json["title_length"] = title_tokens;
+        doc_json["body_length"] = total_tokens - title_tokens;
         doc_json["words"] = words_obj;
         
         json line_obj;
@@ -214,55 +344,15 @@ void BatchIndexWriter::update_indices(const std::vector<PendingDocument>& batch)
     }
     forward_file.close();
     
-    // 3. Batch delta barrel updates
-    std::string delta_path = "data/processed/barrels/inverted_delta.json";
-    json delta_json;
-    
-    std::ifstream delta_in(delta_path);
-    if (delta_in.good()) {
-        try { delta_in >> delta_json; } catch(...) { delta_json = json::object(); }
-    }
-    delta_in.close();
-    
+    // 3. Batch delta barrel updates: one appended record per document
+    std::vector<DeltaDocument> delta_docs;
+    delta_docs.reserve(batch.size());
     for (const auto& doc : batch) {
-        for (const auto& [word_id, stats] : doc.doc_stats) {
-            std::string w_id_str = std::to_string(word_id);
-            
-            std::vector<int> all_positions = stats.title_positions;
-            all_positions.insert(all_positions.end(), 
-                               stats.body_positions.begin(), 
-                               stats.body_positions.end());
-            
-            json entry = json::array({
-                doc.doc_id,
-                stats.get_weighted_frequency(),
-                all_positions
-            });
-            
-            if (delta_json.contains(w_id_str)) {
-                delta_json[w_id_str].push_back(entry);
-            } else {
-                delta_json[w_id_str] = json::array({entry});
-            }
-        }
-    }
-    
-    // Write to temp file first
-    std::string delta_temp = delta_path + ".tmp";
-    std::ofstream delta_out(delta_temp, std::ios::trunc);
-    if (!delta_out.is_open()) {
-        throw std::runtime_error("Failed to open delta temp file");
+        delta_docs.push_back(InvertedIndexBuilder::make_delta_document(doc.doc_id, doc.doc_stats));
     }
-    delta_out << delta_json.dump(-1);
-    delta_out.flush();
-    if (!delta_out.good()) {
-        delta_out.close();
-        throw std::runtime_error("Failed to write delta file");
+    if (!inverted_builder_.append_delta(delta_docs)) {
+        throw std::runtime_error("Failed to append to delta log");
     }
-    delta_out.close();
-    
-    // Atomic rename
-    std::rename(delta_temp.c_str(), delta_path.c_str());
     
     // 4. Batch metadata updates
     for (const auto& doc : batch) {
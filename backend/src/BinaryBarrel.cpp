@@ -0,0 +1,362 @@
+#include "BinaryBarrel.hpp"
+#include "PostingCodec.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <limits>
+#include <fstream>
+#include <iostream>
+
+void PostingListView::decode_block(uint32_t b, PostingBlock& out) const {
+    const BarrelBlockEntry& block = blocks[b];
+    const uint8_t* in = data + block.postings_offset;
+    uint32_t buffer[barrel_format::BLOCK_SIZE];
+
+    out.count = block.count;
+
+    // Doc ids: gaps relative to the previous block's last doc id
+    in += posting_codec::decode(in, block.count, buffer);
+    uint32_t base = (b == 0) ? 0 : static_cast<uint32_t>(blocks[b - 1].last_doc_id);
+    posting_codec::prefix_sum(buffer, block.count, base);
+    std::memcpy(out.doc_ids, buffer, block.count * sizeof(uint32_t));
+
+    in += posting_codec::decode(in, block.count, buffer);
+    std::memcpy(out.frequencies, buffer, block.count * sizeof(uint32_t));
+
+    // Position counts -> offsets into the block's positions
+    posting_codec::decode(in, block.count, buffer);
+    out.position_starts[0] = 0;
+    for (uint32_t i = 0; i < block.count; ++i) {
+        out.position_starts[i + 1] = out.position_starts[i] + buffer[i];
+    }
+}
+
+void PostingListView::decode_positions(uint32_t b, int32_t* out) const {
+    const BarrelBlockEntry& block = blocks[b];
+    uint32_t* raw = reinterpret_cast<uint32_t*>(out);
+    posting_codec::decode(data + block.positions_offset, block.num_positions, raw);
+
+    int32_t previous = 0;
+    for (uint32_t i = 0; i < block.num_positions; ++i) {
+        previous += posting_codec::zigzag_decode(raw[i]);
+        out[i] = previous;
+    }
+}
+
+bool BinaryBarrel::open(const std::string& path) {
+    header_ = nullptr;
+    if (!file_.open(path)) return false;
+
+    const char* base = file_.data();
+    size_t size = file_.size();
+
+    if (size < sizeof(BarrelHeader)) {
+        std::cerr << "[BinaryBarrel] Truncated header: " << path << "\n";
+        file_.close();
+        return false;
+    }
+
+    const auto* header = reinterpret_cast<const BarrelHeader*>(base);
+    if (std::memcmp(header->magic, barrel_format::MAGIC, 4) != 0 ||
+        header->version != barrel_format::VERSION ||
+        header->block_size != barrel_format::BLOCK_SIZE) {
+        std::cerr << "[BinaryBarrel] Unsupported barrel format in " << path
+                  << " (rebuild with build_inverted_index)\n";
+        file_.close();
+        return false;
+    }
+
+    // Validate that every section fits in the file before trusting any offset
+    uint64_t expected = sizeof(BarrelHeader)
+                      + static_cast<uint64_t>(header->num_terms) * sizeof(BarrelTermEntry)
+                      + header->num_blocks * sizeof(BarrelBlockEntry)
+                      + header->data_bytes;
+    if (expected != size || header->data_bytes < posting_codec::DECODE_PADDING) {
+        std::cerr << "[BinaryBarrel] Size mismatch in " << path << " (expected "
+                  << expected << " bytes, got " << size << ")\n";
+        file_.close();
+        return false;
+    }
+
+    const char* cursor = base + sizeof(BarrelHeader);
+    const auto* terms = reinterpret_cast<const BarrelTermEntry*>(cursor);
+    cursor += header->num_terms * sizeof(BarrelTermEntry);
+    const auto* blocks = reinterpret_cast<const BarrelBlockEntry*>(cursor);
+    cursor += header->num_blocks * sizeof(BarrelBlockEntry);
+
+    // Queries index the directories without checks: validate them once here
+    if (!valid_directories(*header, terms, blocks, reinterpret_cast<const uint8_t*>(cursor))) {
+        std::cerr << "[BinaryBarrel] Corrupt term or block directory in " << path << "\n";
+        file_.close();
+        return false;
+    }
+
+    terms_ = terms;
+    blocks_ = blocks;
+    data_ = reinterpret_cast<const uint8_t*>(cursor);
+    header_ = header;
+    return true;
+}
+
+namespace {
+
+// Bounds on the bytes of a Stream VByte stream of n values: a control byte
+// per 4 values, plus 1 to 4 bytes per value
+uint64_t min_stream_bytes(uint64_t n) { return (n + 3) / 4 + n; }
+uint64_t max_stream_bytes(uint64_t n) { return (n + 3) / 4 + 4 * n; }
+
+} // namespace
+
+bool BinaryBarrel::valid_directories(const BarrelHeader& header, const BarrelTermEntry* terms,
+                                     const BarrelBlockEntry* blocks, const uint8_t* data) {
+    using posting_codec::DECODE_PADDING;
+
+    // A block's doc id, frequency and position count streams run from
+    // postings_offset to positions_offset, its positions from there to the
+    // next block (the last one to the decoder padding). The decoder reads up
+    // to DECODE_PADDING past a stream, which stays in the data section as long
+    // as the streams stay in their payload; that is certain unless a stream
+    // of 4-byte values could run past the padding, so only then are its exact
+    // sizes read off the control bytes. Counts are capped by the payload they
+    // claim: a value takes at least a byte.
+    uint64_t payload_end = header.data_bytes - DECODE_PADDING;
+    for (uint64_t b = 0; b < header.num_blocks; ++b) {
+        const BarrelBlockEntry& block = blocks[b];
+        uint64_t end = b + 1 < header.num_blocks ? blocks[b + 1].postings_offset : payload_end;
+        if (block.count == 0 || block.count > barrel_format::BLOCK_SIZE ||
+            block.positions_offset < block.postings_offset || end < block.positions_offset ||
+            end > payload_end ||
+            3 * min_stream_bytes(block.count) > block.positions_offset - block.postings_offset ||
+            min_stream_bytes(block.num_positions) > end - block.positions_offset) {
+            return false;
+        }
+
+        if (block.postings_offset + 3 * max_stream_bytes(block.count) + DECODE_PADDING > header.data_bytes) {
+            uint64_t offset = block.postings_offset;
+            for (int stream = 0; stream < 3; ++stream) {
+                if (offset + (block.count + 3) / 4 > block.positions_offset) return false;
+                offset += posting_codec::encoded_size(data + offset, block.count);
+            }
+            if (offset > block.positions_offset) return false;
+        }
+        if (block.positions_offset + max_stream_bytes(block.num_positions) + DECODE_PADDING > header.data_bytes &&
+            block.positions_offset + posting_codec::encoded_size(data + block.positions_offset,
+                                                                 block.num_positions) > end) {
+            return false;
+        }
+    }
+
+    // Terms sorted by word id (binary searched), each owning its own run of
+    // blocks that holds exactly its postings
+    uint64_t next_block = 0;
+    for (uint32_t t = 0; t < header.num_terms; ++t) {
+        const BarrelTermEntry& term = terms[t];
+        if ((t > 0 && terms[t - 1].word_id >= term.word_id) || term.first_block != next_block ||
+            static_cast<uint64_t>(term.first_block) + term.num_blocks > header.num_blocks) {
+            return false;
+        }
+        uint64_t postings = 0;
+        for (uint32_t b = term.first_block; b < term.first_block + term.num_blocks; ++b) {
+            postings += blocks[b].count;
+        }
+        if (postings != term.doc_count) return false;
+        next_block = static_cast<uint64_t>(term.first_block) + term.num_blocks;
+    }
+    return next_block == header.num_blocks;
+}
+
+bool BinaryBarrel::find(int word_id, PostingListView& out) const {
+    if (!header_) return false;
+
+    const BarrelTermEntry* end = terms_ + header_->num_terms;
+    const BarrelTermEntry* it = std::lower_bound(terms_, end, word_id,
+        [](const BarrelTermEntry& entry, int id) { return entry.word_id < id; });
+    if (it == end || it->word_id != word_id) return false;
+
+    out.blocks = blocks_ + it->first_block;
+    out.data = data_;
+    out.num_blocks = it->num_blocks;
+    out.size = it->doc_count;
+    out.max_score = it->max_score;
+    out.idf = it->idf;
+    out.num_positions = 0;
+    for (uint32_t b = 0; b < it->num_blocks; ++b) {
+        out.num_positions += out.blocks[b].num_positions;
+    }
+    return true;
+}
+
+void BinaryBarrel::to_barrel_map(BarrelMap& out) const {
+    if (!header_) return;
+
+    PostingBlock block;
+    std::vector<int32_t> positions;
+
+    for (uint32_t t = 0; t < header_->num_terms; ++t) {
+        PostingListView view;
+        find(terms_[t].word_id, view);
+
+        auto& entries = out[terms_[t].word_id];
+        entries.reserve(entries.size() + view.size);
+        for (uint32_t b = 0; b < view.num_blocks; ++b) {
+            view.decode_block(b, block);
+            positions.resize(view.blocks[b].num_positions);
+            view.decode_positions(b, positions.data());
+
+            for (uint32_t i = 0; i < block.count; ++i) {
+                InvertedEntry entry{
+                    block.doc_ids[i],
+                    block.frequencies[i],
+                    std::vector<int>(positions.begin() + block.position_starts[i],
+                                     positions.begin() + block.position_starts[i + 1])
+                };
+                entries.push_back(std::move(entry));
+            }
+        }
+    }
+}
+
+CollectionStats BinaryBarrel::collection() const {
+    CollectionStats stats;
+    if (!header_) return stats;
+    stats.num_documents = header_->num_documents;
+    stats.avg_title_length = header_->avg_title_length;
+    stats.avg_body_length = header_->avg_body_length;
+    return stats;
+}
+
+namespace {
+
+// Narrow a bound to float without ever rounding it down
+float upper_bound_to_float(double bound) {
+    float narrowed = static_cast<float>(bound);
+    if (static_cast<double>(narrowed) < bound) {
+        narrowed = std::nextafter(narrowed, std::numeric_limits<float>::infinity());
+    }
+    return narrowed;
+}
+
+} // namespace
+
+bool BinaryBarrel::write(const std::string& path, const BarrelMap& barrel, const BarrelScoring& scoring) {
+    using barrel_format::BLOCK_SIZE;
+    const float unbounded = std::numeric_limits<float>::infinity();
+
+    BarrelHeader header{};
+    std::memcpy(header.magic, barrel_format::MAGIC, 4);
+    header.version = barrel_format::VERSION;
+    header.num_terms = static_cast<uint32_t>(barrel.size());
+    header.block_size = BLOCK_SIZE;
+    header.num_documents = scoring.collection.num_documents;
+    header.avg_title_length = scoring.collection.avg_title_length;
+    header.avg_body_length = scoring.collection.avg_body_length;
+
+    std::vector<BarrelTermEntry> terms;
+    std::vector<BarrelBlockEntry> blocks;
+    std::vector<uint8_t> data;
+    terms.reserve(barrel.size());
+
+    uint32_t buffer[BLOCK_SIZE];
+    std::vector<uint32_t> position_buffer;
+
+    // BarrelMap is ordered by word_id, which is what the term directory needs
+    for (const auto& [word_id, unsorted] : barrel) {
+        // Doc id gaps need postings in doc order
+        std::vector<const InvertedEntry*> entries;
+        entries.reserve(unsorted.size());
+        for (const auto& entry : unsorted) entries.push_back(&entry);
+        std::stable_sort(entries.begin(), entries.end(),
+            [](const InvertedEntry* a, const InvertedEntry* b) { return a->doc_id < b->doc_id; });
+
+        BarrelTermEntry term{};
+        term.word_id = word_id;
+        term.doc_count = static_cast<uint32_t>(entries.size());
+        term.first_block = static_cast<uint32_t>(blocks.size());
+        term.max_score = scoring.score ? 0.0f : unbounded;
+        term.idf = scoring.idf ? scoring.idf(word_id, term.doc_count)
+                               : RankingScorer::inverse_document_frequency(term.doc_count, scoring.collection.num_documents);
+
+        int32_t previous_last = 0;
+        for (size_t start = 0; start < entries.size(); start += BLOCK_SIZE) {
+            uint32_t count = static_cast<uint32_t>(std::min<size_t>(BLOCK_SIZE, entries.size() - start));
+
+            BarrelBlockEntry block{};
+            block.count = count;
+            block.last_doc_id = entries[start + count - 1]->doc_id;
+            block.postings_offset = data.size();
+
+            if (scoring.score) {
+                double block_max = 0.0;
+                for (uint32_t i = 0; i < count; ++i) {
+                    block_max = std::max(block_max, scoring.score(word_id, term.idf, scoring.collection, *entries[start + i]));
+                }
+                block.max_score = upper_bound_to_float(block_max);
+                term.max_score = std::max(term.max_score, block.max_score);
+            } else {
+                block.max_score = unbounded;
+            }
+
+            for (uint32_t i = 0; i < count; ++i) buffer[i] = static_cast<uint32_t>(entries[start + i]->doc_id);
+            posting_codec::delta_encode(buffer, count, static_cast<uint32_t>(previous_last));
+            posting_codec::encode(buffer, count, data);
+
+            for (uint32_t i = 0; i < count; ++i) buffer[i] = static_cast<uint32_t>(entries[start + i]->frequency);
+            posting_codec::encode(buffer, count, data);
+
+            for (uint32_t i = 0; i < count; ++i) buffer[i] = static_cast<uint32_t>(entries[start + i]->positions.size());
+            posting_codec::encode(buffer, count, data);
+
+            // Positions of the whole block as one zigzag gap stream
+            position_buffer.clear();
+            int32_t previous = 0;
+            for (uint32_t i = 0; i < count; ++i) {
+                for (int pos : entries[start + i]->positions) {
+                    position_buffer.push_back(posting_codec::zigzag_encode(pos - previous));
+                    previous = pos;
+                }
+            }
+            block.num_positions = static_cast<uint32_t>(position_buffer.size());
+            block.positions_offset = data.size();
+            posting_codec::encode(position_buffer.data(), position_buffer.size(), data);
+
+            blocks.push_back(block);
+            previous_last = block.last_doc_id;
+        }
+
+        term.num_blocks = static_cast<uint32_t>(blocks.size()) - term.first_block;
+        terms.push_back(term);
+        header.num_postings += entries.size();
+    }
+
+    // Slack for the SIMD decoder's 16-byte loads
+    data.resize(data.size() + posting_codec::DECODE_PADDING, 0);
+    header.num_blocks = blocks.size();
+    header.data_bytes = data.size();
+
+    std::string temp_path = path + ".tmp";
+    std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "[BinaryBarrel] Could not open " << temp_path << " for writing\n";
+        return false;
+    }
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(terms.data()), terms.size() * sizeof(BarrelTermEntry));
+    out.write(reinterpret_cast<const char*>(blocks.data()), blocks.size() * sizeof(BarrelBlockEntry));
+    out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    out.flush();
+
+    if (!out.good()) {
+        std::cerr << "[BinaryBarrel] Write failed for " << temp_path << "\n";
+        return false;
+    }
+    out.close();
+
+    // Atomic rename
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::cerr << "[BinaryBarrel] Could not rename " << temp_path << "\n";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,39 @@
+#include "Checksum.hpp"
+
+namespace checksum {
+
+namespace {
+
+struct Crc32Table {
+    uint32_t entries[256];
+
+    Crc32Table() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : (c >> 1);
+            }
+            entries[i] = c;
+        }
+    }
+};
+
+const Crc32Table& crc32_table() {
+    static const Crc32Table table;
+    return table;
+}
+
+} // namespace
+
+uint32_t crc32(const void* data, size_t size, uint32_t crc) {
+    const uint32_t* table = crc32_table().entries;
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+} // namespace checksum
@@ -0,0 +1,312 @@
+#include "DeltaLog.hpp"
+#include "Checksum.hpp"
+#include "json.hpp"
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace {
+
+constexpr size_t RECORD_HEADER_BYTES = 2 * sizeof(uint32_t);
+
+template <typename T>
+void put(std::string& buffer, T value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool get(const char*& p, const char* end, T& value) {
+    if (static_cast<size_t>(end - p) < sizeof(T)) return false;
+    std::memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return true;
+}
+
+void append_record(std::string& buffer, const DeltaDocument& doc) {
+    std::string payload;
+    put<int32_t>(payload, doc.doc_id);
+    put<uint32_t>(payload, static_cast<uint32_t>(doc.postings.size()));
+    for (const auto& posting : doc.postings) {
+        put<int32_t>(payload, posting.word_id);
+        put<int32_t>(payload, posting.frequency);
+        put<uint32_t>(payload, static_cast<uint32_t>(posting.positions.size()));
+        payload.append(reinterpret_cast<const char*>(posting.positions.data()),
+                       posting.positions.size() * sizeof(int32_t));
+    }
+
+    put<uint32_t>(buffer, static_cast<uint32_t>(payload.size()));
+    put<uint32_t>(buffer, checksum::crc32(payload.data(), payload.size()));
+    buffer += payload;
+}
+
+bool parse_payload(const char* p, const char* end, DeltaDocument& doc) {
+    int32_t doc_id;
+    uint32_t num_postings;
+    if (!get(p, end, doc_id) || !get(p, end, num_postings)) return false;
+
+    doc.doc_id = doc_id;
+    doc.postings.clear();
+    doc.postings.reserve(num_postings);
+    for (uint32_t i = 0; i < num_postings; ++i) {
+        int32_t word_id, frequency;
+        uint32_t num_positions;
+        if (!get(p, end, word_id) || !get(p, end, frequency) || !get(p, end, num_positions)) return false;
+        if (static_cast<size_t>(end - p) / sizeof(int32_t) < num_positions) return false;
+
+        DeltaPosting posting{word_id, frequency, std::vector<int>(num_positions)};
+        std::memcpy(posting.positions.data(), p, num_positions * sizeof(int32_t));
+        p += num_positions * sizeof(int32_t);
+        doc.postings.push_back(std::move(posting));
+    }
+    return p == end;
+}
+
+// Parse consecutive records from data[0, size). Returns bytes of valid records.
+size_t parse_records(const char* data, size_t size, std::vector<DeltaDocument>* out) {
+    size_t offset = 0;
+    while (size - offset >= RECORD_HEADER_BYTES) {
+        uint32_t length, crc;
+        std::memcpy(&length, data + offset, sizeof(length));
+        std::memcpy(&crc, data + offset + sizeof(length), sizeof(crc));
+
+        const char* payload = data + offset + RECORD_HEADER_BYTES;
+        if (size - offset - RECORD_HEADER_BYTES < length) break;
+        if (checksum::crc32(payload, length) != crc) break;
+
+        DeltaDocument doc;
+        if (!parse_payload(payload, payload + length, doc)) break;
+        if (out) out->push_back(std::move(doc));
+
+        offset += RECORD_HEADER_BYTES + length;
+    }
+    return offset;
+}
+
+bool read_header(std::ifstream& in, DeltaLogHeader& header) {
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    return in.gcount() == static_cast<std::streamsize>(sizeof(header)) &&
+           std::memcmp(header.magic, delta_log_format::MAGIC, 4) == 0 &&
+           header.version == delta_log_format::VERSION;
+}
+
+uint64_t new_log_id() {
+    std::random_device rd;
+    uint64_t id = static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+    id ^= static_cast<uint64_t>(rd()) << 32;
+    return id == 0 ? 1 : id;
+}
+
+} // namespace
+
+DeltaLog::DeltaLog(std::string path) : path_(std::move(path)) {}
+
+bool DeltaLog::load_legacy_json(const std::string& json_path, std::vector<DeltaDocument>& out) {
+    std::ifstream in(json_path);
+    if (!in.good()) return false;
+
+    json delta_json;
+    try { in >> delta_json; } catch (...) { return false; }
+
+    std::map<int, DeltaDocument> by_doc;
+    for (auto& [word_id_str, entries] : delta_json.items()) {
+        int word_id = std::stoi(word_id_str);
+        for (auto& e : entries) {
+            DeltaDocument& doc = by_doc[e[0].get<int>()];
+            doc.doc_id = e[0].get<int>();
+            doc.postings.push_back({word_id, e[1].get<int>(), e[2].get<std::vector<int>>()});
+        }
+    }
+    for (auto& [doc_id, doc] : by_doc) out.push_back(std::move(doc));
+    return true;
+}
+
+bool DeltaLog::write_new_log(const std::string& records, uint64_t* log_id) {
+    DeltaLogHeader header{};
+    std::memcpy(header.magic, delta_log_format::MAGIC, 4);
+    header.version = delta_log_format::VERSION;
+    header.log_id = new_log_id();
+
+    std::string buffer(reinterpret_cast<const char*>(&header), sizeof(header));
+    buffer += records;
+
+    std::string temp_path = path_ + ".tmp";
+    std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "[DeltaLog] Could not open " << temp_path << " for writing\n";
+        return false;
+    }
+    out.write(buffer.data(), buffer.size());
+    out.flush();
+    if (!out.good()) {
+        std::cerr << "[DeltaLog] Write failed for " << temp_path << "\n";
+        return false;
+    }
+    out.close();
+
+    // Atomic rename: readers see either the old log or the complete new one
+    if (std::rename(temp_path.c_str(), path_.c_str()) != 0) {
+        std::cerr << "[DeltaLog] Could not rename " << temp_path << "\n";
+        return false;
+    }
+    if (log_id) *log_id = header.log_id;
+    return true;
+}
+
+bool DeltaLog::recover() {
+    std::error_code ec;
+    if (!fs::exists(path_, ec)) {
+        // First run after upgrading: carry over the old JSON delta
+        std::string legacy_path = (fs::path(path_).parent_path() / "inverted_delta.json").string();
+        std::vector<DeltaDocument> legacy;
+        if (load_legacy_json(legacy_path, legacy)) {
+            std::string records;
+            for (const auto& doc : legacy) append_record(records, doc);
+            if (!write_new_log(records)) return false;
+            fs::rename(legacy_path, legacy_path + ".migrated", ec);
+            std::cout << "[DeltaLog] Imported " << legacy.size() << " documents from " << legacy_path << "\n";
+            return true;
+        }
+        return write_new_log("");
+    }
+
+    std::ifstream in(path_, std::ios::binary);
+    DeltaLogHeader header;
+    if (!in.is_open() || !read_header(in, header)) {
+        std::cerr << "[DeltaLog] Invalid log header in " << path_ << ", moving it aside\n";
+        in.close();
+        fs::rename(path_, path_ + ".corrupt", ec);
+        return write_new_log("");
+    }
+
+    std::string body((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+
+    size_t valid = parse_records(body.data(), body.size(), nullptr);
+    if (valid < body.size()) {
+        std::cerr << "[DeltaLog] Truncating " << (body.size() - valid)
+                  << " bytes of incomplete records from " << path_ << "\n";
+        fs::resize_file(path_, sizeof(DeltaLogHeader) + valid, ec);
+        if (ec) {
+            std::cerr << "[DeltaLog] Could not truncate " << path_ << ": " << ec.message() << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DeltaLog::open() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!recovered_) recovered_ = recover();
+    return recovered_;
+}
+
+bool DeltaLog::append(const std::vector<DeltaDocument>& documents) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!recovered_) recovered_ = recover();
+    if (!recovered_) return false;
+
+    std::string buffer;
+    for (const auto& doc : documents) append_record(buffer, doc);
+
+    std::error_code ec;
+    uintmax_t size = fs::file_size(path_, ec);
+    if (ec) {
+        std::cerr << "[DeltaLog] Could not stat " << path_ << ": " << ec.message() << "\n";
+        recovered_ = false;
+        return false;
+    }
+
+    std::ofstream out(path_, std::ios::binary | std::ios::app);
+    if (!out.is_open()) {
+        std::cerr << "[DeltaLog] Could not open " << path_ << " for appending\n";
+        return false;
+    }
+    out.write(buffer.data(), buffer.size());
+    out.flush();
+    if (!out.good()) {
+        std::cerr << "[DeltaLog] Append failed for " << path_ << "\n";
+        // Drop the torn record: replay stops at it, so anything appended
+        // after it would never be read. Failing that, recover() before the
+        // next append.
+        out.close();
+        fs::resize_file(path_, size, ec);
+        if (ec) recovered_ = false;
+        return false;
+    }
+    return true;
+}
+
+bool DeltaLog::reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    recovered_ = write_new_log("");
+    return recovered_;
+}
+
+bool DeltaLog::compact(const DeltaLogCursor& flushed, DeltaLogCursor& tail) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!recovered_) recovered_ = recover();
+    if (!recovered_) return false;
+
+    // Appends hold the same lock, so the file can't grow while it is copied
+    std::ifstream in(path_, std::ios::binary);
+    DeltaLogHeader header;
+    if (!in.is_open() || !read_header(in, header) || header.log_id != flushed.log_id) {
+        std::cerr << "[DeltaLog] " << path_ << " changed since it was flushed, not compacting\n";
+        return false;
+    }
+    std::string body((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+
+    size_t start = flushed.offset > sizeof(DeltaLogHeader) ? flushed.offset - sizeof(DeltaLogHeader) : 0;
+    if (start > body.size()) return false;
+
+    uint64_t log_id = 0;
+    if (!write_new_log(body.substr(start), &log_id)) return false;
+    tail = DeltaLogCursor{log_id, sizeof(DeltaLogHeader)};
+    return true;
+}
+
+DeltaLog::ReplayResult DeltaLog::replay(const std::string& path, DeltaLogCursor& cursor,
+                                        std::vector<DeltaDocument>& out) {
+    ReplayResult result;
+
+    std::ifstream in(path, std::ios::binary);
+    DeltaLogHeader header;
+    if (!in.is_open() || !read_header(in, header)) return result;
+    result.ok = true;
+
+    uint64_t start = sizeof(DeltaLogHeader);
+    if (header.log_id == cursor.log_id && cursor.offset > start) {
+        start = cursor.offset;
+    } else if (header.log_id != cursor.log_id) {
+        result.restarted = true;
+    }
+
+    // Only the tail past the cursor is read
+    in.seekg(0, std::ios::end);
+    uint64_t size = static_cast<uint64_t>(in.tellg());
+    if (size < start) {
+        // Shorter than what we already read: not the log we knew, read it all
+        result.restarted = true;
+        start = sizeof(DeltaLogHeader);
+    }
+
+    std::string tail(size - start, '\0');
+    in.seekg(static_cast<std::streamoff>(start));
+    in.read(&tail[0], static_cast<std::streamsize>(tail.size()));
+    tail.resize(static_cast<size_t>(in.gcount()));
+
+    size_t valid = parse_records(tail.data(), tail.size(), &out);
+    result.bytes_ignored = tail.size() - valid;
+
+    cursor.log_id = header.log_id;
+    cursor.offset = start + valid;
+    return result;
+}
@@ -0,0 +1,240 @@
+#include "DocStatsStore.hpp"
+#include "Checksum.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+namespace {
+
+constexpr uint64_t SECTION_ALIGNMENT = 64;
+
+uint64_t align_up(uint64_t offset) {
+    return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+} // namespace
+
+bool doc_stats_format::read_source(const std::string& path, bool with_crc, Source& source) {
+    std::error_code ec;
+    source = Source{};
+    source.size = std::filesystem::file_size(path, ec);
+    if (ec) return false;
+    source.mtime = static_cast<int64_t>(std::filesystem::last_write_time(path, ec).time_since_epoch().count());
+    if (ec) return false;
+    if (!with_crc) return true;
+
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return false;
+    std::vector<char> chunk(1 << 20);
+    while (in) {
+        in.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+        source.crc = checksum::crc32(chunk.data(), static_cast<size_t>(in.gcount()), source.crc);
+    }
+    return !in.bad();
+}
+
+void DocStatsStore::Builder::add(int doc_id, int doc_length, int title_length,
+                                 std::vector<TitleFrequency> title_frequencies) {
+    if (doc_id < 0) return;
+    doc_length = std::max(0, doc_length);
+    rows_.push_back({doc_id, doc_length, std::clamp(title_length, 0, doc_length), std::move(title_frequencies)});
+}
+
+std::shared_ptr<DocStatsStore> DocStatsStore::build(Builder documents) {
+    return DocStatsStore().with_documents(std::move(documents));
+}
+
+std::shared_ptr<DocStatsStore> DocStatsStore::with_documents(Builder documents) const {
+    auto& rows = documents.rows_;
+    // By doc id; of repeated ids the last one added comes first and is kept
+    std::reverse(rows.begin(), rows.end());
+    std::stable_sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) { return a.doc_id < b.doc_id; });
+    rows.erase(std::unique(rows.begin(), rows.end(), [](const auto& a, const auto& b) { return a.doc_id == b.doc_id; }),
+               rows.end());
+
+    int max_doc_id = max_doc_id_;
+    if (!rows.empty()) max_doc_id = std::max(max_doc_id, rows.back().doc_id);
+
+    auto next = std::make_shared<DocStatsStore>();
+    size_t num_ids = static_cast<size_t>(max_doc_id + 1);
+    next->owned_lengths_.assign(num_ids, doc_stats_format::MISSING);
+    next->owned_title_lengths_.assign(num_ids, 0);
+    next->owned_offsets_.assign(num_ids + 1, 0);
+    next->owned_entries_.reserve(num_entries_);
+
+    auto row = rows.begin();
+    for (size_t doc_id = 0; doc_id < num_ids; ++doc_id) {
+        int id = static_cast<int>(doc_id);
+        while (row != rows.end() && row->doc_id < id) ++row;
+
+        if (contains(id)) {
+            next->owned_lengths_[doc_id] = lengths_[doc_id];
+            next->owned_title_lengths_[doc_id] = title_lengths_[doc_id];
+            next->owned_entries_.insert(next->owned_entries_.end(),
+                                        entries_ + offsets_[doc_id], entries_ + offsets_[doc_id + 1]);
+            ++next->num_documents_;
+        } else if (row != rows.end() && row->doc_id == id) {
+            auto& titles = row->title_frequencies;
+            std::sort(titles.begin(), titles.end(),
+                      [](const TitleFrequency& a, const TitleFrequency& b) { return a.word_id < b.word_id; });
+            next->owned_lengths_[doc_id] = row->doc_length;
+            next->owned_title_lengths_[doc_id] = row->title_length;
+            for (const TitleFrequency& title : titles) {
+                if (title.frequency > 0) next->owned_entries_.push_back(title);
+            }
+            ++next->num_documents_;
+        }
+        // Offsets are 32-bit; past that the remaining documents get no title words
+        size_t end = std::min<size_t>(next->owned_entries_.size(), std::numeric_limits<uint32_t>::max());
+        next->owned_entries_.resize(end);
+        next->owned_offsets_[doc_id + 1] = static_cast<uint32_t>(end);
+    }
+    next->max_doc_id_ = max_doc_id;
+    next->adopt_owned();
+    next->sum_lengths();
+    return next;
+}
+
+void DocStatsStore::adopt_owned() {
+    lengths_ = owned_lengths_.data();
+    title_lengths_ = owned_title_lengths_.data();
+    offsets_ = owned_offsets_.empty() ? EMPTY_OFFSETS : owned_offsets_.data();
+    entries_ = owned_entries_.data();
+    num_entries_ = owned_entries_.size();
+}
+
+void DocStatsStore::sum_lengths() {
+    total_length_ = 0;
+    total_title_length_ = 0;
+    for (int doc_id = 0; doc_id <= max_doc_id_; ++doc_id) {
+        if (lengths_[doc_id] == doc_stats_format::MISSING) continue;
+        total_length_ += static_cast<uint64_t>(lengths_[doc_id]);
+        total_title_length_ += static_cast<uint64_t>(title_lengths_[doc_id]);
+    }
+}
+
+bool DocStatsStore::load(const std::string& path) {
+    file_.close();
+    owned_lengths_.clear();
+    owned_title_lengths_.clear();
+    owned_offsets_.clear();
+    owned_entries_.clear();
+    adopt_owned();
+    max_doc_id_ = -1;
+    num_documents_ = 0;
+    total_length_ = 0;
+    total_title_length_ = 0;
+    source_ = doc_stats_format::Source{};
+
+    if (!file_.open(path)) {
+        return false;
+    }
+
+    DocStatsFileHeader header{};
+    if (file_.size() >= sizeof(header)) std::memcpy(&header, file_.data(), sizeof(header));
+    uint64_t num_ids = static_cast<uint64_t>(header.max_doc_id) + 1;
+    bool valid = file_.size() >= sizeof(header) &&
+                 std::memcmp(header.magic, doc_stats_format::MAGIC, 4) == 0 &&
+                 header.version == doc_stats_format::VERSION &&
+                 header.max_doc_id >= -1 &&
+                 header.num_entries <= std::numeric_limits<uint32_t>::max() &&
+                 header.lengths_offset >= sizeof(header) &&
+                 header.lengths_offset % sizeof(int32_t) == 0 &&
+                 header.title_lengths_offset % sizeof(int32_t) == 0 &&
+                 header.offsets_offset % sizeof(uint32_t) == 0 &&
+                 header.entries_offset % sizeof(int32_t) == 0 &&
+                 header.lengths_offset + num_ids * sizeof(int32_t) <= header.title_lengths_offset &&
+                 header.title_lengths_offset + num_ids * sizeof(int32_t) <= header.offsets_offset &&
+                 header.offsets_offset + (num_ids + 1) * sizeof(uint32_t) <= header.entries_offset &&
+                 header.entries_offset + header.num_entries * sizeof(TitleFrequency) <= file_.size();
+    const char* base = file_.data();
+    const uint32_t* offsets = reinterpret_cast<const uint32_t*>(base + header.offsets_offset);
+    if (valid) {
+        // Offsets are read straight into entries_: they must stay in bounds
+        valid = offsets[0] == 0 && offsets[num_ids] == header.num_entries;
+        for (uint64_t i = 0; i < num_ids && valid; ++i) valid = offsets[i] <= offsets[i + 1];
+    }
+    if (!valid) {
+        std::cerr << "[DocStats] Bad header or truncated file " << path << " (version " << header.version << ")\n";
+        file_.close();
+        return false;
+    }
+    if (checksum::crc32(base + header.lengths_offset, file_.size() - header.lengths_offset) != header.payload_crc) {
+        std::cerr << "[DocStats] Checksum mismatch in " << path << "\n";
+        file_.close();
+        return false;
+    }
+
+    lengths_ = reinterpret_cast<const int32_t*>(base + header.lengths_offset);
+    title_lengths_ = reinterpret_cast<const int32_t*>(base + header.title_lengths_offset);
+    offsets_ = offsets;
+    entries_ = reinterpret_cast<const TitleFrequency*>(base + header.entries_offset);
+    max_doc_id_ = header.max_doc_id;
+    num_documents_ = header.num_documents;
+    num_entries_ = header.num_entries;
+    source_.size = header.source_size;
+    source_.mtime = header.source_mtime;
+    source_.crc = header.source_crc;
+    sum_lengths();
+    return true;
+}
+
+bool DocStatsStore::save(const std::string& path, const doc_stats_format::Source& source) const {
+    DocStatsFileHeader header{};
+    std::memcpy(header.magic, doc_stats_format::MAGIC, 4);
+    header.version = doc_stats_format::VERSION;
+    header.num_documents = static_cast<uint32_t>(num_documents_);
+    header.max_doc_id = max_doc_id_;
+    header.num_entries = num_entries_;
+    uint64_t num_ids = static_cast<uint64_t>(max_doc_id_ + 1);
+    header.lengths_offset = align_up(sizeof(header));
+    header.title_lengths_offset = align_up(header.lengths_offset + num_ids * sizeof(int32_t));
+    header.offsets_offset = align_up(header.title_lengths_offset + num_ids * sizeof(int32_t));
+    header.entries_offset = align_up(header.offsets_offset + (num_ids + 1) * sizeof(uint32_t));
+    header.source_size = source.size;
+    header.source_mtime = source.mtime;
+    header.source_crc = source.crc;
+
+    // Written next to the target and renamed over it: a crash leaves the old file
+    std::string tmp_path = path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "[DocStats] Could not create " << tmp_path << "\n";
+        return false;
+    }
+    // The header goes last, once the payload checksum is known
+    uint64_t written = header.lengths_offset;
+    uint32_t crc = 0;
+    auto write_at = [&](uint64_t offset, const void* data, size_t bytes) {
+        static const char zeros[SECTION_ALIGNMENT] = {};
+        out.write(zeros, offset - written);
+        out.write(static_cast<const char*>(data), bytes);
+        crc = checksum::crc32(zeros, offset - written, crc);
+        crc = checksum::crc32(data, bytes, crc);
+        written = offset + bytes;
+    };
+    out.seekp(header.lengths_offset);
+    write_at(header.lengths_offset, lengths_, num_ids * sizeof(int32_t));
+    write_at(header.title_lengths_offset, title_lengths_, num_ids * sizeof(int32_t));
+    write_at(header.offsets_offset, offsets_, (num_ids + 1) * sizeof(uint32_t));
+    write_at(header.entries_offset, entries_, num_entries_ * sizeof(TitleFrequency));
+    header.payload_crc = crc;
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+    if (!out || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::cerr << "[DocStats] Could not write " << path << "\n";
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+size_t DocStatsStore::data_bytes() const {
+    size_t num_ids = static_cast<size_t>(max_doc_id_ + 1);
+    return 2 * num_ids * sizeof(int32_t) + (num_ids + 1) * sizeof(uint32_t) + num_entries_ * sizeof(TitleFrequency);
+}
@@ -0,0 +1,347 @@
+#include "DocumentVectors.hpp"
+#include "VectorKernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace vector_format {
+
+size_t element_size(Encoding encoding) {
+    switch (encoding) {
+        case Encoding::Float16: return sizeof(uint16_t);
+        case Encoding::Int8: return sizeof(int8_t);
+        default: return sizeof(float);
+    }
+}
+
+const char* encoding_name(Encoding encoding) {
+    switch (encoding) {
+        case Encoding::Float16: return "float16";
+        case Encoding::Int8: return "int8";
+        default: return "float32";
+    }
+}
+
+bool parse_encoding(const std::string& name, Encoding& encoding) {
+    for (Encoding candidate : {Encoding::Float32, Encoding::Float16, Encoding::Int8}) {
+        if (name == encoding_name(candidate)) {
+            encoding = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t padded_stride(uint32_t dim, Encoding encoding) {
+    uint32_t per_line = static_cast<uint32_t>(ROW_ALIGNMENT / element_size(encoding));
+    return (dim + per_line - 1) / per_line * per_line;
+}
+
+float encode_row(const float* values, uint32_t dim, Encoding encoding, void* out) {
+    switch (encoding) {
+        case Encoding::Float16: {
+            uint16_t* halves = static_cast<uint16_t*>(out);
+            for (uint32_t i = 0; i < dim; ++i) halves[i] = vector_kernels::float_to_half(values[i]);
+            return 1.0f;
+        }
+        case Encoding::Int8: {
+            float max_abs = 0.0f;
+            for (uint32_t i = 0; i < dim; ++i) max_abs = std::max(max_abs, std::fabs(values[i]));
+            int8_t* bytes = static_cast<int8_t*>(out);
+            if (max_abs == 0.0f) {
+                std::memset(bytes, 0, dim);
+                return 0.0f;
+            }
+            float scale = max_abs / 127.0f;
+            for (uint32_t i = 0; i < dim; ++i) {
+                float q = std::nearbyint(values[i] / scale);
+                bytes[i] = static_cast<int8_t>(std::max(-127.0f, std::min(127.0f, q)));
+            }
+            return scale;
+        }
+        default:
+            std::memcpy(out, values, dim * sizeof(float));
+            return 1.0f;
+    }
+}
+
+void decode_row(const void* row, float scale, uint32_t dim, Encoding encoding, float* out) {
+    switch (encoding) {
+        case Encoding::Float16: {
+            const uint16_t* halves = static_cast<const uint16_t*>(row);
+            for (uint32_t i = 0; i < dim; ++i) out[i] = vector_kernels::half_to_float(halves[i]);
+            break;
+        }
+        case Encoding::Int8: {
+            const int8_t* bytes = static_cast<const int8_t*>(row);
+            for (uint32_t i = 0; i < dim; ++i) out[i] = bytes[i] * scale;
+            break;
+        }
+        default:
+            std::memcpy(out, row, dim * sizeof(float));
+    }
+}
+
+} // namespace vector_format
+
+using vector_format::Encoding;
+
+void DocumentVectors::close() {
+    file_.close();
+    owned_matrix_.clear();
+    owned_row_table_.clear();
+    matrix_ = nullptr;
+    scales_ = nullptr;
+    row_table_ = nullptr;
+    num_rows_ = 0;
+    max_doc_id_ = -1;
+    num_documents_ = 0;
+}
+
+bool DocumentVectors::load(const std::string& path, uint32_t dim) {
+    close();
+
+    if (!file_.open(path)) {
+        std::cerr << "[DocumentVectors] Could not open document vectors file: " << path << "\n";
+        return false;
+    }
+    if (file_.size() < sizeof(VectorFileHeader) ||
+        std::memcmp(file_.data(), vector_format::MAGIC, 4) != 0) {
+        file_.close();
+        return load_legacy(path, dim);
+    }
+
+    VectorFileHeader header;
+    std::memcpy(&header, file_.data(), sizeof(header));
+
+    Encoding encoding = static_cast<Encoding>(header.encoding);
+    bool known_encoding = encoding == Encoding::Float32 || encoding == Encoding::Float16 ||
+                          encoding == Encoding::Int8;
+    size_t element = vector_format::element_size(encoding);
+    uint64_t row_bytes = uint64_t{header.row_stride} * element;
+    uint64_t matrix_bytes = uint64_t{header.num_rows} * row_bytes;
+    uint64_t scales_bytes = encoding == Encoding::Int8 ? uint64_t{header.num_rows} * sizeof(float) : 0;
+    uint64_t table_bytes = (header.flags & vector_format::FLAG_ROW_TABLE)
+        ? (uint64_t(int64_t{header.max_doc_id} + 1)) * sizeof(int32_t) : 0;
+    bool valid = header.version == vector_format::VERSION &&
+                 known_encoding &&
+                 header.dim == dim &&
+                 header.row_stride >= dim &&
+                 row_bytes % vector_format::ROW_ALIGNMENT == 0 &&
+                 header.matrix_offset % vector_format::ROW_ALIGNMENT == 0 &&
+                 header.matrix_offset >= sizeof(VectorFileHeader) &&
+                 header.max_doc_id >= -1 &&
+                 header.matrix_offset + matrix_bytes <= file_.size();
+    if (valid && scales_bytes > 0) {
+        valid = header.scales_offset % alignof(float) == 0 &&
+                header.scales_offset + scales_bytes <= file_.size();
+    }
+    if (valid && table_bytes > 0) {
+        valid = header.row_table_offset % alignof(int32_t) == 0 &&
+                header.row_table_offset + table_bytes <= file_.size();
+    } else if (valid) {
+        valid = int64_t{header.num_rows} == int64_t{header.max_doc_id} + 1;
+    }
+    if (!valid) {
+        std::cerr << "[DocumentVectors] Bad header or truncated file " << path << " (version " << header.version
+                  << ", dim " << header.dim << ", expected dim " << dim
+                  << ", encoding " << header.encoding << ")\n";
+        file_.close();
+        return false;
+    }
+
+    matrix_ = reinterpret_cast<const uint8_t*>(file_.data() + header.matrix_offset);
+    if (scales_bytes > 0) {
+        scales_ = reinterpret_cast<const float*>(file_.data() + header.scales_offset);
+    }
+    if (table_bytes > 0) {
+        row_table_ = reinterpret_cast<const int32_t*>(file_.data() + header.row_table_offset);
+        // Row numbers come from the file; don't trust them blindly
+        for (int32_t doc_id = 0; doc_id <= header.max_doc_id; ++doc_id) {
+            if (row_table_[doc_id] >= static_cast<int64_t>(header.num_rows)) {
+                std::cerr << "[DocumentVectors] Row table of " << path << " points past the matrix\n";
+                close();
+                return false;
+            }
+        }
+    }
+    encoding_ = encoding;
+    dim_ = header.dim;
+    row_bytes_ = row_bytes;
+    num_rows_ = header.num_rows;
+    max_doc_id_ = header.max_doc_id;
+    num_documents_ = header.num_documents;
+    return num_documents_ > 0;
+}
+
+bool DocumentVectors::load_legacy(const std::string& path, uint32_t dim) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "[DocumentVectors] Could not open document vectors file: " << path << "\n";
+        return false;
+    }
+    std::cout << "[DocumentVectors] " << path << " is in the old record format; reading it into memory"
+              << " (rerun build_semantic_vectors.py to get a file that can be mapped)\n";
+
+    int32_t num_docs = 0;
+    file.read(reinterpret_cast<char*>(&num_docs), sizeof(num_docs));
+
+    std::vector<std::pair<int32_t, std::vector<float>>> records;
+    records.reserve(num_docs > 0 ? num_docs : 0);
+    for (int32_t i = 0; i < num_docs; ++i) {
+        int32_t doc_id;
+        file.read(reinterpret_cast<char*>(&doc_id), sizeof(doc_id));
+        std::vector<float> vector(dim);
+        file.read(reinterpret_cast<char*>(vector.data()), dim * sizeof(float));
+        if (!file.good()) break;
+        if (doc_id < 0) continue;
+        records.emplace_back(doc_id, std::move(vector));
+    }
+    if (records.empty()) return false;
+
+    int32_t max_doc_id = 0;
+    for (const auto& record : records) max_doc_id = std::max(max_doc_id, record.first);
+
+    // Same layout choice as the writer: dense unless most rows would be padding
+    size_t dense_rows = static_cast<size_t>(max_doc_id) + 1;
+    bool use_row_table = dense_rows > 2 * records.size();
+    if (use_row_table) {
+        owned_row_table_.assign(dense_rows, -1);
+    }
+
+    uint32_t stride = vector_format::padded_stride(dim, Encoding::Float32);
+    size_t max_rows = use_row_table ? records.size() : dense_rows;
+    constexpr size_t align_floats = vector_format::ROW_ALIGNMENT / sizeof(float);
+    owned_matrix_.assign(max_rows * stride + align_floats, 0.0f);
+    float* base = owned_matrix_.data();
+    size_t misalignment = reinterpret_cast<uintptr_t>(base) % vector_format::ROW_ALIGNMENT;
+    if (misalignment != 0) base += (vector_format::ROW_ALIGNMENT - misalignment) / sizeof(float);
+
+    uint32_t rows = use_row_table ? 0 : static_cast<uint32_t>(dense_rows);
+    size_t documents = 0;
+    std::vector<bool> seen(dense_rows, false);
+    for (auto& record : records) {
+        int32_t doc_id = record.first;
+        size_t row = doc_id;
+        if (use_row_table) {
+            if (owned_row_table_[doc_id] < 0) owned_row_table_[doc_id] = static_cast<int32_t>(rows++);
+            row = owned_row_table_[doc_id];
+        }
+        if (!seen[doc_id]) {
+            seen[doc_id] = true;
+            ++documents;
+        }
+        // Later records for the same id win, as they did in the old hash map
+        float* destination = base + row * stride;
+        std::memcpy(destination, record.second.data(), dim * sizeof(float));
+        vector_kernels::normalize(destination, dim);
+    }
+
+    matrix_ = reinterpret_cast<const uint8_t*>(base);
+    row_table_ = use_row_table ? owned_row_table_.data() : nullptr;
+    encoding_ = Encoding::Float32;
+    dim_ = dim;
+    row_bytes_ = stride * sizeof(float);
+    num_rows_ = rows;
+    max_doc_id_ = max_doc_id;
+    num_documents_ = documents;
+    return true;
+}
+
+double DocumentVectors::dot(const float* query, uint32_t row) const {
+    const uint8_t* data = row_data(row);
+    switch (encoding_) {
+        case Encoding::Float16:
+            return vector_kernels::dot_f16(query, reinterpret_cast<const uint16_t*>(data), dim_);
+        case Encoding::Int8:
+            return scales_[row] * vector_kernels::dot_i8(query, reinterpret_cast<const int8_t*>(data), dim_);
+        default:
+            return vector_kernels::dot(query, reinterpret_cast<const float*>(data), dim_);
+    }
+}
+
+void DocumentVectors::decode(uint32_t row, float* out) const {
+    vector_format::decode_row(row_data(row), row_scale(row), dim_, encoding_, out);
+}
+
+size_t DocumentVectors::data_bytes() const {
+    size_t bytes = static_cast<size_t>(num_rows_) * row_bytes_;
+    if (scales_) bytes += num_rows_ * sizeof(float);
+    if (row_table_) bytes += (static_cast<size_t>(max_doc_id_) + 1) * sizeof(int32_t);
+    return bytes;
+}
+
+bool DocumentVectors::write(const std::string& path, const DocumentVectors& source,
+                            Encoding encoding, std::string& error) {
+    if (!source.is_loaded()) {
+        error = "no vectors loaded";
+        return false;
+    }
+
+    uint32_t dim = source.dim();
+    uint32_t stride = vector_format::padded_stride(dim, encoding);
+    size_t row_bytes = stride * vector_format::element_size(encoding);
+    bool has_table = source.row_table_ != nullptr;
+
+    VectorFileHeader header{};
+    std::memcpy(header.magic, vector_format::MAGIC, 4);
+    header.version = vector_format::VERSION;
+    header.dim = dim;
+    header.row_stride = stride;
+    header.num_rows = source.num_rows();
+    header.num_documents = static_cast<uint32_t>(source.num_documents());
+    header.max_doc_id = source.max_doc_id();
+    header.flags = has_table ? vector_format::FLAG_ROW_TABLE : 0;
+    header.encoding = static_cast<uint32_t>(encoding);
+    header.matrix_offset = sizeof(VectorFileHeader);
+    uint64_t end = header.matrix_offset + uint64_t{header.num_rows} * row_bytes;
+    if (encoding == Encoding::Int8) {
+        header.scales_offset = end;
+        end += uint64_t{header.num_rows} * sizeof(float);
+    }
+    if (has_table) {
+        header.row_table_offset = end;
+    }
+
+    // Written next to the target and renamed over it, like the barrels
+    std::string tmp_path = path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        error = "could not create " + tmp_path;
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<float> values(dim);
+    std::vector<uint8_t> encoded(row_bytes, 0);
+    std::vector<float> scales;
+    scales.reserve(encoding == Encoding::Int8 ? header.num_rows : 0);
+    for (uint32_t row = 0; row < header.num_rows; ++row) {
+        source.decode(row, values.data());
+        float scale = vector_format::encode_row(values.data(), dim, encoding, encoded.data());
+        if (encoding == Encoding::Int8) scales.push_back(scale);
+        out.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+    }
+    if (encoding == Encoding::Int8) {
+        out.write(reinterpret_cast<const char*>(scales.data()), scales.size() * sizeof(float));
+    }
+    if (has_table) {
+        out.write(reinterpret_cast<const char*>(source.row_table_),
+                  (static_cast<size_t>(source.max_doc_id()) + 1) * sizeof(int32_t));
+    }
+    out.close();
+    if (!out) {
+        error = "write to " + tmp_path + " failed";
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        error = "could not rename " + tmp_path + " to " + path;
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
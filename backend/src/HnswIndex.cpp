@@ -0,0 +1,501 @@
+#include "HnswIndex.hpp"
+#include "VectorKernels.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <queue>
+#include <random>
+
+namespace {
+
+struct Candidate {
+    float similarity;
+    uint32_t node;
+};
+
+// Priority queue orders: BestOnTop for the nodes still to expand, WorstOnTop
+// for the beam of results so far
+struct BestOnTop {
+    bool operator()(const Candidate& a, const Candidate& b) const { return a.similarity < b.similarity; }
+};
+struct WorstOnTop {
+    bool operator()(const Candidate& a, const Candidate& b) const { return a.similarity > b.similarity; }
+};
+
+// Nodes seen by the current search. Marks carry the search's generation, so
+// starting a search doesn't clear anything.
+class VisitedSet {
+public:
+    void start(size_t num_nodes) {
+        if (marks_.size() < num_nodes) marks_.resize(num_nodes, 0);
+        if (++generation_ == 0) {
+            std::fill(marks_.begin(), marks_.end(), 0);
+            generation_ = 1;
+        }
+    }
+
+    // True the first time node is seen since start()
+    bool visit(uint32_t node) {
+        if (marks_[node] == generation_) return false;
+        marks_[node] = generation_;
+        return true;
+    }
+
+private:
+    std::vector<uint32_t> marks_;
+    uint32_t generation_ = 0;
+};
+
+// Walk one level towards the query, always moving to the most similar neighbour
+// (the upper levels are only used to find a good entry point into level 0).
+// similarity(node) scores a node against the query; neighbors(node) returns
+// its count-prefixed list on the level.
+template <typename Similarity, typename Neighbors>
+Candidate greedy_closest(Candidate current, Similarity similarity, Neighbors neighbors) {
+    bool moved = true;
+    while (moved) {
+        moved = false;
+        const uint32_t* list = neighbors(current.node);
+        for (uint32_t i = 1; i <= list[0]; ++i) {
+            float s = similarity(list[i]);
+            if (s > current.similarity) {
+                current = {s, list[i]};
+                moved = true;
+            }
+        }
+    }
+    return current;
+}
+
+// Best-first beam search of one level: up to ef nodes, best first. visited
+// must have been started for this search.
+template <typename Similarity, typename Neighbors>
+std::vector<Candidate> search_level(const std::vector<Candidate>& entry_points, size_t ef,
+                                    VisitedSet& visited, Similarity similarity, Neighbors neighbors) {
+    std::priority_queue<Candidate, std::vector<Candidate>, BestOnTop> frontier;
+    std::priority_queue<Candidate, std::vector<Candidate>, WorstOnTop> beam;
+    for (const Candidate& entry : entry_points) {
+        if (!visited.visit(entry.node)) continue;
+        frontier.push(entry);
+        beam.push(entry);
+        if (beam.size() > ef) beam.pop();
+    }
+
+    while (!frontier.empty()) {
+        Candidate current = frontier.top();
+        // Everything left is worse than the whole beam
+        if (beam.size() >= ef && current.similarity < beam.top().similarity) break;
+        frontier.pop();
+
+        const uint32_t* list = neighbors(current.node);
+        for (uint32_t i = 1; i <= list[0]; ++i) {
+            uint32_t next = list[i];
+            if (!visited.visit(next)) continue;
+            float s = similarity(next);
+            if (beam.size() < ef || s > beam.top().similarity) {
+                frontier.push({s, next});
+                beam.push({s, next});
+                if (beam.size() > ef) beam.pop();
+            }
+        }
+    }
+
+    std::vector<Candidate> best(beam.size());
+    for (size_t i = best.size(); i-- > 0; ) {
+        best[i] = beam.top();
+        beam.pop();
+    }
+    return best;
+}
+
+// File layout of the per-node sections, derived from the node count
+struct NodeSections {
+    uint64_t rows_offset;
+    uint64_t doc_ids_offset;
+    uint64_t levels_offset;
+    uint64_t upper_index_offset;
+    uint64_t end;
+
+    explicit NodeSections(uint64_t num_nodes) {
+        rows_offset = sizeof(HnswFileHeader);
+        doc_ids_offset = rows_offset + num_nodes * sizeof(uint32_t);
+        levels_offset = doc_ids_offset + num_nodes * sizeof(int32_t);
+        upper_index_offset = levels_offset + (num_nodes + 3) / 4 * 4;
+        end = upper_index_offset + num_nodes * sizeof(uint32_t);
+    }
+};
+
+// Builds the graph in memory in the file's layout (fixed-size, count-prefixed
+// neighbour lists) and writes it out
+class GraphBuilder {
+public:
+    GraphBuilder(const DocumentVectors& vectors, const HnswIndex::BuildOptions& options)
+        : vectors_(vectors),
+          dim_(vectors.dim()),
+          max_neighbors_(options.max_neighbors),
+          max_neighbors0_(2 * options.max_neighbors),
+          ef_construction_(std::max(options.ef_construction, options.max_neighbors)),
+          rng_(options.seed),
+          level_multiplier_(1.0 / std::log(std::max(2u, options.max_neighbors))) {}
+
+    // Every row with a vector becomes a node
+    void collect_nodes() {
+        bool decode = vectors_.encoding() != vector_format::Encoding::Float32;
+        std::vector<float> values(dim_);
+        for (int32_t doc_id = 0; doc_id <= vectors_.max_doc_id(); ++doc_id) {
+            int64_t row = vectors_.row_index(doc_id);
+            if (row < 0) continue;
+            vectors_.decode(static_cast<uint32_t>(row), values.data());
+            if (vector_kernels::dot(values.data(), values.data(), dim_) == 0.0) continue;
+
+            rows_.push_back(static_cast<uint32_t>(row));
+            doc_ids_.push_back(doc_id);
+            if (decode) decoded_.insert(decoded_.end(), values.begin(), values.end());
+        }
+    }
+
+    size_t num_nodes() const { return rows_.size(); }
+
+    void insert_all() {
+        uint32_t count = static_cast<uint32_t>(rows_.size());
+        level0_.assign(static_cast<size_t>(count) * (1 + max_neighbors0_), 0);
+        upper_.resize(count);
+        levels_.resize(count);
+
+        auto start = std::chrono::steady_clock::now();
+        uint32_t report_every = std::max(1u, count / 10);
+        for (uint32_t node = 0; node < count; ++node) {
+            insert(node);
+            if ((node + 1) % report_every == 0 || node + 1 == count) {
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                std::cout << "[HnswIndex] Inserted " << node + 1 << " / " << count
+                          << " (" << seconds << " s)\n";
+            }
+        }
+    }
+
+    bool write(const std::string& path, std::string& error) const {
+        uint32_t count = static_cast<uint32_t>(rows_.size());
+        NodeSections sections(count);
+
+        std::vector<uint32_t> upper_index(count, 0);
+        uint32_t num_upper_blocks = 0;
+        for (uint32_t node = 0; node < count; ++node) {
+            upper_index[node] = num_upper_blocks;
+            num_upper_blocks += levels_[node];
+        }
+
+        HnswFileHeader header{};
+        std::memcpy(header.magic, hnsw_format::MAGIC, 4);
+        header.version = hnsw_format::VERSION;
+        header.dim = dim_;
+        header.num_nodes = count;
+        header.vector_rows = vectors_.num_rows();
+        header.vector_max_doc_id = vectors_.max_doc_id();
+        header.max_neighbors = max_neighbors_;
+        header.max_neighbors0 = max_neighbors0_;
+        header.max_level = max_level_;
+        header.entry_point = entry_point_;
+        header.ef_construction = ef_construction_;
+        header.num_upper_blocks = num_upper_blocks;
+        header.level0_offset = (sections.end + vector_format::ROW_ALIGNMENT - 1) /
+                               vector_format::ROW_ALIGNMENT * vector_format::ROW_ALIGNMENT;
+        header.upper_offset = header.level0_offset + level0_.size() * sizeof(uint32_t);
+
+        // Written next to the target and renamed over it, like the vector files
+        std::string tmp_path = path + ".tmp";
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            error = "could not create " + tmp_path;
+            return false;
+        }
+        const char zeros[vector_format::ROW_ALIGNMENT] = {};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(rows_.data()), rows_.size() * sizeof(uint32_t));
+        out.write(reinterpret_cast<const char*>(doc_ids_.data()), doc_ids_.size() * sizeof(int32_t));
+        out.write(reinterpret_cast<const char*>(levels_.data()), levels_.size());
+        out.write(zeros, sections.upper_index_offset - sections.levels_offset - levels_.size());
+        out.write(reinterpret_cast<const char*>(upper_index.data()), upper_index.size() * sizeof(uint32_t));
+        out.write(zeros, header.level0_offset - sections.end);
+        out.write(reinterpret_cast<const char*>(level0_.data()), level0_.size() * sizeof(uint32_t));
+        for (const auto& blocks : upper_) {
+            out.write(reinterpret_cast<const char*>(blocks.data()), blocks.size() * sizeof(uint32_t));
+        }
+        out.close();
+        if (!out) {
+            error = "write to " + tmp_path + " failed";
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+        if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+            error = "could not rename " + tmp_path + " to " + path;
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    const float* vector_of(uint32_t node) const {
+        if (!decoded_.empty()) return decoded_.data() + static_cast<size_t>(node) * dim_;
+        return reinterpret_cast<const float*>(vectors_.row_data(rows_[node]));
+    }
+
+    float similarity(uint32_t a, uint32_t b) const {
+        return static_cast<float>(vector_kernels::dot(vector_of(a), vector_of(b), dim_));
+    }
+
+    uint32_t* list(uint32_t node, uint32_t level) {
+        if (level == 0) return level0_.data() + static_cast<size_t>(node) * (1 + max_neighbors0_);
+        return upper_[node].data() + static_cast<size_t>(level - 1) * (1 + max_neighbors_);
+    }
+
+    uint32_t random_level() {
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        double level = -std::log(1.0 - uniform(rng_)) * level_multiplier_;
+        return static_cast<uint32_t>(std::min<double>(level, hnsw_format::MAX_LEVEL));
+    }
+
+    // Up to max of the candidates (best first, similarity to base), skipping
+    // any that is more similar to an already chosen neighbour than to base.
+    // Keeps the links spread out instead of all pointing into one cluster
+    // (the neighbour selection heuristic of the HNSW paper).
+    void select_neighbors(const std::vector<Candidate>& candidates, uint32_t max,
+                          std::vector<Candidate>& selected) const {
+        selected.clear();
+        for (const Candidate& candidate : candidates) {
+            if (selected.size() >= max) break;
+            bool diverse = true;
+            for (const Candidate& chosen : selected) {
+                if (similarity(candidate.node, chosen.node) > candidate.similarity) {
+                    diverse = false;
+                    break;
+                }
+            }
+            if (diverse) selected.push_back(candidate);
+        }
+    }
+
+    // Link node to selected on level, and each of them back to node, pruning
+    // their lists when they overflow
+    void connect(uint32_t node, uint32_t level, const std::vector<Candidate>& selected) {
+        uint32_t capacity = level == 0 ? max_neighbors0_ : max_neighbors_;
+        uint32_t* own = list(node, level);
+        own[0] = static_cast<uint32_t>(selected.size());
+        for (size_t i = 0; i < selected.size(); ++i) own[1 + i] = selected[i].node;
+
+        std::vector<Candidate> candidates, kept;
+        for (const Candidate& neighbor : selected) {
+            uint32_t* other = list(neighbor.node, level);
+            if (other[0] < capacity) {
+                other[1 + other[0]++] = node;
+                continue;
+            }
+            candidates.clear();
+            candidates.push_back({neighbor.similarity, node});
+            for (uint32_t i = 1; i <= other[0]; ++i) {
+                candidates.push_back({similarity(neighbor.node, other[i]), other[i]});
+            }
+            std::sort(candidates.begin(), candidates.end(),
+                      [](const Candidate& a, const Candidate& b) { return a.similarity > b.similarity; });
+            select_neighbors(candidates, capacity, kept);
+            other[0] = static_cast<uint32_t>(kept.size());
+            for (size_t i = 0; i < kept.size(); ++i) other[1 + i] = kept[i].node;
+        }
+    }
+
+    void insert(uint32_t node) {
+        uint32_t level = random_level();
+        levels_[node] = static_cast<uint8_t>(level);
+        upper_[node].assign(static_cast<size_t>(level) * (1 + max_neighbors_), 0);
+        if (node == 0) {
+            entry_point_ = 0;
+            max_level_ = level;
+            return;
+        }
+
+        auto similarity_to_node = [&](uint32_t other) { return similarity(node, other); };
+        Candidate current{similarity(node, entry_point_), entry_point_};
+        for (uint32_t l = max_level_; l > level; --l) {
+            current = greedy_closest(current, similarity_to_node, [&](uint32_t n) { return list(n, l); });
+        }
+
+        std::vector<Candidate> entry_points{current};
+        std::vector<Candidate> selected;
+        for (uint32_t l = std::min(level, max_level_) + 1; l-- > 0; ) {
+            visited_.start(rows_.size());
+            std::vector<Candidate> found = search_level(entry_points, ef_construction_, visited_,
+                                                        similarity_to_node, [&](uint32_t n) { return list(n, l); });
+            select_neighbors(found, max_neighbors_, selected);
+            connect(node, l, selected);
+            entry_points = std::move(found);
+        }
+
+        if (level > max_level_) {
+            max_level_ = level;
+            entry_point_ = node;
+        }
+    }
+
+    const DocumentVectors& vectors_;
+    uint32_t dim_;
+    uint32_t max_neighbors_;
+    uint32_t max_neighbors0_;
+    uint32_t ef_construction_;
+    std::mt19937 rng_;
+    double level_multiplier_;
+
+    std::vector<uint32_t> rows_;
+    std::vector<int32_t> doc_ids_;
+    std::vector<float> decoded_;                // Quantized input only: node vectors as floats
+    std::vector<uint8_t> levels_;
+    std::vector<uint32_t> level0_;
+    std::vector<std::vector<uint32_t>> upper_;  // Per node, levels 1..L
+    uint32_t max_level_ = 0;
+    uint32_t entry_point_ = 0;
+    VisitedSet visited_;
+};
+
+} // namespace
+
+bool HnswIndex::build(const DocumentVectors& vectors, const BuildOptions& options,
+                      const std::string& path, std::string& error) {
+    if (!vectors.is_loaded()) {
+        error = "no vectors loaded";
+        return false;
+    }
+    if (options.max_neighbors < 2) {
+        error = "max_neighbors must be at least 2";
+        return false;
+    }
+
+    GraphBuilder builder(vectors, options);
+    builder.collect_nodes();
+    if (builder.num_nodes() == 0) {
+        error = "no document has a vector";
+        return false;
+    }
+    builder.insert_all();
+    return builder.write(path, error);
+}
+
+void HnswIndex::close() {
+    file_.close();
+    node_rows_ = nullptr;
+    node_doc_ids_ = nullptr;
+    node_levels_ = nullptr;
+    upper_index_ = nullptr;
+    level0_ = nullptr;
+    upper_ = nullptr;
+    num_nodes_ = 0;
+    vector_rows_ = 0;
+    max_level_ = 0;
+}
+
+bool HnswIndex::load(const std::string& path, const DocumentVectors& vectors) {
+    close();
+
+    if (!file_.open(path)) {
+        std::cerr << "[HnswIndex] Could not open graph file: " << path << "\n";
+        return false;
+    }
+
+    HnswFileHeader header{};
+    if (file_.size() >= sizeof(header)) std::memcpy(&header, file_.data(), sizeof(header));
+    NodeSections sections(header.num_nodes);
+    uint64_t level0_bytes = uint64_t{header.num_nodes} * (1 + uint64_t{header.max_neighbors0}) * sizeof(uint32_t);
+    uint64_t upper_bytes = uint64_t{header.num_upper_blocks} * (1 + uint64_t{header.max_neighbors}) * sizeof(uint32_t);
+    bool valid = file_.size() >= sizeof(header) &&
+                 std::memcmp(header.magic, hnsw_format::MAGIC, 4) == 0 &&
+                 header.version == hnsw_format::VERSION &&
+                 header.num_nodes > 0 &&
+                 header.max_neighbors > 0 &&
+                 header.max_neighbors0 > 0 &&
+                 header.max_level <= hnsw_format::MAX_LEVEL &&
+                 header.entry_point < header.num_nodes &&
+                 header.level0_offset % sizeof(uint32_t) == 0 &&
+                 header.level0_offset >= sections.end &&
+                 header.upper_offset == header.level0_offset + level0_bytes &&
+                 header.upper_offset + upper_bytes <= file_.size();
+    if (!valid) {
+        std::cerr << "[HnswIndex] Bad header or truncated file " << path << "\n";
+        close();
+        return false;
+    }
+    if (header.dim != vectors.dim() || header.vector_rows != vectors.num_rows() ||
+        header.vector_max_doc_id != vectors.max_doc_id()) {
+        std::cerr << "[HnswIndex] " << path << " was built for other document vectors ("
+                  << header.vector_rows << " rows, max doc id " << header.vector_max_doc_id
+                  << "); rerun build_hnsw\n";
+        close();
+        return false;
+    }
+
+    const char* base = file_.data();
+    node_rows_ = reinterpret_cast<const uint32_t*>(base + sections.rows_offset);
+    node_doc_ids_ = reinterpret_cast<const int32_t*>(base + sections.doc_ids_offset);
+    node_levels_ = reinterpret_cast<const uint8_t*>(base + sections.levels_offset);
+    upper_index_ = reinterpret_cast<const uint32_t*>(base + sections.upper_index_offset);
+    level0_ = reinterpret_cast<const uint32_t*>(base + header.level0_offset);
+    upper_ = reinterpret_cast<const uint32_t*>(base + header.upper_offset);
+    num_nodes_ = header.num_nodes;
+    vector_rows_ = header.vector_rows;
+    max_neighbors_ = header.max_neighbors;
+    max_neighbors0_ = header.max_neighbors0;
+    max_level_ = header.max_level;
+    entry_point_ = header.entry_point;
+
+    // Every number below comes from the file and is used as an index; check
+    // them once here so search() doesn't have to
+    bool consistent = node_levels_[entry_point_] == max_level_;
+    for (uint32_t node = 0; node < num_nodes_ && consistent; ++node) {
+        uint32_t levels = node_levels_[node];
+        consistent = node_rows_[node] < header.vector_rows &&
+                     levels <= max_level_ &&
+                     uint64_t{upper_index_[node]} + levels <= header.num_upper_blocks;
+        for (uint32_t level = 0; level <= levels && consistent; ++level) {
+            const uint32_t* list = neighbors(node, level);
+            consistent = list[0] <= (level == 0 ? max_neighbors0_ : max_neighbors_);
+            for (uint32_t i = 1; i <= list[0] && consistent; ++i) {
+                consistent = list[i] < num_nodes_ && node_levels_[list[i]] >= level;
+            }
+        }
+    }
+    if (!consistent) {
+        std::cerr << "[HnswIndex] " << path << " has out of range nodes or neighbours\n";
+        close();
+        return false;
+    }
+    return true;
+}
+
+std::vector<VectorMatch> HnswIndex::search(const DocumentVectors& vectors, const float* query,
+                                                   size_t k, size_t ef) const {
+    if (!is_loaded() || k == 0 || vectors.num_rows() != vector_rows_) return {};
+
+    auto similarity = [&](uint32_t node) {
+        return static_cast<float>(vectors.dot(query, node_rows_[node]));
+    };
+
+    Candidate current{similarity(entry_point_), entry_point_};
+    for (uint32_t level = max_level_; level > 0; --level) {
+        current = greedy_closest(current, similarity, [&](uint32_t n) { return neighbors(n, level); });
+    }
+
+    // One per server thread, reused across queries
+    static thread_local VisitedSet visited;
+    visited.start(num_nodes_);
+    std::vector<Candidate> best = search_level({current}, std::max(ef, k), visited, similarity,
+                                               [&](uint32_t n) { return neighbors(n, 0); });
+
+    std::vector<VectorMatch> results;
+    results.reserve(std::min(k, best.size()));
+    for (size_t i = 0; i < best.size() && i < k; ++i) {
+        results.push_back({node_doc_ids_[best[i].node], best[i].similarity});
+    }
+    return results;
+}
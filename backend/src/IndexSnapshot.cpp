@@ -0,0 +1,129 @@
+#include "IndexSnapshot.hpp"
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <iterator>
+
+namespace fs = std::filesystem;
+
+namespace {
+std::atomic<uint64_t> next_barrel_generation{1};
+}
+
+BarrelSet::BarrelSet(std::string barrels_dir, std::shared_ptr<BarrelCache> cache)
+    : barrels_dir_(std::move(barrels_dir)),
+      generation_(next_barrel_generation++),
+      cache_(std::move(cache)) {}
+
+BarrelSet::~BarrelSet() {
+    for (int barrel_id = 0; barrel_id < NUM_BARRELS; ++barrel_id) {
+        cache_->erase(generation_, barrel_id);
+    }
+    if (retired_) remove_files(barrels_dir_);
+}
+
+void BarrelSet::remove_files(const std::string& barrels_dir) {
+    // Mappings still held by running searches stay valid after the unlink
+    std::error_code ec;
+    for (int barrel_id = 0; barrel_id < NUM_BARRELS; ++barrel_id) {
+        fs::remove(barrels_dir + "/inverted_barrel_" + std::to_string(barrel_id) + ".bin", ec);
+    }
+    fs::remove(barrels_dir, ec);  // Only if nothing else lives there
+    std::cout << "[Segments] Removed retired segment " << barrels_dir << "\n";
+}
+
+std::shared_ptr<const BinaryBarrel> BarrelSet::get(int barrel_id) const {
+    if (barrel_id < 0 || barrel_id >= NUM_BARRELS) return nullptr;
+
+    std::shared_ptr<const BinaryBarrel> barrel;
+    if (cache_->lookup(generation_, barrel_id, barrel)) {
+        return barrel;
+    }
+
+    // Miss: map outside any lock. Racing threads may both map it; insert keeps one.
+    std::string path = barrels_dir_ + "/inverted_barrel_" + std::to_string(barrel_id) + ".bin";
+    auto opened = std::make_shared<BinaryBarrel>();
+    if (!opened->open(path)) {
+        std::cerr << "[Engine] WARNING: Could not load barrel " << barrel_id << "\n";
+        opened = nullptr;
+    }
+    return cache_->insert(generation_, barrel_id, std::move(opened));
+}
+
+int IndexSnapshot::get_word_index(const std::string& word) const {
+    int word_id = lexicon->get_word_index(word);
+    return word_id != -1 ? word_id : delta->word_id(word);
+}
+
+std::vector<std::string> IndexSnapshot::autocomplete(const std::string& prefix, int k) const {
+    std::vector<std::string> base = lexicon->autocomplete(prefix, k);
+    std::vector<std::string> added = delta->autocomplete(prefix, k);
+    if (added.empty()) return base;
+
+    // Both lists are sorted; the delta only holds words the lexicon lacks
+    std::vector<std::string> merged;
+    merged.reserve(base.size() + added.size());
+    std::merge(base.begin(), base.end(), added.begin(), added.end(), std::back_inserter(merged));
+    if (merged.size() > static_cast<size_t>(k)) merged.resize(k);
+    return merged;
+}
+
+int DocStatsRef::title_frequency(int word_id) const {
+    if (!delta_) {
+        return store_->title_frequency(doc_id_, word_id);
+    }
+
+    auto word_it = delta_->title_frequencies.find(word_id);
+    if (word_it == delta_->title_frequencies.end()) {
+        return 0;
+    }
+
+    return static_cast<int>(word_it->second);
+}
+
+// Segment stats first: they belong to documents newer than the stats on disk
+DocStatsRef IndexSnapshot::get_doc_stats(int doc_id) const {
+    return DocStatsRef(delta->stats(doc_id), doc_stats.get(), doc_id);
+}
+
+const DocMetadata* IndexSnapshot::get_metadata(int doc_id) const {
+    if (const DocMetadata* meta = delta->metadata(doc_id)) return meta;
+    return metadata->get_metadata(doc_id);
+}
+
+StaticScore IndexSnapshot::get_static_score(int doc_id) const {
+    if (const StaticScore* score = delta->static_score(doc_id)) return *score;
+    return static_scores->get(doc_id);
+}
+
+const std::string& IndexSnapshot::get_url(int doc_id) const {
+    const DocMetadata* meta = delta->metadata(doc_id);
+    if (meta && !meta->url.empty()) return meta->url;
+    return doc_urls->get(doc_id);
+}
+
+CollectionStats IndexSnapshot::collection_stats() const {
+    uint64_t documents = doc_stats->size() + delta->num_stats();
+    uint64_t total = doc_stats->total_length() + delta->total_length();
+    uint64_t title = doc_stats->total_title_length() + delta->total_title_length();
+
+    CollectionStats stats;
+    stats.num_documents = static_cast<uint32_t>(documents);
+    if (documents > 0) {
+        stats.avg_title_length = static_cast<float>(static_cast<double>(title) / documents);
+        stats.avg_body_length = static_cast<float>(static_cast<double>(total - title) / documents);
+    }
+    return stats;
+}
+
+uint32_t IndexSnapshot::document_frequency(int word_id) const {
+    uint32_t documents = 0;
+    if (word_id < 0) return documents;
+    for (const auto& segment : segments) {
+        auto barrel = segment->get(word_id % BarrelSet::NUM_BARRELS);
+        PostingListView postings;
+        if (barrel && barrel->find(word_id, postings)) documents += postings.size;
+    }
+    if (const auto* entries = delta->postings(word_id)) documents += static_cast<uint32_t>(entries->size());
+    return documents;
+}
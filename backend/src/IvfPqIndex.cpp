@@ -0,0 +1,556 @@
+#include "IvfPqIndex.hpp"
+#include "VectorKernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <thread>
+
+using vector_kernels::PQ4_BLOCK;
+using ivfpq_format::CODEWORDS;
+
+namespace {
+
+constexpr uint32_t MIN_POINTS_PER_CENTROID = 39;  // Below this k-means centroids are mostly noise
+
+uint64_t align_up(uint64_t offset) {
+    return (offset + vector_format::ROW_ALIGNMENT - 1) / vector_format::ROW_ALIGNMENT * vector_format::ROW_ALIGNMENT;
+}
+
+// fn(begin, end) over [0, count) split across the cores
+template <typename Fn>
+void parallel_for(size_t count, Fn fn) {
+    size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    workers = std::min(workers, std::max<size_t>(1, count / 256));
+    size_t chunk = (count + workers - 1) / workers;
+    std::vector<std::thread> threads;
+    for (size_t w = 1; w < workers; ++w) {
+        size_t begin = std::min(count, w * chunk);
+        size_t end = std::min(count, begin + chunk);
+        threads.emplace_back([&fn, begin, end] { fn(begin, end); });
+    }
+    fn(0, std::min(count, chunk));
+    for (auto& thread : threads) thread.join();
+}
+
+// Lloyd's k-means over n points of d floats (row-major), returning k centroids.
+// Spherical k-means (largest dot product, unit-length centroids) for the lists,
+// since documents are ranked by dot product; squared distance otherwise.
+class KMeans {
+public:
+    KMeans(size_t d, size_t k, bool spherical) : d_(d), k_(k), spherical_(spherical) {}
+
+    std::vector<float> run(const float* points, size_t n, uint32_t iterations, std::mt19937& rng) {
+        // Start from k distinct points
+        std::vector<uint32_t> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        std::shuffle(order.begin(), order.end(), rng);
+        centroids_.assign(k_ * d_, 0.0f);
+        for (size_t c = 0; c < k_; ++c) {
+            std::copy(points + order[c] * d_, points + (order[c] + 1) * d_, centroids_.begin() + c * d_);
+        }
+
+        std::vector<uint32_t> assignment(n);
+        std::uniform_int_distribution<size_t> any_point(0, n - 1);
+        for (uint32_t iteration = 0; iteration < iterations; ++iteration) {
+            update_biases();
+            parallel_for(n, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) assignment[i] = nearest(points + i * d_);
+            });
+
+            std::vector<double> sums(k_ * d_, 0.0);
+            std::vector<size_t> counts(k_, 0);
+            for (size_t i = 0; i < n; ++i) {
+                const float* point = points + i * d_;
+                double* sum = sums.data() + assignment[i] * d_;
+                for (size_t x = 0; x < d_; ++x) sum[x] += point[x];
+                ++counts[assignment[i]];
+            }
+            for (size_t c = 0; c < k_; ++c) {
+                float* centroid = centroids_.data() + c * d_;
+                if (counts[c] == 0) {
+                    // Empty cluster: restart it on a random point
+                    const float* point = points + any_point(rng) * d_;
+                    std::copy(point, point + d_, centroid);
+                    continue;
+                }
+                for (size_t x = 0; x < d_; ++x) centroid[x] = static_cast<float>(sums[c * d_ + x] / counts[c]);
+                if (spherical_) vector_kernels::normalize(centroid, d_);
+            }
+        }
+        return centroids_;
+    }
+
+private:
+    // argmax of x . c - bias_c: with bias_c = |c|^2 / 2 that is the nearest
+    // centroid by squared distance
+    void update_biases() {
+        biases_.assign(k_, 0.0f);
+        if (spherical_) return;
+        for (size_t c = 0; c < k_; ++c) {
+            const float* centroid = centroids_.data() + c * d_;
+            biases_[c] = 0.5f * static_cast<float>(vector_kernels::dot(centroid, centroid, d_));
+        }
+    }
+
+    uint32_t nearest(const float* point) const {
+        uint32_t best = 0;
+        double best_score = -std::numeric_limits<double>::infinity();
+        for (size_t c = 0; c < k_; ++c) {
+            double score = vector_kernels::dot(point, centroids_.data() + c * d_, d_) - biases_[c];
+            if (score > best_score) {
+                best_score = score;
+                best = static_cast<uint32_t>(c);
+            }
+        }
+        return best;
+    }
+
+    size_t d_, k_;
+    bool spherical_;
+    std::vector<float> centroids_;
+    std::vector<float> biases_;
+};
+
+// Index of the largest dot product of point with k rows of d floats
+uint32_t nearest_by_dot(const float* point, const float* rows, size_t k, size_t d) {
+    uint32_t best = 0;
+    double best_score = -std::numeric_limits<double>::infinity();
+    for (size_t c = 0; c < k; ++c) {
+        double score = vector_kernels::dot(point, rows + c * d, d);
+        if (score > best_score) {
+            best_score = score;
+            best = static_cast<uint32_t>(c);
+        }
+    }
+    return best;
+}
+
+// Index of the nearest of k rows of d floats by squared distance
+uint8_t nearest_by_distance(const float* point, const float* rows, size_t k, size_t d) {
+    uint8_t best = 0;
+    float best_distance = std::numeric_limits<float>::infinity();
+    for (size_t c = 0; c < k; ++c) {
+        float distance = 0.0f;
+        for (size_t x = 0; x < d; ++x) {
+            float diff = point[x] - rows[c * d + x];
+            distance += diff * diff;
+        }
+        if (distance < best_distance) {
+            best_distance = distance;
+            best = static_cast<uint8_t>(c);
+        }
+    }
+    return best;
+}
+
+// One encoded document
+struct Encoded {
+    int32_t doc_id;
+    uint32_t list;
+};
+
+} // namespace
+
+bool IvfPqIndex::build(const DocumentVectors& vectors, const TrainOptions& options,
+                       const std::string& path, std::string& error) {
+    if (!vectors.is_loaded()) {
+        error = "no vectors loaded";
+        return false;
+    }
+    const uint32_t dim = vectors.dim();
+    const uint32_t m = options.num_subspaces;
+    if (m == 0 || dim % m != 0 || m > vector_kernels::PQ4_MAX_SUBSPACES) {
+        error = "num_subspaces must divide the dimension (" + std::to_string(dim) + ") and be at most " +
+                std::to_string(vector_kernels::PQ4_MAX_SUBSPACES);
+        return false;
+    }
+    const uint32_t sub_dim = dim / m;
+
+    // Documents that have a vector (all-zero rows are missing documents)
+    std::vector<int32_t> doc_ids;
+    std::vector<float> values(dim);
+    for (int32_t doc_id = 0; doc_id <= vectors.max_doc_id(); ++doc_id) {
+        int64_t row = vectors.row_index(doc_id);
+        if (row < 0) continue;
+        vectors.decode(static_cast<uint32_t>(row), values.data());
+        if (vector_kernels::dot(values.data(), values.data(), dim) > 0.0) doc_ids.push_back(doc_id);
+    }
+    if (doc_ids.empty()) {
+        error = "no document has a vector";
+        return false;
+    }
+    auto decode_doc = [&vectors](int32_t doc_id, float* out) {
+        vectors.decode(static_cast<uint32_t>(vectors.row_index(doc_id)), out);
+    };
+
+    // Training sample
+    std::mt19937 rng(options.seed);
+    std::vector<int32_t> sample_ids = doc_ids;
+    if (sample_ids.size() > options.sample_size && options.sample_size > 0) {
+        std::shuffle(sample_ids.begin(), sample_ids.end(), rng);
+        sample_ids.resize(options.sample_size);
+    }
+    size_t n = sample_ids.size();
+    std::vector<float> sample(n * dim);
+    parallel_for(n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) decode_doc(sample_ids[i], sample.data() + i * dim);
+    });
+
+    uint32_t num_lists = options.num_lists;
+    if (num_lists == 0) num_lists = static_cast<uint32_t>(std::lround(4.0 * std::sqrt(double(doc_ids.size()))));
+    num_lists = std::max<uint32_t>(1, std::min<uint64_t>(num_lists, std::max<size_t>(1, n / MIN_POINTS_PER_CENTROID)));
+
+    std::cout << "[IvfPqIndex] Training " << num_lists << " lists on " << n << " documents\n";
+    std::vector<float> centroids = KMeans(dim, num_lists, true).run(sample.data(), n, options.iterations, rng);
+
+    // Codebooks are trained on the sample's residuals
+    std::cout << "[IvfPqIndex] Training " << m << " x " << CODEWORDS << " codewords of " << sub_dim << " dims\n";
+    parallel_for(n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            float* point = sample.data() + i * dim;
+            const float* centroid = centroids.data() + size_t{nearest_by_dot(point, centroids.data(), num_lists, dim)} * dim;
+            for (uint32_t x = 0; x < dim; ++x) point[x] -= centroid[x];
+        }
+    });
+    std::vector<float> codebooks(size_t{m} * CODEWORDS * sub_dim);
+    std::vector<float> subvectors(n * sub_dim);
+    size_t codewords = std::min<size_t>(CODEWORDS, n);
+    for (uint32_t j = 0; j < m; ++j) {
+        for (size_t i = 0; i < n; ++i) {
+            std::copy(sample.data() + i * dim + j * sub_dim, sample.data() + i * dim + (j + 1) * sub_dim,
+                      subvectors.data() + i * sub_dim);
+        }
+        std::vector<float> trained = KMeans(sub_dim, codewords, false).run(subvectors.data(), n, options.iterations, rng);
+        std::copy(trained.begin(), trained.end(), codebooks.begin() + size_t{j} * CODEWORDS * sub_dim);
+        // Fewer documents than codewords: the rest repeat the first, never chosen over it
+        for (size_t c = codewords; c < CODEWORDS; ++c) {
+            std::copy(trained.begin(), trained.begin() + sub_dim,
+                      codebooks.begin() + (size_t{j} * CODEWORDS + c) * sub_dim);
+        }
+    }
+    sample.clear();
+    sample.shrink_to_fit();
+
+    // Encode every document
+    std::cout << "[IvfPqIndex] Encoding " << doc_ids.size() << " documents\n";
+    std::vector<Encoded> encoded(doc_ids.size());
+    std::vector<uint8_t> doc_codes(doc_ids.size() * m);
+    parallel_for(doc_ids.size(), [&](size_t begin, size_t end) {
+        std::vector<float> point(dim);
+        for (size_t i = begin; i < end; ++i) {
+            decode_doc(doc_ids[i], point.data());
+            uint32_t list = nearest_by_dot(point.data(), centroids.data(), num_lists, dim);
+            const float* centroid = centroids.data() + size_t{list} * dim;
+            for (uint32_t x = 0; x < dim; ++x) point[x] -= centroid[x];
+            for (uint32_t j = 0; j < m; ++j) {
+                doc_codes[i * m + j] = nearest_by_distance(point.data() + j * sub_dim,
+                                                           codebooks.data() + size_t{j} * CODEWORDS * sub_dim,
+                                                           CODEWORDS, sub_dim);
+            }
+            encoded[i] = {doc_ids[i], list};
+        }
+    });
+
+    // Lay the lists out in blocks of 32
+    std::vector<uint32_t> list_sizes(num_lists, 0);
+    for (const Encoded& e : encoded) ++list_sizes[e.list];
+    std::vector<uint32_t> list_blocks(num_lists + 1, 0);
+    for (uint32_t l = 0; l < num_lists; ++l) {
+        list_blocks[l + 1] = list_blocks[l] + (list_sizes[l] + PQ4_BLOCK - 1) / PQ4_BLOCK;
+    }
+    size_t total_slots = size_t{list_blocks[num_lists]} * PQ4_BLOCK;
+    size_t block_bytes = size_t{m} * 16;
+
+    std::vector<int32_t> slot_doc_ids(total_slots, -1);
+    std::vector<uint32_t> doc_slots(size_t(int64_t{vectors.max_doc_id()} + 1), ivfpq_format::NO_SLOT);
+    std::vector<uint8_t> codes(size_t{list_blocks[num_lists]} * block_bytes, 0);
+    std::vector<uint32_t> next_in_list(num_lists, 0);
+    for (size_t i = 0; i < encoded.size(); ++i) {
+        uint32_t list = encoded[i].list;
+        uint32_t slot = list_blocks[list] * static_cast<uint32_t>(PQ4_BLOCK) + next_in_list[list]++;
+        slot_doc_ids[slot] = encoded[i].doc_id;
+        doc_slots[encoded[i].doc_id] = slot;
+
+        uint8_t* block = codes.data() + (slot / PQ4_BLOCK) * block_bytes;
+        uint32_t v = slot % PQ4_BLOCK;
+        for (uint32_t j = 0; j < m; ++j) {
+            uint8_t code = doc_codes[i * m + j];
+            block[j * 16 + v % 16] |= v < 16 ? code : static_cast<uint8_t>(code << 4);
+        }
+    }
+
+    IvfPqFileHeader header{};
+    std::memcpy(header.magic, ivfpq_format::MAGIC, 4);
+    header.version = ivfpq_format::VERSION;
+    header.dim = dim;
+    header.num_lists = num_lists;
+    header.num_subspaces = m;
+    header.num_documents = static_cast<uint32_t>(doc_ids.size());
+    header.max_doc_id = vectors.max_doc_id();
+    header.centroids_offset = align_up(sizeof(header));
+    header.codebooks_offset = align_up(header.centroids_offset + centroids.size() * sizeof(float));
+    header.lists_offset = align_up(header.codebooks_offset + codebooks.size() * sizeof(float));
+    header.doc_ids_offset = align_up(header.lists_offset + list_blocks.size() * sizeof(uint32_t));
+    header.slots_offset = align_up(header.doc_ids_offset + slot_doc_ids.size() * sizeof(int32_t));
+    header.codes_offset = align_up(header.slots_offset + doc_slots.size() * sizeof(uint32_t));
+
+    // Written next to the target and renamed over it, like the vector files
+    std::string tmp_path = path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        error = "could not create " + tmp_path;
+        return false;
+    }
+    uint64_t written = 0;
+    auto write_at = [&](uint64_t offset, const void* data, size_t bytes) {
+        static const char zeros[vector_format::ROW_ALIGNMENT] = {};
+        out.write(zeros, offset - written);
+        out.write(static_cast<const char*>(data), bytes);
+        written = offset + bytes;
+    };
+    write_at(0, &header, sizeof(header));
+    write_at(header.centroids_offset, centroids.data(), centroids.size() * sizeof(float));
+    write_at(header.codebooks_offset, codebooks.data(), codebooks.size() * sizeof(float));
+    write_at(header.lists_offset, list_blocks.data(), list_blocks.size() * sizeof(uint32_t));
+    write_at(header.doc_ids_offset, slot_doc_ids.data(), slot_doc_ids.size() * sizeof(int32_t));
+    write_at(header.slots_offset, doc_slots.data(), doc_slots.size() * sizeof(uint32_t));
+    write_at(header.codes_offset, codes.data(), codes.size());
+    out.close();
+    if (!out) {
+        error = "write to " + tmp_path + " failed";
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        error = "could not rename " + tmp_path + " to " + path;
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+void IvfPqIndex::close() {
+    file_.close();
+    centroids_ = nullptr;
+    codebooks_ = nullptr;
+    list_blocks_ = nullptr;
+    doc_ids_ = nullptr;
+    slots_ = nullptr;
+    codes_ = nullptr;
+    num_lists_ = 0;
+    num_subspaces_ = 0;
+    max_doc_id_ = -1;
+    num_documents_ = 0;
+}
+
+bool IvfPqIndex::load(const std::string& path, uint32_t dim) {
+    close();
+
+    if (!file_.open(path)) {
+        std::cerr << "[IvfPqIndex] Could not open index file: " << path << "\n";
+        return false;
+    }
+
+    IvfPqFileHeader header{};
+    if (file_.size() >= sizeof(header)) std::memcpy(&header, file_.data(), sizeof(header));
+    uint64_t m = header.num_subspaces;
+    uint64_t lists = header.num_lists;
+    bool valid = file_.size() >= sizeof(header) &&
+                 std::memcmp(header.magic, ivfpq_format::MAGIC, 4) == 0 &&
+                 header.version == ivfpq_format::VERSION &&
+                 header.dim == dim &&
+                 lists > 0 &&
+                 m > 0 && m <= vector_kernels::PQ4_MAX_SUBSPACES && dim % m == 0 &&
+                 header.max_doc_id >= 0;
+    // Fixed-size sections, in file order, each 4-byte aligned and in bounds
+    const uint64_t offsets[] = {header.centroids_offset, header.codebooks_offset, header.lists_offset,
+                                header.doc_ids_offset, header.slots_offset, header.codes_offset};
+    const uint64_t sizes[] = {lists * dim * sizeof(float), m * CODEWORDS * (dim / std::max<uint64_t>(m, 1)) * sizeof(float),
+                              (lists + 1) * sizeof(uint32_t), 0, (uint64_t(header.max_doc_id) + 1) * sizeof(uint32_t), 0};
+    uint64_t end = sizeof(header);
+    for (size_t s = 0; s < 6 && valid; ++s) {
+        valid = offsets[s] >= end && offsets[s] % sizeof(uint32_t) == 0 && offsets[s] + sizes[s] <= file_.size();
+        end = offsets[s] + sizes[s];
+    }
+    uint64_t total_blocks = 0;
+    if (valid) {
+        const uint32_t* list_blocks = reinterpret_cast<const uint32_t*>(file_.data() + header.lists_offset);
+        valid = list_blocks[0] == 0;
+        for (uint64_t l = 0; l < lists && valid; ++l) valid = list_blocks[l] <= list_blocks[l + 1];
+        total_blocks = list_blocks[lists];
+        valid = valid &&
+                header.doc_ids_offset + total_blocks * PQ4_BLOCK * sizeof(int32_t) <= header.slots_offset &&
+                header.codes_offset + total_blocks * m * 16 <= file_.size();
+    }
+    if (!valid) {
+        std::cerr << "[IvfPqIndex] Bad header or truncated file " << path << " (version " << header.version
+                  << ", dim " << header.dim << ", expected dim " << dim << ")\n";
+        close();
+        return false;
+    }
+
+    const char* base = file_.data();
+    centroids_ = reinterpret_cast<const float*>(base + header.centroids_offset);
+    codebooks_ = reinterpret_cast<const float*>(base + header.codebooks_offset);
+    list_blocks_ = reinterpret_cast<const uint32_t*>(base + header.lists_offset);
+    doc_ids_ = reinterpret_cast<const int32_t*>(base + header.doc_ids_offset);
+    slots_ = reinterpret_cast<const uint32_t*>(base + header.slots_offset);
+    codes_ = reinterpret_cast<const uint8_t*>(base + header.codes_offset);
+    dim_ = dim;
+    sub_dim_ = dim / header.num_subspaces;
+    num_lists_ = header.num_lists;
+    num_subspaces_ = header.num_subspaces;
+    max_doc_id_ = header.max_doc_id;
+    num_documents_ = header.num_documents;
+
+    // Slots come from the file; don't trust them blindly
+    for (int32_t doc_id = 0; doc_id <= max_doc_id_; ++doc_id) {
+        if (slots_[doc_id] != ivfpq_format::NO_SLOT && slots_[doc_id] >= total_blocks * PQ4_BLOCK) {
+            std::cerr << "[IvfPqIndex] Slot table of " << path << " points past the codes\n";
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void IvfPqIndex::compute_tables(const float* query, std::vector<float>& tables) const {
+    tables.resize(size_t{num_subspaces_} * CODEWORDS);
+    for (uint32_t j = 0; j < num_subspaces_; ++j) {
+        const float* sub_query = query + size_t{j} * sub_dim_;
+        for (uint32_t c = 0; c < CODEWORDS; ++c) {
+            const float* codeword = codebooks_ + (size_t{j} * CODEWORDS + c) * sub_dim_;
+            tables[j * CODEWORDS + c] = static_cast<float>(vector_kernels::dot(sub_query, codeword, sub_dim_));
+        }
+    }
+}
+
+double IvfPqIndex::residual_score(uint32_t slot, const std::vector<float>& tables) const {
+    const uint8_t* block = codes_ + size_t{slot / PQ4_BLOCK} * num_subspaces_ * 16;
+    uint32_t v = slot % PQ4_BLOCK;
+    double total = 0.0;
+    for (uint32_t j = 0; j < num_subspaces_; ++j) {
+        uint8_t packed = block[j * 16 + v % 16];
+        total += tables[j * CODEWORDS + (v < 16 ? packed & 0x0F : packed >> 4)];
+    }
+    return total;
+}
+
+uint32_t IvfPqIndex::list_of(uint32_t slot) const {
+    uint32_t block = slot / PQ4_BLOCK;
+    // Last list starting at or before block (empty lists share its start)
+    const uint32_t* after = std::upper_bound(list_blocks_, list_blocks_ + num_lists_ + 1, block);
+    return static_cast<uint32_t>(after - list_blocks_) - 1;
+}
+
+std::vector<VectorMatch> IvfPqIndex::search(const float* query, size_t k, const SearchOptions& options) const {
+    if (!is_loaded() || k == 0) return {};
+
+    // 1. The nprobe lists whose centroids are most similar to the query
+    std::vector<std::pair<double, uint32_t>> lists(num_lists_);
+    for (uint32_t l = 0; l < num_lists_; ++l) {
+        lists[l] = {vector_kernels::dot(query, centroids_ + size_t{l} * dim_, dim_), l};
+    }
+    size_t nprobe = std::max<size_t>(1, std::min<size_t>(options.nprobe, num_lists_));
+    std::partial_sort(lists.begin(), lists.begin() + nprobe, lists.end(),
+                      [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    // 2. Tables, and 8-bit copies for the scan: entry = (value - subspace
+    // minimum) * scale, one scale for all subspaces so the sums stay comparable
+    std::vector<float> tables;
+    compute_tables(query, tables);
+    std::vector<uint8_t> lut(tables.size());
+    double bias = 0.0;
+    float max_range = 0.0f;
+    std::vector<float> minimums(num_subspaces_);
+    for (uint32_t j = 0; j < num_subspaces_; ++j) {
+        auto [low, high] = std::minmax_element(tables.begin() + j * CODEWORDS, tables.begin() + (j + 1) * CODEWORDS);
+        minimums[j] = *low;
+        bias += *low;
+        max_range = std::max(max_range, *high - *low);
+    }
+    float scale = max_range > 0.0f ? 255.0f / max_range : 1.0f;
+    for (uint32_t j = 0; j < num_subspaces_; ++j) {
+        for (uint32_t c = 0; c < CODEWORDS; ++c) {
+            float entry = std::nearbyint((tables[j * CODEWORDS + c] - minimums[j]) * scale);
+            lut[j * CODEWORDS + c] = static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, entry)));
+        }
+    }
+
+    // 3. Scan: keep the best k * rerank_factor by 8-bit sums (min-heap on score)
+    struct Candidate {
+        double score;
+        uint32_t slot;
+        double list_score;
+    };
+    auto worse = [](const Candidate& a, const Candidate& b) { return a.score > b.score; };
+    size_t shortlist = k * std::max<uint32_t>(1, options.rerank_factor);
+    std::vector<Candidate> heap;
+    heap.reserve(shortlist + 1);
+    std::vector<uint16_t> sums;
+    for (size_t p = 0; p < nprobe; ++p) {
+        double list_score = lists[p].first;
+        uint32_t list = lists[p].second;
+        uint32_t first_block = list_blocks_[list];
+        uint32_t num_blocks = list_blocks_[list + 1] - first_block;
+        if (num_blocks == 0) continue;
+
+        sums.resize(size_t{num_blocks} * PQ4_BLOCK);
+        vector_kernels::pq4_scan(codes_ + size_t{first_block} * num_subspaces_ * 16, lut.data(),
+                                 num_subspaces_, num_blocks, sums.data());
+        double base = list_score + bias;
+        uint32_t first_slot = first_block * static_cast<uint32_t>(PQ4_BLOCK);
+        for (size_t i = 0; i < sums.size(); ++i) {
+            if (doc_ids_[first_slot + i] < 0) continue;  // Padding
+            double score = base + sums[i] / scale;
+            if (heap.size() == shortlist && score <= heap.front().score) continue;
+            heap.push_back({score, static_cast<uint32_t>(first_slot + i), list_score});
+            std::push_heap(heap.begin(), heap.end(), worse);
+            if (heap.size() > shortlist) {
+                std::pop_heap(heap.begin(), heap.end(), worse);
+                heap.pop_back();
+            }
+        }
+    }
+
+    // 4. Re-score the shortlist with the float tables
+    std::vector<VectorMatch> results;
+    results.reserve(heap.size());
+    for (const Candidate& candidate : heap) {
+        results.push_back({doc_ids_[candidate.slot], candidate.list_score + residual_score(candidate.slot, tables)});
+    }
+    std::sort(results.begin(), results.end(),
+              [](const VectorMatch& a, const VectorMatch& b) { return a.similarity > b.similarity; });
+    if (results.size() > k) results.resize(k);
+    return results;
+}
+
+void IvfPqIndex::score(const float* query, const int* doc_ids, size_t count, double* scores) const {
+    if (!is_loaded()) {
+        std::fill(scores, scores + count, 0.0);
+        return;
+    }
+
+    std::vector<float> tables;
+    compute_tables(query, tables);
+    std::vector<double> list_scores(num_lists_, std::numeric_limits<double>::quiet_NaN());
+    for (size_t i = 0; i < count; ++i) {
+        int doc_id = doc_ids[i];
+        uint32_t slot = doc_id >= 0 && doc_id <= max_doc_id_ ? slots_[doc_id] : ivfpq_format::NO_SLOT;
+        if (slot == ivfpq_format::NO_SLOT) {
+            scores[i] = 0.0;
+            continue;
+        }
+        uint32_t list = list_of(slot);
+        if (std::isnan(list_scores[list])) {
+            list_scores[list] = vector_kernels::dot(query, centroids_ + size_t{list} * dim_, dim_);
+        }
+        scores[i] = list_scores[list] + residual_score(slot, tables);
+    }
+}
@@ -52,6 +52,10 @@ bool LexiconWithTrie::contains_word(const std::string& word) const {
     return lexicon_.contains_word(word);
 }
 
+bool LexiconWithTrie::is_significant_word(const std::string& word) const {
+    return lexicon_.is_significant_word(word);
+}
+
 std::vector<std::string> LexiconWithTrie::autocomplete(const std::string& prefix, int k) const {
     return trie_.autocomplete(prefix, k);
 }
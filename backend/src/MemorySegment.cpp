@@ -0,0 +1,99 @@
+#include "MemorySegment.hpp"
+#include <algorithm>
+
+std::shared_ptr<const MemorySegment> MemorySegment::with_documents(std::vector<SegmentDocument> documents,
+                                                                   const LexiconWithTrie& lexicon) const {
+    auto next = std::make_shared<MemorySegment>(*this);
+    std::shared_ptr<Trie> suggestions;
+
+    for (auto& doc : documents) {
+        int doc_id = doc.index.doc_id;
+        if (!next->known_ids_.insert(doc_id).second) continue;
+
+        for (const auto& word : doc.vocabulary) {
+            if (!lexicon.is_significant_word(word) || lexicon.get_word_index(word) != -1) continue;
+            const Trie* current = suggestions ? suggestions.get() : suggestions_.get();
+            if (current && current->contains(word)) continue;
+            if (!suggestions) {
+                suggestions = suggestions_ ? std::make_shared<Trie>(*suggestions_) : std::make_shared<Trie>();
+            }
+            suggestions->insert(word);
+        }
+        next->doc_ids_.insert(doc_id);
+
+        for (size_t i = 0; i < doc.index.postings.size(); ++i) {
+            DeltaPosting& posting = doc.index.postings[i];
+            // Lists stay sorted by doc id (documents usually arrive in order)
+            auto& entries = next->postings_[posting.word_id];
+            auto at = entries.end();
+            if (!entries.empty() && entries.back().doc_id > doc_id) {
+                at = std::upper_bound(entries.begin(), entries.end(), doc_id,
+                                      [](int id, const DeltaEntry& e) { return id < e.doc_id; });
+            }
+            entries.insert(at, {doc_id, posting.frequency, std::move(posting.positions)});
+
+            if (i < doc.words.size() && !doc.words[i].empty() &&
+                lexicon.get_word_index(doc.words[i]) == -1) {
+                next->words_.emplace(doc.words[i], posting.word_id);
+            }
+        }
+
+        if (doc.has_stats) {
+            next->total_length_ += static_cast<uint64_t>(std::max(0, doc.stats.doc_length));
+            next->total_title_length_ += static_cast<uint64_t>(std::max(0, doc.stats.title_length));
+            next->stats_[doc_id] = std::move(doc.stats);
+        }
+        if (doc.has_metadata) {
+            next->metadata_[doc_id] = std::move(doc.metadata);
+            next->static_scores_[doc_id] = doc.static_score;
+        }
+    }
+    if (suggestions) next->suggestions_ = std::move(suggestions);
+    return next;
+}
+
+std::shared_ptr<const MemorySegment> MemorySegment::without_postings(const std::unordered_set<int>& doc_ids) const {
+    auto next = std::make_shared<MemorySegment>(*this);
+
+    for (auto it = next->postings_.begin(); it != next->postings_.end();) {
+        auto& entries = it->second;
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                     [&](const DeltaEntry& e) { return doc_ids.count(e.doc_id) > 0; }),
+                      entries.end());
+        it = entries.empty() ? next->postings_.erase(it) : std::next(it);
+    }
+    for (int doc_id : doc_ids) next->doc_ids_.erase(doc_id);
+    return next;
+}
+
+const std::vector<DeltaEntry>* MemorySegment::postings(int word_id) const {
+    auto it = postings_.find(word_id);
+    return it == postings_.end() ? nullptr : &it->second;
+}
+
+const DocStats* MemorySegment::stats(int doc_id) const {
+    if (stats_.empty()) return nullptr;  // The usual case, asked once per scored document
+    auto it = stats_.find(doc_id);
+    return it == stats_.end() ? nullptr : &it->second;
+}
+
+const DocMetadata* MemorySegment::metadata(int doc_id) const {
+    auto it = metadata_.find(doc_id);
+    return it == metadata_.end() ? nullptr : &it->second;
+}
+
+const StaticScore* MemorySegment::static_score(int doc_id) const {
+    if (static_scores_.empty()) return nullptr;  // Asked once per scored document
+    auto it = static_scores_.find(doc_id);
+    return it == static_scores_.end() ? nullptr : &it->second;
+}
+
+int MemorySegment::word_id(const std::string& word) const {
+    auto it = words_.find(word);
+    return it == words_.end() ? -1 : it->second;
+}
+
+std::vector<std::string> MemorySegment::autocomplete(const std::string& prefix, int k) const {
+    if (!suggestions_) return {};
+    return suggestions_->autocomplete(prefix, k);
+}
@@ -0,0 +1,311 @@
+#include "MergeScheduler.hpp"
+#include "IndexSnapshot.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <map>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::string barrel_path(const std::string& dir, int barrel_id) {
+    return dir + "/inverted_barrel_" + std::to_string(barrel_id) + ".bin";
+}
+
+} // namespace
+
+MergeScheduler::MergeScheduler(std::string barrels_dir, DeltaLog& log, PublishFn publisher,
+                               ScoringFn scoring)
+    : MergeScheduler(std::move(barrels_dir), log, std::move(publisher), std::move(scoring), Options()) {}
+
+MergeScheduler::MergeScheduler(std::string barrels_dir, DeltaLog& log, PublishFn publisher,
+                               ScoringFn scoring, Options options)
+    : barrels_dir_(std::move(barrels_dir)),
+      log_(log),
+      publisher_(std::move(publisher)),
+      scoring_(std::move(scoring)),
+      options_(options) {
+    options_.merge_factor = std::max<size_t>(2, options_.merge_factor);
+
+    if (!SegmentManifest::load(barrels_dir_, manifest_)) {
+        // Writing a manifest now would drop the segments the broken one lists
+        std::cerr << "[Segments] Not flushing or merging until " << SegmentManifest::path(barrels_dir_)
+                  << " is repaired\n";
+        return;
+    }
+    cursor_ = manifest_.flushed;
+    remove_orphans();
+
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.segments = manifest_.segments.size();
+    }
+
+    thread_ = std::thread(&MergeScheduler::scheduler_thread, this);
+    std::cout << "[Segments] Merge scheduler started: " << manifest_.segments.size()
+              << " segments, flush at " << options_.flush_documents << " documents, merge factor "
+              << options_.merge_factor << ", I/O budget "
+              << (options_.io_bytes_per_sec / 1024 / 1024) << " MB/s\n";
+}
+
+MergeScheduler::~MergeScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        shutdown_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+MergeScheduler::Stats MergeScheduler::get_stats() const {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return stats_;
+}
+
+void MergeScheduler::scheduler_thread() {
+    while (!shutdown_) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait_for(lock, options_.poll_interval, [this]() { return shutdown_.load(); });
+        }
+        if (shutdown_) break;
+
+        poll_delta();
+
+        bool due = pending_.size() >= options_.flush_documents ||
+                   (!pending_.empty() &&
+                    std::chrono::steady_clock::now() - pending_since_ >= options_.max_delta_age);
+        if (due) flush_delta();
+
+        while (!shutdown_ && merge_tier()) {}
+    }
+}
+
+void MergeScheduler::poll_delta() {
+    std::vector<DeltaDocument> documents;
+    DeltaLog::ReplayResult replay = DeltaLog::replay(log_.path(), cursor_, documents);
+    if (!replay.ok) return;
+
+    if (replay.restarted) pending_.clear();
+    if (pending_.empty() && !documents.empty()) pending_since_ = std::chrono::steady_clock::now();
+    for (auto& doc : documents) pending_.push_back(std::move(doc));
+
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.pending_documents = pending_.size();
+}
+
+bool MergeScheduler::flush_delta() {
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<BarrelMap> barrels(BarrelSet::NUM_BARRELS);
+    std::unordered_set<int> doc_ids;
+    for (const auto& doc : pending_) {
+        doc_ids.insert(doc.doc_id);
+        for (const auto& posting : doc.postings) {
+            InvertedEntry entry{doc.doc_id, posting.frequency, posting.positions};
+            barrels[posting.word_id % BarrelSet::NUM_BARRELS][posting.word_id].push_back(std::move(entry));
+        }
+    }
+
+    std::string dir = new_segment_dir();
+    uint64_t bytes = 0;
+    auto fill = [&](int barrel_id, BarrelMap& out) -> uint64_t {
+        out = std::move(barrels[barrel_id]);
+        return 0;
+    };
+    if (!write_segment(dir, fill, bytes)) return false;
+
+    SegmentManifest next = manifest_;
+    next.segments.push_back({dir, bytes});
+    next.flushed = cursor_;
+    if (!commit(next, doc_ids)) return false;
+
+    // The flushed records are in the manifest now; cutting them off the log
+    // is only housekeeping, replay starts at manifest.flushed either way
+    DeltaLogCursor tail;
+    if (log_.compact(cursor_, tail)) cursor_ = tail;
+
+    auto duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    std::cout << "[Segments] Flushed " << pending_.size() << " delta documents to " << dir
+              << " (" << (bytes / 1024) << " KB, " << duration_ms << "ms)\n";
+
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.flushes++;
+    stats_.documents_flushed += pending_.size();
+    stats_.pending_documents = 0;
+    pending_.clear();
+    return true;
+}
+
+size_t MergeScheduler::tier_of(uint64_t bytes) const {
+    size_t tier = 0;
+    uint64_t limit = options_.tier_base_bytes;
+    while (bytes > limit && tier < 32) {
+        limit *= options_.merge_factor;
+        tier++;
+    }
+    return tier;
+}
+
+bool MergeScheduler::merge_tier() {
+    std::map<size_t, std::vector<size_t>> tiers;
+    for (size_t i = 0; i < manifest_.segments.size(); ++i) {
+        tiers[tier_of(manifest_.segments[i].bytes)].push_back(i);
+    }
+
+    // Smallest full tier first; its oldest segments
+    std::vector<size_t> inputs;
+    for (auto& [tier, members] : tiers) {
+        if (members.size() >= options_.merge_factor) {
+            inputs.assign(members.begin(), members.begin() + options_.merge_factor);
+            break;
+        }
+    }
+    if (inputs.empty()) return false;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> input_dirs;
+    for (size_t i : inputs) input_dirs.push_back(barrels_dir_ + "/" + manifest_.segments[i].dir);
+
+    // Documents are disjoint across segments, so merging is concatenation;
+    // the postings are scored again with the statistics of today's collection
+    std::string dir = new_segment_dir();
+    uint64_t bytes = 0;
+    auto fill = [&](int barrel_id, BarrelMap& out) -> uint64_t {
+        uint64_t read = 0;
+        for (const auto& input : input_dirs) {
+            BinaryBarrel barrel;
+            if (!barrel.open(barrel_path(input, barrel_id))) continue;
+            barrel.to_barrel_map(out);
+            read += barrel.size_bytes();
+        }
+        return read;
+    };
+    if (!write_segment(dir, fill, bytes)) return false;
+
+    SegmentManifest next = manifest_;
+    next.segments.clear();
+    for (size_t i = 0; i < manifest_.segments.size(); ++i) {
+        if (i == inputs.front()) next.segments.push_back({dir, bytes});
+        if (std::find(inputs.begin(), inputs.end(), i) == inputs.end()) {
+            next.segments.push_back(manifest_.segments[i]);
+        }
+    }
+    if (!commit(next, {}, input_dirs)) return false;
+
+    auto duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    std::cout << "[Segments] Merged " << inputs.size() << " segments into " << dir
+              << " (" << (bytes / 1024) << " KB, " << duration_ms << "ms)\n";
+
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.merges++;
+    return true;
+}
+
+bool MergeScheduler::write_segment(const std::string& dir,
+                                   const std::function<uint64_t(int, BarrelMap&)>& fill,
+                                   uint64_t& bytes) {
+    std::string path = barrels_dir_ + "/" + dir;
+    std::error_code ec;
+    fs::create_directories(path, ec);
+    if (ec) {
+        std::cerr << "[Segments] Could not create " << path << ": " << ec.message() << "\n";
+        return false;
+    }
+
+    BarrelScoring scoring = scoring_ ? scoring_() : BarrelScoring();
+
+    bytes = 0;
+    for (int barrel_id = 0; barrel_id < BarrelSet::NUM_BARRELS; ++barrel_id) {
+        if (shutdown_) {
+            fs::remove_all(path, ec);
+            return false;
+        }
+        auto started = std::chrono::steady_clock::now();
+
+        // Empty barrels are written too, so a missing file always means an error
+        BarrelMap barrel;
+        uint64_t read = fill(barrel_id, barrel);
+        std::string file = barrel_path(path, barrel_id);
+        if (!BinaryBarrel::write(file, barrel, scoring)) {
+            std::cerr << "[Segments] Could not write " << file << ", dropping " << dir << "\n";
+            fs::remove_all(path, ec);
+            return false;
+        }
+
+        uint64_t written = fs::file_size(file, ec);
+        bytes += written;
+        throttle(read + written, started);
+    }
+
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.bytes_written += bytes;
+    return true;
+}
+
+bool MergeScheduler::commit(SegmentManifest next, const std::unordered_set<int>& flushed_doc_ids,
+                            const std::vector<std::string>& merged_dirs) {
+    if (!next.save(barrels_dir_)) return false;
+    manifest_ = std::move(next);
+
+    if (publisher_) {
+        publisher_(manifest_, flushed_doc_ids, merged_dirs);
+    } else {
+        // Nothing serves the merged-away segments
+        for (const auto& dir : merged_dirs) BarrelSet::remove_files(dir);
+    }
+
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.segments = manifest_.segments.size();
+    return true;
+}
+
+void MergeScheduler::throttle(uint64_t bytes, std::chrono::steady_clock::time_point started) {
+    if (options_.io_bytes_per_sec == 0) return;
+
+    auto budget = std::chrono::duration<double>(static_cast<double>(bytes) / options_.io_bytes_per_sec);
+    auto spent = std::chrono::steady_clock::now() - started;
+    if (budget <= spent) return;
+
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(budget - spent);
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait_for(lock, wait, [this]() { return shutdown_.load(); });
+    }
+
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.throttled_ms += static_cast<uint64_t>(wait.count());
+}
+
+void MergeScheduler::remove_orphans() {
+    std::unordered_set<std::string> live;
+    for (const auto& segment : manifest_.segments) live.insert(segment.dir);
+
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(barrels_dir_ + "/segments", ec)) {
+        std::string dir = "segments/" + entry.path().filename().string();
+        if (live.count(dir)) continue;
+        fs::remove_all(entry.path(), ec);
+        std::cout << "[Segments] Removed unreferenced " << dir << "\n";
+    }
+
+    // The base barrels were merged into a segment
+    if (!live.count(".")) {
+        for (int barrel_id = 0; barrel_id < BarrelSet::NUM_BARRELS; ++barrel_id) {
+            fs::remove(barrel_path(barrels_dir_, barrel_id), ec);
+        }
+    }
+}
+
+std::string MergeScheduler::new_segment_dir() {
+    char name[32];
+    std::snprintf(name, sizeof(name), "seg_%06llu",
+                  static_cast<unsigned long long>(manifest_.next_segment_id++));
+    return std::string("segments/") + name;
+}
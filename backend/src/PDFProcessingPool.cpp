@@ -1,18 +1,17 @@
 #include "PDFProcessingPool.hpp"
+#include "PDFTextExtractor.hpp"
 #include <iostream>
 #include <filesystem>
 #include <algorithm>
-#include <fstream>
-#include "json.hpp"
 
 namespace fs = std::filesystem;
-using json = nlohmann::json;
 
 PDFProcessingPool::PDFProcessingPool(
     size_t num_threads,
     BatchIndexWriter& batch_writer,
-    Lexicon& lexicon
-) : batch_writer_(batch_writer), lexicon_(lexicon) {
+    Lexicon& lexicon,
+    TokenizerWorkerPool& tokenizer_workers
+) : batch_writer_(batch_writer), lexicon_(lexicon), tokenizer_workers_(tokenizer_workers) {
     
     for (size_t i = 0; i < num_threads; ++i) {
         workers_.emplace_back(&PDFProcessingPool::worker_thread, this);
@@ -103,8 +102,15 @@ void PDFProcessingPool::process_pdf(Task& task) {
     std::cout << "[PDFProcessingPool] Processing doc_id=" << task.doc_id 
               << " (" << task.pdf_path << ")\n";
     
-    // 1. Call Python tokenizer
-    ProcessedPDF processed = call_python_tokenizer(task.pdf_path, task.doc_id);
+    // 1. Extract and tokenize in-process; PDFs the native extractor can't
+    //    read go through the Python tokenizer
+    ProcessedPDF processed = extract_native(task.pdf_path, task.doc_id);
+    bool fallback = !processed.success;
+    if (fallback) {
+        std::cout << "[PDFProcessingPool] doc_id=" << task.doc_id << ": " << processed.error
+                  << ", using Python tokenizer\n";
+        processed = call_python_tokenizer(task.pdf_path, task.doc_id);
+    }
     if (!processed.success) {
         throw std::runtime_error(processed.error);
     }
@@ -133,6 +139,26 @@ void PDFProcessingPool::process_pdf(Task& task) {
     
     std::lock_guard<std::mutex> stats_lock(stats_mutex_);
     stats_.completed_tasks++;
+    if (fallback) {
+        stats_.fallback_extractions++;
+    } else {
+        stats_.native_extractions++;
+    }
+}
+
+ProcessedPDF PDFProcessingPool::extract_native(const std::string& pdf_path, int doc_id) {
+    ProcessedPDF result;
+    result.doc_id = doc_id;
+
+    PDFTextExtractor::Result extracted;
+    if (!PDFTextExtractor::extract(pdf_path, extracted, result.error)) {
+        return result;
+    }
+
+    result.title = std::move(extracted.title);
+    result.tokens = std::move(extracted.tokens);
+    result.success = true;
+    return result;
 }
 
 ProcessedPDF PDFProcessingPool::call_python_tokenizer(
@@ -141,73 +167,20 @@ ProcessedPDF PDFProcessingPool::call_python_tokenizer(
 ) {
     ProcessedPDF result;
     result.doc_id = doc_id;
-    result.success = false;
-    
-    std::string temp_dir = "data/temp_json";
-    if (!fs::exists(temp_dir)) {
-        fs::create_directories(temp_dir);
-    }
-    
-    std::string temp_json = temp_dir + "/temp_" + std::to_string(doc_id) + ".json";
     
-    std::string python_exe;
-    #ifdef _WIN32
-        if (fs::exists("venv/Scripts/python.exe")) {
-            python_exe = "venv\\Scripts\\python.exe";
-        } else {
-            python_exe = "python";
-        }
-    #else
-        if (fs::exists("venv/bin/python")) {
-            python_exe = "venv/bin/python";
-        } else {
-            python_exe = "python3";
-        }
-    #endif
-    
-    std::string python_cmd = python_exe + " scripts/tokenize_single_pdf.py \"" 
-                           + pdf_path + "\" " 
-                           + std::to_string(doc_id) + " \"" 
-                           + temp_json + "\"";
-    
-    int ret = std::system(python_cmd.c_str());
-    
-    if (ret != 0) {
-        result.error = "Python tokenizer failed";
-        fs::remove(temp_json);
+    TokenizerWorkerPool::Result tokenized;
+    if (!tokenizer_workers_.tokenize(pdf_path, tokenized, result.error)) {
         return result;
     }
     
-    std::ifstream f(temp_json);
-    if (!f.is_open()) {
-        result.error = "Could not read tokenized output";
-        fs::remove(temp_json);
-        return result;
-    }
-    
-    try {
-        json j;
-        f >> j;
-        f.close();
-        
-        result.title = j.value("title", "Untitled");
-        result.tokens = j.value("body_tokens", std::vector<std::string>());
-        
-        if (result.tokens.empty()) {
-            result.error = "No tokens extracted from PDF";
-            fs::remove(temp_json);
-            return result;
-        }
-        
-        result.success = true;
-        fs::remove(temp_json);
-        
-    } catch (const std::exception& e) {
-        result.error = std::string("JSON parse error: ") + e.what();
-        fs::remove(temp_json);
+    result.title = std::move(tokenized.title);
+    result.tokens = std::move(tokenized.tokens);
+    if (result.tokens.empty()) {
+        result.error = "No tokens extracted from PDF";
         return result;
     }
     
+    result.success = true;
     return result;
 }
 
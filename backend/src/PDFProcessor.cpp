@@ -1,11 +1,11 @@
 #include "PDFProcessor.hpp"
+#include "PDFTextExtractor.hpp"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <filesystem>
 #include <cstdlib>
 #include <algorithm>
-#include <set>
 #include "json.hpp"
 
 using json = nlohmann::json;
@@ -16,12 +16,14 @@ PDFProcessor::PDFProcessor(
     ForwardIndexBuilder& forward_builder,
     InvertedIndexBuilder& inverted_builder,
     DocumentMetadata& metadata,
-    DocURLMapper& url_mapper
+    DocURLMapper& url_mapper,
+    TokenizerWorkerPool& tokenizer_workers
 ) : lexicon_(lexicon),
     forward_builder_(forward_builder),
     inverted_builder_(inverted_builder),
     metadata_(metadata),
-    url_mapper_(url_mapper) {}
+    url_mapper_(url_mapper),
+    tokenizer_workers_(tokenizer_workers) {}
 
 int PDFProcessor::get_next_doc_id() {
     // Read existing test.jsonl to find max doc_id
@@ -120,80 +122,33 @@ ProcessedPDF PDFProcessor::tokenize_pdf(const std::string& pdf_path, int doc_id)
     result.doc_id = doc_id;
     result.success = false;
 
-    // Create dedicated temp directory for JSON files (separate from PDFs)
-    std::string temp_dir = "data/temp_json";
-    if (!fs::exists(temp_dir)) {
-        fs::create_directories(temp_dir);
-    }
-    
-    // Create temp output file for Python script
-    std::string temp_json = temp_dir + "/temp_" + std::to_string(doc_id) + ".json";
-    
-    // Call Python tokenizer (use venv if available, fallback to system python)
-    std::string python_exe;
-    #ifdef _WIN32
-        if (fs::exists("venv/Scripts/python.exe")) {
-            python_exe = "venv\\Scripts\\python.exe";
-        } else {
-            python_exe = "py -3.14";
-        }
-    #else
-        if (fs::exists("venv/bin/python")) {
-            python_exe = "venv/bin/python";
-        } else {
-            python_exe = "python3";
-        }
-    #endif
-    
-    std::string python_cmd = python_exe + " scripts/tokenize_single_pdf.py \"" 
-                           + pdf_path + "\" " 
-                           + std::to_string(doc_id) + " \"" 
-                           + temp_json + "\" 2>&1";
-    
-    std::cout << "[PDFProcessor] Tokenizing (max 5000 tokens, 20 pages)..." << std::endl;
-    int ret = std::system(python_cmd.c_str());
-    
-    if (ret != 0) {
-        result.error = "Python tokenizer failed";
-        fs::remove(temp_json); // Clean up even on failure
+    // In-process extraction first; the Python tokenizer handles the rest
+    PDFTextExtractor::Result extracted;
+    std::string native_error;
+    if (PDFTextExtractor::extract(pdf_path, extracted, native_error)) {
+        result.title = std::move(extracted.title);
+        result.tokens = std::move(extracted.tokens);
+        result.success = true;
+        std::cout << "[PDFProcessor] Title: " << result.title.substr(0, 50) << "..." << std::endl;
         return result;
     }
+    std::cout << "[PDFProcessor] " << native_error << ", using Python tokenizer" << std::endl;
 
-    // Read tokenized output
-    std::ifstream f(temp_json);
-    if (!f.is_open()) {
-        result.error = "Could not read tokenized output";
-        fs::remove(temp_json); // Clean up
+    TokenizerWorkerPool::Result tokenized;
+    if (!tokenizer_workers_.tokenize(pdf_path, tokenized, result.error)) {
         return result;
     }
 
-    try {
-        json j;
-        f >> j;
-        f.close(); // Close before deleting
-        
-        result.title = j.value("title", "Untitled Document");
-        result.tokens = j.value("body_tokens", std::vector<std::string>());
-        
-        std::cout << "[PDFProcessor] Title: " << result.title.substr(0, 50) << "..." << std::endl;
-        
-        if (result.tokens.empty()) {
-            result.error = "No tokens extracted from PDF";
-            fs::remove(temp_json); // Clean up
-            return result;
-        }
-        
-        result.success = true;
-        
-        // Clean up temp file
-        fs::remove(temp_json);
-        
-    } catch (const std::exception& e) {
-        result.error = std::string("JSON parse error: ") + e.what();
-        fs::remove(temp_json); // Clean up on error
+    result.title = std::move(tokenized.title);
+    result.tokens = std::move(tokenized.tokens);
+    std::cout << "[PDFProcessor] Title: " << result.title.substr(0, 50) << "..." << std::endl;
+
+    if (result.tokens.empty()) {
+        result.error = "No tokens extracted from PDF";
         return result;
     }
 
+    result.success = true;
     return result;
 }
 
@@ -217,43 +172,6 @@ std::map<int, WordStats> PDFProcessor::build_doc_stats(const std::vector<std::st
     return doc_stats;
 }
 
-void PDFProcessor::check_and_merge_delta() {
-    // Check delta barrel size
-    std::ifstream f("data/processed/barrels/inverted_delta.json");
-    if (!f.good()) return;
-    
-    try {
-        json delta;
-        f >> delta;
-        
-        // Count unique documents in delta barrel
-        std::set<int> unique_docs;
-        for (auto& word_entry : delta.items()) {
-            if (word_entry.value().is_array()) {
-                for (auto& doc_entry : word_entry.value()) {
-                    if (doc_entry.contains("doc_id")) {
-                        unique_docs.insert(doc_entry["doc_id"].get<int>());
-                    }
-                }
-            }
-        }
-        
-        int total_docs = unique_docs.size();
-        
-        // OPTIMIZATION: Higher threshold to reduce merge frequency  
-        if (total_docs >= 100) {
-            std::cout << "[PDFProcessor] ⚠️  Delta barrel has " << total_docs 
-                      << " documents. Consider merging (auto-merge at 100+)" << std::endl;
-            
-            // Optionally enable auto-merge here if needed
-            // inverted_builder_.merge_delta_to_main("data/processed/barrels");
-            // std::cout << "[PDFProcessor] ✅ Delta barrel merged and cleared!" << std::endl;
-        }
-    } catch (const std::exception& e) {
-        std::cerr << "[PDFProcessor] Warning: Could not check delta size: " << e.what() << "\n";
-    }
-}
-
 bool PDFProcessor::process_and_index(const std::string& pdf_path, int& assigned_doc_id) {
     std::cout << "[PDFProcessor] ⏱️  Starting fast processing..." << std::endl;
     
@@ -354,8 +272,7 @@ bool PDFProcessor::process_and_index(const std::string& pdf_path, int& assigned_
         std::cout << "[PDFProcessor] ✓ Added to test.jsonl" << std::endl;
     }
     
-    // 10. Check if delta barrel needs merging (less frequent)
-    check_and_merge_delta();
+    // The delta log is flushed into on-disk segments by MergeScheduler
     
     std::cout << "[PDFProcessor] ✅ Document " << assigned_doc_id << " is SEARCHABLE!" << std::endl;
     return true;
@@ -0,0 +1,1201 @@
+#include "PDFTextExtractor.hpp"
+#include "MappedFile.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#ifdef DSA_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Decoded streams larger than this are treated as damaged (or a zip bomb)
+constexpr size_t MAX_STREAM_BYTES = 64 * 1024 * 1024;
+constexpr int MAX_NESTING = 64;
+
+// Raw tokens at which the fragment check kicks in, and the share of
+// single-character ones above which the text is considered misdecoded
+constexpr size_t FRAGMENT_CHECK_TOKENS = 50;
+constexpr double MAX_FRAGMENT_SHARE = 0.5;
+
+// Share of glyphs without a Unicode mapping that is still acceptable
+constexpr double MAX_UNMAPPED_SHARE = 0.1;
+
+// ---------------------------------------------------------------------------
+// Objects
+
+struct PdfValue {
+    enum class Kind { Null, Bool, Number, String, Name, Array, Dict, Ref };
+    Kind kind = Kind::Null;
+    double number = 0;
+    std::string text;                 // String bytes or Name (without '/')
+    int ref = 0;                      // Object number of a Ref
+    std::vector<PdfValue> items;      // Array items, or Dict values
+    std::vector<std::string> keys;    // Dict keys, parallel to items
+
+    bool is(Kind k) const { return kind == k; }
+    bool is_name(const char* name) const { return kind == Kind::Name && text == name; }
+
+    const PdfValue* get(const std::string& key) const {
+        if (kind != Kind::Dict) return nullptr;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (keys[i] == key) return &items[i];
+        }
+        return nullptr;
+    }
+};
+
+const PdfValue NULL_VALUE;
+
+bool is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\0';
+}
+
+bool is_delimiter(char c) {
+    return is_space(c) || c == '(' || c == ')' || c == '<' || c == '>' || c == '[' || c == ']' ||
+           c == '{' || c == '}' || c == '/' || c == '%';
+}
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+void append_utf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+// Ligature code points come out as their letters, so "ﬁnd" tokenizes as "find"
+void append_code_point(std::string& out, uint32_t cp) {
+    switch (cp) {
+        case 0xFB00: out += "ff"; return;
+        case 0xFB01: out += "fi"; return;
+        case 0xFB02: out += "fl"; return;
+        case 0xFB03: out += "ffi"; return;
+        case 0xFB04: out += "ffl"; return;
+        case 0xFB05: case 0xFB06: out += "st"; return;
+    }
+    append_utf8(out, cp);
+}
+
+std::string utf16be_to_utf8(const std::string& bytes, size_t start = 0) {
+    std::string out;
+    for (size_t i = start; i + 1 < bytes.size(); i += 2) {
+        uint32_t unit = (static_cast<uint8_t>(bytes[i]) << 8) | static_cast<uint8_t>(bytes[i + 1]);
+        if (unit >= 0xD800 && unit < 0xDC00 && i + 3 < bytes.size()) {
+            uint32_t low = (static_cast<uint8_t>(bytes[i + 2]) << 8) | static_cast<uint8_t>(bytes[i + 3]);
+            if (low >= 0xDC00 && low < 0xE000) {
+                append_code_point(out, 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00));
+                i += 2;
+                continue;
+            }
+        }
+        append_code_point(out, unit);
+    }
+    return out;
+}
+
+// Text strings outside content streams (document info): UTF-16BE with a BOM,
+// otherwise PDFDocEncoding, read as Latin-1
+std::string decode_text_string(const std::string& bytes) {
+    if (bytes.size() >= 2 && static_cast<uint8_t>(bytes[0]) == 0xFE && static_cast<uint8_t>(bytes[1]) == 0xFF) {
+        return utf16be_to_utf8(bytes, 2);
+    }
+    std::string out;
+    for (unsigned char c : bytes) append_utf8(out, c);
+    return out;
+}
+
+size_t utf8_length(const std::string& s) {
+    size_t n = 0;
+    for (unsigned char c : s) {
+        if ((c & 0xC0) != 0x80) n++;
+    }
+    return n;
+}
+
+// First max_chars code points of s
+std::string utf8_prefix(const std::string& s, size_t max_chars) {
+    size_t n = 0;
+    for (size_t i = 0; i < s.size(); ++i) {
+        if ((static_cast<unsigned char>(s[i]) & 0xC0) != 0x80 && n++ == max_chars) return s.substr(0, i);
+    }
+    return s;
+}
+
+std::string trim(const std::string& s) {
+    size_t begin = 0, end = s.size();
+    while (begin < end && is_space(s[begin])) begin++;
+    while (end > begin && is_space(s[end - 1])) end--;
+    return s.substr(begin, end - begin);
+}
+
+// ---------------------------------------------------------------------------
+// Lexer for object syntax and content streams
+
+class Lexer {
+public:
+    Lexer(const char* begin, const char* end) : p_(begin), end_(end) {}
+
+    const char* pos() const { return p_; }
+
+    // Next operand (true), or a bare keyword / operator (false; empty at the end)
+    bool next(PdfValue& out, std::string& keyword, int depth = 0) {
+        keyword.clear();
+        out = PdfValue();
+        skip_space();
+        if (p_ >= end_) return false;
+
+        char c = *p_;
+        if (depth > MAX_NESTING && (c == '[' || c == '<')) {
+            // Too deep to be a real file; hand it back as a keyword instead of recursing
+            keyword.assign(1, c);
+            p_++;
+            return false;
+        }
+        if (c == '/') {
+            read_name(out);
+            return true;
+        }
+        if (c == '(') {
+            read_literal(out);
+            return true;
+        }
+        if (c == '<') {
+            if (p_ + 1 < end_ && p_[1] == '<') {
+                p_ += 2;
+                read_dict(out, depth);
+            } else {
+                read_hex(out);
+            }
+            return true;
+        }
+        if (c == '[') {
+            p_++;
+            read_array(out, depth);
+            return true;
+        }
+        if (c == '>' && p_ + 1 < end_ && p_[1] == '>') {
+            p_ += 2;
+            keyword = ">>";
+            return false;
+        }
+        if (c == ']' || c == ')' || c == '>' || c == '{' || c == '}') {
+            keyword.assign(1, c);
+            p_++;
+            return false;
+        }
+        if ((c >= '0' && c <= '9') || c == '+' || c == '-' || c == '.') {
+            read_number(out);
+            return true;
+        }
+
+        const char* start = p_;
+        while (p_ < end_ && !is_delimiter(*p_)) p_++;
+        keyword.assign(start, p_);
+        if (keyword.empty()) {
+            // Stray delimiter; skip it so callers keep making progress
+            keyword.assign(1, *p_);
+            p_++;
+        }
+        if (keyword == "true" || keyword == "false") {
+            out.kind = PdfValue::Kind::Bool;
+            out.number = keyword == "true" ? 1 : 0;
+            keyword.clear();
+            return true;
+        }
+        if (keyword == "null") {
+            keyword.clear();
+            return true;
+        }
+        return false;
+    }
+
+    // Skip inline image data after the ID operator, up to and including EI
+    void skip_inline_image() {
+        if (p_ < end_) p_++;
+        while (p_ + 1 < end_) {
+            if (p_[0] == 'E' && p_[1] == 'I' && is_space(p_[-1]) && (p_ + 2 == end_ || is_delimiter(p_[2]))) {
+                p_ += 2;
+                return;
+            }
+            p_++;
+        }
+        p_ = end_;
+    }
+
+    void skip_space() {
+        while (p_ < end_) {
+            if (is_space(*p_)) {
+                p_++;
+            } else if (*p_ == '%') {
+                while (p_ < end_ && *p_ != '\n' && *p_ != '\r') p_++;
+            } else {
+                break;
+            }
+        }
+    }
+
+private:
+    void read_name(PdfValue& out) {
+        out.kind = PdfValue::Kind::Name;
+        p_++;
+        while (p_ < end_ && !is_delimiter(*p_)) {
+            if (*p_ == '#' && p_ + 2 < end_ && hex_value(p_[1]) >= 0 && hex_value(p_[2]) >= 0) {
+                out.text += static_cast<char>(hex_value(p_[1]) * 16 + hex_value(p_[2]));
+                p_ += 3;
+            } else {
+                out.text += *p_++;
+            }
+        }
+    }
+
+    void read_literal(PdfValue& out) {
+        out.kind = PdfValue::Kind::String;
+        p_++;
+        int nesting = 1;
+        while (p_ < end_) {
+            char c = *p_++;
+            if (c == '(') {
+                nesting++;
+            } else if (c == ')') {
+                if (--nesting == 0) return;
+            } else if (c == '\\' && p_ < end_) {
+                char e = *p_++;
+                switch (e) {
+                    case 'n': out.text += '\n'; continue;
+                    case 'r': out.text += '\r'; continue;
+                    case 't': out.text += '\t'; continue;
+                    case 'b': out.text += '\b'; continue;
+                    case 'f': out.text += '\f'; continue;
+                    case '\r':
+                        if (p_ < end_ && *p_ == '\n') p_++;
+                        continue;
+                    case '\n':
+                        continue;
+                }
+                if (e >= '0' && e <= '7') {
+                    int value = e - '0';
+                    for (int i = 0; i < 2 && p_ < end_ && *p_ >= '0' && *p_ <= '7'; ++i) {
+                        value = value * 8 + (*p_++ - '0');
+                    }
+                    out.text += static_cast<char>(value & 0xFF);
+                    continue;
+                }
+                out.text += e;     // \( \) \\ and unknown escapes
+                continue;
+            }
+            out.text += c;
+        }
+    }
+
+    void read_hex(PdfValue& out) {
+        out.kind = PdfValue::Kind::String;
+        p_++;
+        int high = -1;
+        while (p_ < end_ && *p_ != '>') {
+            int v = hex_value(*p_++);
+            if (v < 0) continue;
+            if (high < 0) {
+                high = v;
+            } else {
+                out.text += static_cast<char>(high * 16 + v);
+                high = -1;
+            }
+        }
+        if (high >= 0) out.text += static_cast<char>(high * 16);
+        if (p_ < end_) p_++;
+    }
+
+    void read_number(PdfValue& out) {
+        out.kind = PdfValue::Kind::Number;
+        const char* start = p_;
+        bool negative = false;
+        if (*p_ == '+' || *p_ == '-') negative = *p_++ == '-';
+        double value = 0;
+        bool integer = true;
+        while (p_ < end_ && *p_ >= '0' && *p_ <= '9') value = value * 10 + (*p_++ - '0');
+        if (p_ < end_ && *p_ == '.') {
+            integer = false;
+            p_++;
+            double scale = 0.1;
+            while (p_ < end_ && *p_ >= '0' && *p_ <= '9') {
+                value += (*p_++ - '0') * scale;
+                scale *= 0.1;
+            }
+        }
+        // Garbage such as "--5" or "1.2.3": consume the whole token
+        while (p_ < end_ && !is_delimiter(*p_)) {
+            integer = false;
+            p_++;
+        }
+        out.number = negative ? -value : value;
+        if (!integer || negative || (p_ == start + 1 && (*start == '+' || *start == '-'))) return;
+
+        // "num gen R" is an indirect reference
+        const char* save = p_;
+        skip_space();
+        const char* gen = p_;
+        while (p_ < end_ && *p_ >= '0' && *p_ <= '9') p_++;
+        if (p_ > gen && p_ < end_ && is_space(*p_)) {
+            skip_space();
+            if (p_ < end_ && *p_ == 'R' && (p_ + 1 == end_ || is_delimiter(p_[1]))) {
+                p_++;
+                out.kind = PdfValue::Kind::Ref;
+                out.ref = static_cast<int>(value);
+                return;
+            }
+        }
+        p_ = save;
+    }
+
+    void read_array(PdfValue& out, int depth) {
+        out.kind = PdfValue::Kind::Array;
+        PdfValue item;
+        std::string keyword;
+        while (p_ < end_) {
+            if (next(item, keyword, depth + 1)) {
+                if (depth < MAX_NESTING) out.items.push_back(std::move(item));
+            } else if (keyword == "]" || keyword.empty()) {
+                return;
+            }
+        }
+    }
+
+    void read_dict(PdfValue& out, int depth) {
+        out.kind = PdfValue::Kind::Dict;
+        PdfValue key, value;
+        std::string keyword;
+        while (p_ < end_) {
+            if (!next(key, keyword, depth + 1)) {
+                if (keyword == ">>" || keyword.empty()) return;
+                continue;
+            }
+            if (!key.is(PdfValue::Kind::Name)) continue;
+            if (!next(value, keyword, depth + 1)) {
+                if (keyword == ">>" || keyword.empty()) return;
+                continue;
+            }
+            if (depth < MAX_NESTING) {
+                out.keys.push_back(std::move(key.text));
+                out.items.push_back(std::move(value));
+            }
+        }
+    }
+
+    const char* p_;
+    const char* end_;
+};
+
+// ---------------------------------------------------------------------------
+// Stream filters
+
+bool inflate_data(const char* data, size_t size, std::string& out) {
+#ifdef DSA_HAVE_ZLIB
+    z_stream zs{};
+    if (inflateInit(&zs) != Z_OK) return false;
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    zs.avail_in = static_cast<uInt>(size);
+
+    char buffer[64 * 1024];
+    int ret = Z_OK;
+    while (ret == Z_OK && out.size() < MAX_STREAM_BYTES) {
+        zs.next_out = reinterpret_cast<Bytef*>(buffer);
+        zs.avail_out = sizeof(buffer);
+        ret = inflate(&zs, Z_NO_FLUSH);
+        out.append(buffer, sizeof(buffer) - zs.avail_out);
+    }
+    inflateEnd(&zs);
+
+    // Streams cut short or followed by junk are common; keep what inflated
+    return ret == Z_STREAM_END || !out.empty();
+#else
+    (void)data;
+    (void)size;
+    (void)out;
+    return false;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Document: object table, trailer and stream access
+
+class Document {
+public:
+    bool open(const std::string& path, std::string& error) {
+        if (!file_.open(path)) {
+            error = "cannot open file";
+            return false;
+        }
+        begin_ = file_.data();
+        end_ = begin_ + file_.size();
+        if (file_.size() < 8 || std::memcmp(begin_, "%PDF-", 5) != 0) {
+            error = "not a PDF file";
+            return false;
+        }
+
+        scan_objects();
+        if (locations_.empty()) {
+            error = "no objects found";
+            return false;
+        }
+        load_object_streams();
+        find_trailer();
+        return true;
+    }
+
+    const PdfValue& trailer() const { return trailer_; }
+
+    // Follow indirect references; other values are returned as they are
+    const PdfValue& resolve(const PdfValue& value) {
+        const PdfValue* current = &value;
+        for (int hops = 0; hops < 8 && current->is(PdfValue::Kind::Ref); ++hops) {
+            current = &object(current->ref).value;
+        }
+        return current->is(PdfValue::Kind::Ref) ? NULL_VALUE : *current;
+    }
+
+    const PdfValue* resolve_key(const PdfValue& dict, const char* key) {
+        const PdfValue* value = resolve(dict).get(key);
+        return value ? &resolve(*value) : nullptr;
+    }
+
+    // Decoded data of the stream behind a reference. False (error set) for
+    // filters we don't implement.
+    bool stream_data(const PdfValue& ref, std::string& out, std::string& error) {
+        out.clear();
+        if (!ref.is(PdfValue::Kind::Ref)) return false;
+        const Object& obj = object(ref.ref);
+        if (!obj.stream) return false;
+        return decode(obj, out, error);
+    }
+
+private:
+    struct Object {
+        PdfValue value;
+        const char* stream = nullptr;
+        size_t stream_size = 0;
+    };
+
+    const Object& object(int num) {
+        auto cached = objects_.find(num);
+        if (cached != objects_.end()) return cached->second;
+
+        Object& obj = objects_[num];
+        auto location = locations_.find(num);
+        if (location != locations_.end()) parse_object(location->second, obj);
+        return obj;
+    }
+
+    // "num gen obj" headers anywhere in the file; later ones win, as
+    // incremental updates append replacements at the end
+    void scan_objects() {
+        const char* p = begin_;
+        while (p < end_) {
+            const char* hit = static_cast<const char*>(std::memchr(p, 'o', end_ - p));
+            if (!hit) break;
+            p = hit + 1;
+            if (hit + 3 > end_ || hit[1] != 'b' || hit[2] != 'j') continue;
+            if (hit + 3 < end_ && !is_delimiter(hit[3])) continue;
+
+            const char* q = hit;
+            if (q == begin_ || !is_space(q[-1])) continue;
+            while (q > begin_ && is_space(q[-1])) q--;
+            const char* gen_end = q;
+            while (q > begin_ && q[-1] >= '0' && q[-1] <= '9') q--;
+            if (q == gen_end || q == begin_ || !is_space(q[-1])) continue;
+            while (q > begin_ && is_space(q[-1])) q--;
+            const char* num_end = q;
+            while (q > begin_ && q[-1] >= '0' && q[-1] <= '9') q--;
+            if (q == num_end || (q > begin_ && !is_delimiter(q[-1]))) continue;
+
+            long num = std::strtol(std::string(q, num_end).c_str(), nullptr, 10);
+            if (num <= 0 || num > 10000000) continue;
+            locations_[static_cast<int>(num)] = hit + 3;
+            starts_.push_back({q - begin_, static_cast<int>(num)});
+        }
+        std::sort(starts_.begin(), starts_.end());
+    }
+
+    void parse_object(const char* at, Object& obj) {
+        Lexer lexer(at, end_);
+        std::string keyword;
+        if (!lexer.next(obj.value, keyword)) return;
+
+        PdfValue next;
+        if (lexer.next(next, keyword) || keyword != "stream") return;
+
+        const char* data = lexer.pos();
+        if (data < end_ && *data == '\r') data++;
+        if (data < end_ && *data == '\n') data++;
+
+        // /Length may itself be an indirect object; only trust it if
+        // "endstream" follows where it says the data ends
+        size_t size = 0;
+        bool sized = false;
+        if (const PdfValue* length = obj.value.get("Length")) {
+            double n = length->is(PdfValue::Kind::Ref) ? resolve(*length).number : length->number;
+            if (n >= 0 && n <= static_cast<double>(end_ - data)) {
+                Lexer check(data + static_cast<size_t>(n), end_);
+                check.skip_space();
+                if (static_cast<size_t>(end_ - check.pos()) >= 9 && std::memcmp(check.pos(), "endstream", 9) == 0) {
+                    size = static_cast<size_t>(n);
+                    sized = true;
+                }
+            }
+        }
+        if (!sized) {
+            const char* endstream = find(data, "endstream");
+            if (!endstream) return;
+            const char* stop = endstream;
+            if (stop > data && stop[-1] == '\n') stop--;
+            if (stop > data && stop[-1] == '\r') stop--;
+            size = stop - data;
+        }
+        obj.stream = data;
+        obj.stream_size = size;
+    }
+
+    bool decode(const Object& obj, std::string& out, std::string& error) {
+        std::vector<std::string> filters;
+        const PdfValue& filter = resolve(obj.value.get("Filter") ? *obj.value.get("Filter") : NULL_VALUE);
+        if (filter.is(PdfValue::Kind::Name)) {
+            filters.push_back(filter.text);
+        } else if (filter.is(PdfValue::Kind::Array)) {
+            for (const auto& item : filter.items) filters.push_back(resolve(item).text);
+        }
+
+        if (filters.empty()) {
+            out.assign(obj.stream, obj.stream_size);
+            return true;
+        }
+        if (filters.size() > 1 || (filters[0] != "FlateDecode" && filters[0] != "Fl")) {
+            error = "unsupported stream filter /" + filters[0];
+            return false;
+        }
+
+        const PdfValue* params = obj.value.get("DecodeParms");
+        if (params) {
+            const PdfValue& p = resolve(*params);
+            const PdfValue* predictor = p.get("Predictor");
+            if (predictor && resolve(*predictor).number > 1) {
+                error = "unsupported stream predictor";
+                return false;
+            }
+        }
+#ifndef DSA_HAVE_ZLIB
+        error = "built without zlib, cannot inflate streams";
+        return false;
+#endif
+        if (!inflate_data(obj.stream, obj.stream_size, out)) {
+            error = "corrupt FlateDecode stream";
+            return false;
+        }
+        return true;
+    }
+
+    // PDF 1.5 object streams hold most dictionaries of modern files; their
+    // objects are parsed up front, regular objects take precedence
+    void load_object_streams() {
+        const char* p = begin_;
+        std::unordered_set<int> seen;
+        while ((p = find(p, "/ObjStm"))) {
+            size_t offset = p - begin_;
+            p += 7;
+            auto it = std::upper_bound(starts_.begin(), starts_.end(), std::make_pair(offset, std::numeric_limits<int>::max()));
+            if (it == starts_.begin()) continue;
+            int num = std::prev(it)->second;
+            if (!seen.insert(num).second) continue;
+
+            const Object& stm = object(num);
+            const PdfValue* type = stm.value.get("Type");
+            if (!stm.stream || !type || !type->is_name("ObjStm")) continue;
+
+            std::string data, error;
+            if (!decode(stm, data, error)) continue;
+            const PdfValue* n = stm.value.get("N");
+            const PdfValue* first = stm.value.get("First");
+            if (!n || !first || first->number < 0 || first->number > data.size()) continue;
+
+            const char* base = data.data();
+            size_t first_offset = static_cast<size_t>(first->number);
+            Lexer header(base, base + first_offset);
+            PdfValue id, at;
+            std::string keyword;
+            for (int i = 0; i < static_cast<int>(n->number); ++i) {
+                if (!header.next(id, keyword) || !header.next(at, keyword)) break;
+                int obj_num = static_cast<int>(id.number);
+                size_t obj_offset = first_offset + static_cast<size_t>(at.number);
+                if (obj_offset >= data.size() || locations_.count(obj_num)) continue;
+
+                Object parsed;
+                Lexer body(base + obj_offset, base + data.size());
+                body.next(parsed.value, keyword);
+                objects_[obj_num] = std::move(parsed);
+            }
+        }
+    }
+
+    void find_trailer() {
+        // Classic files: the last trailer dictionary
+        for (const char* p = end_; p > begin_;) {
+            const char* hit = rfind(begin_, p, "trailer");
+            if (!hit) break;
+            Lexer lexer(hit + 7, end_);
+            std::string keyword;
+            if (lexer.next(trailer_, keyword) && trailer_.get("Root")) return;
+            p = hit;
+        }
+
+        // Cross-reference streams carry the trailer entries in their dictionary
+        for (const char* p = end_; p > begin_;) {
+            const char* hit = rfind(begin_, p, "/XRef");
+            if (!hit) break;
+            p = hit;
+            auto it = std::upper_bound(starts_.begin(), starts_.end(),
+                                       std::make_pair(static_cast<size_t>(hit - begin_), std::numeric_limits<int>::max()));
+            if (it == starts_.begin()) continue;
+            const PdfValue& dict = object(std::prev(it)->second).value;
+            if (dict.get("Root")) {
+                trailer_ = dict;
+                return;
+            }
+        }
+
+        // Damaged file without either: look for the catalog itself
+        for (auto& [num, at] : locations_) {
+            const PdfValue& dict = object(num).value;
+            const PdfValue* type = dict.get("Type");
+            if (type && type->is_name("Catalog")) {
+                trailer_ = PdfValue();
+                trailer_.kind = PdfValue::Kind::Dict;
+                PdfValue root;
+                root.kind = PdfValue::Kind::Ref;
+                root.ref = num;
+                trailer_.keys.push_back("Root");
+                trailer_.items.push_back(root);
+                return;
+            }
+        }
+    }
+
+    const char* find(const char* from, const char* needle) const {
+        size_t n = std::strlen(needle);
+        auto it = std::search(from, end_, needle, needle + n);
+        return it == end_ ? nullptr : it;
+    }
+
+    static const char* rfind(const char* begin, const char* end, const char* needle) {
+        size_t n = std::strlen(needle);
+        auto it = std::find_end(begin, end, needle, needle + n);
+        return it == end ? nullptr : it;
+    }
+
+    MappedFile file_;
+    const char* begin_ = nullptr;
+    const char* end_ = nullptr;
+    std::unordered_map<int, const char*> locations_;
+    std::vector<std::pair<size_t, int>> starts_;     // (offset of "num gen obj", num)
+    std::unordered_map<int, Object> objects_;        // Parsed on first use
+    PdfValue trailer_;
+};
+
+// ---------------------------------------------------------------------------
+// Fonts: byte codes of shown strings to text
+
+// Glyph names of /Differences encodings (Adobe glyph list, the part that
+// matters for [a-z0-9] tokens and readable titles)
+std::string glyph_text(const std::string& glyph) {
+    static const std::unordered_map<std::string, std::string> names = {
+        {"zero", "0"}, {"one", "1"}, {"two", "2"}, {"three", "3"}, {"four", "4"},
+        {"five", "5"}, {"six", "6"}, {"seven", "7"}, {"eight", "8"}, {"nine", "9"},
+        {"space", " "}, {"nbspace", " "}, {"hyphen", "-"}, {"endash", "-"}, {"emdash", "-"},
+        {"period", "."}, {"comma", ","}, {"colon", ":"}, {"semicolon", ";"},
+        {"quoteright", "'"}, {"quoteleft", "'"}, {"quotesingle", "'"}, {"quotedbl", "\""},
+        {"quotedblleft", "\""}, {"quotedblright", "\""}, {"parenleft", "("}, {"parenright", ")"},
+        {"bracketleft", "["}, {"bracketright", "]"}, {"slash", "/"}, {"ampersand", "&"},
+        {"question", "?"}, {"exclam", "!"}, {"percent", "%"}, {"plus", "+"}, {"equal", "="},
+        {"ff", "ff"}, {"fi", "fi"}, {"fl", "fl"}, {"ffi", "ffi"}, {"ffl", "ffl"},
+        {"germandbls", "ss"}, {"ae", "ae"}, {"AE", "AE"}, {"oe", "oe"}, {"OE", "OE"},
+    };
+
+    // Suffixes name variants of the same glyph: "a.sc", "one.oldstyle"
+    std::string base = glyph.substr(0, glyph.find('.'));
+    std::string out;
+    size_t start = 0;
+    while (start <= base.size()) {
+        size_t end = base.find('_', start);
+        if (end == std::string::npos) end = base.size();
+        std::string part = base.substr(start, end - start);
+        start = end + 1;
+        if (part.empty()) continue;
+
+        auto it = names.find(part);
+        if (it != names.end()) {
+            out += it->second;
+        } else if (part.size() == 1) {
+            out += part;
+        } else if ((part.size() == 7 && part.compare(0, 3, "uni") == 0) ||
+                   (part.size() >= 5 && part.size() <= 7 && part[0] == 'u')) {
+            size_t digits = part[1] == 'n' ? 3 : 1;
+            uint32_t cp = 0;
+            bool ok = true;
+            for (size_t i = digits; i < part.size(); ++i) {
+                int v = hex_value(part[i]);
+                if (v < 0) ok = false;
+                cp = cp * 16 + (v < 0 ? 0 : v);
+            }
+            if (ok) append_code_point(out, cp);
+        }
+    }
+    return out;
+}
+
+struct Font {
+    int code_bytes = 1;                                    // 2 for composite (Type0) fonts, Identity-H
+    std::unordered_map<uint32_t, std::string> to_unicode;  // From the ToUnicode CMap
+    std::array<std::string, 256> differences;              // Simple fonts: /Encoding /Differences
+    std::array<bool, 256> has_difference{};
+};
+
+void parse_cmap(const std::string& data, Font& font) {
+    Lexer lexer(data.data(), data.data() + data.size());
+    PdfValue a, b, c;
+    std::string keyword;
+    auto code_of = [](const std::string& bytes) {
+        uint32_t code = 0;
+        for (unsigned char ch : bytes) code = (code << 8) | ch;
+        return code;
+    };
+
+    while (true) {
+        bool operand = lexer.next(a, keyword);
+        if (!operand && keyword.empty()) break;
+        if (operand) continue;
+
+        if (keyword == "beginbfchar") {
+            while (lexer.next(a, keyword) && lexer.next(b, keyword)) {
+                if (a.is(PdfValue::Kind::String) && b.is(PdfValue::Kind::String)) {
+                    font.to_unicode[code_of(a.text)] = utf16be_to_utf8(b.text);
+                }
+            }
+        } else if (keyword == "beginbfrange") {
+            while (lexer.next(a, keyword) && lexer.next(b, keyword) && lexer.next(c, keyword)) {
+                if (!a.is(PdfValue::Kind::String) || !b.is(PdfValue::Kind::String)) continue;
+                uint32_t lo = code_of(a.text), hi = code_of(b.text);
+                if (hi < lo || hi - lo > 0xFFFF) continue;
+
+                if (c.is(PdfValue::Kind::Array)) {
+                    for (uint32_t code = lo; code <= hi && code - lo < c.items.size(); ++code) {
+                        font.to_unicode[code] = utf16be_to_utf8(c.items[code - lo].text);
+                    }
+                } else if (c.is(PdfValue::Kind::String) && c.text.size() >= 2) {
+                    // The destination's last UTF-16 unit counts up along the range
+                    std::string dst = c.text;
+                    for (uint32_t code = lo; code <= hi; ++code) {
+                        font.to_unicode[code] = utf16be_to_utf8(dst);
+                        size_t i = dst.size() - 1;
+                        if (++dst[i] == 0 && i > 0) ++dst[i - 1];
+                    }
+                }
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Page text: runs the text operators of content streams
+
+class PageReader {
+public:
+    PageReader(Document& doc, std::unordered_map<int, std::unique_ptr<Font>>& fonts)
+        : doc_(doc), fonts_(fonts) {}
+
+    // Text of one page, lines separated by '\n'
+    bool read(const PdfValue& page, const PdfValue& resources, std::string& text, std::string& error) {
+        text_.clear();
+        const PdfValue* contents = doc_.resolve(page).get("Contents");
+        if (!contents) {
+            text.clear();
+            return true;
+        }
+
+        std::vector<PdfValue> parts;
+        if (contents->is(PdfValue::Kind::Array)) {
+            parts = contents->items;
+        } else {
+            const PdfValue& resolved = doc_.resolve(*contents);
+            if (resolved.is(PdfValue::Kind::Array)) {
+                parts = resolved.items;
+            } else {
+                parts.push_back(*contents);
+            }
+        }
+
+        // Content may be split across streams at any token boundary
+        std::string data, part;
+        for (const auto& ref : parts) {
+            if (!doc_.stream_data(ref, part, error)) {
+                if (!error.empty()) return false;
+                continue;
+            }
+            data += part;
+            data += '\n';
+        }
+        run(data, resources, 0);
+        text = std::move(text_);
+        return true;
+    }
+
+    size_t glyphs() const { return glyphs_; }
+    size_t unmapped_glyphs() const { return unmapped_; }
+
+private:
+    void run(const std::string& data, const PdfValue& resources, int depth) {
+        Lexer lexer(data.data(), data.data() + data.size());
+        std::vector<PdfValue> operands;
+        PdfValue value;
+        std::string op;
+        const Font* font = nullptr;
+        double line_y = NAN;
+
+        while (true) {
+            if (lexer.next(value, op)) {
+                if (operands.size() < 16) operands.push_back(std::move(value));
+                continue;
+            }
+            if (op.empty()) break;
+
+            if (op == "Tf" && !operands.empty()) {
+                font = find_font(resources, operands[0]);
+            } else if (op == "Tj" && !operands.empty()) {
+                show(font, operands.back());
+            } else if (op == "'" && !operands.empty()) {
+                newline();
+                show(font, operands.back());
+            } else if (op == "\"" && !operands.empty()) {
+                newline();
+                show(font, operands.back());
+            } else if (op == "TJ" && !operands.empty() && operands.back().is(PdfValue::Kind::Array)) {
+                for (const auto& item : operands.back().items) {
+                    if (item.is(PdfValue::Kind::String)) {
+                        show(font, item);
+                    } else if (item.is(PdfValue::Kind::Number) && item.number < -200) {
+                        space();    // Kerning this wide is a word gap
+                    }
+                }
+            } else if ((op == "Td" || op == "TD") && operands.size() >= 2) {
+                if (std::fabs(operands[1].number) > 0.01) {
+                    newline();
+                    if (!std::isnan(line_y)) line_y += operands[1].number;
+                } else {
+                    space();
+                }
+            } else if (op == "Tm" && operands.size() >= 6) {
+                double y = operands[5].number;
+                if (std::isnan(line_y) || std::fabs(y - line_y) > 0.01) {
+                    newline();
+                } else {
+                    space();
+                }
+                line_y = y;
+            } else if (op == "T*") {
+                newline();
+            } else if (op == "ET") {
+                space();
+            } else if (op == "Do" && !operands.empty() && depth < 8) {
+                run_form(resources, operands[0], depth);
+            } else if (op == "ID") {
+                lexer.skip_inline_image();
+            }
+            operands.clear();
+        }
+    }
+
+    // Form XObjects are content streams of their own, often a whole page's worth
+    void run_form(const PdfValue& resources, const PdfValue& name, int depth) {
+        const PdfValue* xobjects = doc_.resolve_key(resources, "XObject");
+        if (!xobjects || !name.is(PdfValue::Kind::Name)) return;
+        const PdfValue* ref = xobjects->get(name.text);
+        if (!ref || !ref->is(PdfValue::Kind::Ref) || !forms_seen_.insert(ref->ref).second) return;
+
+        const PdfValue& form = doc_.resolve(*ref);
+        const PdfValue* subtype = form.get("Subtype");
+        if (!subtype || !subtype->is_name("Form")) return;
+
+        std::string data, error;
+        if (!doc_.stream_data(*ref, data, error)) return;
+        const PdfValue* own = doc_.resolve_key(form, "Resources");
+        run(data, own ? *own : resources, depth + 1);
+        forms_seen_.erase(ref->ref);
+    }
+
+    const Font* find_font(const PdfValue& resources, const PdfValue& name) {
+        const PdfValue* dict = doc_.resolve_key(resources, "Font");
+        if (!dict || !name.is(PdfValue::Kind::Name)) return nullptr;
+        const PdfValue* ref = dict->get(name.text);
+        if (!ref) return nullptr;
+
+        // Fonts are shared between pages; decode each only once
+        int key = ref->is(PdfValue::Kind::Ref) ? ref->ref : -1;
+        if (key >= 0) {
+            auto it = fonts_.find(key);
+            if (it != fonts_.end()) return it->second.get();
+        }
+
+        auto font = std::make_unique<Font>();
+        const PdfValue& desc = doc_.resolve(*ref);
+        const PdfValue* subtype = desc.get("Subtype");
+        if (subtype && subtype->is_name("Type0")) font->code_bytes = 2;
+
+        if (const PdfValue* encoding = doc_.resolve_key(desc, "Encoding")) {
+            const PdfValue* diffs = encoding->get("Differences");
+            if (diffs) {
+                const PdfValue& list = doc_.resolve(*diffs);
+                int code = 0;
+                for (const auto& item : list.items) {
+                    if (item.is(PdfValue::Kind::Number)) {
+                        code = static_cast<int>(item.number);
+                    } else if (item.is(PdfValue::Kind::Name) && code >= 0 && code < 256) {
+                        font->differences[code] = glyph_text(item.text);
+                        font->has_difference[code] = true;
+                        code++;
+                    }
+                }
+            }
+        }
+
+        if (const PdfValue* to_unicode = desc.get("ToUnicode")) {
+            std::string cmap, error;
+            if (doc_.stream_data(*to_unicode, cmap, error)) parse_cmap(cmap, *font);
+        }
+
+        Font* raw = font.get();
+        if (key >= 0) {
+            fonts_[key] = std::move(font);
+        } else {
+            inline_fonts_.push_back(std::move(font));
+        }
+        return raw;
+    }
+
+    void show(const Font* font, const PdfValue& string) {
+        if (!string.is(PdfValue::Kind::String)) return;
+        const std::string& bytes = string.text;
+        int width = font ? font->code_bytes : 1;
+
+        for (size_t i = 0; i + width <= bytes.size(); i += width) {
+            uint32_t code = static_cast<uint8_t>(bytes[i]);
+            if (width == 2) code = (code << 8) | static_cast<uint8_t>(bytes[i + 1]);
+            glyphs_++;
+
+            if (font) {
+                auto it = font->to_unicode.find(code);
+                if (it != font->to_unicode.end()) {
+                    text_ += it->second;
+                    continue;
+                }
+                if (width == 1 && font->has_difference[code]) {
+                    text_ += font->differences[code];
+                    continue;
+                }
+            }
+            if (width == 2) {
+                // Composite font without a mapping: glyph ids, not text
+                unmapped_++;
+                text_ += ' ';
+                continue;
+            }
+            // Standard / WinAnsi encodings agree with ASCII where tokens live;
+            // of the WinAnsi extras only punctuation matters (for titles)
+            if (code >= 0x80 && code < 0xA0) {
+                text_ += (code == 0x91 || code == 0x92) ? '\'' : (code == 0x93 || code == 0x94) ? '"'
+                       : (code == 0x96 || code == 0x97) ? '-' : ' ';
+            } else {
+                append_utf8(text_, code);
+            }
+        }
+    }
+
+    void space() {
+        if (!text_.empty() && text_.back() != ' ' && text_.back() != '\n') text_ += ' ';
+    }
+
+    void newline() {
+        if (!text_.empty() && text_.back() != '\n') text_ += '\n';
+    }
+
+    Document& doc_;
+    std::unordered_map<int, std::unique_ptr<Font>>& fonts_;
+    std::vector<std::unique_ptr<Font>> inline_fonts_;
+    std::unordered_set<int> forms_seen_;
+    std::string text_;
+    size_t glyphs_ = 0;
+    size_t unmapped_ = 0;
+};
+
+// Leaf pages in document order; /Resources is inherited down the tree
+struct PageRef {
+    const PdfValue* page;
+    const PdfValue* resources;
+};
+
+void collect_pages(Document& doc, const PdfValue& node_ref, const PdfValue* resources,
+                   std::vector<PageRef>& pages, std::unordered_set<int>& visited, int depth) {
+    if (pages.size() >= static_cast<size_t>(PDFTextExtractor::MAX_PAGES) || depth > MAX_NESTING) return;
+    if (node_ref.is(PdfValue::Kind::Ref) && !visited.insert(node_ref.ref).second) return;
+
+    const PdfValue& node = doc.resolve(node_ref);
+    if (!node.is(PdfValue::Kind::Dict)) return;
+    if (const PdfValue* own = doc.resolve_key(node, "Resources")) resources = own;
+
+    const PdfValue* kids = doc.resolve_key(node, "Kids");
+    if (kids && kids->is(PdfValue::Kind::Array)) {
+        for (const auto& kid : kids->items) {
+            collect_pages(doc, kid, resources, pages, visited, depth + 1);
+        }
+        return;
+    }
+    pages.push_back({&node, resources ? resources : &NULL_VALUE});
+}
+
+// Script's title strategy 2: first line of page 1 that looks like a title
+std::string title_from_text(const std::string& text) {
+    std::string first;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos) end = text.size();
+        std::string line = trim(text.substr(start, end - start));
+        start = end + 1;
+        if (line.empty()) continue;
+
+        if (first.empty()) first = line;
+        size_t length = utf8_length(line);
+        if (length > 10 && length < 300) return utf8_prefix(line, 200);
+    }
+    return utf8_prefix(first, 200);
+}
+
+std::string title_from_filename(const std::string& pdf_path) {
+    std::string name = fs::path(pdf_path).filename().string();
+    size_t ext;
+    while ((ext = name.find(".pdf")) != std::string::npos) name.erase(ext, 4);
+    std::replace(name.begin(), name.end(), '_', ' ');
+    std::replace(name.begin(), name.end(), '-', ' ');
+    return name;
+}
+
+} // namespace
+
+void PDFTextExtractor::tokenize(const std::string& text, std::vector<std::string>& tokens,
+                                size_t max_tokens) {
+    std::string token;
+    for (size_t i = 0; i <= text.size() && tokens.size() < max_tokens; ++i) {
+        char c = i < text.size() ? text[i] : ' ';
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) {
+            token += c;
+        } else if (!token.empty()) {
+            tokens.push_back(std::move(token));
+            token.clear();
+        }
+    }
+}
+
+bool PDFTextExtractor::extract(const std::string& pdf_path, Result& out, std::string& error) {
+    out = Result();
+    error.clear();
+
+    Document doc;
+    if (!doc.open(pdf_path, error)) return false;
+    if (doc.trailer().get("Encrypt")) {
+        error = "encrypted PDF";
+        return false;
+    }
+
+    const PdfValue* root = doc.resolve_key(doc.trailer(), "Root");
+    const PdfValue* tree = root ? root->get("Pages") : nullptr;
+    std::vector<PageRef> pages;
+    std::unordered_set<int> visited;
+    if (tree) collect_pages(doc, *tree, nullptr, pages, visited, 0);
+    if (pages.empty()) {
+        error = "no pages found";
+        return false;
+    }
+
+    std::unordered_map<int, std::unique_ptr<Font>> fonts;
+    PageReader reader(doc, fonts);
+    std::string first_page_text, text;
+    for (const auto& page : pages) {
+        if (!reader.read(*page.page, *page.resources, text, error)) return false;
+        if (out.pages == 0) first_page_text = text;
+        out.pages++;
+
+        tokenize(text, out.tokens, MAX_TOKENS);
+        if (out.tokens.size() >= MAX_TOKENS) break;
+    }
+
+    if (reader.glyphs() > 0 &&
+        static_cast<double>(reader.unmapped_glyphs()) / reader.glyphs() > MAX_UNMAPPED_SHARE) {
+        error = "fonts without a Unicode mapping";
+        return false;
+    }
+    if (out.tokens.empty()) {
+        error = "no extractable text";
+        return false;
+    }
+
+    // Text shown glyph by glyph with explicit positioning comes out as single
+    // letters here; the script's layout analysis does better on those
+    size_t single = std::count_if(out.tokens.begin(), out.tokens.end(),
+                                  [](const std::string& t) { return t.size() == 1; });
+    if (out.tokens.size() >= FRAGMENT_CHECK_TOKENS &&
+        static_cast<double>(single) / out.tokens.size() > MAX_FRAGMENT_SHARE) {
+        error = "text decodes to fragments";
+        return false;
+    }
+    out.tokens.erase(std::remove_if(out.tokens.begin(), out.tokens.end(),
+                                    [](const std::string& t) { return t.size() <= 1; }),
+                     out.tokens.end());
+    if (out.tokens.empty()) {
+        error = "no extractable text";
+        return false;
+    }
+
+    // Title: document info, first line of page 1, file name
+    if (const PdfValue* info = doc.resolve_key(doc.trailer(), "Info")) {
+        if (const PdfValue* title = doc.resolve_key(*info, "Title")) {
+            std::string decoded = trim(decode_text_string(title->text));
+            size_t length = utf8_length(decoded);
+            if (length > 3 && length < 500) out.title = utf8_prefix(decoded, 200);
+        }
+    }
+    if (out.title.empty()) out.title = title_from_text(first_page_text);
+    if (out.title.empty()) out.title = title_from_filename(pdf_path);
+    return true;
+}
@@ -0,0 +1,96 @@
+#include "PositionalMatch.hpp"
+#include <algorithm>
+#include <vector>
+
+namespace positional {
+
+namespace {
+
+// Some p in a has p + offset in b
+bool any_at_offset(const int* a, size_t na, const int* b, size_t nb, int offset) {
+    size_t i = 0, j = 0;
+    while (i < na && j < nb) {
+        int wanted = a[i] + offset;
+        if (b[j] < wanted) {
+            ++j;
+        } else if (b[j] > wanted) {
+            ++i;
+        } else {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Some p in a and q in b with |p - q| <= distance
+bool any_within(const int* a, size_t na, const int* b, size_t nb, int distance) {
+    size_t i = 0, j = 0;
+    while (i < na && j < nb) {
+        if (a[i] - b[j] > distance) {
+            ++j;
+        } else if (b[j] - a[i] > distance) {
+            ++i;
+        } else {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Phrase inside one field. runs[t] / counts[t]: word t's positions there.
+bool phrase_in_field(const int* const* runs, const size_t* counts, size_t num_terms, std::vector<int>& starts) {
+    // Start positions that still fit the phrase, narrowed word by word
+    starts.assign(runs[0], runs[0] + counts[0]);
+    for (size_t t = 1; t < num_terms && !starts.empty(); ++t) {
+        size_t kept = 0;
+        size_t j = 0;
+        for (int start : starts) {
+            int wanted = start + static_cast<int>(t);
+            while (j < counts[t] && runs[t][j] < wanted) ++j;
+            if (j == counts[t]) break;
+            if (runs[t][j] == wanted) starts[kept++] = start;
+        }
+        starts.resize(kept);
+    }
+    return !starts.empty();
+}
+
+} // namespace
+
+TermPositions TermPositions::split(const int* positions, size_t count, int title_frequency) {
+    size_t num_title = std::min(count, static_cast<size_t>(std::max(0, title_frequency)));
+    return {positions, num_title, positions + num_title, count - num_title};
+}
+
+bool phrase(const TermPositions* terms, size_t num_terms) {
+    if (num_terms == 0) return true;
+    if (num_terms == 2) return adjacent(terms[0], terms[1]);
+
+    std::vector<const int*> runs(num_terms);
+    std::vector<size_t> counts(num_terms);
+    std::vector<int> starts;
+
+    for (size_t t = 0; t < num_terms; ++t) {
+        runs[t] = terms[t].title;
+        counts[t] = terms[t].num_title;
+    }
+    if (phrase_in_field(runs.data(), counts.data(), num_terms, starts)) return true;
+
+    for (size_t t = 0; t < num_terms; ++t) {
+        runs[t] = terms[t].body;
+        counts[t] = terms[t].num_body;
+    }
+    return phrase_in_field(runs.data(), counts.data(), num_terms, starts);
+}
+
+bool adjacent(const TermPositions& a, const TermPositions& b) {
+    return any_at_offset(a.title, a.num_title, b.title, b.num_title, 1) ||
+           any_at_offset(a.body, a.num_body, b.body, b.num_body, 1);
+}
+
+bool near(const TermPositions& a, const TermPositions& b, int distance) {
+    return any_within(a.title, a.num_title, b.title, b.num_title, distance) ||
+           any_within(a.body, a.num_body, b.body, b.num_body, distance);
+}
+
+} // namespace positional
@@ -0,0 +1,162 @@
+#include "PostingCodec.hpp"
+#include "CpuFeatures.hpp"
+#include <cstring>
+
+#if DSA_HAVE_X86_SIMD
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#endif
+
+namespace posting_codec {
+
+namespace {
+
+// Byte length (1-4) of a value, minus one: the 2-bit code stored in the control byte
+inline uint32_t length_code(uint32_t v) {
+    if (v < (1u << 8)) return 0;
+    if (v < (1u << 16)) return 1;
+    if (v < (1u << 24)) return 2;
+    return 3;
+}
+
+// For every control byte: the pshufb mask that spreads the packed bytes of 4
+// values into 4 little-endian uint32 lanes, and the number of data bytes used.
+struct ShuffleTables {
+    alignas(16) uint8_t masks[256][16];
+    uint8_t lengths[256];
+
+    ShuffleTables() {
+        for (int control = 0; control < 256; ++control) {
+            uint8_t source = 0;
+            for (int lane = 0; lane < 4; ++lane) {
+                int bytes = ((control >> (lane * 2)) & 3) + 1;
+                for (int b = 0; b < 4; ++b) {
+                    masks[control][lane * 4 + b] = (b < bytes) ? source++ : 0x80;
+                }
+            }
+            lengths[control] = source;
+        }
+    }
+};
+
+const ShuffleTables& shuffle_tables() {
+    static const ShuffleTables tables;
+    return tables;
+}
+
+#if DSA_HAVE_X86_SIMD
+__attribute__((target("ssse3")))
+size_t decode_ssse3(const uint8_t* in, size_t n, uint32_t* out) {
+    const ShuffleTables& tables = shuffle_tables();
+    const uint8_t* control = in;
+    const uint8_t* data = in + (n + 3) / 4;
+
+    size_t quads = n / 4;
+    for (size_t q = 0; q < quads; ++q) {
+        uint8_t c = control[q];
+        __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        __m128i mask = _mm_load_si128(reinterpret_cast<const __m128i*>(tables.masks[c]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + q * 4), _mm_shuffle_epi8(packed, mask));
+        data += tables.lengths[c];
+    }
+
+    // Remaining 1-3 values share the last control byte
+    for (size_t i = quads * 4; i < n; ++i) {
+        uint32_t bytes = ((control[i >> 2] >> ((i & 3) * 2)) & 3) + 1;
+        uint32_t value = 0;
+        for (uint32_t b = 0; b < bytes; ++b) {
+            value |= static_cast<uint32_t>(data[b]) << (8 * b);
+        }
+        out[i] = value;
+        data += bytes;
+    }
+    return static_cast<size_t>(data - in);
+}
+#endif
+
+} // namespace
+
+size_t decode_scalar(const uint8_t* in, size_t n, uint32_t* out) {
+    const uint8_t* control = in;
+    const uint8_t* data = in + (n + 3) / 4;
+
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t bytes = ((control[i >> 2] >> ((i & 3) * 2)) & 3) + 1;
+        uint32_t value = 0;
+        for (uint32_t b = 0; b < bytes; ++b) {
+            value |= static_cast<uint32_t>(data[b]) << (8 * b);
+        }
+        out[i] = value;
+        data += bytes;
+    }
+    return static_cast<size_t>(data - in);
+}
+
+size_t encode(const uint32_t* in, size_t n, std::vector<uint8_t>& out) {
+    size_t start = out.size();
+    size_t control_bytes = (n + 3) / 4;
+    out.resize(start + control_bytes, 0);
+
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t code = length_code(in[i]);
+        out[start + (i >> 2)] |= static_cast<uint8_t>(code << ((i & 3) * 2));
+        for (uint32_t b = 0; b <= code; ++b) {
+            out.push_back(static_cast<uint8_t>(in[i] >> (8 * b)));
+        }
+    }
+    return out.size() - start;
+}
+
+size_t decode(const uint8_t* in, size_t n, uint32_t* out) {
+#if DSA_HAVE_X86_SIMD
+    if (cpu::has_ssse3()) return decode_ssse3(in, n, out);
+#endif
+    return decode_scalar(in, n, out);
+}
+
+size_t encoded_size(const uint8_t* in, size_t n) {
+    const ShuffleTables& tables = shuffle_tables();
+    size_t control_bytes = (n + 3) / 4;
+    size_t bytes = control_bytes;
+    for (size_t q = 0; q < n / 4; ++q) bytes += tables.lengths[in[q]];
+    // Remaining 1-3 values share the last control byte
+    for (size_t i = n / 4 * 4; i < n; ++i) bytes += ((in[i >> 2] >> ((i & 3) * 2)) & 3) + 1;
+    return bytes;
+}
+
+void delta_encode(uint32_t* values, size_t n, uint32_t base) {
+    uint32_t previous = base;
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t current = values[i];
+        values[i] = current - previous;
+        previous = current;
+    }
+}
+
+void prefix_sum(uint32_t* values, size_t n, uint32_t base) {
+    size_t i = 0;
+#if DSA_HAVE_X86_SIMD && defined(__SSE2__)
+    // In-register scan of 4 lanes, carrying the last lane into the next group
+    __m128i carry = _mm_set1_epi32(static_cast<int>(base));
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi32(x, carry);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), x);
+        carry = _mm_shuffle_epi32(x, 0xFF);
+    }
+    if (i > 0) base = values[i - 1];
+#endif
+    prefix_sum_scalar(values + i, n - i, base);
+}
+
+void prefix_sum_scalar(uint32_t* values, size_t n, uint32_t base) {
+    uint32_t running = base;
+    for (size_t i = 0; i < n; ++i) {
+        running += values[i];
+        values[i] = running;
+    }
+}
+
+} // namespace posting_codec
@@ -0,0 +1,68 @@
+#include "PostingCursor.hpp"
+#include "PostingIntersect.hpp"
+#include <algorithm>
+
+PostingCursor::PostingCursor(const PostingListView& list) : list_(list) {
+    if (list_.num_blocks > 0) {
+        load_block(0);
+    }
+}
+
+void PostingCursor::load_block(uint32_t b) {
+    list_.decode_block(b, block_);
+    block_index_ = b;
+    if (shallow_block_ < b) shallow_block_ = b;
+    index_ = 0;
+    positions_loaded_ = false;
+    doc_ = block_.doc_ids[0];
+}
+
+uint32_t PostingCursor::first_block_reaching(uint32_t from, int target) const {
+    return static_cast<uint32_t>(posting_intersect::gallop(from, list_.num_blocks, [&](size_t b) {
+        return list_.blocks[b].last_doc_id < target;
+    }));
+}
+
+void PostingCursor::next() {
+    if (doc_ == END) return;
+
+    if (++index_ < block_.count) {
+        doc_ = block_.doc_ids[index_];
+    } else if (block_index_ + 1 < list_.num_blocks) {
+        load_block(block_index_ + 1);
+    } else {
+        doc_ = END;
+    }
+}
+
+void PostingCursor::next_geq(int target) {
+    if (doc_ >= target) return;
+
+    // Skip whole blocks using their last doc id
+    uint32_t b = first_block_reaching(block_index_, target);
+    if (b == list_.num_blocks) {
+        doc_ = END;
+        return;
+    }
+    if (b != block_index_) load_block(b);
+
+    // The block's last doc id is >= target, so this stays inside the block
+    index_ += static_cast<uint32_t>(posting_intersect::lower_bound(block_.doc_ids + index_, block_.count - index_, target));
+    doc_ = block_.doc_ids[index_];
+}
+
+bool PostingCursor::shallow_seek(int target) {
+    uint32_t b = first_block_reaching(std::max(shallow_block_, block_index_), target);
+    if (b == list_.num_blocks) return false;
+    shallow_block_ = b;
+    return true;
+}
+
+const int* PostingCursor::positions() {
+    if (!positions_loaded_) {
+        positions_.resize(list_.blocks[block_index_].num_positions);
+        list_.decode_positions(block_index_, positions_.data());
+        positions_loaded_ = true;
+    }
+    return positions_.data() + block_.position_starts[index_];
+}
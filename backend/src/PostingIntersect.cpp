@@ -0,0 +1,94 @@
+#include "PostingIntersect.hpp"
+#include "CpuFeatures.hpp"
+
+#if DSA_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace posting_intersect {
+
+namespace {
+
+// Merge of the parts of a and b from i and j on
+size_t intersect_from(const int32_t* a, size_t na, const int32_t* b, size_t nb, int32_t* out,
+                      size_t i, size_t j, size_t found) {
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) {
+            ++i;
+        } else if (b[j] < a[i]) {
+            ++j;
+        } else {
+            out[found++] = a[i];
+            ++i;
+            ++j;
+        }
+    }
+    return found;
+}
+
+#if DSA_HAVE_X86_SIMD
+// Lanes below target form a prefix of a sorted group of 8: the first lane
+// that isn't is the answer
+__attribute__((target("avx2")))
+size_t lower_bound_avx2(const int32_t* values, size_t n, int32_t target) {
+    const __m256i key = _mm256_set1_epi32(target);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i group = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+        unsigned below = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(key, group))));
+        if (below != 0xFF) return i + static_cast<size_t>(__builtin_ctz(~below));
+    }
+    return i + lower_bound_scalar(values + i, n - i, target);
+}
+
+// Each value of a is compared with 8 values of b at once; b's window moves
+// on only once its last value is below the value of a being looked for.
+__attribute__((target("avx2")))
+size_t intersect_avx2(const int32_t* a, size_t na, const int32_t* b, size_t nb, int32_t* out) {
+    size_t i = 0, j = 0, found = 0;
+    while (i < na && j + 8 <= nb) {
+        int32_t value = a[i];
+        if (b[j + 7] < value) {
+            j += 8;
+            continue;
+        }
+        __m256i window = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j));
+        __m256i equal = _mm256_cmpeq_epi32(_mm256_set1_epi32(value), window);
+        if (!_mm256_testz_si256(equal, equal)) out[found++] = value;
+        ++i;
+    }
+    return intersect_from(a, na, b, nb, out, i, j, found);
+}
+#endif
+
+} // namespace
+
+size_t lower_bound_scalar(const int32_t* values, size_t n, int32_t target) {
+    size_t i = 0;
+    while (i < n && values[i] < target) ++i;
+    return i;
+}
+
+size_t intersect_scalar(const int32_t* a, size_t na, const int32_t* b, size_t nb, int32_t* out) {
+    return intersect_from(a, na, b, nb, out, 0, 0, 0);
+}
+
+size_t lower_bound(const int32_t* values, size_t n, int32_t target) {
+#if DSA_HAVE_X86_SIMD
+    if (cpu::has_avx2_fma()) return lower_bound_avx2(values, n, target);
+#endif
+    return lower_bound_scalar(values, n, target);
+}
+
+size_t intersect(const int32_t* a, size_t na, const int32_t* b, size_t nb, int32_t* out) {
+#if DSA_HAVE_X86_SIMD
+    if (cpu::has_avx2_fma()) return intersect_avx2(a, na, b, nb, out);
+#endif
+    return intersect_scalar(a, na, b, nb, out);
+}
+
+bool simd_enabled() {
+    return cpu::has_avx2_fma();
+}
+
+} // namespace posting_intersect
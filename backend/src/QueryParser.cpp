@@ -0,0 +1,252 @@
+#include "QueryParser.hpp"
+#include <algorithm>
+#include <cctype>
+
+namespace {
+
+constexpr int MAX_NEAR_DISTANCE = 1000;
+
+bool is_word_char(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) != 0;
+}
+
+bool is_digit(char c) {
+    return std::isdigit(static_cast<unsigned char>(c)) != 0;
+}
+
+std::string lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+struct Token {
+    enum class Type { Word, Quote, LParen, RParen, Minus, Or, Near, Title };
+
+    Type type;
+    std::string text;   // Word: lowercased
+    int distance = 0;   // Near
+};
+
+std::vector<Token> tokenize_query(const std::string& query) {
+    std::vector<Token> tokens;
+    bool in_phrase = false;
+
+    size_t i = 0;
+    while (i < query.size()) {
+        char c = query[i];
+        if (c == '"') {
+            tokens.push_back({Token::Type::Quote, ""});
+            in_phrase = !in_phrase;
+            ++i;
+            continue;
+        }
+        if (!is_word_char(c)) {
+            // Inside a phrase everything else just separates words
+            bool starts_operand = i + 1 < query.size() &&
+                                  (is_word_char(query[i + 1]) || query[i + 1] == '"' || query[i + 1] == '(');
+            if (!in_phrase && c == '(') {
+                tokens.push_back({Token::Type::LParen, ""});
+            } else if (!in_phrase && c == ')') {
+                tokens.push_back({Token::Type::RParen, ""});
+            } else if (!in_phrase && c == '-' && starts_operand && (i == 0 || !is_word_char(query[i - 1]))) {
+                tokens.push_back({Token::Type::Minus, ""});
+            }
+            ++i;
+            continue;
+        }
+
+        size_t end = i;
+        while (end < query.size() && is_word_char(query[end])) ++end;
+        std::string text = query.substr(i, end - i);
+
+        if (!in_phrase && text == "OR") {
+            tokens.push_back({Token::Type::Or, ""});
+        } else if (!in_phrase && text == "NEAR" && end + 1 < query.size() && query[end] == '/' && is_digit(query[end + 1])) {
+            int distance = 0;
+            for (++end; end < query.size() && is_digit(query[end]); ++end) {
+                distance = std::min(MAX_NEAR_DISTANCE, distance * 10 + (query[end] - '0'));
+            }
+            tokens.push_back({Token::Type::Near, "", distance});
+        } else if (!in_phrase && end < query.size() && query[end] == ':' && lowercase(text) == "title") {
+            tokens.push_back({Token::Type::Title, ""});
+            ++end;
+        } else {
+            tokens.push_back({Token::Type::Word, lowercase(std::move(text))});
+        }
+        i = end;
+    }
+    return tokens;
+}
+
+void set_title_only(QueryNode& node) {
+    node.title_only = true;
+    for (auto& child : node.children) set_title_only(child);
+}
+
+// Recursive descent over the tokens; words are added to the query as they are met
+class Parser {
+public:
+    Parser(std::vector<Token> tokens, ParsedQuery& query) : tokens_(std::move(tokens)), query_(query) {}
+
+    QueryNode parse() {
+        return parse_or();
+    }
+
+private:
+    bool peek(Token::Type type) const { return pos_ < tokens_.size() && tokens_[pos_].type == type; }
+
+    bool accept(Token::Type type) {
+        if (!peek(type)) return false;
+        ++pos_;
+        return true;
+    }
+
+    size_t add_word() {
+        query_.words.push_back(tokens_[pos_++].text);
+        query_.excluded.push_back(false);
+        return query_.words.size() - 1;
+    }
+
+    // and_expr (OR and_expr)*
+    QueryNode parse_or() {
+        QueryNode first = parse_and();
+        if (!peek(Token::Type::Or)) return first;
+
+        QueryNode node;
+        node.kind = QueryNode::Kind::Or;
+        node.children.push_back(std::move(first));
+        while (accept(Token::Type::Or)) node.children.push_back(parse_and());
+        return node;
+    }
+
+    // unary+, with NEAR/k between two of them
+    QueryNode parse_and() {
+        QueryNode node;
+        node.kind = QueryNode::Kind::And;
+        while (pos_ < tokens_.size() && !peek(Token::Type::Or)) {
+            if (peek(Token::Type::RParen)) {
+                if (depth_ > 0) break;
+                ++pos_;  // Stray closing parenthesis
+                continue;
+            }
+            if (peek(Token::Type::Near)) {
+                int distance = tokens_[pos_++].distance;
+                parse_near(node, distance);
+                continue;
+            }
+            QueryNode child;
+            if (!parse_unary(child)) continue;
+            if (child.kind == QueryNode::Kind::And) {
+                // A group without OR: its terms are just more terms of this AND
+                for (auto& term : child.children) node.children.push_back(std::move(term));
+            } else {
+                node.children.push_back(std::move(child));
+            }
+        }
+        return node;
+    }
+
+    // The operand after NEAR/k, plus the NEAR between it and the last word of
+    // the operand before (when there is one)
+    void parse_near(QueryNode& conjunction, int distance) {
+        bool has_left = !conjunction.children.empty() && conjunction.children.back().kind != QueryNode::Kind::Not &&
+                        conjunction.children.back().kind != QueryNode::Kind::And &&
+                        conjunction.children.back().kind != QueryNode::Kind::Or;
+        size_t left = query_.words.size() - 1;
+
+        QueryNode right;
+        if (!parse_primary(right)) return;
+        bool joins = has_left && (right.kind == QueryNode::Kind::Word || right.kind == QueryNode::Kind::Phrase) &&
+                     right.first == left + 1;
+        conjunction.children.push_back(std::move(right));
+        if (joins) {
+            QueryNode near;
+            near.kind = QueryNode::Kind::Near;
+            near.first = left;
+            near.count = 2;
+            near.distance = distance;
+            conjunction.children.push_back(std::move(near));
+        }
+    }
+
+    // -primary | primary
+    bool parse_unary(QueryNode& node) {
+        if (!accept(Token::Type::Minus)) return parse_primary(node);
+
+        size_t first_word = query_.words.size();
+        QueryNode operand;
+        if (!parse_primary(operand)) return false;
+        for (size_t i = first_word; i < query_.words.size(); ++i) query_.excluded[i] = true;
+        node.kind = QueryNode::Kind::Not;
+        node.children.push_back(std::move(operand));
+        return true;
+    }
+
+    // title:primary | ( or_expr ) | "words" | word
+    bool parse_primary(QueryNode& node) {
+        if (accept(Token::Type::Title)) {
+            if (!parse_primary(node)) return false;
+            set_title_only(node);
+            return true;
+        }
+        if (accept(Token::Type::LParen)) {
+            ++depth_;
+            node = parse_or();
+            --depth_;
+            accept(Token::Type::RParen);
+            return true;
+        }
+        if (accept(Token::Type::Quote)) {
+            size_t first = query_.words.size();
+            while (peek(Token::Type::Word)) add_word();
+            accept(Token::Type::Quote);
+            if (query_.words.size() == first) return false;
+            node.kind = query_.words.size() - first == 1 ? QueryNode::Kind::Word : QueryNode::Kind::Phrase;
+            node.first = first;
+            node.count = query_.words.size() - first;
+            return true;
+        }
+        if (peek(Token::Type::Word)) {
+            node.kind = QueryNode::Kind::Word;
+            node.first = add_word();
+            node.count = 1;
+            return true;
+        }
+        // An operator where an operand should be: skip it (closing
+        // parentheses and OR are left to the caller)
+        if (!peek(Token::Type::RParen) && !peek(Token::Type::Or)) ++pos_;
+        return false;
+    }
+
+    std::vector<Token> tokens_;
+    ParsedQuery& query_;
+    size_t pos_ = 0;
+    int depth_ = 0;
+};
+
+} // namespace
+
+std::vector<std::string> ParsedQuery::scoring_words() const {
+    std::vector<std::string> scoring;
+    for (size_t i = 0; i < words.size(); ++i) {
+        if (!excluded[i]) scoring.push_back(words[i]);
+    }
+    return scoring;
+}
+
+bool ParsedQuery::is_plain_conjunction() const {
+    if (root.kind != QueryNode::Kind::And) return false;
+    for (const auto& child : root.children) {
+        bool positional = child.kind == QueryNode::Kind::Word || child.kind == QueryNode::Kind::Phrase ||
+                          child.kind == QueryNode::Kind::Near;
+        if (!positional || child.title_only) return false;
+    }
+    return true;
+}
+
+ParsedQuery parse_query(const std::string& query) {
+    ParsedQuery parsed;
+    parsed.root = Parser(tokenize_query(query), parsed).parse();
+    return parsed;
+}
@@ -0,0 +1,242 @@
+#include "QueryPlan.hpp"
+#include "PositionalMatch.hpp"
+#include "PostingIntersect.hpp"
+#include <algorithm>
+
+namespace query_plan {
+
+void DeltaSource::next_geq(int target) {
+    index_ = posting_intersect::gallop(index_, entries_.size(),
+                                       [&](size_t k) { return entries_[k].doc_id < target; });
+}
+
+namespace {
+
+// A word no document here has, or a phrase with one
+class EmptyNode : public PlanNode {
+public:
+    int next_geq(int) override { return END; }
+    size_t cost() const override { return 0; }
+};
+
+class WordNode : public PlanNode {
+public:
+    WordNode(std::unique_ptr<TermSource> source, size_t word, bool title_only, const TitleFrequency& title_frequency)
+        : source_(std::move(source)), word_(word), title_only_(title_only), title_frequency_(title_frequency) {}
+
+    int next_geq(int target) override {
+        if (current_ >= target) return current_;
+        source_->next_geq(target);
+        while (title_only_ && source_->doc() != END && title_frequency_(source_->doc(), word_) == 0) {
+            source_->next_geq(source_->doc() + 1);
+        }
+        return current_ = source_->doc();
+    }
+
+    size_t cost() const override { return source_->size(); }
+
+private:
+    std::unique_ptr<TermSource> source_;
+    size_t word_;
+    bool title_only_;
+    const TitleFrequency& title_frequency_;
+    int current_ = -1;
+};
+
+// Phrase or NEAR: documents with every word, then a positional test
+class PositionalNode : public PlanNode {
+public:
+    PositionalNode(const QueryNode& node, std::vector<std::unique_ptr<TermSource>> sources,
+                   const TitleFrequency& title_frequency)
+        : kind_(node.kind), first_word_(node.first), distance_(node.distance), title_only_(node.title_only),
+          sources_(std::move(sources)), terms_(sources_.size()), title_frequency_(title_frequency) {
+        for (size_t t = 0; t < sources_.size(); ++t) order_.push_back(t);
+        std::sort(order_.begin(), order_.end(),
+                  [&](size_t a, size_t b) { return sources_[a]->size() < sources_[b]->size(); });
+    }
+
+    int next_geq(int target) override {
+        if (current_ >= target) return current_;
+        int doc = target;
+        while ((doc = align(doc)) != END && !positions_match(doc)) ++doc;
+        return current_ = doc;
+    }
+
+    size_t cost() const override { return sources_[order_[0]]->size(); }
+
+private:
+    // First doc id >= doc that every word's postings have
+    int align(int doc) {
+        bool aligned = false;
+        while (!aligned) {
+            aligned = true;
+            for (size_t t : order_) {
+                sources_[t]->next_geq(doc);
+                if (sources_[t]->doc() == END) return END;
+                if (sources_[t]->doc() > doc) {
+                    doc = sources_[t]->doc();
+                    aligned = false;
+                    break;
+                }
+            }
+        }
+        return doc;
+    }
+
+    bool positions_match(int doc) {
+        for (size_t t = 0; t < sources_.size(); ++t) {
+            TermSource& source = *sources_[t];
+            terms_[t] = positional::TermPositions::split(source.positions(), source.num_positions(),
+                                                         title_frequency_(doc, first_word_ + t));
+            if (title_only_) terms_[t].num_body = 0;
+        }
+        return kind_ == QueryNode::Kind::Phrase ? positional::phrase(terms_.data(), terms_.size())
+                                                : positional::near(terms_[0], terms_[1], distance_);
+    }
+
+    QueryNode::Kind kind_;
+    size_t first_word_;
+    int distance_;
+    bool title_only_;
+    std::vector<std::unique_ptr<TermSource>> sources_;
+    std::vector<size_t> order_;  // Rarest word first
+    std::vector<positional::TermPositions> terms_;
+    const TitleFrequency& title_frequency_;
+    int current_ = -1;
+};
+
+class AndNode : public PlanNode {
+public:
+    AndNode(std::vector<std::unique_ptr<PlanNode>> required, std::vector<std::unique_ptr<PlanNode>> excluded)
+        : required_(std::move(required)), excluded_(std::move(excluded)) {
+        std::stable_sort(required_.begin(), required_.end(),
+                         [](const auto& a, const auto& b) { return a->cost() < b->cost(); });
+    }
+
+    int next_geq(int target) override {
+        if (current_ >= target) return current_;
+        if (required_.empty()) return current_ = END;  // Only exclusions: nothing to match
+
+        int doc = target;
+        while (true) {
+            // The cheapest child proposes, the others confirm or move the candidate on
+            doc = required_[0]->next_geq(doc);
+            bool aligned = true;
+            for (size_t c = 1; c < required_.size() && doc != END; ++c) {
+                int found = required_[c]->next_geq(doc);
+                if (found != doc) {
+                    doc = found;
+                    aligned = false;
+                    break;
+                }
+            }
+            if (doc == END) return current_ = END;
+            if (!aligned) continue;
+
+            bool excluded = false;
+            for (auto& child : excluded_) {
+                if (child->next_geq(doc) == doc) {
+                    excluded = true;
+                    break;
+                }
+            }
+            if (!excluded) return current_ = doc;
+            ++doc;
+        }
+    }
+
+    size_t cost() const override { return required_.empty() ? 0 : required_[0]->cost(); }
+
+private:
+    std::vector<std::unique_ptr<PlanNode>> required_;  // Cheapest first
+    std::vector<std::unique_ptr<PlanNode>> excluded_;
+    int current_ = -1;
+};
+
+class OrNode : public PlanNode {
+public:
+    explicit OrNode(std::vector<std::unique_ptr<PlanNode>> children) : children_(std::move(children)) {}
+
+    int next_geq(int target) override {
+        if (current_ >= target) return current_;
+        int doc = END;
+        for (auto& child : children_) doc = std::min(doc, child->next_geq(target));
+        return current_ = doc;
+    }
+
+    size_t cost() const override {
+        size_t total = 0;
+        for (const auto& child : children_) total += child->cost();
+        return total;
+    }
+
+private:
+    std::vector<std::unique_ptr<PlanNode>> children_;
+    int current_ = -1;
+};
+
+class Builder {
+public:
+    Builder(const std::vector<bool>& ignored, const OpenSource& open_source, const TitleFrequency& title_frequency)
+        : ignored_(ignored), open_source_(open_source), title_frequency_(title_frequency) {}
+
+    // nullptr: every word under node is ignored, so the node is left out
+    std::unique_ptr<PlanNode> build(const QueryNode& node) {
+        switch (node.kind) {
+            case QueryNode::Kind::Word: {
+                if (ignored_[node.first]) return nullptr;
+                auto source = open_source_(node.first);
+                if (!source) return std::make_unique<EmptyNode>();
+                return std::make_unique<WordNode>(std::move(source), node.first, node.title_only, title_frequency_);
+            }
+            case QueryNode::Kind::Phrase:
+            case QueryNode::Kind::Near: {
+                // Positions of ignored words aren't kept, so a phrase with one can't be checked
+                std::vector<std::unique_ptr<TermSource>> sources;
+                for (size_t i = node.first; i < node.first + node.count; ++i) {
+                    auto source = ignored_[i] ? nullptr : open_source_(i);
+                    if (!source) return std::make_unique<EmptyNode>();
+                    sources.push_back(std::move(source));
+                }
+                return std::make_unique<PositionalNode>(node, std::move(sources), title_frequency_);
+            }
+            case QueryNode::Kind::And: {
+                std::vector<std::unique_ptr<PlanNode>> required;
+                std::vector<std::unique_ptr<PlanNode>> excluded;
+                for (const auto& child : node.children) {
+                    bool negated = child.kind == QueryNode::Kind::Not;
+                    auto built = build(negated ? child.children[0] : child);
+                    if (built) (negated ? excluded : required).push_back(std::move(built));
+                }
+                if (required.empty() && excluded.empty()) return nullptr;
+                return std::make_unique<AndNode>(std::move(required), std::move(excluded));
+            }
+            case QueryNode::Kind::Or: {
+                std::vector<std::unique_ptr<PlanNode>> children;
+                for (const auto& child : node.children) {
+                    if (auto built = build(child)) children.push_back(std::move(built));
+                }
+                if (children.empty()) return nullptr;
+                if (children.size() == 1) return std::move(children[0]);
+                return std::make_unique<OrNode>(std::move(children));
+            }
+            default:
+                // A minus outside a conjunction has nothing to exclude from
+                return std::make_unique<EmptyNode>();
+        }
+    }
+
+private:
+    const std::vector<bool>& ignored_;
+    const OpenSource& open_source_;
+    const TitleFrequency& title_frequency_;
+};
+
+} // namespace
+
+std::unique_ptr<PlanNode> build_plan(const QueryNode& root, const std::vector<bool>& ignored,
+                                     const OpenSource& open_source, const TitleFrequency& title_frequency) {
+    return Builder(ignored, open_source, title_frequency).build(root);
+}
+
+} // namespace query_plan
@@ -6,7 +6,12 @@ RankingScorer::RankingScorer()
     : weight_frequency_(0.4), 
       weight_position_(0.2), 
       weight_title_(0.3), 
-      weight_metadata_(0.1) {
+      weight_metadata_(0.1),
+      bm25f_title_weight_(3.0),
+      bm25f_body_weight_(1.0),
+      bm25f_title_b_(0.3),
+      bm25f_body_b_(0.75),
+      bm25f_k1_(1.2) {
 }
 
 void RankingScorer::set_weights(double freq_weight, double pos_weight, double title_weight, double meta_weight) {
@@ -23,34 +28,40 @@ void RankingScorer::get_weights(double& freq_weight, double& pos_weight, double&
     meta_weight = weight_metadata_;
 }
 
-ScoreComponents RankingScorer::calculate_score(
-    int weighted_frequency,
+void RankingScorer::set_bm25f(double title_weight, double body_weight, double title_b, double body_b, double k1) {
+    bm25f_title_weight_ = title_weight;
+    bm25f_body_weight_ = body_weight;
+    bm25f_title_b_ = title_b;
+    bm25f_body_b_ = body_b;
+    bm25f_k1_ = k1;
+}
+
+ScoreComponents RankingScorer::calculate_document_score(
+    float idf,
+    const CollectionStats& collection,
     int title_frequency,
-    const std::vector<int>& positions,
-    int doc_id,
+    const int* positions,
+    size_t num_positions,
     int doc_length,
-    const DocumentMetadata* metadata
+    int title_length,
+    const StaticScore& static_score
 ) const {
     ScoreComponents scores;
     
-    // Component 1: Frequency Score (logarithmic to prevent dominance)
-    scores.frequency_score = calculate_frequency_score(weighted_frequency);
+    // Component 1: Frequency Score (BM25F over the title and body fields)
+    int body_frequency = std::max(0, static_cast<int>(num_positions) - title_frequency);
+    scores.frequency_score = calculate_bm25f(idf, title_frequency, body_frequency,
+                                             title_length, doc_length - title_length, collection);
     
     // Component 2: Position Score (earlier positions = higher score, using relative position)
-    scores.position_score = calculate_position_score(positions, doc_length);
+    scores.position_score = calculate_position_score(positions, num_positions, doc_length);
     
     // Component 3: Title Boost (documents with query in title get boost)
     scores.title_boost = calculate_title_boost(title_frequency);
     
-    // Component 4: Metadata Score (citations, keywords, etc.)
-    scores.metadata_score = calculate_metadata_score(doc_id, metadata);
-    
-    // Component 5: Date Boost (recent documents get slight boost)
-    int publication_year = 0;
-    if (metadata) {
-        publication_year = metadata->get_publication_year(doc_id);
-    }
-    scores.date_boost = calculate_date_boost(publication_year);
+    // Components 4 and 5: Metadata Score and Date Boost, precomputed per document
+    scores.metadata_score = static_score.metadata_score;
+    scores.date_boost = static_score.date_boost;
     
     // Calculate final weighted score
     scores.final_score = (
@@ -63,34 +74,59 @@ ScoreComponents RankingScorer::calculate_score(
     return scores;
 }
 
-double RankingScorer::calculate_frequency_score(int weighted_frequency) const {
-    // Logarithmic scaling to prevent high-frequency words from dominating
-    // log(1 + freq) gives diminishing returns
-    return std::log1p(static_cast<double>(weighted_frequency));
+StaticScore RankingScorer::static_score(const DocMetadata* doc_metadata) const {
+    StaticScore score;
+    // Metadata Score (citations, keywords, etc.)
+    score.metadata_score = static_cast<float>(calculate_metadata_score(doc_metadata));
+    // Date Boost (recent documents get slight boost)
+    score.date_boost = static_cast<float>(calculate_date_boost(doc_metadata ? doc_metadata->publication_year : 0));
+    return score;
+}
+
+float RankingScorer::inverse_document_frequency(uint32_t document_frequency, uint32_t num_documents) {
+    double n = static_cast<double>(std::max(num_documents, document_frequency));
+    double df = static_cast<double>(document_frequency);
+    return static_cast<float>(std::log1p((n - df + 0.5) / (df + 0.5)));
+}
+
+double RankingScorer::calculate_bm25f(float idf, int title_frequency, int body_frequency,
+                                      int title_length, int body_length, const CollectionStats& collection) const {
+    // Field frequency over its length-normalization factor; no average, no normalization
+    auto normalized = [](int frequency, int length, float avg_length, double b) {
+        if (frequency <= 0) return 0.0;
+        double norm = avg_length > 0.0f ? 1.0 - b + b * std::max(0, length) / avg_length : 1.0;
+        return frequency / std::max(norm, 1e-9);
+    };
+
+    double frequency = bm25f_title_weight_ * normalized(title_frequency, title_length, collection.avg_title_length, bm25f_title_b_) +
+                       bm25f_body_weight_ * normalized(body_frequency, body_length, collection.avg_body_length, bm25f_body_b_);
+    return idf * frequency / (bm25f_k1_ + frequency);
 }
 
-double RankingScorer::calculate_position_score(const std::vector<int>& positions, int doc_length) const {
-    if (positions.empty()) return 0.0;
+double RankingScorer::calculate_position_score(const int* positions, size_t num_positions, int doc_length) const {
+    if (num_positions == 0) return 0.0;
     
     // If document length is unknown or invalid, fall back to absolute position logic
     if (doc_length <= 0) {
         // Fallback: use absolute position with cutoff at 50
         double score = 0.0;
-        for (int pos : positions) {
+        for (size_t i = 0; i < num_positions; ++i) {
+            int pos = positions[i];
             if (pos < 10) {
                 score += (10.0 - static_cast<double>(pos)) * 0.1;
             } else if (pos < 50) {
                 score += (50.0 - static_cast<double>(pos)) * 0.01;
             }
         }
-        return score / std::max(1.0, static_cast<double>(positions.size()));
+        return score / std::max(1.0, static_cast<double>(num_positions));
     }
     
     // Use relative position (normalized by document length)
     double score = 0.0;
     double doc_len = static_cast<double>(doc_length);
     
-    for (int pos : positions) {
+    for (size_t i = 0; i < num_positions; ++i) {
+        int pos = positions[i];
         double relative_pos = static_cast<double>(pos) / doc_len;  // 0.0 to 1.0
         
         if (relative_pos < 0.1) {
@@ -109,7 +145,7 @@ double RankingScorer::calculate_position_score(const std::vector<int>& positions
     }
     
     // Normalize by number of positions (average)
-    return score / std::max(1.0, static_cast<double>(positions.size()));
+    return score / std::max(1.0, static_cast<double>(num_positions));
 }
 
 double RankingScorer::calculate_title_boost(int title_frequency) const {
@@ -118,13 +154,13 @@ double RankingScorer::calculate_title_boost(int title_frequency) const {
     return (title_frequency > 0) ? 2.0 : 1.0;
 }
 
-double RankingScorer::calculate_metadata_score(int doc_id, const DocumentMetadata* metadata) const {
-    if (!metadata) return 0.0;
+double RankingScorer::calculate_metadata_score(const DocMetadata* doc_metadata) const {
+    if (!doc_metadata) return 0.0;
     
     double score = 0.0;
     
     // Citation-based score (logarithmic to handle large citation counts)
-    int cited_count = metadata->get_cited_by_count(doc_id);
+    int cited_count = doc_metadata->cited_by_count;
     if (cited_count > 0) {
         // log(citations) * 0.3 gives diminishing returns
         score += std::log1p(static_cast<double>(cited_count)) * 0.3;
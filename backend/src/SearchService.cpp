@@ -10,6 +10,13 @@
 #include <future>
 #include <chrono>
 #include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include "../include/PostingCursor.hpp"
+#include "../include/PostingIntersect.hpp"
+#include "../include/PositionalMatch.hpp"
+#include "../include/QueryParser.hpp"
+#include "../include/QueryPlan.hpp"
 
 struct SearchResult {
     int doc_id;
@@ -29,452 +36,810 @@ bool compareResults(const SearchResult& a, const SearchResult& b) {
     return a.cited_by_count > b.cited_by_count;
 }
 
-std::vector<std::string> split_query(const std::string& str) {
-    std::vector<std::string> words;
-    std::stringstream ss(str);
-    std::string word;
-    while (ss >> word) {
-        words.push_back(word);
+namespace {
+
+constexpr size_t MAX_RESULTS = 50;
+constexpr size_t SEMANTIC_RERANK_DEPTH = 500;  // Candidates kept for semantic re-ranking
+constexpr size_t SEMANTIC_EXACT_RESCORE_DEPTH = 2 * MAX_RESULTS;  // Re-scored in float32 when vectors are quantized
+constexpr size_t HYBRID_ANN_CANDIDATES = 2 * MAX_RESULTS;  // Nearest documents added to the lexical ones in hybrid mode
+constexpr double PROXIMITY_BONUS = 100.0;
+constexpr double SCORE_EPSILON = 1e-6;         // compareResults treats closer scores as ties
+constexpr double REJECTED = -std::numeric_limits<double>::infinity();  // Fails a phrase / NEAR constraint
+
+const std::string BARRELS_DIR = "data/processed/barrels";
+const std::string DELTA_LOG_PATH = BARRELS_DIR + "/inverted_delta.log";
+const std::string FORWARD_INDEX_PATH = "data/processed/forward_index.jsonl";
+const std::string DOC_STATS_PATH = "data/processed/doc_stats.bin";
+
+// Doc id, lengths and title frequencies of one forward_index.jsonl line.
+// Lines that aren't a document are skipped.
+void add_forward_index_stats(const std::string& line, DocStatsStore::Builder& documents) {
+    try {
+        json doc_line = json::parse(line);
+        if (!doc_line.contains("doc_id") || !doc_line.contains("data")) return;
+
+        int doc_id = std::stoi(doc_line["doc_id"].get<std::string>());
+        json& data = doc_line["data"];
+
+        std::vector<DocStatsStore::TitleFrequency> title_frequencies;
+        if (data.contains("words")) {
+            for (auto& word_item : data["words"].items()) {
+                int word_id = std::stoi(word_item.key());
+                json& word_stats = word_item.value();
+
+                if (word_stats.contains("title_frequency")) {
+                    int title_freq = word_stats["title_frequency"].get<int>();
+                    if (title_freq > 0) {
+                        title_frequencies.push_back({word_id, title_freq});
+                    }
+                }
+            }
+        }
+
+        documents.add(doc_id, data.value("doc_length", 0), data.value("title_length", 0), std::move(title_frequencies));
+    } catch (const std::exception&) {
     }
-    return words;
 }
 
-SearchService::SearchService() {
+// Bounded heap of the best results so far; the worst kept result sits on top
+class TopKCollector {
+public:
+    explicit TopKCollector(size_t k) : k_(k) { heap_.reserve(k); }
+
+    // A document scoring below this can never enter
+    double threshold() const {
+        if (heap_.size() < k_) return -std::numeric_limits<double>::infinity();
+        return heap_.front().score - SCORE_EPSILON;
+    }
+
+    void offer(SearchResult result) {
+        if (heap_.size() < k_) {
+            heap_.push_back(std::move(result));
+            std::push_heap(heap_.begin(), heap_.end(), compareResults);
+        } else if (compareResults(result, heap_.front())) {
+            std::pop_heap(heap_.begin(), heap_.end(), compareResults);
+            heap_.back() = std::move(result);
+            std::push_heap(heap_.begin(), heap_.end(), compareResults);
+        }
+    }
+
+    std::vector<SearchResult> take() { return std::move(heap_); }
+
+private:
+    size_t k_;
+    std::vector<SearchResult> heap_;
+};
+
+// Document-at-a-time AND evaluation with block-max pruning.
+// cursors are in query-word order; candidates come from the rarest term. Before
+// decoding anything for a candidate, the block upper bounds of every term (plus
+// the best possible proximity bonus) are summed; if that can't beat the current
+// top-k threshold, all cursors jump past the nearest block boundary. Otherwise
+// every term's postings up to that boundary sit in one block each: those blocks
+// are decoded and intersected, and only the documents in all of them are
+// scored exactly by score_doc(doc_id) and handed to offer(doc_id, score).
+// score_doc returns REJECTED for documents the query's positional
+// constraints rule out.
+template <typename ScoreDoc, typename Offer>
+void evaluate_conjunctive(std::vector<PostingCursor>& cursors, size_t num_bonus_pairs,
+                          TopKCollector& top_k, ScoreDoc score_doc, Offer offer) {
+    if (cursors.empty()) return;
+
+    auto add_bonus = [num_bonus_pairs](double score) {
+        for (size_t k = 0; k < num_bonus_pairs; ++k) score += PROXIMITY_BONUS;
+        return score;
+    };
+
+    // Candidates are driven by the rarest term
+    size_t lead = 0;
+    for (size_t c = 1; c < cursors.size(); ++c) {
+        if (cursors[c].size() < cursors[lead].size()) lead = c;
+    }
+
+    double max_possible = 0.0;
+    for (const auto& cursor : cursors) max_possible += cursor.max_score();
+    max_possible = add_bonus(max_possible);
+
+    int32_t matches[barrel_format::BLOCK_SIZE];
+    int doc = cursors[lead].doc();
+    while (doc != PostingCursor::END) {
+        double threshold = top_k.threshold();
+        if (max_possible < threshold) break;  // Nothing left can enter the top-k
+
+        // Shallow block-max check: no decoding
+        double bound = 0.0;
+        int skip_to = PostingCursor::END;
+        bool exhausted = false;
+        for (auto& cursor : cursors) {
+            if (!cursor.shallow_seek(doc)) {
+                exhausted = true;
+                break;
+            }
+            bound += cursor.block_max_score();
+            skip_to = std::min(skip_to, cursor.block_last_doc());
+        }
+        if (exhausted) break;
+
+        if (add_bonus(bound) < threshold) {
+            if (skip_to == PostingCursor::END) break;
+            cursors[lead].next_geq(skip_to + 1);
+            doc = cursors[lead].doc();
+            continue;
+        }
+
+        // The lead's postings in [doc, skip_to], narrowed down by each other term's
+        PostingCursor& leader = cursors[lead];
+        size_t num_matches = posting_intersect::lower_bound(leader.block_docs(), leader.block_remaining(), skip_to + 1);
+        std::copy(leader.block_docs(), leader.block_docs() + num_matches, matches);
+        for (size_t c = 0; c < cursors.size() && num_matches > 0; ++c) {
+            if (c == lead) continue;
+            cursors[c].next_geq(doc);
+            size_t in_range = posting_intersect::lower_bound(cursors[c].block_docs(), cursors[c].block_remaining(), skip_to + 1);
+            num_matches = posting_intersect::intersect(matches, num_matches, cursors[c].block_docs(), in_range, matches);
+        }
+
+        for (size_t m = 0; m < num_matches; ++m) {
+            for (auto& cursor : cursors) cursor.next_geq(matches[m]);
+            double score = score_doc(matches[m]);
+            if (score != REJECTED && score >= top_k.threshold()) offer(matches[m], score);
+        }
+
+        leader.next_geq(skip_to + 1);
+        doc = leader.doc();
+    }
+}
+
+SearchResult make_result(const IndexSnapshot& index, int doc_id, double score) {
+    const DocMetadata* meta = index.get_metadata(doc_id);
+    return {
+        doc_id,
+        index.get_url(doc_id),
+        score,
+        meta ? meta->publication_year : 0,
+        meta ? meta->cited_by_count : 0
+    };
+}
+
+// Best MAX_RESULTS of results, best first, into response["results"]
+void append_results(json& response, std::vector<SearchResult>& results, const IndexSnapshot& index) {
+    // Partial sort for top 50 (faster than full sort)
+    if (results.size() > MAX_RESULTS) {
+        std::partial_sort(results.begin(), results.begin() + MAX_RESULTS,
+                          results.end(), compareResults);
+        results.resize(MAX_RESULTS);
+    } else {
+        std::sort(results.begin(), results.end(), compareResults);
+    }
+
+    for (const auto& res : results) {
+        json item;
+        item["docId"] = res.doc_id;
+        item["score"] = res.score;
+        item["url"] = res.url;
+
+        // Add title from metadata
+        const DocMetadata* meta = index.get_metadata(res.doc_id);
+        if (meta && !meta->title.empty()) {
+            item["title"] = meta->title;
+        } else {
+            item["title"] = "Document #" + std::to_string(res.doc_id);
+        }
+
+        if (res.publication_year > 0) item["publication_year"] = res.publication_year;
+        if (res.cited_by_count > 0) item["cited_by_count"] = res.cited_by_count;
+
+        response["results"].push_back(item);
+    }
+}
+
+// Log records carry postings only; stats and metadata come from the snapshot
+std::vector<SegmentDocument> to_segment_documents(std::vector<DeltaDocument> documents) {
+    std::vector<SegmentDocument> converted(documents.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        converted[i].index = std::move(documents[i]);
+    }
+    return converted;
+}
+
+} // namespace
+
+SearchService::SearchService(size_t barrel_cache_bytes)
+    : barrel_cache_(std::make_shared<BarrelCache>(barrel_cache_bytes)) {
     std::cout << "[Engine] Initializing Search Service...\n";
+
+    auto initial = std::make_shared<IndexSnapshot>();
     
     // Load lexicon with trie
-    if (!lexicon_trie_.load_from_json("data/processed/lexicon.json")) {
+    auto lexicon = std::make_shared<LexiconWithTrie>();
+    if (!lexicon->load_from_json("data/processed/lexicon.json")) {
         std::cerr << "[Engine] CRITICAL: Could not load lexicon.json\n";
     } else {
-        std::cout << "[Engine] Lexicon loaded: " << lexicon_trie_.size() << " words\n";
+        std::cout << "[Engine] Lexicon loaded: " << lexicon->size() << " words\n";
         std::cout << "[Engine] Trie built and ready for autocomplete\n";
     }
+    initial->lexicon = lexicon;
     
     // Load URL mapper
-    if (!doc_url_mapper.load("data/processed/docid_to_url.json")) {
+    auto doc_urls = std::make_shared<DocURLMapper>();
+    if (!doc_urls->load("data/processed/docid_to_url.json")) {
         std::cerr << "[Engine] WARNING: Could not load doc_url_map.json\n";
     }
+    initial->doc_urls = doc_urls;
     
-    // Pre-allocate barrel cache (100 barrels max)
-    barrel_cache_.reserve(100);
+    // On-disk segments; barrels are mapped on demand through the shared cache
+    SegmentManifest manifest;
+    SegmentManifest::load(BARRELS_DIR, manifest);
+    load_segments(*initial, manifest);
+    initial->delta_cursor = manifest.flushed;  // The log before it is in segments already
+    std::cout << "[Engine] Index segments: " << initial->segments.size() << "\n";
+    std::cout << "[Engine] Barrel cache budget: " << (barrel_cache_bytes / 1024 / 1024) << " MB\n";
     
     // Load document metadata for ranking
-    if (!document_metadata_.load("data/processed/document_metadata.json")) {
+    auto metadata = std::make_shared<DocumentMetadata>();
+    if (!metadata->load("data/processed/document_metadata.json")) {
         std::cerr << "[Engine] WARNING: Could not load document_metadata.json\n";
         std::cerr << "[Engine] Run extract_metadata.py to generate metadata file\n";
     } else {
-        std::cout << "[Engine] Document metadata loaded: " << document_metadata_.size() << " documents\n";
+        std::cout << "[Engine] Document metadata loaded: " << metadata->size() << " documents\n";
     }
+    initial->metadata = metadata;
+    initial->static_scores = StaticScores::build(*metadata, ranking_scorer_);
     
-    // NEW: Load all document stats into memory for O(1) lookup
-    load_document_stats();
+    // Document lengths and title frequencies, by doc id
+    initial->doc_stats = load_document_stats();
 
     // Load delta index
-    load_delta_index();
+    initial->delta = std::make_shared<MemorySegment>();
+    load_delta_index(*initial);
+
+    publish(initial);
 
     std::string doc_vectors_path = "data/processed/document_vectors.bin";
     std::string word_embeddings_path = "data/processed/word_embeddings.bin";
-    
-    semantic_search_enabled_ = semantic_scorer_.load_document_vectors(doc_vectors_path) && semantic_scorer_.load_word_embeddings(word_embeddings_path);
+
+    // Quantized copies (quantize_vectors) take over when present; the float32
+    // document vectors then only serve the exact re-scoring of the final results
+    const std::string quantized_doc_vectors_path = "data/processed/document_vectors_q.bin";
+    const std::string quantized_word_embeddings_path = "data/processed/word_embeddings_q.bin";
+    bool quantized_docs = std::ifstream(quantized_doc_vectors_path).good();
+    if (std::ifstream(quantized_word_embeddings_path).good()) {
+        word_embeddings_path = quantized_word_embeddings_path;
+    }
+
+    bool have_vectors = semantic_scorer_.load_document_vectors(quantized_docs ? quantized_doc_vectors_path : doc_vectors_path);
+    if (have_vectors && quantized_docs && std::ifstream(doc_vectors_path).good()) {
+        semantic_scorer_.load_exact_vectors(doc_vectors_path);
+    }
+
+    // HNSW graph for mode=semantic / hybrid (build_hnsw); without it those
+    // modes scan every document vector
+    const std::string hnsw_path = "data/processed/document_vectors.hnsw";
+    if (have_vectors && std::ifstream(hnsw_path).good()) {
+        semantic_scorer_.load_ann_index(hnsw_path);
+    }
+
+    // Otherwise the IVF-PQ index (build_ivfpq), which is enough on its own
+    // when the document vectors are left out to save memory
+    const std::string ivfpq_path = "data/processed/document_vectors.ivfpq";
+    bool have_ivfpq = !semantic_scorer_.has_ann_index() && std::ifstream(ivfpq_path).good() &&
+                      semantic_scorer_.load_ivfpq_index(ivfpq_path);
+
+    semantic_search_enabled_ = (have_vectors || have_ivfpq) && semantic_scorer_.load_word_embeddings(word_embeddings_path);
+
     if(semantic_search_enabled_) {
         std::cout << "[Engine] Semantic Search Ready!";
     }
     std::cout << "[Engine] Search Service ready!\n";
 
+    // Only now: the rebuild publishes on top of the served snapshot
+    if (doc_stats_stale_) start_doc_stats_rebuild();
 }
 
-// NEW: Load all document lengths and title frequencies into RAM
-bool SearchService::is_cache_valid(const std::string& cache_path, const std::string& source_path) {
-    std::ifstream cache(cache_path, std::ios::binary);
-    std::ifstream source(source_path);
-    
-    if (!cache.is_open() || !source.is_open()) return false;
-    
-    // Get file modification times (simple check: compare file sizes)
-    cache.seekg(0, std::ios::end);
-    source.seekg(0, std::ios::end);
-    
-    return cache.tellg() > 0; // Cache exists and has content
+SearchService::~SearchService() {
+    if (doc_stats_rebuild_.joinable()) doc_stats_rebuild_.join();
 }
 
-bool SearchService::load_doc_stats_from_cache(const std::string& cache_path) {
-    std::ifstream f(cache_path, std::ios::binary);
-    if (!f.is_open()) return false;
-    
-    // Read header
-    uint32_t num_docs;
-    f.read(reinterpret_cast<char*>(&num_docs), sizeof(num_docs));
-    
-    if (num_docs == 0 || num_docs > 10000000) return false; // Sanity check
-    
-    doc_stats_cache_.reserve(num_docs);
-    
-    // Read each document's stats
-    for (uint32_t i = 0; i < num_docs; ++i) {
-        int doc_id;
-        int doc_length;
-        uint32_t num_title_freqs;
-        
-        f.read(reinterpret_cast<char*>(&doc_id), sizeof(doc_id));
-        f.read(reinterpret_cast<char*>(&doc_length), sizeof(doc_length));
-        f.read(reinterpret_cast<char*>(&num_title_freqs), sizeof(num_title_freqs));
-        
-        DocStats stats;
-        stats.doc_length = doc_length;
-        
-        // Read title frequencies
-        for (uint32_t j = 0; j < num_title_freqs; ++j) {
-            int word_id;
-            int freq;
-            f.read(reinterpret_cast<char*>(&word_id), sizeof(word_id));
-            f.read(reinterpret_cast<char*>(&freq), sizeof(freq));
-            stats.title_frequencies[word_id] = freq;
-        }
-        
-        doc_stats_cache_[doc_id] = std::move(stats);
+std::shared_ptr<const IndexSnapshot> SearchService::snapshot() const {
+    return std::atomic_load(&snapshot_);
+}
+
+BarrelCache::Stats SearchService::barrel_cache_stats() const {
+    return barrel_cache_->get_stats();
+}
+
+void SearchService::publish(std::shared_ptr<const IndexSnapshot> next) {
+    std::atomic_store(&snapshot_, std::move(next));
+}
+
+// doc_stats.bin is current if forward_index.jsonl still has the size and
+// mtime it was built from, or (touched or copied since) the same content
+bool SearchService::is_cache_valid(const DocStatsStore& cache, const std::string& source_path) {
+    doc_stats_format::Source current;
+    if (!doc_stats_format::read_source(source_path, false, current)) {
+        return true;  // Nothing to rebuild from: the cache is all there is
     }
-    
-    return !f.fail();
+    if (current.size != cache.source().size) return false;
+    if (current.same_file(cache.source())) return true;
+    return doc_stats_format::read_source(source_path, true, current) && current.crc == cache.source().crc;
 }
 
-void SearchService::build_doc_stats_cache(const std::string& cache_path) {
+std::shared_ptr<const DocStatsStore> SearchService::load_doc_stats_from_cache(const std::string& cache_path) {
+    auto doc_stats = std::make_shared<DocStatsStore>();
+    if (!doc_stats->load(cache_path) || doc_stats->size() == 0) return nullptr;
+    return doc_stats;
+}
+
+std::shared_ptr<const DocStatsStore> SearchService::build_doc_stats_cache(const std::string& cache_path) {
     std::cout << "[Engine] Building doc stats cache from forward_index.jsonl...\n";
-    
-    std::ifstream f("data/processed/forward_index.jsonl");
-    if (!f.is_open()) {
+
+    // Fingerprinted before reading: lines appended meanwhile make the cache
+    // look stale next time, never current
+    doc_stats_format::Source source;
+    std::ifstream f(FORWARD_INDEX_PATH);
+    if (!f.is_open() || !doc_stats_format::read_source(FORWARD_INDEX_PATH, true, source)) {
         std::cerr << "[Engine] ERROR: Could not open forward_index.jsonl\n";
-        return;
+        return nullptr;
     }
 
     std::string line;
     line.reserve(4096);
-    int docs_loaded = 0;
-    
-    doc_stats_cache_.clear();
-    doc_stats_cache_.reserve(50000);
+    DocStatsStore::Builder documents;
 
     while (std::getline(f, line)) {
         if (line.empty()) continue;
-
-        try {
-            json doc_line = json::parse(line);
-            
-            if (!doc_line.contains("doc_id") || !doc_line.contains("data")) continue;
-
-            int doc_id = std::stoi(doc_line["doc_id"].get<std::string>());
-            json& data = doc_line["data"];
-
-            DocStats stats;
-            stats.doc_length = data.value("doc_length", 0);
-
-            if (data.contains("words")) {
-                for (auto& word_item : data["words"].items()) {
-                    int word_id = std::stoi(word_item.key());
-                    json& word_stats = word_item.value();
-                    
-                    if (word_stats.contains("title_frequency")) {
-                        int title_freq = word_stats["title_frequency"].get<int>();
-                        if (title_freq > 0) {
-                            stats.title_frequencies[word_id] = title_freq;
-                        }
-                    }
-                }
-            }
-
-            doc_stats_cache_[doc_id] = std::move(stats);
-            docs_loaded++;
-
-        } catch (const std::exception&) {
-            continue;
-        }
+        add_forward_index_stats(line, documents);
     }
-    
-    // Write binary cache
-    std::ofstream out(cache_path, std::ios::binary);
-    if (!out.is_open()) {
+
+    std::shared_ptr<const DocStatsStore> doc_stats = DocStatsStore::build(std::move(documents));
+    if (!doc_stats->save(cache_path, source)) {
         std::cerr << "[Engine] WARNING: Could not create cache file\n";
-        return;
-    }
-    
-    uint32_t num_docs = static_cast<uint32_t>(doc_stats_cache_.size());
-    out.write(reinterpret_cast<const char*>(&num_docs), sizeof(num_docs));
-    
-    for (const auto& [doc_id, stats] : doc_stats_cache_) {
-        out.write(reinterpret_cast<const char*>(&doc_id), sizeof(doc_id));
-        out.write(reinterpret_cast<const char*>(&stats.doc_length), sizeof(stats.doc_length));
-        
-        uint32_t num_title_freqs = static_cast<uint32_t>(stats.title_frequencies.size());
-        out.write(reinterpret_cast<const char*>(&num_title_freqs), sizeof(num_title_freqs));
-        
-        for (const auto& [word_id, freq] : stats.title_frequencies) {
-            out.write(reinterpret_cast<const char*>(&word_id), sizeof(word_id));
-            out.write(reinterpret_cast<const char*>(&freq), sizeof(freq));
-        }
+        return doc_stats;
     }
     
-    std::cout << "[Engine] ✅ Cache built: " << doc_stats_cache_.size() << " documents\n";
+    std::cout << "[Engine] ✅ Cache built: " << doc_stats->size() << " documents\n";
+    return doc_stats;
 }
 
-void SearchService::load_document_stats() {
-    std::string cache_path = "data/processed/doc_stats.bin";
-    
-    // Try loading from binary cache first (100x faster)
-    if (is_cache_valid(cache_path, "data/processed/forward_index.jsonl")) {
-        std::cout << "[Engine] Loading from binary cache...\n";
-        auto start = std::chrono::high_resolution_clock::now();
-        
-        if (load_doc_stats_from_cache(cache_path)) {
-            auto end = std::chrono::high_resolution_clock::now();
-            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-            
-            std::cout << "[Engine] ⚡ Loaded " << doc_stats_cache_.size() 
-                      << " documents in " << duration << "ms (from cache)\n";
-            return;
-        } else {
-            std::cout << "[Engine] Cache corrupted, rebuilding...\n";
+std::shared_ptr<const DocStatsStore> SearchService::load_document_stats() {
+    // Try mapping the binary cache first (nothing to parse)
+    std::cout << "[Engine] Loading from binary cache...\n";
+    auto start = std::chrono::high_resolution_clock::now();
+
+    if (auto doc_stats = load_doc_stats_from_cache(DOC_STATS_PATH)) {
+        auto end = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+        std::cout << "[Engine] ⚡ Loaded " << doc_stats->size()
+                  << " documents in " << duration << "ms (from cache)\n";
+
+        // Stale stats still beat none: serve them while the rebuild runs
+        if (!is_cache_valid(*doc_stats, FORWARD_INDEX_PATH)) {
+            std::cout << "[Engine] forward_index.jsonl changed since doc_stats.bin was built; "
+                      << "rebuilding it in the background\n";
+            doc_stats_stale_ = true;
         }
+        return doc_stats;
     }
     
-    // Cache miss or invalid - build from scratch
+    // Missing, corrupted or an old format: nothing to serve, build it now
     std::cout << "[Engine] No valid cache found, building from forward_index.jsonl...\n";
-    auto start = std::chrono::high_resolution_clock::now();
+    start = std::chrono::high_resolution_clock::now();
     
-    build_doc_stats_cache(cache_path);
+    std::shared_ptr<const DocStatsStore> doc_stats = build_doc_stats_cache(DOC_STATS_PATH);
+    if (!doc_stats) doc_stats = std::make_shared<DocStatsStore>();
     
     auto end = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
     
     std::cout << "[Engine] ✅ Built cache in " << duration << "ms\n";
-    
-    size_t estimated_mem = doc_stats_cache_.size() * (sizeof(int) + sizeof(DocStats) + 50);
-    std::cout << "[Engine] Memory usage: " << (estimated_mem / 1024 / 1024) << " MB\n";
+    std::cout << "[Engine] Memory usage: " << (doc_stats->data_bytes() / 1024 / 1024) << " MB\n";
+    return doc_stats;
 }
 
-void SearchService::load_delta_index() {
-    std::ifstream f("data/processed/barrels/inverted_delta.json");
-    if (!f.good()) {
-        std::cout << "[Engine] No delta index found (this is normal for fresh builds)\n";
-        return;
-    }
-
-    try {
-        json j;
-        f >> j;
-        for (auto& item : j.items()) {
-            int word_id = std::stoi(item.key());
-            std::vector<DeltaEntry> entries;
-            for (auto& elem : item.value()) {
-                entries.push_back({
-                    elem[0].get<int>(),
-                    elem[1].get<int>(),
-                    elem[2].get<std::vector<int>>()
-                });
-            }
-            delta_index_[word_id] = std::move(entries);
+void SearchService::start_doc_stats_rebuild() {
+    doc_stats_rebuilding_ = true;
+    doc_stats_rebuild_ = std::thread([this] {
+        auto start = std::chrono::steady_clock::now();
+        std::shared_ptr<const DocStatsStore> rebuilt = build_doc_stats_cache(DOC_STATS_PATH);
+        if (rebuilt) {
+            std::lock_guard<std::mutex> lock(reload_mutex_);
+            auto next = std::make_shared<IndexSnapshot>(*snapshot());
+            // Uploads that reached the forward index after it was read
+            next->doc_stats = with_recent_documents(rebuilt);
+            next->generation++;
+            publish(next);
+
+            auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "[Engine] Serving rebuilt doc stats (" << next->doc_stats->size() << " documents, "
+                      << seconds << " s)\n";
         }
-        std::cout << "[Engine] Delta Index loaded: " << delta_index_.size() << " words\n";
-    } catch (const std::exception& e) {
-        std::cerr << "[Engine] Error loading delta index: " << e.what() << "\n";
-    }
+        doc_stats_rebuilding_ = false;
+    });
 }
 
-// Barrel cache with LRU eviction
-json& SearchService::get_barrel(int barrel_id) {
-    // Check if already in cache
-    auto it = barrel_cache_.find(barrel_id);
-    if (it != barrel_cache_.end()) {
-        return it->second;
-    }
-    
-    // Limit cache size to prevent memory overflow (max 30 barrels in memory)
-    // 30 barrels * ~5MB each = ~150MB max
-    if (barrel_cache_.size() >= 30) {
-        // Simple eviction: clear oldest half
-        auto erase_it = barrel_cache_.begin();
-        std::advance(erase_it, 15);
-        barrel_cache_.erase(barrel_cache_.begin(), erase_it);
-    }
-    
-    std::string path = "data/processed/barrels/inverted_barrel_" + std::to_string(barrel_id) + ".json";
-    std::ifstream f(path);
-    
-    if (f.is_open()) {
-        json j;
-        f >> j;
-        barrel_cache_[barrel_id] = std::move(j);
-    } else {
-        std::cerr << "[Engine] WARNING: Could not load barrel " << barrel_id << "\n";
-        barrel_cache_[barrel_id] = json::object();
+bool SearchService::load_delta_index(IndexSnapshot& next) {
+    std::vector<DeltaDocument> documents;
+    DeltaLogCursor cursor = next.delta_cursor;
+    DeltaLog::ReplayResult replay = DeltaLog::replay(DELTA_LOG_PATH, cursor, documents);
+
+    if (!replay.ok) {
+        // No log yet: the server may predate it, read the old JSON delta
+        documents.clear();
+        if (!DeltaLog::load_legacy_json(BARRELS_DIR + "/inverted_delta.json", documents)) {
+            std::cout << "[Engine] No delta index found (this is normal for fresh builds)\n";
+        }
+        bool had_log = next.delta_cursor.log_id != 0;
+        next.delta = MemorySegment().with_documents(to_segment_documents(std::move(documents)), *next.lexicon);
+        next.delta_cursor = DeltaLogCursor{};
+        return had_log;
     }
-    
-    return barrel_cache_[barrel_id];
+
+    // Only the tail since the last reload is applied, on top of the previous
+    // segment (running searches keep reading the old one). Documents the
+    // segment already has - published before they reached the log, or flushed
+    // to an on-disk segment before the log was compacted - are skipped.
+    if (!replay.restarted && documents.empty()) return false;
+    size_t replayed = documents.size();
+    next.delta = next.delta->with_documents(to_segment_documents(std::move(documents)), *next.lexicon);
+
+    std::cout << "[Engine] Delta Index: replayed " << replayed << " documents"
+              << (replay.restarted ? " (full log)" : " (new tail)") << ", "
+              << next.delta->num_words() << " words\n";
+    next.delta_cursor = cursor;
+    return replay.restarted;
 }
 
-// Fast O(1) memory lookup for title frequency
-int SearchService::get_title_frequency(int doc_id, int word_id) {
-    auto doc_it = doc_stats_cache_.find(doc_id);
-    if (doc_it == doc_stats_cache_.end()) {
-        return 0;
-    }
-    
-    auto word_it = doc_it->second.title_frequencies.find(word_id);
-    if (word_it == doc_it->second.title_frequencies.end()) {
-        return 0;
+bool parse_search_mode(const std::string& name, SearchMode& mode) {
+    for (SearchMode candidate : {SearchMode::Lexical, SearchMode::Semantic, SearchMode::Hybrid}) {
+        if (name == search_mode_name(candidate)) {
+            mode = candidate;
+            return true;
+        }
     }
-    
-    return static_cast<int>(word_it->second);
+    return false;
 }
 
-// Fast O(1) memory lookup for document length
-int SearchService::get_document_length(int doc_id) {
-    auto it = doc_stats_cache_.find(doc_id);
-    if (it == doc_stats_cache_.end()) {
-        return 0;
+const char* search_mode_name(SearchMode mode) {
+    switch (mode) {
+        case SearchMode::Semantic: return "semantic";
+        case SearchMode::Hybrid: return "hybrid";
+        default: return "lexical";
     }
-    return it->second.doc_length;
 }
 
-std::string SearchService::search(std::string query) {
+std::string SearchService::search(std::string query, SearchMode mode, size_t nprobe) {
+    // Without document vectors there is only the lexical index to search
+    if (!semantic_search_enabled_) mode = SearchMode::Lexical;
+
     json response_json;
     response_json["query"] = query;
+    response_json["mode"] = search_mode_name(mode);
     response_json["results"] = json::array();
 
-    // 1. Clean and Split Query
-    std::string clean_query_str;
-    clean_query_str.reserve(query.size());
-    for(char c : query) {
-        if(std::isalnum(static_cast<unsigned char>(c))) {
-            clean_query_str += std::tolower(static_cast<unsigned char>(c));
-        } else {
-            clean_query_str += ' ';
+    // Everything below reads this snapshot only; reloads can't change it under us
+    std::shared_ptr<const IndexSnapshot> index = snapshot();
+
+    // 1. Parse the query: words, phrases, NEAR/k, OR, minus, groups, title:
+    ParsedQuery parsed = parse_query(query);
+    const std::vector<std::string>& query_words = parsed.words;
+    if (query_words.empty()) return response_json.dump();
+    std::vector<std::string> scoring_words = parsed.scoring_words();  // Excluded words aren't what the query is about
+
+    // Semantic mode: nearest documents by embedding similarity, no lexicon involved
+    if (mode == SearchMode::Semantic) {
+        std::vector<float> query_vec = semantic_scorer_.compute_query_vector(scoring_words);
+        std::vector<SearchResult> results;
+        for (const auto& match : semantic_scorer_.nearest(query_vec, MAX_RESULTS, nprobe)) {
+            results.push_back(make_result(*index, match.doc_id, match.similarity));
         }
+        append_results(response_json, results, *index);
+        return response_json.dump();
     }
 
-    std::vector<std::string> query_words = split_query(clean_query_str);
-    if (query_words.empty()) return response_json.dump();
+    // 2. Resolve query words. Words the lexicon never keeps (stopwords, short
+    // words, numbers) are ignored; any other word counts, so ANDing in a word
+    // no document has matches nothing.
+    std::vector<int> word_ids(query_words.size(), -1);
+    std::vector<bool> ignored(query_words.size(), false);
+    for (size_t i = 0; i < query_words.size(); ++i) {
+        word_ids[i] = index->get_word_index(query_words[i]);
+        ignored[i] = word_ids[i] == -1 && !index->lexicon->is_significant_word(query_words[i]);
+    }
 
-    // Pre-allocate with estimated size
-    std::unordered_map<int, double> doc_scores;
-    doc_scores.reserve(2000);
-    std::unordered_map<int, int> doc_match_count;
-    doc_match_count.reserve(2000);
-    std::unordered_map<int, std::map<int, std::vector<int>>> doc_positions_map;
+    // Plain conjunctions (words, phrases, NEARs) go through the block-max AND
+    // below; anything with OR, minus, groups or title: through a query plan
+    bool plain_conjunction = parsed.is_plain_conjunction();
+    bool lexical_possible = true;
+    if (plain_conjunction) {
+        // A phrase or NEAR with an unknown word can't match anywhere, even a stopword
+        bool any_word = false;
+        for (const auto& child : parsed.root.children) {
+            for (size_t i = child.first; i < child.first + child.count; ++i) {
+                if (word_ids[i] != -1) {
+                    any_word = true;
+                } else if (!ignored[i] || child.kind != QueryNode::Kind::Word) {
+                    lexical_possible = false;
+                }
+            }
+        }
+        lexical_possible = lexical_possible && any_word;
+    }
 
-    int valid_query_words = 0;
+    // (Hybrid queries can still find documents by embedding)
+    if (!lexical_possible && mode != SearchMode::Hybrid) return response_json.dump();
 
-    // 2. Process query words (sequential is faster for small queries due to overhead)
-    for (size_t i = 0; i < query_words.size(); ++i) {
-        std::string word = query_words[i];
-        int word_id = lexicon_trie_.get_word_index(word);
-
-        if (word_id != -1) {
-            valid_query_words++;
-            std::string id_str = std::to_string(word_id);
-            
-            int barrel_id = word_id % 100;
-            json& barrel = get_barrel(barrel_id);
-            
-            std::vector<DeltaEntry> combined_entries;
-            combined_entries.reserve(500);
-
-            // Combine main index and delta index
-            if (barrel.contains(id_str)) {
-                auto& raw = barrel[id_str];
-                combined_entries.reserve(raw.size());
-                for (auto& entry : raw) {
-                    if (entry.size() >= 3) {
-                        combined_entries.push_back({
-                            entry[0].get<int>(),
-                            entry[1].get<int>(),
-                            entry[2].get<std::vector<int>>()
-                        });
-                    }
-                }
+    // Adjacent query words that can earn the proximity bonus
+    std::vector<size_t> proximity_pairs;
+    for (size_t k = 0; k + 1 < query_words.size(); ++k) {
+        if (word_ids[k] != -1 && word_ids[k + 1] != -1 && !parsed.excluded[k] && !parsed.excluded[k + 1]) {
+            proximity_pairs.push_back(k);
+        }
+    }
+
+    // Positions of each query word in the document being scored, split by
+    // field; filled only for documents that matched
+    std::vector<positional::TermPositions> term_positions(query_words.size());
+    auto meets_constraints = [&]() {
+        for (const auto& child : parsed.root.children) {
+            const positional::TermPositions* terms = &term_positions[child.first];
+            if (child.kind == QueryNode::Kind::Phrase && !positional::phrase(terms, child.count)) return false;
+            if (child.kind == QueryNode::Kind::Near && !positional::near(terms[0], terms[1], child.distance)) return false;
+        }
+        return true;
+    };
+    auto add_proximity_bonus = [&](double score, const std::vector<bool>& present) {
+        for (size_t k : proximity_pairs) {
+            if (present[k] && present[k + 1] && positional::adjacent(term_positions[k], term_positions[k + 1])) {
+                score += PROXIMITY_BONUS;
             }
+        }
+        return score;
+    };
+    std::vector<int> title_frequencies(query_words.size(), 0);
+
+    // BM25F statistics of the postings being scored: a segment's are frozen in
+    // its barrels, the delta's are the served collection's
+    CollectionStats collection;
+    std::vector<float> idfs(query_words.size(), 0.0f);
+
+    TopKCollector top_k(semantic_search_enabled_ ? SEMANTIC_RERANK_DEPTH : MAX_RESULTS);
+
+    auto offer = [&](int doc_id, double score) {
+        const DocMetadata* meta = index->get_metadata(doc_id);
+        top_k.offer({
+            doc_id,
+            "",
+            score,
+            meta ? meta->publication_year : 0,
+            meta ? meta->cited_by_count : 0
+        });
+    };
+
+    // Query-plan evaluation over one segment's (or the delta's) postings.
+    // Every document the plan matches is scored on the non-excluded words it
+    // has, read through postings of their own.
+    query_plan::TitleFrequency plan_title_frequency = [&](int doc_id, size_t word) {
+        return index->get_doc_stats(doc_id).title_frequency(word_ids[word]);
+    };
+    auto evaluate_plan = [&](const query_plan::OpenSource& open_source) {
+        auto plan = query_plan::build_plan(parsed.root, ignored, open_source, plan_title_frequency);
+        if (!plan) return;
+
+        std::vector<std::unique_ptr<query_plan::TermSource>> scorers(query_words.size());
+        for (size_t i = 0; i < query_words.size(); ++i) {
+            if (word_ids[i] != -1 && !parsed.excluded[i]) scorers[i] = open_source(i);
+        }
 
-            if (delta_index_.count(word_id)) {
-                const auto& deltas = delta_index_[word_id];
-                combined_entries.insert(combined_entries.end(), deltas.begin(), deltas.end());
+        std::vector<bool> present(query_words.size(), false);
+        for (int doc_id = plan->next_geq(0); doc_id != query_plan::END; doc_id = plan->next_geq(doc_id + 1)) {
+            DocStatsRef doc_stats = index->get_doc_stats(doc_id);
+            StaticScore static_score = index->get_static_score(doc_id);
+            double total = 0.0;
+
+            for (size_t i = 0; i < query_words.size(); ++i) {
+                present[i] = false;
+                if (!scorers[i]) continue;
+                query_plan::TermSource& source = *scorers[i];
+                source.next_geq(doc_id);
+                if (source.doc() != doc_id) continue;  // One side of an OR
+
+                present[i] = true;
+                title_frequencies[i] = doc_stats.title_frequency(word_ids[i]);
+                term_positions[i] = positional::TermPositions::split(
+                    source.positions(), source.num_positions(), title_frequencies[i]);
+                total += ranking_scorer_.calculate_document_score(
+                    idfs[i],
+                    collection,
+                    title_frequencies[i],
+                    source.positions(),
+                    source.num_positions(),
+                    doc_stats.doc_length(),
+                    doc_stats.title_length(),
+                    static_score
+                ).final_score;
             }
 
-            // Process entries
-            for (auto& entry : combined_entries) {
-                int doc_id = entry.doc_id;
-                int weighted_freq = entry.frequency;
-                const std::vector<int>& positions = entry.positions;
+            total = add_proximity_bonus(total, present);
+            if (total >= top_k.threshold()) offer(doc_id, total);
+        }
+    };
+
+    // 3a. On-disk segments: DAAT over the compressed postings. Segments hold
+    // disjoint documents, so each is evaluated on its own; the shared top-k
+    // threshold carries over from one to the next.
+    for (const auto& segment : index->segments) {
+        std::vector<std::shared_ptr<const BinaryBarrel>> barrels;  // Keep mapped while cursors live
+
+        if (!plain_conjunction) {
+            evaluate_plan([&](size_t i) -> std::unique_ptr<query_plan::TermSource> {
+                if (word_ids[i] == -1) return nullptr;
+                auto barrel = segment->get(word_ids[i] % BarrelSet::NUM_BARRELS);
+                PostingListView postings;
+                if (!barrel || !barrel->find(word_ids[i], postings)) return nullptr;
+                barrels.push_back(barrel);
+                collection = barrel->collection();
+                idfs[i] = postings.idf;
+                return std::make_unique<query_plan::CursorSource>(postings);
+            });
+            continue;
+        }
+
+        // Plain conjunction: block-max pruned AND
+        std::vector<PostingCursor> cursors;
+        std::vector<size_t> cursor_of_word(query_words.size(), 0);
+        bool all_found = lexical_possible;
 
-                // OPTIMIZED: Memory lookups instead of disk I/O
-                int title_freq = get_title_frequency(doc_id, word_id);
-                int doc_len = get_document_length(doc_id);
-
-                ScoreComponents scores = ranking_scorer_.calculate_score(
-                    weighted_freq,
-                    title_freq,
-                    positions,
-                    doc_id,
-                    doc_len,
-                    &document_metadata_
-                );
-
-                doc_scores[doc_id] += scores.final_score;
-                doc_match_count[doc_id]++;
-                doc_positions_map[doc_id][static_cast<int>(i)] = positions;
+        for (size_t i = 0; i < query_words.size() && all_found; ++i) {
+            if (word_ids[i] == -1) continue;
+
+            auto barrel = segment->get(word_ids[i] % BarrelSet::NUM_BARRELS);
+            PostingListView postings;
+            if (!barrel || !barrel->find(word_ids[i], postings)) {
+                all_found = false;
+                break;
             }
+            barrels.push_back(barrel);
+            collection = barrel->collection();
+            idfs[i] = postings.idf;
+            cursor_of_word[i] = cursors.size();
+            cursors.emplace_back(postings);
         }
-    }
 
-    if (valid_query_words == 0) return response_json.dump();
-
-    // 3. Filter and Apply Proximity
-    std::vector<SearchResult> final_results;
-    final_results.reserve(std::min(static_cast<size_t>(500), doc_match_count.size()));
-
-    for (const auto& [doc_id, count] : doc_match_count) {
-        // Only include documents that match ALL query words
-        if (count == valid_query_words) {
-            double final_score = doc_scores[doc_id];
-
-            // Proximity bonus for adjacent words
-            for (int k = 0; k < static_cast<int>(query_words.size()) - 1; ++k) {
-                if (doc_positions_map[doc_id].count(k) && doc_positions_map[doc_id].count(k + 1)) {
-                    const auto& posA = doc_positions_map[doc_id][k];
-                    const auto& posB = doc_positions_map[doc_id][k + 1];
-
-                    bool found_adjacent = false;
-                    for (int a : posA) {
-                        for (int b : posB) {
-                            if (b == a + 1) {
-                                found_adjacent = true;
-                                break;
-                            }
-                        }
-                        if (found_adjacent) break;
-                    }
-                    if (found_adjacent) final_score += 100.0;
+        if (all_found) {
+            std::vector<bool> present(query_words.size());
+            for (size_t i = 0; i < query_words.size(); ++i) present[i] = word_ids[i] != -1;
+
+            auto score_doc = [&](int doc_id) {
+                // OPTIMIZED: Memory lookups instead of disk I/O
+                DocStatsRef doc_stats = index->get_doc_stats(doc_id);
+
+                // Positions are decoded only for documents that got this far
+                for (size_t i = 0; i < query_words.size(); ++i) {
+                    if (word_ids[i] == -1) continue;
+                    PostingCursor& cursor = cursors[cursor_of_word[i]];
+                    title_frequencies[i] = doc_stats.title_frequency(word_ids[i]);
+                    term_positions[i] = positional::TermPositions::split(
+                        cursor.positions(), cursor.num_positions(), title_frequencies[i]);
+                }
+                if (!meets_constraints()) return REJECTED;
+
+                int doc_len = doc_stats.doc_length();
+                int title_len = doc_stats.title_length();
+                StaticScore static_score = index->get_static_score(doc_id);
+                double total = 0.0;
+
+                for (size_t i = 0; i < query_words.size(); ++i) {
+                    if (word_ids[i] == -1) continue;
+                    PostingCursor& cursor = cursors[cursor_of_word[i]];
+
+                    total += ranking_scorer_.calculate_document_score(
+                        idfs[i],
+                        collection,
+                        title_frequencies[i],
+                        cursor.positions(),
+                        cursor.num_positions(),
+                        doc_len,
+                        title_len,
+                        static_score
+                    ).final_score;
                 }
-            }
 
-            std::string url = doc_url_mapper.get(doc_id);
-            int pub_year = document_metadata_.get_publication_year(doc_id);
-            int citations = document_metadata_.get_cited_by_count(doc_id);
+                // Proximity bonus for adjacent words
+                return add_proximity_bonus(total, present);
+            };
 
-            final_results.push_back({doc_id, url, final_score, pub_year, citations});
+            evaluate_conjunctive(cursors, proximity_pairs.size(), top_k, score_doc, offer);
         }
     }
 
+    // 3b. Delta index: few documents, so always a query plan; its lists are
+    // sorted by doc id and skipped through by galloping
+    if (lexical_possible) {
+        collection = index->collection_stats();
+        evaluate_plan([&](size_t i) -> std::unique_ptr<query_plan::TermSource> {
+            const std::vector<DeltaEntry>* entries = word_ids[i] == -1 ? nullptr : index->delta->postings(word_ids[i]);
+            if (!entries || entries->empty()) return nullptr;
+            idfs[i] = RankingScorer::inverse_document_frequency(index->document_frequency(word_ids[i]),
+                                                               collection.num_documents);
+            return std::make_unique<query_plan::DeltaSource>(*entries);
+        });
+    }
+
+    std::vector<SearchResult> final_results = top_k.take();
+    for (auto& result : final_results) {
+        result.url = index->get_url(result.doc_id);
+    }
+
     // After final_results is populated with initial search results
 
+// Hybrid: the nearest documents by embedding join the lexical candidates with
+// no lexical score. Lexical scores are unbounded (the proximity bonus alone is
+// 100), so they are min-max normalized first, putting both sides of the blend
+// below on the same 0..1 scale.
+std::vector<float> query_vec;
+if (mode == SearchMode::Hybrid) {
+    if (!final_results.empty()) {
+        auto [low_it, high_it] = std::minmax_element(final_results.begin(), final_results.end(),
+            [](const SearchResult& a, const SearchResult& b) { return a.score < b.score; });
+        double low = low_it->score;
+        double range = high_it->score - low;
+        for (auto& result : final_results) {
+            result.score = range > 0 ? (result.score - low) / range : 1.0;
+        }
+    }
+
+    std::unordered_set<int> candidate_set;
+    for (const auto& result : final_results) {
+        candidate_set.insert(result.doc_id);
+    }
+    query_vec = semantic_scorer_.compute_query_vector(scoring_words);
+    for (const auto& match : semantic_scorer_.nearest(query_vec, HYBRID_ANN_CANDIDATES, nprobe)) {
+        if (candidate_set.insert(match.doc_id).second) {
+            final_results.push_back(make_result(*index, match.doc_id, 0.0));
+        }
+    }
+}
+
 // 4. Apply semantic scoring if available
 if (semantic_search_enabled_ && !final_results.empty()) {
     std::cout << "[Engine] Computing semantic scores for " << final_results.size() << " documents\n";
     
-    // Get semantic scores for all results
-    std::vector<double> semantic_scores;
-    semantic_scores.reserve(final_results.size());
-    
+    // Get semantic scores for all results (query vector built once)
+    std::vector<int> candidate_ids;
+    candidate_ids.reserve(final_results.size());
     for (const auto& result : final_results) {
-        double sem_score = semantic_scorer_.compute_similarity(result.doc_id, query_words);
-        semantic_scores.push_back(sem_score);
+        candidate_ids.push_back(result.doc_id);
+    }
+    if (query_vec.empty()) query_vec = semantic_scorer_.compute_query_vector(scoring_words);
+    std::vector<double> semantic_scores(final_results.size());
+    semantic_scorer_.compute_similarities(query_vec, candidate_ids.data(), candidate_ids.size(),
+                                          semantic_scores.data());
+
+    // Quantized document vectors: their scores pick the likely final results,
+    // which are then re-scored against the float32 vectors
+    if (semantic_scorer_.has_exact_vectors() && final_results.size() > 0) {
+        auto [approx_min, approx_max] = std::minmax_element(semantic_scores.begin(), semantic_scores.end());
+        double approx_low = *approx_min;
+        double approx_range = *approx_max - approx_low;
+        std::vector<std::pair<double, size_t>> provisional;
+        provisional.reserve(final_results.size());
+        for (size_t i = 0; i < final_results.size(); i++) {
+            double normalized = approx_range > 0 ? (semantic_scores[i] - approx_low) / approx_range : 0.0;
+            provisional.emplace_back(0.6 * final_results[i].score + 0.4 * normalized, i);
+        }
+        size_t depth = std::min(SEMANTIC_EXACT_RESCORE_DEPTH, provisional.size());
+        std::nth_element(provisional.begin(), provisional.begin() + (depth - 1), provisional.end(),
+                         [](const auto& a, const auto& b) { return a.first > b.first; });
+
+        std::vector<int> rescore_ids(depth);
+        std::vector<double> exact_scores(depth);
+        for (size_t r = 0; r < depth; r++) {
+            rescore_ids[r] = candidate_ids[provisional[r].second];
+        }
+        semantic_scorer_.rescore_exact(query_vec, rescore_ids.data(), depth, exact_scores.data());
+        for (size_t r = 0; r < depth; r++) {
+            semantic_scores[provisional[r].second] = exact_scores[r];
+        }
     }
     
     // Find min and max for normalization
@@ -492,35 +857,8 @@ if (semantic_search_enabled_ && !final_results.empty()) {
     }
 }
 
-// 4. Partial sort for top 50 (faster than full sort)
-if (final_results.size() > 50) {
-    std::partial_sort(final_results.begin(), final_results.begin() + 50, 
-                     final_results.end(), compareResults);
-    final_results.resize(50);
-} else {
-    std::sort(final_results.begin(), final_results.end(), compareResults);
-}
-
 // 5. Build JSON response
-for (const auto& res : final_results) {
-    json item;
-    item["docId"] = res.doc_id;
-    item["score"] = res.score;
-    item["url"] = res.url;
-    
-    // Add title from metadata
-    const DocMetadata* meta = document_metadata_.get_metadata(res.doc_id);
-    if (meta && !meta->title.empty()) {
-        item["title"] = meta->title;
-    } else {
-        item["title"] = "Document #" + std::to_string(res.doc_id);
-    }
-    
-    if (res.publication_year > 0) item["publication_year"] = res.publication_year;
-    if (res.cited_by_count > 0) item["cited_by_count"] = res.cited_by_count;
-    
-    response_json["results"].push_back(item);
-}
+append_results(response_json, final_results, *index);
     
 return response_json.dump();
 }
@@ -542,7 +880,7 @@ std::string SearchService::autocomplete(const std::string& prefix, int limit) {
         }
     }
     
-    std::vector<std::string> suggestions = lexicon_trie_.autocomplete(clean_prefix, limit);
+    std::vector<std::string> suggestions = snapshot()->autocomplete(clean_prefix, limit);
     
     for (const auto& suggestion : suggestions) {
         response_json["suggestions"].push_back(suggestion);
@@ -551,98 +889,116 @@ std::string SearchService::autocomplete(const std::string& prefix, int limit) {
     return response_json.dump();
 }
 
-void SearchService::reload_delta_index() {
-    std::cout << "[Engine] Reloading delta index..." << std::endl;
+std::shared_ptr<const DocStatsStore> SearchService::with_recent_documents(
+        std::shared_ptr<const DocStatsStore> doc_stats) {
+    // Fast approach: Read ONLY the last 100 lines (recent uploads)
+    std::ifstream f(FORWARD_INDEX_PATH);
+    if (!f.is_open()) return doc_stats;
+
+    // Get to end and count lines
+    f.seekg(0, std::ios::end);
+    std::streampos file_size = f.tellg();
+    
+    // Read last chunk (max 500KB for ~100 docs)
+    std::streamoff chunk_size = 500000;
+    std::streampos start_pos = (file_size > chunk_size) ? file_size - chunk_size : std::streampos(0);
+    f.seekg(start_pos);
+    
+    // Skip partial line if we didn't start at beginning
+    if (start_pos > std::streampos(0)) {
+        std::string dummy;
+        std::getline(f, dummy);
+    }
     
-    // CRITICAL: Clear both delta index AND barrel cache
-    std::cout << "[Engine] Clearing delta index (" << delta_index_.size() << " words)..." << std::endl;
-    delta_index_.clear();
+    std::string line;
+    line.reserve(4096);
+    DocStatsStore::Builder documents;
     
-    std::cout << "[Engine] Clearing barrel cache (" << barrel_cache_.size() << " barrels)..." << std::endl;
-    barrel_cache_.clear();
+    while (std::getline(f, line)) {
+        if (line.empty()) continue;
+        add_forward_index_stats(line, documents);
+    }
     
-    load_delta_index();
-    std::cout << "[Engine] ✅ Delta index reloaded: " << delta_index_.size() << " words" << std::endl;
+    // A new store with the documents it lacks; the old one stays untouched
+    // for running searches
+    std::shared_ptr<const DocStatsStore> next = doc_stats->with_documents(std::move(documents));
+    std::cout << "[Engine] ⚡ Added " << next->size() - doc_stats->size()
+              << " new documents (total: " << next->size() << ")" << std::endl;
+    return next;
 }
 
-void SearchService::reload_metadata() {
-    std::cout << "[Engine] Reloading metadata..." << std::endl;
-    document_metadata_.load("data/processed/document_metadata.json");
-    std::cout << "[Engine] Metadata reloaded: " << document_metadata_.size() << " documents" << std::endl;
-    
-    // Also reload URL mapper
-    std::cout << "[Engine] Reloading URL mapper..." << std::endl;
-    doc_url_mapper.load("data/processed/docid_to_url.json");
-    std::cout << "[Engine] URL mapper reloaded" << std::endl;
-    
-    // CRITICAL: Reload lexicon to pick up new words from uploaded docs
-    std::cout << "[Engine] Reloading lexicon..." << std::endl;
-    lexicon_trie_.load_from_json("data/processed/lexicon.json");
-    std::cout << "[Engine] Lexicon reloaded: " << lexicon_trie_.size() << " words" << std::endl;
-    
-    // CRITICAL: Incrementally update doc stats cache for NEW documents only
-    std::cout << "[Engine] Checking for new documents..." << std::endl;
-    
-    // Fast approach: Read ONLY the last 100 lines (recent uploads)
-    std::ifstream f("data/processed/forward_index.jsonl");
-    if (f.is_open()) {
-        // Get to end and count lines
-        f.seekg(0, std::ios::end);
-        std::streampos file_size = f.tellg();
-        
-        // Read last chunk (max 500KB for ~100 docs)
-        std::streamoff chunk_size = 500000;
-        std::streampos start_pos = (file_size > chunk_size) ? file_size - chunk_size : std::streampos(0);
-        f.seekg(start_pos);
-        
-        // Skip partial line if we didn't start at beginning
-        if (start_pos > std::streampos(0)) {
-            std::string dummy;
-            std::getline(f, dummy);
-        }
-        
-        std::string line;
-        line.reserve(4096);
-        int added = 0;
-        
-        while (std::getline(f, line)) {
-            if (line.empty()) continue;
-            
-            try {
-                json doc_line = json::parse(line);
-                if (!doc_line.contains("doc_id") || !doc_line.contains("data")) continue;
-                
-                int doc_id = std::stoi(doc_line["doc_id"].get<std::string>());
-                
-                // Only add if not in cache
-                if (doc_stats_cache_.find(doc_id) == doc_stats_cache_.end()) {
-                    json& data = doc_line["data"];
-                    DocStats stats;
-                    stats.doc_length = data.value("doc_length", 0);
-                    
-                    if (data.contains("words")) {
-                        for (auto& word_item : data["words"].items()) {
-                            int word_id = std::stoi(word_item.key());
-                            json& word_stats = word_item.value();
-                            
-                            if (word_stats.contains("title_frequency")) {
-                                int title_freq = word_stats["title_frequency"].get<int>();
-                                if (title_freq > 0) {
-                                    stats.title_frequencies[word_id] = title_freq;
-                                }
-                            }
-                        }
-                    }
-                    
-                    doc_stats_cache_[doc_id] = std::move(stats);
-                    added++;
-                }
-            } catch (const std::exception&) {
-                continue;
-            }
+void SearchService::load_segments(IndexSnapshot& next, const SegmentManifest& manifest) {
+    std::vector<std::shared_ptr<const BarrelSet>> segments;
+    for (const auto& info : manifest.segments) {
+        std::string dir = BARRELS_DIR + "/" + info.dir;
+
+        // Unchanged segments keep their barrel set, and with it the cached barrels
+        auto same = std::find_if(next.segments.begin(), next.segments.end(),
+                                 [&](const auto& s) { return s->dir() == dir; });
+        segments.push_back(same != next.segments.end() ? *same
+                                                       : std::make_shared<BarrelSet>(dir, barrel_cache_));
+    }
+    next.segments = std::move(segments);
+}
+
+void SearchService::publish_segments(const SegmentManifest& manifest, const std::unordered_set<int>& flushed_doc_ids,
+                                     const std::vector<std::string>& merged_dirs) {
+    std::lock_guard<std::mutex> lock(reload_mutex_);
+    auto next = std::make_shared<IndexSnapshot>(*snapshot());
+
+    // Merged-away segments: files go when the last snapshot using them does,
+    // or now if no snapshot ever did
+    for (const auto& dir : merged_dirs) {
+        auto served = std::find_if(next->segments.begin(), next->segments.end(),
+                                   [&](const auto& s) { return s->dir() == dir; });
+        if (served != next->segments.end()) {
+            (*served)->retire();
+        } else {
+            BarrelSet::remove_files(dir);
         }
-        
-        std::cout << "[Engine] ⚡ Added " << added << " new documents (total: " 
-                  << doc_stats_cache_.size() << ")" << std::endl;
     }
+    load_segments(*next, manifest);
+    if (!flushed_doc_ids.empty()) {
+        next->delta = next->delta->without_postings(flushed_doc_ids);
+    }
+    next->generation++;
+    publish(next);
 }
+
+BarrelScoring SearchService::barrel_scoring() const {
+    std::shared_ptr<const IndexSnapshot> index = snapshot();
+    BarrelScoring scoring;
+    scoring.collection = index->collection_stats();
+    uint32_t num_documents = scoring.collection.num_documents;
+    scoring.idf = [index, num_documents](int word_id, uint32_t num_postings) {
+        uint32_t df = std::max(index->document_frequency(word_id), num_postings);
+        return RankingScorer::inverse_document_frequency(df, num_documents);
+    };
+    scoring.score = [this, index](int word_id, float idf, const CollectionStats& collection,
+                                  const InvertedEntry& entry) {
+        DocStatsRef stats = index->get_doc_stats(entry.doc_id);
+        return ranking_scorer_.calculate_document_score(
+            idf,
+            collection,
+            stats.title_frequency(word_id),
+            entry.positions.data(),
+            entry.positions.size(),
+            stats.doc_length(),
+            stats.title_length(),
+            index->get_static_score(entry.doc_id)
+        ).final_score;
+    };
+    return scoring;
+}
+
+void SearchService::add_documents(std::vector<SegmentDocument> documents) {
+    std::lock_guard<std::mutex> lock(reload_mutex_);
+    auto next = std::make_shared<IndexSnapshot>(*snapshot());
+    for (auto& doc : documents) {
+        if (doc.has_metadata) doc.static_score = ranking_scorer_.static_score(&doc.metadata);
+    }
+    next->delta = next->delta->with_documents(std::move(documents), *next->lexicon);
+    next->generation++;
+    publish(next);
+}
+
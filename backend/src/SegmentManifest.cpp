@@ -0,0 +1,79 @@
+#include "SegmentManifest.hpp"
+#include "json.hpp"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+std::string SegmentManifest::path(const std::string& barrels_dir) {
+    return barrels_dir + "/segments.json";
+}
+
+bool SegmentManifest::load(const std::string& barrels_dir, SegmentManifest& manifest) {
+    manifest = SegmentManifest();
+    bool ok = true;
+
+    std::ifstream in(path(barrels_dir));
+    if (in.is_open()) {
+        try {
+            json j;
+            in >> j;
+            manifest.next_segment_id = j.at("next_segment_id").get<uint64_t>();
+            manifest.flushed.log_id = j.at("flushed").at("log_id").get<uint64_t>();
+            manifest.flushed.offset = j.at("flushed").at("offset").get<uint64_t>();
+            for (const auto& s : j.at("segments")) {
+                manifest.segments.push_back({s.at("dir").get<std::string>(), s.value("bytes", uint64_t{0})});
+            }
+            return true;
+        } catch (const std::exception& e) {
+            std::cerr << "[Segments] Invalid " << path(barrels_dir) << ": " << e.what()
+                      << ", using the base barrels only\n";
+            manifest = SegmentManifest();
+            ok = false;
+        }
+    }
+
+    // Before the first flush the index is just the base build
+    SegmentInfo base{".", 0};
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(barrels_dir, ec)) {
+        if (entry.path().extension() == ".bin") base.bytes += entry.file_size(ec);
+    }
+    manifest.segments.push_back(base);
+    return ok;
+}
+
+bool SegmentManifest::save(const std::string& barrels_dir) const {
+    json j;
+    j["version"] = 1;
+    j["next_segment_id"] = next_segment_id;
+    j["flushed"] = {{"log_id", flushed.log_id}, {"offset", flushed.offset}};
+    j["segments"] = json::array();
+    for (const auto& segment : segments) {
+        j["segments"].push_back({{"dir", segment.dir}, {"bytes", segment.bytes}});
+    }
+
+    std::string final_path = path(barrels_dir);
+    std::string temp_path = final_path + ".tmp";
+    std::ofstream out(temp_path, std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "[Segments] Could not open " << temp_path << " for writing\n";
+        return false;
+    }
+    out << j.dump(2);
+    out.flush();
+    if (!out.good()) {
+        std::cerr << "[Segments] Write failed for " << temp_path << "\n";
+        return false;
+    }
+    out.close();
+
+    if (std::rename(temp_path.c_str(), final_path.c_str()) != 0) {
+        std::cerr << "[Segments] Could not rename " << temp_path << "\n";
+        return false;
+    }
+    return true;
+}
@@ -1,4 +1,5 @@
 #include "../include/SemanticScorer.hpp"
+#include "VectorKernels.hpp"
 #include <iostream>
 #include <algorithm>
 #include <cmath>
@@ -9,86 +10,68 @@ SemanticScorer::SemanticScorer() : vectors_loaded_(false), embeddings_loaded_(fa
 SemanticScorer::~SemanticScorer() {}
 
 bool SemanticScorer::load_document_vectors(const std::string& doc_vectors_path) {
-    std::ifstream file(doc_vectors_path, std::ios::binary);
-    if (!file.is_open()) {
-        std::cerr << "[SemanticScorer] Could not open document vectors file: " << doc_vectors_path << "\n";
-        return false;
-    }
-
-    int num_docs;
-    file.read(reinterpret_cast<char*>(&num_docs), sizeof(int));
-
-    document_vectors_.clear();
-    document_vectors_.reserve(num_docs);
-
-    for (int i = 0; i < num_docs; ++i) {
-        int doc_id;
-        file.read(reinterpret_cast<char*>(&doc_id), sizeof(int));
-
-        std::vector<float> vector(EMBEDDING_DIM);
-        file.read(reinterpret_cast<char*>(vector.data()), EMBEDDING_DIM * sizeof(float));
-
-        if (file.good()) {
-            document_vectors_[doc_id] = std::move(vector);
-        } else {
-            break;
-        }
-    }
-
-    vectors_loaded_ = (document_vectors_.size() > 0);
+    vectors_loaded_ = document_vectors_.load(doc_vectors_path, EMBEDDING_DIM);
     if (vectors_loaded_) {
-        std::cout << "[SemanticScorer] Loaded " << document_vectors_.size() << " document vectors\n";
+        std::cout << "[SemanticScorer] Loaded " << document_vectors_.num_documents() << " document vectors ("
+                  << vector_format::encoding_name(document_vectors_.encoding()) << ", "
+                  << (document_vectors_.is_mapped() ? "mapped" : "read") << ", "
+                  << document_vectors_.data_bytes() / (1024 * 1024) << " MB, "
+                  << vector_kernels::isa_name(vector_kernels::active_isa()) << " kernels)\n";
     }
     return vectors_loaded_;
 }
 
-bool SemanticScorer::load_word_embeddings(const std::string& word_embeddings_path) {
-    std::ifstream file(word_embeddings_path, std::ios::binary);
-    if (!file.is_open()) {
-        std::cerr << "[SemanticScorer] Could not open word embeddings file: " << word_embeddings_path << "\n";
+bool SemanticScorer::load_exact_vectors(const std::string& doc_vectors_path) {
+    if (!exact_vectors_.load(doc_vectors_path, EMBEDDING_DIM)) {
         return false;
     }
+    if (exact_vectors_.encoding() != vector_format::Encoding::Float32) {
+        std::cerr << "[SemanticScorer] " << doc_vectors_path << " is "
+                  << vector_format::encoding_name(exact_vectors_.encoding())
+                  << ", not float32; exact re-scoring disabled\n";
+        exact_vectors_.close();
+        return false;
+    }
+    std::cout << "[SemanticScorer] Exact re-scoring against " << doc_vectors_path << "\n";
+    return true;
+}
 
-    int num_words;
-    file.read(reinterpret_cast<char*>(&num_words), sizeof(int));
-
-    word_embeddings_.clear();
-    word_embeddings_.reserve(num_words);
-
-    for (int i = 0; i < num_words; ++i) {
-        int word_len;
-        file.read(reinterpret_cast<char*>(&word_len), sizeof(int));
-
-        std::string word(word_len, '\0');
-        file.read(&word[0], word_len);
-
-        std::vector<float> vector(EMBEDDING_DIM);
-        file.read(reinterpret_cast<char*>(vector.data()), EMBEDDING_DIM * sizeof(float));
+bool SemanticScorer::load_ann_index(const std::string& hnsw_path) {
+    if (!vectors_loaded_ || !ann_index_.load(hnsw_path, document_vectors_)) {
+        return false;
+    }
+    std::cout << "[SemanticScorer] Loaded HNSW graph with " << ann_index_.num_nodes() << " documents ("
+              << ann_index_.max_level() + 1 << " levels)\n";
+    return true;
+}
 
-        if (file.good()) {
-            // Normalize word embedding
-            normalize_vector(vector);
-            word_embeddings_[word] = std::move(vector);
-        } else {
-            break;
-        }
+bool SemanticScorer::load_ivfpq_index(const std::string& ivfpq_path) {
+    if (!ivfpq_index_.load(ivfpq_path, EMBEDDING_DIM)) {
+        return false;
     }
+    std::cout << "[SemanticScorer] Loaded IVF-PQ index with " << ivfpq_index_.num_documents() << " documents ("
+              << ivfpq_index_.num_lists() << " lists, " << ivfpq_index_.num_subspaces() << " subspaces, "
+              << ivfpq_index_.data_bytes() / (1024 * 1024) << " MB)\n";
+    return true;
+}
 
-    embeddings_loaded_ = (word_embeddings_.size() > 0);
+bool SemanticScorer::load_word_embeddings(const std::string& word_embeddings_path) {
+    embeddings_loaded_ = word_embeddings_.load(word_embeddings_path, EMBEDDING_DIM);
     if (embeddings_loaded_) {
-        std::cout << "[SemanticScorer] Loaded " << word_embeddings_.size() << " word embeddings\n";
+        std::cout << "[SemanticScorer] Loaded " << word_embeddings_.size() << " word embeddings ("
+                  << vector_format::encoding_name(word_embeddings_.encoding()) << ", "
+                  << word_embeddings_.data_bytes() / (1024 * 1024) << " MB)\n";
     }
     return embeddings_loaded_;
 }
 
 std::vector<float> SemanticScorer::compute_query_vector(const std::vector<std::string>& query_words) const {
     std::vector<float> query_vec(EMBEDDING_DIM, 0.0f);
+    float word_vec[EMBEDDING_DIM];
     int valid_words = 0;
 
     for (const auto& word : query_words) {
-        auto it = word_embeddings_.find(word);
-        if (it != word_embeddings_.end()) {
-            const auto& word_vec = it->second;
+        if (word_embeddings_.lookup(word, word_vec)) {
             for (int i = 0; i < EMBEDDING_DIM; ++i) {
                 query_vec[i] += word_vec[i];
             }
@@ -97,7 +80,7 @@ std::vector<float> SemanticScorer::compute_query_vector(const std::vector<std::s
     }
 
     if (valid_words == 0) {
-        return std::vector<float>(EMBEDDING_DIM, 0.0f);
+        return {};
     }
 
     // Average
@@ -110,62 +93,117 @@ std::vector<float> SemanticScorer::compute_query_vector(const std::vector<std::s
     return query_vec;
 }
 
-double SemanticScorer::compute_similarity(int doc_id, const std::vector<std::string>& query_words) const {
-    if (!is_loaded()) {
-        return 0.0;
+void SemanticScorer::compute_similarities(const std::vector<float>& query_vec,
+                                          const int* doc_ids, size_t count, double* scores) const {
+    if (!vectors_loaded_) {
+        score_estimated(query_vec, doc_ids, count, scores);
+        return;
     }
+    score_against(document_vectors_, query_vec, doc_ids, count, scores);
+}
 
-    auto doc_it = document_vectors_.find(doc_id);
-    if (doc_it == document_vectors_.end()) {
-        return 0.0;
+void SemanticScorer::rescore_exact(const std::vector<float>& query_vec,
+                                   const int* doc_ids, size_t count, double* scores) const {
+    if (!exact_vectors_.is_loaded()) {
+        compute_similarities(query_vec, doc_ids, count, scores);
+        return;
     }
+    score_against(exact_vectors_, query_vec, doc_ids, count, scores);
+}
 
-    std::vector<float> query_vec = compute_query_vector(query_words);
-    if (query_vec.empty() || std::all_of(query_vec.begin(), query_vec.end(), [](float x) { return x == 0.0f; })) {
-        return 0.0;
+void SemanticScorer::score_against(const DocumentVectors& vectors, const std::vector<float>& query_vec,
+                                   const int* doc_ids, size_t count, double* scores) const {
+    if (!is_loaded() || query_vec.size() != EMBEDDING_DIM) {
+        std::fill(scores, scores + count, 0.0);
+        return;
     }
 
-    return cosine_similarity(query_vec, doc_it->second);
+    for (size_t i = 0; i < count; ++i) {
+        int64_t row = vectors.row_index(doc_ids[i]);
+        scores[i] = row < 0 ? 0.0 : clamp_similarity(vectors.dot(query_vec.data(), static_cast<uint32_t>(row)));
+    }
 }
 
-double SemanticScorer::cosine_similarity(const std::vector<float>& a, const std::vector<float>& b) const {
-    if (a.size() != b.size() || a.size() != EMBEDDING_DIM) {
-        return 0.0;
+void SemanticScorer::score_estimated(const std::vector<float>& query_vec,
+                                     const int* doc_ids, size_t count, double* scores) const {
+    if (!is_loaded() || query_vec.size() != EMBEDDING_DIM) {
+        std::fill(scores, scores + count, 0.0);
+        return;
     }
 
-    double dot_product = 0.0;
-    double norm_a = 0.0;
-    double norm_b = 0.0;
-
-    for (int i = 0; i < EMBEDDING_DIM; ++i) {
-        dot_product += a[i] * b[i];
-        norm_a += a[i] * a[i];
-        norm_b += b[i] * b[i];
+    ivfpq_index_.score(query_vec.data(), doc_ids, count, scores);
+    for (size_t i = 0; i < count; ++i) {
+        scores[i] = clamp_similarity(scores[i]);
     }
+}
 
-    norm_a = std::sqrt(norm_a);
-    norm_b = std::sqrt(norm_b);
+std::vector<VectorMatch> SemanticScorer::nearest(const std::vector<float>& query_vec, size_t k, size_t nprobe) const {
+    if (!is_loaded() || query_vec.size() != EMBEDDING_DIM || k == 0) {
+        return {};
+    }
+
+    std::vector<VectorMatch> found;
+    if (ann_index_.is_loaded()) {
+        found = ann_index_.search(document_vectors_, query_vec.data(), k, std::max(k, ANN_EF_SEARCH));
+    } else if (ivfpq_index_.is_loaded()) {
+        // A longer shortlist when there are vectors to re-score it against
+        IvfPqIndex::SearchOptions options(static_cast<uint32_t>(nprobe > 0 ? nprobe : IVFPQ_NPROBE));
+        found = ivfpq_index_.search(query_vec.data(), vectors_loaded_ ? k * ANN_RESCORE_FACTOR : k, options);
+    } else {
+        found = scan_nearest(query_vec.data(), k);
+    }
+
+    // Same scale as compute_similarities(), and exact when the graph was
+    // walked over quantized vectors
+    std::vector<int> doc_ids(found.size());
+    std::vector<double> scores(found.size());
+    for (size_t i = 0; i < found.size(); ++i) {
+        doc_ids[i] = found[i].doc_id;
+    }
+    rescore_exact(query_vec, doc_ids.data(), doc_ids.size(), scores.data());
+    for (size_t i = 0; i < found.size(); ++i) {
+        found[i].similarity = scores[i];
+    }
+    // Unrelated (similarity clamped to 0) documents aren't matches
+    found.erase(std::remove_if(found.begin(), found.end(),
+                               [](const VectorMatch& n) { return n.similarity <= 0.0; }),
+                found.end());
+    std::stable_sort(found.begin(), found.end(), [](const VectorMatch& a, const VectorMatch& b) {
+        return a.similarity > b.similarity;
+    });
+    if (found.size() > k) found.resize(k);
+    return found;
+}
 
-    if (norm_a == 0.0 || norm_b == 0.0) {
-        return 0.0;
+std::vector<VectorMatch> SemanticScorer::scan_nearest(const float* query, size_t k) const {
+    std::vector<VectorMatch> best;
+    best.reserve(k + 1);
+    auto worse = [](const VectorMatch& a, const VectorMatch& b) {
+        return a.similarity > b.similarity;
+    };
+
+    // Min-heap of the best k so far
+    for (int32_t doc_id = 0; doc_id <= document_vectors_.max_doc_id(); ++doc_id) {
+        int64_t row = document_vectors_.row_index(doc_id);
+        if (row < 0) continue;
+        double similarity = document_vectors_.dot(query, static_cast<uint32_t>(row));
+        if (similarity <= 0.0 || (best.size() == k && similarity <= best.front().similarity)) continue;
+        best.push_back({doc_id, similarity});
+        std::push_heap(best.begin(), best.end(), worse);
+        if (best.size() > k) {
+            std::pop_heap(best.begin(), best.end(), worse);
+            best.pop_back();
+        }
     }
+    std::sort_heap(best.begin(), best.end(), worse);
+    return best;
+}
 
-    double similarity = dot_product / (norm_a * norm_b);
-    // Clamp to [0, 1] (cosine similarity is [-1, 1], but normalized vectors give [0, 1])
-    return std::max(0.0, std::min(1.0, similarity));
+double SemanticScorer::clamp_similarity(double dot_product) {
+    // Clamp to [0, 1] (cosine similarity is [-1, 1], negatives count as unrelated)
+    return std::max(0.0, std::min(1.0, dot_product));
 }
 
 void SemanticScorer::normalize_vector(std::vector<float>& vec) const {
-    double norm = 0.0;
-    for (float x : vec) {
-        norm += x * x;
-    }
-    norm = std::sqrt(norm);
-
-    if (norm > 0.0) {
-        for (float& x : vec) {
-            x /= norm;
-        }
-    }
+    vector_kernels::normalize(vec.data(), vec.size());
 }
-
@@ -0,0 +1,17 @@
+#include "StaticScores.hpp"
+#include <algorithm>
+
+std::shared_ptr<const StaticScores> StaticScores::build(const DocumentMetadata& metadata,
+                                                        const RankingScorer& scorer) {
+    auto scores = std::make_shared<StaticScores>();
+    scores->missing_ = scorer.static_score(nullptr);
+
+    int max_doc_id = -1;
+    metadata.for_each([&](const DocMetadata& meta) { max_doc_id = std::max(max_doc_id, meta.doc_id); });
+    scores->scores_.assign(static_cast<size_t>(max_doc_id + 1), scores->missing_);
+
+    metadata.for_each([&](const DocMetadata& meta) {
+        if (meta.doc_id >= 0) scores->scores_[meta.doc_id] = scorer.static_score(&meta);
+    });
+    return scores;
+}
@@ -0,0 +1,516 @@
+#include "TokenizerWorkerPool.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+
+#ifdef _WIN32
+#include <cstdlib>
+#include <fstream>
+#include "json.hpp"
+#else
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char** environ;
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr size_t NO_WORKER = std::numeric_limits<size_t>::max();
+constexpr std::chrono::seconds PING_TIMEOUT{5};
+
+std::string default_python() {
+#ifdef _WIN32
+    return fs::exists("venv/Scripts/python.exe") ? "venv\\Scripts\\python.exe" : "python";
+#else
+    return fs::exists("venv/bin/python") ? "venv/bin/python" : "python3";
+#endif
+}
+
+void append_u32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) out += static_cast<char>((value >> (8 * i)) & 0xFF);
+}
+
+// Bounds-checked reads of a response payload
+struct FrameReader {
+    const std::string& data;
+    size_t pos = 0;
+    bool ok = true;
+
+    uint32_t uint(size_t bytes) {
+        if (data.size() - pos < bytes) {
+            ok = false;
+            return 0;
+        }
+        uint32_t value = 0;
+        for (size_t i = 0; i < bytes; ++i) {
+            value |= static_cast<uint32_t>(static_cast<uint8_t>(data[pos + i])) << (8 * i);
+        }
+        pos += bytes;
+        return value;
+    }
+
+    std::string string(size_t length) {
+        if (data.size() - pos < length) {
+            ok = false;
+            return {};
+        }
+        std::string value = data.substr(pos, length);
+        pos += length;
+        return value;
+    }
+};
+
+// False on a malformed payload (protocol_ok cleared) or an error status
+bool decode_tokenize_response(const std::string& payload, TokenizerWorkerPool::Result& out,
+                              std::string& error, bool& protocol_ok) {
+    using namespace tokenizer_protocol;
+    FrameReader reader{payload};
+    uint8_t status = static_cast<uint8_t>(reader.uint(1));
+    protocol_ok = true;
+
+    if (reader.ok && status == STATUS_ERROR) {
+        error = reader.string(reader.uint(4));
+        if (reader.ok) return false;
+    } else if (reader.ok && status == STATUS_OK) {
+        out.title = reader.string(reader.uint(4));
+        uint32_t count = reader.uint(4);
+        out.tokens.clear();
+        out.tokens.reserve(std::min<uint32_t>(count, 1 << 16));
+        for (uint32_t i = 0; i < count && reader.ok; ++i) {
+            out.tokens.push_back(reader.string(reader.uint(2)));
+        }
+        if (reader.ok && reader.pos == payload.size()) return true;
+    }
+
+    protocol_ok = false;
+    error = "malformed response from tokenizer worker";
+    return false;
+}
+
+#ifndef _WIN32
+bool make_pipe(int fds[2]) {
+#ifdef __linux__
+    return pipe2(fds, O_CLOEXEC) == 0;
+#else
+    if (pipe(fds) != 0) return false;
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+#endif
+}
+
+bool write_all(int fd, const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        written += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool read_exact(int fd, char* out, size_t size, std::chrono::steady_clock::time_point deadline,
+                std::string& error) {
+    size_t done = 0;
+    while (done < size) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0) {
+            error = "timed out";
+            return false;
+        }
+
+        pollfd pfd{fd, POLLIN, 0};
+        int ready = ::poll(&pfd, 1, static_cast<int>(std::min<long long>(left, 1000 * 1000)));
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready < 0) {
+            error = std::string("poll failed: ") + std::strerror(errno);
+            return false;
+        }
+        if (ready == 0) continue;
+
+        ssize_t n = ::read(fd, out + done, size - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            error = "worker exited";
+            return false;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+#endif
+
+} // namespace
+
+TokenizerWorkerPool::TokenizerWorkerPool() : TokenizerWorkerPool(Options()) {}
+
+TokenizerWorkerPool::TokenizerWorkerPool(Options options) : options_(std::move(options)) {
+    if (options_.python_exe.empty()) options_.python_exe = default_python();
+    options_.num_workers = std::max<size_t>(1, options_.num_workers);
+    workers_.resize(options_.num_workers);
+    stats_.workers.resize(options_.num_workers);
+
+#ifndef _WIN32
+    // A worker dying between requests must not take the server down with SIGPIPE
+    std::signal(SIGPIPE, SIG_IGN);
+    monitor_ = std::thread(&TokenizerWorkerPool::monitor_thread, this);
+#endif
+}
+
+TokenizerWorkerPool::~TokenizerWorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        shutdown_ = true;
+    }
+    cv_.notify_all();
+    if (monitor_.joinable()) {
+        monitor_.join();
+    }
+    for (auto& worker : workers_) {
+        stop_worker(worker, true);
+    }
+}
+
+TokenizerWorkerPool::Stats TokenizerWorkerPool::get_stats() const {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return stats_;
+}
+
+bool TokenizerWorkerPool::tokenize(const std::string& pdf_path, Result& out, std::string& error) {
+#ifdef _WIN32
+    auto start = std::chrono::steady_clock::now();
+    bool ok = run_script_once(pdf_path, out, error);
+    record(0, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), ok);
+    return ok;
+#else
+    size_t index = acquire();
+    if (index == NO_WORKER) {
+        error = "tokenizer workers are shutting down";
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Worker& worker = workers_[index];
+    std::string request(1, static_cast<char>(tokenizer_protocol::OP_TOKENIZE));
+    append_u32(request, static_cast<uint32_t>(pdf_path.size()));
+    request += pdf_path;
+
+    bool ok = false;
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        if (worker.pid < 0 && !start_worker(index, error)) break;
+
+        std::string response;
+        CallResult result = call(worker, request, response, options_.request_timeout, error);
+        if (result == CallResult::Ok) {
+            bool protocol_ok = true;
+            ok = decode_tokenize_response(response, out, error, protocol_ok);
+            if (!protocol_ok) replace_worker(index);
+            break;
+        }
+
+        // Dead or hung: replace it. Only retry when the request never got
+        // there - a PDF that crashed one worker would crash the next one too.
+        std::cerr << "[TokenizerWorkers] Worker " << worker.pid << " failed on " << pdf_path
+                  << " (" << error << "), restarting it\n";
+        replace_worker(index);
+        if (result != CallResult::SendFailed) break;
+    }
+
+    record(index, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), ok);
+    release(index);
+    return ok;
+#endif
+}
+
+size_t TokenizerWorkerPool::acquire() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return shutdown_ || !idle_.empty(); });
+    if (shutdown_) return NO_WORKER;
+    size_t index = idle_.back();
+    idle_.pop_back();
+    return index;
+}
+
+void TokenizerWorkerPool::release(size_t index) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        idle_.push_back(index);
+    }
+    // The monitor waits on the same condition variable
+    cv_.notify_all();
+}
+
+void TokenizerWorkerPool::record(size_t index, double latency_ms, bool ok) {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    WorkerStats& worker = stats_.workers[index];
+    worker.avg_latency_ms = (worker.avg_latency_ms * worker.requests + latency_ms) / (worker.requests + 1);
+    worker.requests++;
+    worker.last_latency_ms = latency_ms;
+    worker.max_latency_ms = std::max(worker.max_latency_ms, latency_ms);
+    stats_.requests++;
+    if (!ok) {
+        worker.failures++;
+        stats_.failures++;
+    }
+}
+
+#ifdef _WIN32
+
+bool TokenizerWorkerPool::start_worker(size_t, std::string& error) {
+    error = "tokenizer workers are not supported on Windows";
+    return false;
+}
+
+void TokenizerWorkerPool::stop_worker(Worker&, bool) {}
+
+void TokenizerWorkerPool::replace_worker(size_t) {}
+
+TokenizerWorkerPool::CallResult TokenizerWorkerPool::call(Worker&, const std::string&, std::string&,
+                                                          std::chrono::steady_clock::duration,
+                                                          std::string& error) {
+    error = "tokenizer workers are not supported on Windows";
+    return CallResult::SendFailed;
+}
+
+bool TokenizerWorkerPool::ping(Worker&, std::chrono::steady_clock::duration, std::string& error) {
+    error = "tokenizer workers are not supported on Windows";
+    return false;
+}
+
+void TokenizerWorkerPool::monitor_thread() {}
+
+bool TokenizerWorkerPool::run_script_once(const std::string& pdf_path, Result& out, std::string& error) {
+    static std::atomic<uint64_t> next_request{0};
+
+    std::string temp_dir = "data/temp_json";
+    if (!fs::exists(temp_dir)) {
+        fs::create_directories(temp_dir);
+    }
+    std::string temp_json = temp_dir + "/temp_" + std::to_string(next_request++) + ".json";
+
+    std::string python_cmd = options_.python_exe + " scripts/tokenize_single_pdf.py \""
+                           + pdf_path + "\" 0 \"" + temp_json + "\"";
+    if (std::system(python_cmd.c_str()) != 0) {
+        error = "Python tokenizer failed";
+        fs::remove(temp_json);
+        return false;
+    }
+
+    std::ifstream f(temp_json);
+    if (!f.is_open()) {
+        error = "Could not read tokenized output";
+        fs::remove(temp_json);
+        return false;
+    }
+
+    try {
+        nlohmann::json j;
+        f >> j;
+        f.close();
+        out.title = j.value("title", "Untitled");
+        out.tokens = j.value("body_tokens", std::vector<std::string>());
+    } catch (const std::exception& e) {
+        error = std::string("JSON parse error: ") + e.what();
+        fs::remove(temp_json);
+        return false;
+    }
+    fs::remove(temp_json);
+    return true;
+}
+
+#else
+
+bool TokenizerWorkerPool::start_worker(size_t index, std::string& error) {
+    Worker& worker = workers_[index];
+
+    int to_child[2], from_child[2];
+    if (!make_pipe(to_child)) {
+        error = std::string("could not create pipe: ") + std::strerror(errno);
+        return false;
+    }
+    if (!make_pipe(from_child)) {
+        error = std::string("could not create pipe: ") + std::strerror(errno);
+        ::close(to_child[0]);
+        ::close(to_child[1]);
+        return false;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, to_child[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, from_child[1], STDOUT_FILENO);
+
+    std::string python = options_.python_exe;
+    std::string script = options_.script;
+    char* argv[] = {python.data(), script.data(), nullptr};
+    pid_t pid = -1;
+    int rc = posix_spawnp(&pid, python.c_str(), &actions, nullptr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    ::close(to_child[0]);
+    ::close(from_child[1]);
+
+    if (rc != 0) {
+        ::close(to_child[1]);
+        ::close(from_child[0]);
+        error = "could not start " + python + ": " + std::strerror(rc);
+        return false;
+    }
+
+    worker.pid = pid;
+    worker.to_child = to_child[1];
+    worker.from_child = from_child[0];
+
+    // The first pong means the PDF library is imported and the worker is serving
+    auto started = std::chrono::steady_clock::now();
+    if (!ping(worker, options_.startup_timeout, error)) {
+        stop_worker(worker, false);
+        error = "tokenizer worker did not start (" + error + ")";
+        return false;
+    }
+
+    auto startup_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - started).count();
+    std::cout << "[TokenizerWorkers] Worker " << pid << " ready in " << startup_ms << "ms\n";
+
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.workers[index].pid = pid;
+    stats_.workers[index].alive = true;
+    return true;
+}
+
+void TokenizerWorkerPool::stop_worker(Worker& worker, bool graceful) {
+    if (worker.to_child >= 0) ::close(worker.to_child);
+    worker.to_child = -1;
+
+    if (worker.pid > 0) {
+        // Closed stdin ends the worker's request loop; give it a moment first
+        bool exited = false;
+        for (int i = 0; graceful && i < 200 && !exited; ++i) {
+            exited = ::waitpid(worker.pid, nullptr, WNOHANG) == worker.pid;
+            if (!exited) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (!exited) {
+            ::kill(worker.pid, SIGKILL);
+            ::waitpid(worker.pid, nullptr, 0);
+        }
+    }
+    worker.pid = -1;
+
+    if (worker.from_child >= 0) ::close(worker.from_child);
+    worker.from_child = -1;
+}
+
+void TokenizerWorkerPool::replace_worker(size_t index) {
+    stop_worker(workers_[index], false);
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.workers[index].alive = false;
+        stats_.workers[index].pid = -1;
+        stats_.workers[index].restarts++;
+        stats_.restarts++;
+    }
+
+    std::string error;
+    if (!start_worker(index, error)) {
+        std::cerr << "[TokenizerWorkers] " << error << "\n";
+    }
+}
+
+TokenizerWorkerPool::CallResult TokenizerWorkerPool::call(Worker& worker, const std::string& request,
+                                                          std::string& response,
+                                                          std::chrono::steady_clock::duration timeout,
+                                                          std::string& error) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    std::string frame;
+    append_u32(frame, static_cast<uint32_t>(request.size()));
+    frame += request;
+    if (!write_all(worker.to_child, frame)) {
+        error = "worker exited";
+        return CallResult::SendFailed;
+    }
+
+    char header[4];
+    if (!read_exact(worker.from_child, header, sizeof(header), deadline, error)) {
+        return CallResult::Failed;
+    }
+    uint32_t length = 0;
+    for (int i = 0; i < 4; ++i) length |= static_cast<uint32_t>(static_cast<uint8_t>(header[i])) << (8 * i);
+    if (length == 0 || length > tokenizer_protocol::MAX_FRAME_BYTES) {
+        error = "bad frame length " + std::to_string(length);
+        return CallResult::Failed;
+    }
+
+    response.resize(length);
+    if (!read_exact(worker.from_child, &response[0], length, deadline, error)) {
+        return CallResult::Failed;
+    }
+    return CallResult::Ok;
+}
+
+bool TokenizerWorkerPool::ping(Worker& worker, std::chrono::steady_clock::duration timeout, std::string& error) {
+    std::string response;
+    std::string request(1, static_cast<char>(tokenizer_protocol::OP_PING));
+    if (call(worker, request, response, timeout, error) != CallResult::Ok) return false;
+    if (response.size() != 1 || static_cast<uint8_t>(response[0]) != tokenizer_protocol::STATUS_PONG) {
+        error = "unexpected reply to ping";
+        return false;
+    }
+    return true;
+}
+
+void TokenizerWorkerPool::monitor_thread() {
+    // Start every worker before the first upload needs one. Workers that
+    // can't start stay down until a request asks for them.
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        std::string error;
+        if (!shutdown_ && !start_worker(i, error)) {
+            std::cerr << "[TokenizerWorkers] " << error << "\n";
+        }
+        release(i);
+    }
+
+    while (!shutdown_) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait_for(lock, options_.health_check_interval, [this]() { return shutdown_.load(); });
+        }
+        if (shutdown_) break;
+
+        // Only idle workers are checked; busy ones are proving themselves already
+        for (size_t i = 0; i < workers_.size() && !shutdown_; ++i) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = std::find(idle_.begin(), idle_.end(), i);
+                if (it == idle_.end()) continue;
+                idle_.erase(it);
+            }
+
+            Worker& worker = workers_[i];
+            if (worker.pid > 0) {
+                std::string error;
+                if (!ping(worker, PING_TIMEOUT, error)) {
+                    std::cerr << "[TokenizerWorkers] Worker " << worker.pid << " failed health check ("
+                              << error << "), restarting it\n";
+                    replace_worker(i);
+                }
+                std::lock_guard<std::mutex> lock(stats_mutex_);
+                stats_.health_checks++;
+            }
+            release(i);
+        }
+    }
+}
+
+#endif
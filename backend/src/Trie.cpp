@@ -9,6 +9,18 @@ Trie::~Trie() {
     clear();
 }
 
+Trie::Trie(const Trie& other) : root_(copy_node(*other.root_)) {}
+
+std::unique_ptr<TrieNode> Trie::copy_node(const TrieNode& node) {
+    auto copy = std::make_unique<TrieNode>();
+    copy->is_end_of_word = node.is_end_of_word;
+    copy->word = node.word;
+    for (const auto& [c, child] : node.children) {
+        copy->children[c] = copy_node(*child);
+    }
+    return copy;
+}
+
 void Trie::insert(const std::string& word) {
     if (word.empty()) return;
 
@@ -56,6 +68,16 @@ std::vector<std::string> Trie::autocomplete(const std::string& prefix, int k) co
     return results;
 }
 
+bool Trie::contains(const std::string& word) const {
+    const TrieNode* current = root_.get();
+    for (char c : word) {
+        auto it = current->children.find(std::tolower(static_cast<unsigned char>(c)));
+        if (it == current->children.end()) return false;
+        current = it->second.get();
+    }
+    return current->is_end_of_word;
+}
+
 bool Trie::empty() const {
     return root_->children.empty();
 }
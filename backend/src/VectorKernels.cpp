@@ -0,0 +1,466 @@
+#include "VectorKernels.hpp"
+#include "CpuFeatures.hpp"
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+
+#if DSA_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace vector_kernels {
+
+namespace {
+
+struct Kernels {
+    double (*dot)(const float* a, const float* b, size_t n);
+    void (*scale)(float* v, size_t n, float factor);
+    double (*dot_f16)(const float* a, const uint16_t* b, size_t n);
+    double (*dot_i8)(const float* a, const int8_t* b, size_t n);
+    void (*pq4_scan)(const uint8_t* codes, const uint8_t* lut, size_t num_subspaces,
+                     size_t num_blocks, uint16_t* out);
+};
+
+double dot_scalar(const float* a, const float* b, size_t n) {
+    double total = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        total += a[i] * b[i];
+    }
+    return total;
+}
+
+void scale_scalar(float* v, size_t n, float factor) {
+    for (size_t i = 0; i < n; ++i) {
+        v[i] *= factor;
+    }
+}
+
+double dot_f16_scalar(const float* a, const uint16_t* b, size_t n) {
+    double total = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        total += a[i] * half_to_float(b[i]);
+    }
+    return total;
+}
+
+double dot_i8_scalar(const float* a, const int8_t* b, size_t n) {
+    double total = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        total += a[i] * static_cast<float>(b[i]);
+    }
+    return total;
+}
+
+void pq4_scan_scalar(const uint8_t* codes, const uint8_t* lut, size_t num_subspaces,
+                     size_t num_blocks, uint16_t* out) {
+    for (size_t block = 0; block < num_blocks; ++block) {
+        for (size_t v = 0; v < PQ4_BLOCK; ++v) {
+            uint32_t total = 0;
+            for (size_t j = 0; j < num_subspaces; ++j) {
+                uint8_t packed = codes[j * 16 + v % 16];
+                total += lut[j * 16 + (v < 16 ? packed & 0x0F : packed >> 4)];
+            }
+            out[v] = static_cast<uint16_t>(total);
+        }
+        codes += num_subspaces * 16;
+        out += PQ4_BLOCK;
+    }
+}
+
+#if DSA_HAVE_X86_SIMD
+// Several independent accumulators hide the add latency; lanes are summed in
+// double so the only float rounding is inside each lane's partial sum.
+
+__attribute__((target("sse2")))
+double dot_sse2(const float* a, const float* b, size_t n) {
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    __m128 s2 = _mm_setzero_ps(), s3 = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+        s2 = _mm_add_ps(s2, _mm_mul_ps(_mm_loadu_ps(a + i + 8), _mm_loadu_ps(b + i + 8)));
+        s3 = _mm_add_ps(s3, _mm_mul_ps(_mm_loadu_ps(a + i + 12), _mm_loadu_ps(b + i + 12)));
+    }
+    for (; i + 4 <= n; i += 4) {
+        s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, _mm_add_ps(_mm_add_ps(s0, s1), _mm_add_ps(s2, s3)));
+    double total = 0.0;
+    for (float lane : lanes) total += lane;
+    for (; i < n; ++i) total += a[i] * b[i];
+    return total;
+}
+
+__attribute__((target("sse2")))
+void scale_sse2(float* v, size_t n, float factor) {
+    __m128 f = _mm_set1_ps(factor);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(v + i, _mm_mul_ps(_mm_loadu_ps(v + i), f));
+    }
+    for (; i < n; ++i) v[i] *= factor;
+}
+
+__attribute__((target("avx2,fma")))
+double dot_avx2(const float* a, const float* b, size_t n) {
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    __m256 s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), s0);
+        s1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), s1);
+        s2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16), s2);
+        s3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24), s3);
+    }
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), s0);
+    }
+
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, _mm256_add_ps(_mm256_add_ps(s0, s1), _mm256_add_ps(s2, s3)));
+    double total = 0.0;
+    for (float lane : lanes) total += lane;
+    for (; i < n; ++i) total += a[i] * b[i];
+    return total;
+}
+
+__attribute__((target("avx2,fma")))
+void scale_avx2(float* v, size_t n, float factor) {
+    __m256 f = _mm256_set1_ps(factor);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(v + i, _mm256_mul_ps(_mm256_loadu_ps(v + i), f));
+    }
+    for (; i < n; ++i) v[i] *= factor;
+}
+
+__attribute__((target("avx2,fma,f16c")))
+double dot_f16_avx2(const float* a, const uint16_t* b, size_t n) {
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 b0 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        __m256 b1 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 8)));
+        s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), b0, s0);
+        s1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), b1, s1);
+    }
+    for (; i + 8 <= n; i += 8) {
+        __m256 b0 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), b0, s0);
+    }
+
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, _mm256_add_ps(s0, s1));
+    double total = 0.0;
+    for (float lane : lanes) total += lane;
+    for (; i < n; ++i) total += a[i] * half_to_float(b[i]);
+    return total;
+}
+
+__attribute__((target("avx2,fma")))
+double dot_i8_avx2(const float* a, const int8_t* b, size_t n) {
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        __m256 b0 = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(bytes));
+        __m256 b1 = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_srli_si128(bytes, 8)));
+        s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), b0, s0);
+        s1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), b1, s1);
+    }
+    for (; i + 8 <= n; i += 8) {
+        __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(b + i));
+        s0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(bytes)), s0);
+    }
+
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, _mm256_add_ps(s0, s1));
+    double total = 0.0;
+    for (float lane : lanes) total += lane;
+    for (; i < n; ++i) total += a[i] * static_cast<float>(b[i]);
+    return total;
+}
+
+// Two subspaces per step: a 32-byte load holds subspace j's codes in the low
+// lane and j + 1's in the high lane, lined up with their tables in lut. The
+// in-lane byte shuffle is the 16-entry table lookup for 16 vectors at once.
+__attribute__((target("avx2")))
+void pq4_scan_avx2(const uint8_t* codes, const uint8_t* lut, size_t num_subspaces,
+                   size_t num_blocks, uint16_t* out) {
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    for (size_t block = 0; block < num_blocks; ++block) {
+        __m256i sum_low = _mm256_setzero_si256();   // Vectors 0-15
+        __m256i sum_high = _mm256_setzero_si256();  // Vectors 16-31
+        size_t j = 0;
+        for (; j + 2 <= num_subspaces; j += 2) {
+            __m256i packed = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + j * 16));
+            __m256i table = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lut + j * 16));
+            __m256i low = _mm256_shuffle_epi8(table, _mm256_and_si256(packed, nibble));
+            __m256i high = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(packed, 4), nibble));
+            sum_low = _mm256_add_epi16(sum_low, _mm256_cvtepu8_epi16(_mm256_castsi256_si128(low)));
+            sum_low = _mm256_add_epi16(sum_low, _mm256_cvtepu8_epi16(_mm256_extracti128_si256(low, 1)));
+            sum_high = _mm256_add_epi16(sum_high, _mm256_cvtepu8_epi16(_mm256_castsi256_si128(high)));
+            sum_high = _mm256_add_epi16(sum_high, _mm256_cvtepu8_epi16(_mm256_extracti128_si256(high, 1)));
+        }
+        if (j < num_subspaces) {
+            __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + j * 16));
+            __m128i table = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lut + j * 16));
+            __m128i low = _mm_shuffle_epi8(table, _mm_and_si128(packed, _mm256_castsi256_si128(nibble)));
+            __m128i high = _mm_shuffle_epi8(table, _mm_and_si128(_mm_srli_epi16(packed, 4),
+                                                                 _mm256_castsi256_si128(nibble)));
+            sum_low = _mm256_add_epi16(sum_low, _mm256_cvtepu8_epi16(low));
+            sum_high = _mm256_add_epi16(sum_high, _mm256_cvtepu8_epi16(high));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), sum_low);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 16), sum_high);
+        codes += num_subspaces * 16;
+        out += PQ4_BLOCK;
+    }
+}
+
+__attribute__((target("avx512f")))
+double dot_avx512(const float* a, const float* b, size_t n) {
+    __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), s0);
+        s1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), s1);
+    }
+    for (; i + 16 <= n; i += 16) {
+        s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), s0);
+    }
+    if (i < n) {
+        // Masked loads read only the remaining 1-15 floats
+        __mmask16 tail = static_cast<__mmask16>((1u << (n - i)) - 1);
+        s1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(tail, a + i), _mm512_maskz_loadu_ps(tail, b + i), s1);
+    }
+
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, _mm512_add_ps(s0, s1));
+    double total = 0.0;
+    for (float lane : lanes) total += lane;
+    return total;
+}
+
+__attribute__((target("avx512f")))
+void scale_avx512(float* v, size_t n, float factor) {
+    __m512 f = _mm512_set1_ps(factor);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm512_storeu_ps(v + i, _mm512_mul_ps(_mm512_loadu_ps(v + i), f));
+    }
+    if (i < n) {
+        __mmask16 tail = static_cast<__mmask16>((1u << (n - i)) - 1);
+        _mm512_mask_storeu_ps(v + i, tail, _mm512_mul_ps(_mm512_maskz_loadu_ps(tail, v + i), f));
+    }
+}
+// The 16-wide loops leave a 1-15 element tail to the scalar code: masked
+// 16-bit and 8-bit loads would need AVX-512BW on top of AVX-512F
+__attribute__((target("avx512f")))
+double dot_f16_avx512(const float* a, const uint16_t* b, size_t n) {
+    __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512 b0 = _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+        __m512 b1 = _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i + 16)));
+        s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), b0, s0);
+        s1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), b1, s1);
+    }
+    for (; i + 16 <= n; i += 16) {
+        __m512 b0 = _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+        s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), b0, s0);
+    }
+
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, _mm512_add_ps(s0, s1));
+    double total = 0.0;
+    for (float lane : lanes) total += lane;
+    for (; i < n; ++i) total += a[i] * half_to_float(b[i]);
+    return total;
+}
+
+__attribute__((target("avx512f")))
+double dot_i8_avx512(const float* a, const int8_t* b, size_t n) {
+    __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512 b0 = _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i))));
+        __m512 b1 = _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 16))));
+        s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), b0, s0);
+        s1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), b1, s1);
+    }
+    for (; i + 16 <= n; i += 16) {
+        __m512 b0 = _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i))));
+        s0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), b0, s0);
+    }
+
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, _mm512_add_ps(s0, s1));
+    double total = 0.0;
+    for (float lane : lanes) total += lane;
+    for (; i < n; ++i) total += a[i] * static_cast<float>(b[i]);
+    return total;
+}
+#endif
+
+const Kernels SCALAR_KERNELS{dot_scalar, scale_scalar, dot_f16_scalar, dot_i8_scalar, pq4_scan_scalar};
+#if DSA_HAVE_X86_SIMD
+const Kernels SSE2_KERNELS{dot_sse2, scale_sse2, dot_f16_scalar, dot_i8_scalar, pq4_scan_scalar};
+const Kernels AVX2_KERNELS{dot_avx2, scale_avx2, dot_f16_avx2, dot_i8_avx2, pq4_scan_avx2};
+const Kernels AVX512_KERNELS{dot_avx512, scale_avx512, dot_f16_avx512, dot_i8_avx512, pq4_scan_avx2};
+#endif
+
+// nullptr when the CPU can't run that set
+const Kernels* kernels_for(Isa isa) {
+    switch (isa) {
+        case Isa::Scalar: return &SCALAR_KERNELS;
+#if DSA_HAVE_X86_SIMD
+        case Isa::SSE2: return cpu::has_sse2() ? &SSE2_KERNELS : nullptr;
+        case Isa::AVX2: return cpu::has_avx2_fma() && cpu::has_f16c() ? &AVX2_KERNELS : nullptr;
+        case Isa::AVX512: return cpu::has_avx512f() && cpu::has_avx2_fma() ? &AVX512_KERNELS : nullptr;
+#endif
+        default: return nullptr;
+    }
+}
+
+Isa detect_isa() {
+    for (Isa isa : {Isa::AVX512, Isa::AVX2, Isa::SSE2}) {
+        if (kernels_for(isa)) return isa;
+    }
+    return Isa::Scalar;
+}
+
+const Kernels& active_kernels() {
+    static const Kernels& kernels = *kernels_for(active_isa());
+    return kernels;
+}
+
+void normalize_with(const Kernels& kernels, float* v, size_t n) {
+    double norm = std::sqrt(kernels.dot(v, v, n));
+    if (norm > 0.0) {
+        kernels.scale(v, n, static_cast<float>(1.0 / norm));
+    }
+}
+
+} // namespace
+
+double dot(const float* a, const float* b, size_t n) {
+    return active_kernels().dot(a, b, n);
+}
+
+void normalize(float* v, size_t n) {
+    normalize_with(active_kernels(), v, n);
+}
+
+double dot_f16(const float* a, const uint16_t* b, size_t n) {
+    return active_kernels().dot_f16(a, b, n);
+}
+
+double dot_i8(const float* a, const int8_t* b, size_t n) {
+    return active_kernels().dot_i8(a, b, n);
+}
+
+void pq4_scan(const uint8_t* codes, const uint8_t* lut, size_t num_subspaces,
+              size_t num_blocks, uint16_t* out) {
+    active_kernels().pq4_scan(codes, lut, num_subspaces, num_blocks, out);
+}
+
+uint16_t float_to_half(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t magnitude = bits & 0x7FFFFFFF;
+
+    if (magnitude >= 0x7F800000) {                  // Inf / NaN (NaN stays quiet)
+        return static_cast<uint16_t>(sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0));
+    }
+    if (magnitude >= 0x477FF000) {                  // Rounds past 65504: Inf
+        return static_cast<uint16_t>(sign | 0x7C00);
+    }
+    if (magnitude < 0x38800000) {                   // Below 2^-14: half subnormal or zero
+        if (magnitude < 0x33000000) return static_cast<uint16_t>(sign);
+        uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+        uint32_t shift = 126 - (magnitude >> 23);   // 14..24
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1))) ++half;
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    // Normal: rebias the exponent (127 -> 15) and round off 13 mantissa bits;
+    // a carry out of the mantissa correctly bumps the exponent
+    uint32_t half = (magnitude - 0x38000000) >> 13;
+    uint32_t rest = magnitude & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) ++half;
+    return static_cast<uint16_t>(sign | half);
+}
+
+float half_to_float(uint16_t bits) {
+    uint32_t sign = static_cast<uint32_t>(bits & 0x8000) << 16;
+    uint32_t exponent = (bits >> 10) & 0x1F;
+    uint32_t mantissa = bits & 0x3FF;
+
+    uint32_t result;
+    if (exponent == 0) {
+        float value = static_cast<float>(mantissa) * 5.9604644775390625e-8f;  // mantissa * 2^-24
+        std::memcpy(&result, &value, sizeof(result));
+        result |= sign;
+    } else if (exponent == 31) {
+        result = sign | 0x7F800000 | (mantissa << 13);
+    } else {
+        result = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float value;
+    std::memcpy(&value, &result, sizeof(value));
+    return value;
+}
+
+Isa active_isa() {
+    static const Isa isa = detect_isa();
+    return isa;
+}
+
+const char* isa_name(Isa isa) {
+    switch (isa) {
+        case Isa::SSE2: return "sse2";
+        case Isa::AVX2: return "avx2";
+        case Isa::AVX512: return "avx512";
+        default: return "scalar";
+    }
+}
+
+bool isa_supported(Isa isa) {
+    return kernels_for(isa) != nullptr;
+}
+
+double dot(Isa isa, const float* a, const float* b, size_t n) {
+    const Kernels* kernels = kernels_for(isa);
+    return (kernels ? *kernels : SCALAR_KERNELS).dot(a, b, n);
+}
+
+void normalize(Isa isa, float* v, size_t n) {
+    const Kernels* kernels = kernels_for(isa);
+    normalize_with(kernels ? *kernels : SCALAR_KERNELS, v, n);
+}
+
+double dot_f16(Isa isa, const float* a, const uint16_t* b, size_t n) {
+    const Kernels* kernels = kernels_for(isa);
+    return (kernels ? *kernels : SCALAR_KERNELS).dot_f16(a, b, n);
+}
+
+double dot_i8(Isa isa, const float* a, const int8_t* b, size_t n) {
+    const Kernels* kernels = kernels_for(isa);
+    return (kernels ? *kernels : SCALAR_KERNELS).dot_i8(a, b, n);
+}
+
+void pq4_scan(Isa isa, const uint8_t* codes, const uint8_t* lut, size_t num_subspaces,
+              size_t num_blocks, uint16_t* out) {
+    const Kernels* kernels = kernels_for(isa);
+    (kernels ? *kernels : SCALAR_KERNELS).pq4_scan(codes, lut, num_subspaces, num_blocks, out);
+}
+
+} // namespace vector_kernels
@@ -0,0 +1,183 @@
+#include "WordEmbeddings.hpp"
+#include "VectorKernels.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using vector_format::Encoding;
+
+namespace {
+
+// Words longer than this are treated as a corrupt file
+constexpr uint32_t MAX_WORD_BYTES = 1 << 16;
+
+} // namespace
+
+bool WordEmbeddings::load(const std::string& path, uint32_t dim) {
+    rows_.clear();
+    data_.clear();
+    scales_.clear();
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "[WordEmbeddings] Could not open word embeddings file: " << path << "\n";
+        return false;
+    }
+
+    char magic[4] = {};
+    file.read(magic, sizeof(magic));
+    file.seekg(0);
+    if (std::memcmp(magic, word_format::MAGIC, 4) == 0) {
+        return load_encoded(file, dim, path);
+    }
+    return load_original(file, dim);
+}
+
+uint32_t WordEmbeddings::insert_row(std::string word) {
+    auto inserted = rows_.emplace(std::move(word), static_cast<uint32_t>(rows_.size()));
+    if (inserted.second) {
+        data_.resize(data_.size() + row_bytes_);
+        if (encoding_ == Encoding::Int8) scales_.push_back(0.0f);
+    }
+    return inserted.first->second;
+}
+
+bool WordEmbeddings::load_original(std::ifstream& file, uint32_t dim) {
+    encoding_ = Encoding::Float32;
+    dim_ = dim;
+    row_bytes_ = dim * sizeof(float);
+
+    int32_t num_words = 0;
+    file.read(reinterpret_cast<char*>(&num_words), sizeof(num_words));
+    if (num_words > 0) {
+        rows_.reserve(num_words);
+        data_.reserve(static_cast<size_t>(num_words) * row_bytes_);
+    }
+
+    std::vector<float> vector(dim);
+    for (int32_t i = 0; i < num_words; ++i) {
+        int32_t word_len = 0;
+        file.read(reinterpret_cast<char*>(&word_len), sizeof(word_len));
+        if (!file.good() || word_len < 0 || static_cast<uint32_t>(word_len) > MAX_WORD_BYTES) break;
+
+        std::string word(word_len, '\0');
+        file.read(&word[0], word_len);
+        file.read(reinterpret_cast<char*>(vector.data()), dim * sizeof(float));
+        if (!file.good()) break;
+
+        // GloVe vectors aren't normalized
+        vector_kernels::normalize(vector.data(), dim);
+        uint32_t row = insert_row(std::move(word));
+        std::memcpy(data_.data() + static_cast<size_t>(row) * row_bytes_, vector.data(), row_bytes_);
+    }
+    return !rows_.empty();
+}
+
+bool WordEmbeddings::load_encoded(std::ifstream& file, uint32_t dim, const std::string& path) {
+    WordFileHeader header{};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    Encoding encoding = static_cast<Encoding>(header.encoding);
+    bool known_encoding = encoding == Encoding::Float32 || encoding == Encoding::Float16 ||
+                          encoding == Encoding::Int8;
+    if (!file.good() || header.version != word_format::VERSION || header.dim != dim || !known_encoding) {
+        std::cerr << "[WordEmbeddings] Bad header in " << path << " (version " << header.version
+                  << ", dim " << header.dim << ", expected dim " << dim
+                  << ", encoding " << header.encoding << ")\n";
+        return false;
+    }
+
+    encoding_ = encoding;
+    dim_ = dim;
+    row_bytes_ = dim * vector_format::element_size(encoding);
+    rows_.reserve(header.num_words);
+    data_.reserve(static_cast<size_t>(header.num_words) * row_bytes_);
+    if (encoding == Encoding::Int8) scales_.reserve(header.num_words);
+
+    for (uint32_t i = 0; i < header.num_words; ++i) {
+        uint32_t word_len = 0;
+        file.read(reinterpret_cast<char*>(&word_len), sizeof(word_len));
+        if (!file.good() || word_len > MAX_WORD_BYTES) break;
+
+        std::string word(word_len, '\0');
+        file.read(&word[0], word_len);
+        float scale = 1.0f;
+        if (encoding == Encoding::Int8) {
+            file.read(reinterpret_cast<char*>(&scale), sizeof(scale));
+        }
+        uint32_t row = insert_row(std::move(word));
+        file.read(reinterpret_cast<char*>(data_.data() + static_cast<size_t>(row) * row_bytes_), row_bytes_);
+        if (!file.good()) {
+            std::cerr << "[WordEmbeddings] " << path << " is truncated after " << i << " words\n";
+            break;
+        }
+        if (encoding == Encoding::Int8) scales_[row] = scale;
+    }
+    return !rows_.empty();
+}
+
+bool WordEmbeddings::lookup(const std::string& word, float* out) const {
+    auto it = rows_.find(word);
+    if (it == rows_.end()) return false;
+    uint32_t row = it->second;
+    vector_format::decode_row(data_.data() + static_cast<size_t>(row) * row_bytes_,
+                              scales_.empty() ? 1.0f : scales_[row], dim_, encoding_, out);
+    return true;
+}
+
+bool WordEmbeddings::write(const std::string& path, const WordEmbeddings& source,
+                           Encoding encoding, std::string& error) {
+    if (source.size() == 0) {
+        error = "no word embeddings loaded";
+        return false;
+    }
+
+    // Sorted, so the same input always gives the same file
+    std::vector<const std::string*> words;
+    words.reserve(source.rows_.size());
+    for (const auto& entry : source.rows_) words.push_back(&entry.first);
+    std::sort(words.begin(), words.end(), [](const std::string* a, const std::string* b) { return *a < *b; });
+
+    WordFileHeader header{};
+    std::memcpy(header.magic, word_format::MAGIC, 4);
+    header.version = word_format::VERSION;
+    header.dim = source.dim();
+    header.encoding = static_cast<uint32_t>(encoding);
+    header.num_words = static_cast<uint32_t>(words.size());
+
+    std::string tmp_path = path + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        error = "could not create " + tmp_path;
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<float> values(source.dim());
+    std::vector<uint8_t> encoded(source.dim() * vector_format::element_size(encoding));
+    for (const std::string* word : words) {
+        source.lookup(*word, values.data());
+        float scale = vector_format::encode_row(values.data(), source.dim(), encoding, encoded.data());
+
+        uint32_t word_len = static_cast<uint32_t>(word->size());
+        out.write(reinterpret_cast<const char*>(&word_len), sizeof(word_len));
+        out.write(word->data(), word_len);
+        if (encoding == Encoding::Int8) {
+            out.write(reinterpret_cast<const char*>(&scale), sizeof(scale));
+        }
+        out.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+    }
+    out.close();
+    if (!out) {
+        error = "write to " + tmp_path + " failed";
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        error = "could not rename " + tmp_path + " to " + path;
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
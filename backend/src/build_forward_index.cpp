@@ -1,8 +1,10 @@
 #include "forward_index.hpp"
 #include <iostream>
 #include <fstream>
+#include <string>
 
-int main() {
+//   build_forward_index [--threads N]   (default: one worker per core)
+int main(int argc, char* argv[]) {
     // Configuration paths
     const std::string LEXICON_PATH = "data/processed/lexicon.json";
     const std::string OUTPUT_PATH = "data/processed/forward_index.jsonl";
@@ -14,6 +16,22 @@ int main() {
     }
     test_file.close(); 
 
+    size_t num_threads = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            try {
+                num_threads = std::stoul(argv[++i]);
+            } catch (...) {
+                std::cerr << "Bad value for --threads: " << argv[i] << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--threads N]" << std::endl;
+            return 1;
+        }
+    }
+
     std::cout << "--- Starting Forward Index Build ---" << std::endl;
 
     ForwardIndexBuilder builder;
@@ -24,7 +42,7 @@ int main() {
     }
 
     // 2. Build Index (Calculates TF, Positions, Doc Length)
-    builder.build_index(DATASET_PATH);
+    builder.build_index(DATASET_PATH, num_threads);
 
     // 3. Save Result
     builder.save_to_file(OUTPUT_PATH);
@@ -0,0 +1,124 @@
+#include "DocumentVectors.hpp"
+#include "HnswIndex.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Builds the HNSW graph the server uses for /search?mode=semantic|hybrid,
+// then checks it: recall@10 against an exhaustive scan and time per query,
+// with sample documents as the queries.
+//
+//   build_hnsw [--vectors IN] [--out OUT] [--m M] [--ef-construction EF]
+
+namespace {
+
+constexpr uint32_t EMBEDDING_DIM = 300;
+constexpr uint32_t SAMPLE_QUERIES = 200;
+constexpr size_t RECALL_K = 10;
+constexpr size_t EF_SEARCH = 128;   // SemanticScorer::ANN_EF_SEARCH
+
+// Exact top k doc ids for query
+std::vector<int> exhaustive_top(const DocumentVectors& vectors, const float* query, size_t k) {
+    std::vector<std::pair<double, int>> scored;
+    for (int32_t doc_id = 0; doc_id <= vectors.max_doc_id(); ++doc_id) {
+        int64_t row = vectors.row_index(doc_id);
+        if (row >= 0) scored.emplace_back(vectors.dot(query, static_cast<uint32_t>(row)), doc_id);
+    }
+    k = std::min(k, scored.size());
+    std::partial_sort(scored.begin(), scored.begin() + k, scored.end(),
+                      [](const auto& a, const auto& b) { return a.first > b.first; });
+    std::vector<int> ids;
+    for (size_t i = 0; i < k; ++i) ids.push_back(scored[i].second);
+    return ids;
+}
+
+void report_quality(const DocumentVectors& vectors, const HnswIndex& index) {
+    std::vector<float> query(EMBEDDING_DIM);
+    size_t found = 0, expected = 0;
+    double search_seconds = 0.0;
+    uint32_t queries = 0;
+    for (uint32_t i = 0; i < SAMPLE_QUERIES; ++i) {
+        int doc_id = static_cast<int>((uint64_t{i} * 2654435761u) % (uint64_t(vectors.max_doc_id()) + 1));
+        int64_t row = vectors.row_index(doc_id);
+        if (row < 0) continue;
+        vectors.decode(static_cast<uint32_t>(row), query.data());
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<VectorMatch> approximate = index.search(vectors, query.data(), RECALL_K, EF_SEARCH);
+        search_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::vector<int> exact = exhaustive_top(vectors, query.data(), RECALL_K);
+        std::unordered_set<int> exact_ids(exact.begin(), exact.end());
+        for (const auto& neighbor : approximate) found += exact_ids.count(neighbor.doc_id);
+        expected += exact.size();
+        ++queries;
+    }
+    if (queries == 0) return;
+    std::cout << "Recall@" << RECALL_K << " over " << queries << " queries (ef " << EF_SEARCH << "): "
+              << (expected ? static_cast<double>(found) / expected : 0.0)
+              << ", " << search_seconds / queries * 1e6 << " us per query\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string vectors_path = "data/processed/document_vectors.bin";
+    std::string out_path = "data/processed/document_vectors.hnsw";
+    HnswIndex::BuildOptions options;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return 1;
+        }
+        std::string value = argv[++i];
+        try {
+            if (arg == "--vectors") {
+                vectors_path = value;
+            } else if (arg == "--out") {
+                out_path = value;
+            } else if (arg == "--m") {
+                options.max_neighbors = static_cast<uint32_t>(std::stoul(value));
+            } else if (arg == "--ef-construction") {
+                options.ef_construction = static_cast<uint32_t>(std::stoul(value));
+            } else {
+                std::cerr << "Usage: " << argv[0]
+                          << " [--vectors IN] [--out OUT] [--m M] [--ef-construction EF]\n";
+                return 1;
+            }
+        } catch (...) {
+            std::cerr << "Bad value for " << arg << ": " << value << "\n";
+            return 1;
+        }
+    }
+
+    DocumentVectors vectors;
+    if (!vectors.load(vectors_path, EMBEDDING_DIM)) {
+        std::cerr << "Could not load document vectors from " << vectors_path << "\n";
+        return 1;
+    }
+    std::cout << "Building HNSW graph over " << vectors.num_documents() << " document vectors (M "
+              << options.max_neighbors << ", ef_construction " << options.ef_construction << ")\n";
+
+    auto start = std::chrono::steady_clock::now();
+    std::string error;
+    if (!HnswIndex::build(vectors, options, out_path, error)) {
+        std::cerr << "Could not build " << out_path << ": " << error << "\n";
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    HnswIndex index;
+    if (!index.load(out_path, vectors)) {
+        std::cerr << "Could not read back " << out_path << "\n";
+        return 1;
+    }
+    std::cout << "Wrote " << out_path << ": " << index.num_nodes() << " nodes, "
+              << index.max_level() + 1 << " levels, " << seconds << " s\n";
+    report_quality(vectors, index);
+    return 0;
+}
@@ -1,7 +1,10 @@
 #include "inverted_index.hpp"
+#include <algorithm>
 #include <iostream>
+#include <string>
 
-int main() {
+//   build_inverted_index [--json] [--memory-mb N] [--run-dir DIR] [--threads N]
+int main(int argc, char* argv[]) {
     // Forward Index path
     const std::string FORWARD_INDEX_PATH = "data/processed/forward_index.jsonl";
 
@@ -11,12 +14,47 @@ int main() {
     // Number of barrels to create
     const int NUM_BARRELS = 100; 
 
+    // Build the Inverted Index
+    InvertedIndexBuilder builder(NUM_BARRELS);
+
+    // --json also exports the legacy JSON barrels (the server only reads the .bin files).
+    // --memory-mb, --run-dir and --threads bound and place the external sort.
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--json") {
+            builder.set_json_export(true);
+            std::cout << "JSON export enabled" << std::endl;
+        } else if ((arg == "--memory-mb" || arg == "--run-dir" || arg == "--threads") && i + 1 < argc) {
+            std::string value = argv[++i];
+            try {
+                if (arg == "--memory-mb") {
+                    builder.set_memory_budget(std::max<size_t>(1, std::stoul(value)) << 20);
+                } else if (arg == "--run-dir") {
+                    builder.set_run_dir(value);
+                } else {
+                    builder.set_merge_threads(std::stoul(value));
+                }
+            } catch (...) {
+                std::cerr << "Bad value for " << arg << ": " << value << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--json] [--memory-mb N] [--run-dir DIR] [--threads N]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
     std::cout << "Starting Inverted Index Build" << std::endl;
     std::cout << "Target Barrels: " << NUM_BARRELS << std::endl;
 
-    // Build the Inverted Index
-    InvertedIndexBuilder builder(NUM_BARRELS);
-    builder.build(FORWARD_INDEX_PATH, OUTPUT_DIR);
+    // Score upper bounds for top-k pruning depend on the metadata (citations, year)
+    builder.load_metadata("data/processed/document_metadata.json");
+
+    if (!builder.build(FORWARD_INDEX_PATH, OUTPUT_DIR)) {
+        std::cerr << "Build failed" << std::endl;
+        return 1;
+    }
 
     std::cout << "Build Complete" << std::endl;
     return 0;
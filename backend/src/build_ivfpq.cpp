@@ -0,0 +1,156 @@
+#include "DocumentVectors.hpp"
+#include "IvfPqIndex.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Builds the IVF-PQ index the server uses for /search?mode=semantic|hybrid
+// when document_vectors.bin is too large to keep mapped, then checks it:
+// bytes per document, and recall@10 against an exhaustive scan and time per
+// query for a range of nprobe, with sample documents as the queries.
+//
+//   build_ivfpq [--vectors IN] [--out OUT] [--lists N] [--subspaces M]
+//               [--iterations I] [--sample S]
+
+namespace {
+
+constexpr uint32_t EMBEDDING_DIM = 300;
+constexpr uint32_t SAMPLE_QUERIES = 200;
+constexpr size_t RECALL_K = 10;
+constexpr uint32_t NPROBES[] = {1, 4, 8, 16, 32, 64};
+constexpr size_t RESCORE_FACTOR = 4;  // SemanticScorer::ANN_RESCORE_FACTOR
+
+// Exact top k doc ids for query
+std::vector<int> exhaustive_top(const DocumentVectors& vectors, const float* query, size_t k) {
+    std::vector<std::pair<double, int>> scored;
+    for (int32_t doc_id = 0; doc_id <= vectors.max_doc_id(); ++doc_id) {
+        int64_t row = vectors.row_index(doc_id);
+        if (row >= 0) scored.emplace_back(vectors.dot(query, static_cast<uint32_t>(row)), doc_id);
+    }
+    k = std::min(k, scored.size());
+    std::partial_sort(scored.begin(), scored.begin() + k, scored.end(),
+                      [](const auto& a, const auto& b) { return a.first > b.first; });
+    std::vector<int> ids;
+    for (size_t i = 0; i < k; ++i) ids.push_back(scored[i].second);
+    return ids;
+}
+
+void report_quality(const DocumentVectors& vectors, const IvfPqIndex& index) {
+    std::vector<std::vector<float>> queries;
+    std::vector<std::unordered_set<int>> exact;
+    size_t expected = 0;
+    for (uint32_t i = 0; i < SAMPLE_QUERIES; ++i) {
+        int doc_id = static_cast<int>((uint64_t{i} * 2654435761u) % (uint64_t(vectors.max_doc_id()) + 1));
+        int64_t row = vectors.row_index(doc_id);
+        if (row < 0) continue;
+        std::vector<float> query(EMBEDDING_DIM);
+        vectors.decode(static_cast<uint32_t>(row), query.data());
+        std::vector<int> top = exhaustive_top(vectors, query.data(), RECALL_K);
+        expected += top.size();
+        exact.emplace_back(top.begin(), top.end());
+        queries.push_back(std::move(query));
+    }
+    if (queries.empty() || expected == 0) return;
+
+    for (uint32_t nprobe : NPROBES) {
+        if (nprobe > index.num_lists() && nprobe != NPROBES[0]) break;
+        IvfPqIndex::SearchOptions options(nprobe);
+        size_t found = 0, found_rescored = 0;
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::vector<VectorMatch>> results;
+        for (const auto& query : queries) results.push_back(index.search(query.data(), RECALL_K, options));
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (size_t q = 0; q < queries.size(); ++q) {
+            for (const auto& match : results[q]) found += exact[q].count(match.doc_id);
+
+            // What SemanticScorer does with document_vectors.bin mapped: a
+            // longer shortlist, re-scored exactly
+            std::vector<VectorMatch> shortlist =
+                index.search(queries[q].data(), RECALL_K * RESCORE_FACTOR, options);
+            for (auto& match : shortlist) {
+                match.similarity = vectors.dot(queries[q].data(), static_cast<uint32_t>(vectors.row_index(match.doc_id)));
+            }
+            size_t keep = std::min(RECALL_K, shortlist.size());
+            std::partial_sort(shortlist.begin(), shortlist.begin() + keep, shortlist.end(),
+                              [](const VectorMatch& a, const VectorMatch& b) { return a.similarity > b.similarity; });
+            for (size_t i = 0; i < keep; ++i) found_rescored += exact[q].count(shortlist[i].doc_id);
+        }
+        std::cout << "nprobe " << nprobe << ": recall@" << RECALL_K << " "
+                  << static_cast<double>(found) / expected << " ("
+                  << static_cast<double>(found_rescored) / expected << " re-scored exactly from "
+                  << RECALL_K * RESCORE_FACTOR << "), " << seconds / queries.size() * 1e6 << " us per query\n";
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string vectors_path = "data/processed/document_vectors.bin";
+    std::string out_path = "data/processed/document_vectors.ivfpq";
+    IvfPqIndex::TrainOptions options;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return 1;
+        }
+        std::string value = argv[++i];
+        try {
+            if (arg == "--vectors") {
+                vectors_path = value;
+            } else if (arg == "--out") {
+                out_path = value;
+            } else if (arg == "--lists") {
+                options.num_lists = static_cast<uint32_t>(std::stoul(value));
+            } else if (arg == "--subspaces") {
+                options.num_subspaces = static_cast<uint32_t>(std::stoul(value));
+            } else if (arg == "--iterations") {
+                options.iterations = static_cast<uint32_t>(std::stoul(value));
+            } else if (arg == "--sample") {
+                options.sample_size = static_cast<uint32_t>(std::stoul(value));
+            } else {
+                std::cerr << "Usage: " << argv[0] << " [--vectors IN] [--out OUT] [--lists N] [--subspaces M]"
+                          << " [--iterations I] [--sample S]\n";
+                return 1;
+            }
+        } catch (...) {
+            std::cerr << "Bad value for " << arg << ": " << value << "\n";
+            return 1;
+        }
+    }
+
+    DocumentVectors vectors;
+    if (!vectors.load(vectors_path, EMBEDDING_DIM)) {
+        std::cerr << "Could not load document vectors from " << vectors_path << "\n";
+        return 1;
+    }
+    std::cout << "Building IVF-PQ index over " << vectors.num_documents() << " document vectors ("
+              << options.num_subspaces << " subspaces)\n";
+
+    auto start = std::chrono::steady_clock::now();
+    std::string error;
+    if (!IvfPqIndex::build(vectors, options, out_path, error)) {
+        std::cerr << "Could not build " << out_path << ": " << error << "\n";
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    IvfPqIndex index;
+    if (!index.load(out_path, EMBEDDING_DIM)) {
+        std::cerr << "Could not read back " << out_path << "\n";
+        return 1;
+    }
+    std::cout << "Wrote " << out_path << ": " << index.num_documents() << " documents in "
+              << index.num_lists() << " lists, "
+              << static_cast<double>(index.data_bytes()) / std::max<size_t>(1, index.num_documents())
+              << " bytes per document (document_vectors.bin: "
+              << static_cast<double>(vectors.data_bytes()) / std::max<size_t>(1, vectors.num_documents())
+              << "), " << seconds << " s\n";
+    report_quality(vectors, index);
+    return 0;
+}
@@ -4,6 +4,10 @@
 #include <algorithm>
 #include <cctype>
 #include <map>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 
 // Helper tokenizer, cleans text and splits into tokens
 std::vector<std::string> tokenize(const std::string& text) {
@@ -42,11 +46,9 @@ bool ForwardIndexBuilder::load_lexicon(const std::string& filepath) {
         json j;
         f >> j;
         // Handle both simple and nested JSON formats
-        if (j.contains("word_to_index")) {
-            for (auto& el : j["word_to_index"].items()) lexicon_[el.key()] = el.value();
-        } else {
-            for (auto& el : j.items()) lexicon_[el.key()] = el.value();
-        }
+        const json& words = j.contains("word_to_index") ? j["word_to_index"] : j;
+        lexicon_.reserve(words.size());
+        for (auto& el : words.items()) lexicon_[el.key()] = el.value();
     } catch (const std::exception& e) {
         std::cerr << "JSON error: " << e.what() << std::endl;
         return false;
@@ -55,8 +57,185 @@ bool ForwardIndexBuilder::load_lexicon(const std::string& filepath) {
     return true;
 }
 
+// One dataset line: the document's "data" object, or empty if it has no
+// lexicon words. False if the line couldn't be parsed as a document.
+bool ForwardIndexBuilder::index_line(const std::string& line, std::string& data_json) const {
+    data_json.clear();
+    try {
+        auto doc_obj = json::parse(line);
+        
+        // Extract title and body tokens separately
+        std::vector<std::string> title_tokens;
+        std::vector<std::string> body_tokens;
+        
+        // Handle pre-tokenized format with title_tokens and body_tokens
+        if (doc_obj.contains("title_tokens") && doc_obj.contains("body_tokens")) {
+            title_tokens = doc_obj["title_tokens"].get<std::vector<std::string>>();
+            body_tokens = doc_obj["body_tokens"].get<std::vector<std::string>>();
+        } else if (doc_obj.contains("tokens")) {
+            // Legacy format: all tokens together (treat as body)
+            body_tokens = doc_obj["tokens"].get<std::vector<std::string>>();
+        } else {
+            // Tokenize from raw text fields
+            if (doc_obj.contains("title") && !doc_obj["title"].is_null()) {
+                std::string title = doc_obj["title"].get<std::string>();
+                title_tokens = tokenize(title);
+            }
+            if (doc_obj.contains("body") && !doc_obj["body"].is_null()) {
+                std::string body = doc_obj["body"].get<std::string>();
+                body_tokens = tokenize(body);
+            } else if (doc_obj.contains("abstract") && !doc_obj["abstract"].is_null()) {
+                std::string abstract = doc_obj["abstract"].get<std::string>();
+                body_tokens = tokenize(abstract);
+            }
+        }
+
+        // Map automatically sorts keys by WordID (0, 1, 2...)
+        std::map<int, WordStats> doc_stats;
+        std::string lower_token;
+
+        // Lowercased token's WordID, or -1 if it isn't in the lexicon
+        auto word_id = [&](const std::string& token) {
+            lower_token.assign(token);
+            std::transform(lower_token.begin(), lower_token.end(), lower_token.begin(),
+                         [](unsigned char c) { return std::tolower(c); });
+            auto it = lexicon_.find(lower_token);
+            return it == lexicon_.end() ? -1 : it->second;
+        };
+
+        // Process title tokens
+        for (size_t pos = 0; pos < title_tokens.size(); ++pos) {
+            int id = word_id(title_tokens[pos]);
+            if (id < 0) continue;
+            doc_stats[id].title_frequency++;
+            doc_stats[id].title_positions.push_back(static_cast<int>(pos));
+        }
+
+        // Process body tokens
+        for (size_t pos = 0; pos < body_tokens.size(); ++pos) {
+            int id = word_id(body_tokens[pos]);
+            if (id < 0) continue;
+            doc_stats[id].body_frequency++;
+            doc_stats[id].body_positions.push_back(static_cast<int>(pos));
+        }
+
+        // Only store document if it contains valid words
+        if (!doc_stats.empty()) {
+            json doc_json;
+            int total_tokens = title_tokens.size() + body_tokens.size();
+            doc_json["doc_length"] = total_tokens; // Critical for BM25
+            doc_json["title_length"] = title_tokens.size();
+            doc_json["body_length"] = body_tokens.size();
+
+            json words_obj;
+            for (const auto& [id, stats] : doc_stats) {
+                words_obj[std::to_string(id)] = {
+                    {"title_frequency", stats.title_frequency},
+                    {"body_frequency", stats.body_frequency},
+                    {"weighted_frequency", stats.get_weighted_frequency()},
+                    {"title_positions", stats.title_positions},
+                    {"body_positions", stats.body_positions}
+                };
+            }
+            doc_json["words"] = words_obj;
+            data_json = doc_json.dump(-1);
+        }
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+namespace {
+
+constexpr size_t LINES_PER_BATCH = 256;
+constexpr size_t BATCHES_PER_WORKER = 4;   // Read ahead, bounds memory held by the pipeline
+
+struct IndexedLine {
+    bool parsed = false;
+    std::string data_json;
+};
+
+struct LineBatch {
+    size_t sequence = 0;
+    std::vector<std::string> lines;
+    std::vector<IndexedLine> results;
+};
+
+// Hands batches from the reader to the workers, and their results to the
+// writer in the order they were read
+class BuildPipeline {
+public:
+    explicit BuildPipeline(size_t max_in_flight) : max_in_flight_(max_in_flight) {}
+
+    // Reader: waits while max_in_flight batches are read but not yet written
+    void push(LineBatch batch) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        space_.wait(lock, [&] { return in_flight_ < max_in_flight_; });
+        ++in_flight_;
+        ++pushed_;
+        pending_.push_back(std::move(batch));
+        work_.notify_one();
+    }
+
+    // Reader: no more batches
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        work_.notify_all();
+        indexed_.notify_all();
+    }
+
+    // Worker: the next batch to index; false once there are no more
+    bool take(LineBatch& batch) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        work_.wait(lock, [&] { return !pending_.empty() || closed_; });
+        if (pending_.empty()) return false;
+        batch = std::move(pending_.front());
+        pending_.pop_front();
+        return true;
+    }
+
+    // Worker: batch is indexed
+    void finish(LineBatch batch) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t sequence = batch.sequence;
+        done_.emplace(sequence, std::move(batch));
+        indexed_.notify_all();
+    }
+
+    // Writer: the batch after the last one it got; false at the end
+    bool next(LineBatch& batch) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        indexed_.wait(lock, [&] { return done_.count(next_sequence_) || (closed_ && next_sequence_ == pushed_); });
+        auto it = done_.find(next_sequence_);
+        if (it == done_.end()) return false;
+        batch = std::move(it->second);
+        done_.erase(it);
+        ++next_sequence_;
+        --in_flight_;
+        space_.notify_one();
+        return true;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable space_;
+    std::condition_variable work_;
+    std::condition_variable indexed_;
+    std::deque<LineBatch> pending_;
+    std::map<size_t, LineBatch> done_;
+    size_t max_in_flight_;
+    size_t in_flight_ = 0;
+    size_t pushed_ = 0;
+    size_t next_sequence_ = 0;
+    bool closed_ = false;
+};
+
+} // namespace
+
 // Reads dataset line-by-line and builds the index DIRECTLY to disk
-void ForwardIndexBuilder::build_index(const std::string& dataset_path) {
+void ForwardIndexBuilder::build_index(const std::string& dataset_path, size_t num_threads) {
     std::cout << "Reading dataset: " << dataset_path << std::endl;
     std::ifstream dataset(dataset_path);
     if (!dataset.is_open()) {
@@ -72,109 +251,61 @@ void ForwardIndexBuilder::build_index(const std::string& dataset_path) {
         std::cerr << "CRITICAL: Could not create " << output_path << std::endl;
         return;
     }
-    std::cout << "Streaming index to " << output_path << "..." << std::endl;
-
-    std::string line;
-    int doc_int_id = 0;
+    if (num_threads == 0) num_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "Streaming index to " << output_path << " (" << num_threads << " worker threads)..." << std::endl;
 
-    while (std::getline(dataset, line)) {
-        try {
-            auto doc_obj = json::parse(line);
-            
-            // Extract title and body tokens separately
-            std::vector<std::string> title_tokens;
-            std::vector<std::string> body_tokens;
-            
-            // Handle pre-tokenized format with title_tokens and body_tokens
-            if (doc_obj.contains("title_tokens") && doc_obj.contains("body_tokens")) {
-                title_tokens = doc_obj["title_tokens"].get<std::vector<std::string>>();
-                body_tokens = doc_obj["body_tokens"].get<std::vector<std::string>>();
-            } else if (doc_obj.contains("tokens")) {
-                // Legacy format: all tokens together (treat as body)
-                body_tokens = doc_obj["tokens"].get<std::vector<std::string>>();
-            } else {
-                // Tokenize from raw text fields
-                if (doc_obj.contains("title") && !doc_obj["title"].is_null()) {
-                    std::string title = doc_obj["title"].get<std::string>();
-                    title_tokens = tokenize(title);
-                }
-                if (doc_obj.contains("body") && !doc_obj["body"].is_null()) {
-                    std::string body = doc_obj["body"].get<std::string>();
-                    body_tokens = tokenize(body);
-                } else if (doc_obj.contains("abstract") && !doc_obj["abstract"].is_null()) {
-                    std::string abstract = doc_obj["abstract"].get<std::string>();
-                    body_tokens = tokenize(abstract);
-                }
-            }
+    BuildPipeline pipeline(num_threads * BATCHES_PER_WORKER);
 
-            // Map automatically sorts keys by WordID (0, 1, 2...)
-            std::map<int, WordStats> doc_stats;
-            int title_pos = 0;
-            int body_pos = 0;
-
-            // Process title tokens
-            for (const auto& token : title_tokens) {
-                std::string lower_token = token;
-                std::transform(lower_token.begin(), lower_token.end(), lower_token.begin(),
-                             [](unsigned char c) { return std::tolower(c); });
-                
-                if (lexicon_.count(lower_token)) {
-                    int id = lexicon_[lower_token];
-                    doc_stats[id].title_frequency++;
-                    doc_stats[id].title_positions.push_back(title_pos);
-                }
-                title_pos++;
+    std::thread reader([&] {
+        LineBatch batch;
+        std::string line;
+        while (std::getline(dataset, line)) {
+            batch.lines.push_back(std::move(line));
+            if (batch.lines.size() == LINES_PER_BATCH) {
+                size_t sequence = batch.sequence;
+                pipeline.push(std::move(batch));
+                batch = LineBatch();
+                batch.sequence = sequence + 1;
             }
+        }
+        if (!batch.lines.empty()) pipeline.push(std::move(batch));
+        pipeline.close();
+    });
 
-            // Process body tokens
-            for (const auto& token : body_tokens) {
-                std::string lower_token = token;
-                std::transform(lower_token.begin(), lower_token.end(), lower_token.begin(),
-                             [](unsigned char c) { return std::tolower(c); });
-                
-                if (lexicon_.count(lower_token)) {
-                    int id = lexicon_[lower_token];
-                    doc_stats[id].body_frequency++;
-                    doc_stats[id].body_positions.push_back(body_pos);
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < num_threads; ++t) {
+        workers.emplace_back([&] {
+            LineBatch batch;
+            while (pipeline.take(batch)) {
+                batch.results.resize(batch.lines.size());
+                for (size_t i = 0; i < batch.lines.size(); ++i) {
+                    batch.results[i].parsed = index_line(batch.lines[i], batch.results[i].data_json);
                 }
-                body_pos++;
+                batch.lines.clear();
+                pipeline.finish(std::move(batch));
             }
+        });
+    }
 
-            // Only store document if it contains valid words
-            if (!doc_stats.empty()) {
-                json doc_json;
-                int total_tokens = title_tokens.size() + body_tokens.size();
-                doc_json["doc_length"] = total_tokens; // Critical for BM25
-                doc_json["title_length"] = title_tokens.size();
-                doc_json["body_length"] = body_tokens.size();
-
-                json words_obj;
-                for (const auto& [id, stats] : doc_stats) {
-                    words_obj[std::to_string(id)] = {
-                        {"title_frequency", stats.title_frequency},
-                        {"body_frequency", stats.body_frequency},
-                        {"weighted_frequency", stats.get_weighted_frequency()},
-                        {"title_positions", stats.title_positions},
-                        {"body_positions", stats.body_positions}
-                    };
-                }
-                doc_json["words"] = words_obj;
-                
-                // OPTIMIZATION: Write immediately to disk instead of map
-                json line_obj;
-                line_obj["doc_id"] = std::to_string(doc_int_id);
-                line_obj["data"] = doc_json;
-
+    // Doc ids count the lines that parsed, in dataset order
+    int doc_int_id = 0;
+    LineBatch batch;
+    while (pipeline.next(batch)) {
+        for (const IndexedLine& result : batch.results) {
+            if (!result.parsed) continue;
+            if (!result.data_json.empty()) {
+                // Same bytes as json{{"doc_id", ...}, {"data", ...}}.dump(-1)
                 // Use \n instead of endl to avoid excessive flushing
-                outfile << line_obj.dump(-1) << "\n";
+                outfile << "{\"data\":" << result.data_json << ",\"doc_id\":\"" << doc_int_id << "\"}\n";
             }
-            
             doc_int_id++;
             // Simple logging to avoid spamming I/O
             if (doc_int_id % 5000 == 0) std::cout << "Processed " << doc_int_id << " docs...\r" << std::flush;
-
-        } catch (const std::exception&) { continue; }
+        }
     }
+
+    reader.join();
+    for (auto& worker : workers) worker.join();
     
     std::cout << "\nBuild Complete. Total documents processed: " << doc_int_id << std::endl;
 }
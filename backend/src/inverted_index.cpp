@@ -1,5 +1,12 @@
 #include "inverted_index.hpp"
+#include "BinaryBarrel.hpp"
+#include "SegmentManifest.hpp"
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
+#include <functional>
+#include <queue>
+#include <thread>
 
 namespace fs = std::filesystem;
 
@@ -8,30 +15,215 @@ InvertedIndexBuilder::InvertedIndexBuilder(int total_barrels) {
     total_barrels_ = total_barrels;
 }
 
+bool InvertedIndexBuilder::load_metadata(const std::string& metadata_path) {
+    has_metadata_ = metadata_.load(metadata_path);
+    if (has_metadata_) static_scores_ = StaticScores::build(metadata_, ranking_scorer_);
+    return has_metadata_;
+}
+
 // Distribute words evenly across barrels
 int InvertedIndexBuilder::get_barrel_id(int word_id) {
     return word_id % total_barrels_;
 }
 
+namespace {
+
+// A merged barrel takes up to about this many times its bytes in the runs in
+// memory: its entries with their position vectors, plus the sorted entry
+// pointers and encoded data BinaryBarrel::write builds from them
+constexpr uint64_t MERGE_MEMORY_FACTOR = 5;
+
+// One buffered posting; its positions are in a pool shared by the run
+struct RunPosting {
+    int32_t word_id;
+    int32_t doc_id;
+    int32_t frequency;
+    int32_t title_frequency;
+    int32_t doc_length;
+    int32_t title_length;
+    uint32_t num_positions;
+    uint64_t first_position;
+};
+
+// A posting as stored in a run file, followed by its positions
+struct RunRecord {
+    int32_t word_id;
+    int32_t doc_id;
+    int32_t frequency;
+    int32_t title_frequency;
+    int32_t doc_length;
+    int32_t title_length;
+    uint32_t num_positions;
+};
+
+// A spilled run: postings sorted by barrel, then word, then input order.
+// Barrel b's postings are the bytes [barrel_offsets[b], barrel_offsets[b + 1]).
+struct RunFile {
+    std::string path;
+    std::vector<uint64_t> barrel_offsets;
+};
+
+// Reads one barrel's section of a run file, a posting at a time
+class RunReader {
+public:
+    bool open(const RunFile& run, int barrel_id) {
+        position_ = run.barrel_offsets[barrel_id];
+        end_ = run.barrel_offsets[barrel_id + 1];
+        in_.open(run.path, std::ios::binary);
+        in_.seekg(static_cast<std::streamoff>(position_));
+        return static_cast<bool>(in_);
+    }
+
+    // Reads the next posting into word_id() / entry(); false at the end of
+    // the section or on a read error (failed())
+    bool next() {
+        if (position_ >= end_) return false;
+        RunRecord record;
+        if (!in_.read(reinterpret_cast<char*>(&record), sizeof(record))) return fail();
+        entry_ = InvertedEntry();
+        entry_.doc_id = record.doc_id;
+        entry_.frequency = record.frequency;
+        entry_.title_frequency = record.title_frequency;
+        entry_.doc_length = record.doc_length;
+        entry_.title_length = record.title_length;
+        uint64_t bytes = sizeof(record) + uint64_t{record.num_positions} * sizeof(int32_t);
+        if (position_ + bytes > end_) return fail();
+        entry_.positions.resize(record.num_positions);
+        if (!in_.read(reinterpret_cast<char*>(entry_.positions.data()),
+                      static_cast<std::streamsize>(record.num_positions * sizeof(int32_t)))) {
+            return fail();
+        }
+        word_id_ = record.word_id;
+        position_ += bytes;
+        return true;
+    }
+
+    int word_id() const { return word_id_; }
+    InvertedEntry& entry() { return entry_; }
+    bool failed() const { return failed_; }
+
+private:
+    bool fail() {
+        failed_ = true;
+        return false;
+    }
+
+    std::ifstream in_;
+    uint64_t position_ = 0;
+    uint64_t end_ = 0;
+    int word_id_ = 0;
+    InvertedEntry entry_;
+    bool failed_ = false;
+};
+
+// Sorts the buffered postings and writes them to run.path, filling in
+// run.barrel_offsets
+bool write_run(std::vector<RunPosting>& postings, const std::vector<int32_t>& positions,
+               int total_barrels, RunFile& run) {
+    // Stable: a word's postings keep their forward index order
+    std::stable_sort(postings.begin(), postings.end(), [total_barrels](const RunPosting& a, const RunPosting& b) {
+        int barrel_a = a.word_id % total_barrels;
+        int barrel_b = b.word_id % total_barrels;
+        return barrel_a != barrel_b ? barrel_a < barrel_b : a.word_id < b.word_id;
+    });
+
+    std::ofstream out(run.path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) return false;
+
+    run.barrel_offsets.assign(total_barrels + 1, 0);
+    uint64_t written = 0;
+    int barrel = 0;
+    for (const RunPosting& posting : postings) {
+        // Sections of barrels without postings in this run are empty
+        while (barrel <= posting.word_id % total_barrels) run.barrel_offsets[barrel++] = written;
+
+        RunRecord record{posting.word_id, posting.doc_id, posting.frequency,
+                         posting.title_frequency, posting.doc_length, posting.title_length,
+                         posting.num_positions};
+        out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        out.write(reinterpret_cast<const char*>(positions.data() + posting.first_position),
+                  static_cast<std::streamsize>(posting.num_positions * sizeof(int32_t)));
+        written += sizeof(record) + uint64_t{posting.num_positions} * sizeof(int32_t);
+    }
+    while (barrel <= total_barrels) run.barrel_offsets[barrel++] = written;
+
+    out.close();
+    return static_cast<bool>(out);
+}
+
+// K-way merge of one barrel's sections of all runs. Ties on a word go to the
+// earlier run, so postings stay in forward index order.
+bool merge_runs(const std::vector<RunFile>& runs, int barrel_id, BarrelMap& barrel) {
+    std::vector<RunReader> readers(runs.size());
+    using Head = std::pair<int, size_t>;  // (word id, run)
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+
+    for (size_t r = 0; r < runs.size(); ++r) {
+        if (runs[r].barrel_offsets[barrel_id] == runs[r].barrel_offsets[barrel_id + 1]) continue;
+        if (!readers[r].open(runs[r], barrel_id)) return false;
+        if (readers[r].next()) heads.emplace(readers[r].word_id(), r);
+        if (readers[r].failed()) return false;
+    }
+
+    while (!heads.empty()) {
+        auto [word_id, r] = heads.top();
+        heads.pop();
+        std::vector<InvertedEntry>& entries = barrel[word_id];
+        // The rest of this run's postings for the word come next in the file
+        do {
+            entries.push_back(std::move(readers[r].entry()));
+        } while (readers[r].next() && readers[r].word_id() == word_id);
+
+        if (readers[r].failed()) return false;
+        if (readers[r].word_id() != word_id) heads.emplace(readers[r].word_id(), r);
+    }
+    return true;
+}
+
+} // namespace
+
 // Main function to build the Inverted Index from a Forward Index
-void InvertedIndexBuilder::build(const std::string& forward_index_path, const std::string& output_dir) {
+bool InvertedIndexBuilder::build(const std::string& forward_index_path, const std::string& output_dir) {
     std::cout << "Loading Forward Index from: " << forward_index_path << std::endl;
     
     // Open the Forward Index file
     std::ifstream f(forward_index_path);
     if (!f.is_open()) {
         std::cerr << "CRITICAL ERROR: Could not open Forward Index!" << std::endl;
-        return;
+        return false;
     }
 
-    // RAM OPTIMIZATION: Process Line-by-Line (JSONL)
-    // We do NOT load the whole JSON into RAM anymore.
-    
-    std::vector<BarrelMap> barrels(total_barrels_);
+    std::string run_dir = run_dir_.empty() ? output_dir + "/runs" : run_dir_;
+    std::error_code ec;
+    fs::create_directories(run_dir, ec);
+
+    // RAM OPTIMIZATION: Process Line-by-Line (JSONL), and spill the postings
+    // to sorted runs whenever the memory budget is used up
+    std::vector<RunFile> runs;
+    std::vector<RunPosting> postings;
+    std::vector<int32_t> positions;
     std::string line;
     int total_docs_processed = 0;
+    bool spilled = true;
+    uint64_t total_length = 0;        // For the average field lengths
+    uint64_t total_title_length = 0;
+
+    auto remove_runs = [&runs]() {
+        std::error_code remove_ec;
+        for (const RunFile& run : runs) fs::remove(run.path, remove_ec);
+    };
+    auto spill = [&]() {
+        if (postings.empty()) return true;
+        RunFile run;
+        run.path = run_dir + "/run_" + std::to_string(runs.size()) + ".bin";
+        bool ok = write_run(postings, positions, total_barrels_, run);
+        runs.push_back(std::move(run));
+        postings.clear();
+        positions.clear();
+        return ok;
+    };
 
-    std::cout << "Inverting data..." << std::endl;
+    std::cout << "Inverting data (memory budget " << (memory_budget_ >> 20) << " MB)..." << std::endl;
 
     while (std::getline(f, line)) {
         if (line.empty()) continue;
@@ -44,24 +236,31 @@ void InvertedIndexBuilder::build(const std::string& forward_index_path, const st
             std::string doc_id_str = doc_line["doc_id"].get<std::string>();
             int doc_id = std::stoi(doc_id_str);
             json& doc_data = doc_line["data"];
+            int doc_length = std::max(0, doc_data.value("doc_length", 0));
+            int title_length = std::clamp(doc_data.value("title_length", 0), 0, doc_length);
 
             if (doc_data.contains("words")) {
                 for (auto& word_item : doc_data["words"].items()) {
                     int word_id = std::stoi(word_item.key());
+                    if (word_id < 0) continue;
                     json& stats = word_item.value();
 
-                    InvertedEntry entry;
-                    entry.doc_id = doc_id;
+                    RunPosting posting{};
+                    posting.word_id = word_id;
+                    posting.doc_id = doc_id;
+                    posting.doc_length = doc_length;
+                    posting.title_length = title_length;
+                    posting.title_frequency = stats.value("title_frequency", 0);
                     
                     if (stats.contains("weighted_frequency")) {
-                        entry.frequency = stats["weighted_frequency"].get<int>();
+                        posting.frequency = stats["weighted_frequency"].get<int>();
                     } else if (stats.contains("frequency")) {
-                        entry.frequency = stats["frequency"].get<int>();
+                        posting.frequency = stats["frequency"].get<int>();
                     } else {
                         // Fallback calc
                         int title_freq = stats.contains("title_frequency") ? stats["title_frequency"].get<int>() : 0;
                         int body_freq = stats.contains("body_frequency") ? stats["body_frequency"].get<int>() : 0;
-                        entry.frequency = title_freq * 3 + body_freq;
+                        posting.frequency = title_freq * 3 + body_freq;
                     }
 
                     // Collect positions
@@ -78,14 +277,18 @@ void InvertedIndexBuilder::build(const std::string& forward_index_path, const st
                     if (all_positions.empty() && stats.contains("positions")) {
                         all_positions = stats["positions"].get<std::vector<int>>();
                     }
-                    entry.positions = all_positions;
+                    posting.first_position = positions.size();
+                    posting.num_positions = static_cast<uint32_t>(all_positions.size());
+                    positions.insert(positions.end(), all_positions.begin(), all_positions.end());
 
-                    // Add to appropriate barrel in memory
-                    barrels[get_barrel_id(word_id)][word_id].push_back(entry);
+                    // Buffer until the next run is spilled
+                    postings.push_back(posting);
                 }
             }
             
             total_docs_processed++;
+            total_length += static_cast<uint64_t>(doc_length);
+            total_title_length += static_cast<uint64_t>(title_length);
             if (total_docs_processed % 5000 == 0) {
                 std::cout << "Processed " << total_docs_processed << " documents..." << std::endl;
             }
@@ -94,23 +297,159 @@ void InvertedIndexBuilder::build(const std::string& forward_index_path, const st
             // Skip malformed lines without crashing
             continue; 
         }
+
+        size_t buffered = postings.size() * sizeof(RunPosting) + positions.size() * sizeof(int32_t);
+        if (buffered >= memory_budget_) {
+            spilled = spill();
+            if (!spilled) break;
+        }
+    }
+
+    if (!spilled || !spill()) {
+        std::cerr << "CRITICAL ERROR: Could not write run file " << runs.back().path << std::endl;
+        remove_runs();
+        return false;
     }
 
     // Saves everything to disk
-    std::cout << "Inversion complete. Writing barrels to disk..." << std::endl;
+    std::cout << "Inversion complete (" << runs.size() << " runs). Merging runs into barrels..." << std::endl;
 
     if (!fs::exists(output_dir)) {
         fs::create_directories(output_dir);
     }
 
+    if (!has_metadata_) {
+        std::cout << "WARNING: No document metadata loaded, writing barrels without score bounds" << std::endl;
+    }
+
+    // BM25F statistics of the whole collection; every word's postings end up
+    // in one barrel, so each barrel computes its IDFs from its own lists
+    collection_ = CollectionStats();
+    collection_.num_documents = static_cast<uint32_t>(total_docs_processed);
+    if (total_docs_processed > 0) {
+        collection_.avg_title_length = static_cast<float>(static_cast<double>(total_title_length) / total_docs_processed);
+        collection_.avg_body_length =
+            static_cast<float>(static_cast<double>(total_length - total_title_length) / total_docs_processed);
+    }
+
+    // Barrels are written to a staging directory and only swapped in once
+    // all of them are built: base barrels that already hold the uploaded
+    // documents must not be served next to the segments that hold them too
+    std::string staging_dir = output_dir + "/staging";
+    fs::remove_all(staging_dir, ec);
+    fs::create_directories(staging_dir, ec);
+
+    // Barrels are independent: each worker takes the next one, merges it
+    // from the runs and writes it. Every worker holds a whole barrel, so by
+    // default only as many run as the largest barrel fits into the memory
+    // budget (at least one, at most one per core).
+    size_t num_threads = merge_threads_;
+    if (num_threads == 0) {
+        uint64_t largest_barrel = 0;
+        for (int i = 0; i < total_barrels_; ++i) {
+            uint64_t bytes = 0;
+            for (const RunFile& run : runs) bytes += run.barrel_offsets[i + 1] - run.barrel_offsets[i];
+            largest_barrel = std::max(largest_barrel, bytes);
+        }
+        uint64_t per_merge = std::max<uint64_t>(1, largest_barrel * MERGE_MEMORY_FACTOR);
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+        num_threads = static_cast<size_t>(std::clamp<uint64_t>(memory_budget_ / per_merge, 1, num_threads));
+    }
+    num_threads = std::min<size_t>(num_threads, std::max(1, total_barrels_));
+    std::cout << "Merging with " << num_threads << " threads" << std::endl;
+    std::atomic<int> next_barrel{0};
+    std::atomic<int> failed_barrels{0};
+    auto merge_barrels = [&]() {
+        for (int i = next_barrel++; i < total_barrels_; i = next_barrel++) {
+            BarrelMap barrel;
+            if (!merge_runs(runs, i, barrel)) {
+                std::cerr << "ERROR: Could not merge runs for Barrel " << i << std::endl;
+                failed_barrels++;
+                continue;
+            }
+            // Empty barrels are written too: a leftover file from an earlier
+            // build must not be served, and a missing one always means an error
+            if (!save_barrel(i, barrel, staging_dir)) {
+                failed_barrels++;
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < num_threads; ++t) workers.emplace_back(merge_barrels);
+    merge_barrels();
+    for (auto& worker : workers) worker.join();
+
+    remove_runs();
+    if (run_dir_.empty()) fs::remove(run_dir, ec);
+
+    // The segments and the delta log may be the only copy of uploaded
+    // postings a failed barrel should have held
+    if (failed_barrels > 0) {
+        std::cerr << "CRITICAL ERROR: " << failed_barrels << " barrels failed; keeping the previous barrels, "
+                  << "segments and delta log" << std::endl;
+        fs::remove_all(staging_dir, ec);
+        return false;
+    }
+
+    // Renames within one directory tree: nothing is copied
+    std::vector<std::string> extensions = {".bin"};
+    if (export_json_) extensions.push_back(".json");
     for (int i = 0; i < total_barrels_; ++i) {
-        if (!barrels[i].empty()) {
-            save_barrel(i, barrels[i], output_dir);
+        for (const std::string& extension : extensions) {
+            std::string name = "/inverted_barrel_" + std::to_string(i) + extension;
+            fs::rename(staging_dir + name, output_dir + name, ec);
+            if (ec) {
+                std::cerr << "CRITICAL ERROR: Could not move " << staging_dir + name << " into place ("
+                          << ec.message() << "); rerun the build" << std::endl;
+                return false;
+            }
         }
     }
+    fs::remove(staging_dir, ec);
+
+    // The forward index already holds every uploaded document: drop the
+    // segments and delta log built from them, or they'd be indexed twice
+    fs::remove(SegmentManifest::path(output_dir), ec);
+    fs::remove_all(output_dir + "/segments", ec);
+    std::string log_path = output_dir + "/inverted_delta.log";
+    if (fs::exists(log_path, ec)) {
+        DeltaLog(log_path).reset();
+    }
+    return true;
 }
-// Saves one barrel map to a JSON file
-void InvertedIndexBuilder::save_barrel(int barrel_id, const BarrelMap& barrel_data, const std::string& output_dir) {
+// Saves one barrel map to the binary format the server mmaps
+bool InvertedIndexBuilder::save_barrel(int barrel_id, const BarrelMap& barrel_data, const std::string& output_dir) {
+    std::string filename = output_dir + "/inverted_barrel_" + std::to_string(barrel_id) + ".bin";
+
+    // Upper bounds for top-k pruning: the exact score SearchService would give each posting
+    BarrelScoring scoring;
+    scoring.collection = collection_;
+    if (has_metadata_) {
+        scoring.score = [this](int, float idf, const CollectionStats& collection, const InvertedEntry& entry) {
+            return ranking_scorer_.calculate_document_score(
+                idf, collection, entry.title_frequency, entry.positions.data(), entry.positions.size(),
+                entry.doc_length, entry.title_length, static_scores_->get(entry.doc_id)
+            ).final_score;
+        };
+    }
+
+    if (!BinaryBarrel::write(filename, barrel_data, scoring)) {
+        std::cerr << "ERROR: Could not write Barrel " << barrel_id << std::endl;
+        return false;
+    }
+
+    if (export_json_) {
+        save_barrel_json(barrel_id, barrel_data, output_dir);
+    }
+
+    // One string per line: barrels are saved from several threads
+    std::cout << "Saved Barrel " + std::to_string(barrel_id) + " (" + std::to_string(barrel_data.size()) +
+                 " unique words)\n" << std::flush;
+    return true;
+}
+
+// Export option: saves one barrel map to a JSON file (not used by the server)
+void InvertedIndexBuilder::save_barrel_json(int barrel_id, const BarrelMap& barrel_data, const std::string& output_dir) {
     json j_barrel;
     
     // Loop through every word in this barrel
@@ -136,92 +475,30 @@ void InvertedIndexBuilder::save_barrel(int barrel_id, const BarrelMap& barrel_da
     std::string filename = output_dir + "/inverted_barrel_" + std::to_string(barrel_id) + ".json";
     std::ofstream out(filename);
     out << j_barrel.dump(-1);
-    
-    std::cout << "Saved Barrel " << barrel_id << " (" << barrel_data.size() << " unique words)" << std::endl;
 }
 
-// Add a single document to the Delta Barrel (for Dynamic Uploads)
-void InvertedIndexBuilder::update_delta_barrel(int doc_id, const std::map<int, WordStats>& doc_stats) {
-    std::string delta_path = "data/processed/barrels/inverted_delta.json";
-    json delta_json;
-
-    // 1. Load existing Delta (if exists)
-    std::ifstream in(delta_path);
-    if (in.good()) {
-        try { in >> delta_json; } catch(...) {}
-    }
-    in.close();
+DeltaDocument InvertedIndexBuilder::make_delta_document(int doc_id, const std::map<int, WordStats>& doc_stats) {
+    DeltaDocument doc;
+    doc.doc_id = doc_id;
+    doc.postings.reserve(doc_stats.size());
 
-    // 2. Add new entries
     for (const auto& [word_id, stats] : doc_stats) {
-        std::string w_id_str = std::to_string(word_id);
-        
         // Merge title and body positions
         std::vector<int> all_positions = stats.title_positions;
         all_positions.insert(all_positions.end(), stats.body_positions.begin(), stats.body_positions.end());
-        
-        json entry = json::array({
-            doc_id,
-            stats.get_weighted_frequency(),
-            all_positions
-        });
-
-        if (delta_json.contains(w_id_str)) {
-            delta_json[w_id_str].push_back(entry);
-        } else {
-            delta_json[w_id_str] = json::array({ entry });
-        }
-    }
 
-    // 3. Save Delta
-    std::ofstream out(delta_path);
-    out << delta_json.dump(-1);
-    std::cout << "[InvertedIndex] Updated Delta Barrel for doc " << doc_id << std::endl;
+        doc.postings.push_back({word_id, stats.get_weighted_frequency(), std::move(all_positions)});
+    }
+    return doc;
 }
 
-// NEW: End-of-Day Merge
-void InvertedIndexBuilder::merge_delta_to_main(const std::string& output_dir) {
-    std::string delta_path = output_dir + "/inverted_delta.json";
-    std::ifstream in(delta_path);
-    if (!in.good()) return;
-
-    std::cout << "[Maintenance] Merging Delta Barrel into Main Barrels...\n";
-    json delta_json;
-    in >> delta_json;
-    in.close();
-
-    // Group updates by Barrel ID to minimize disk I/O
-    std::map<int, std::map<std::string, json>> updates_by_barrel;
-    for (auto& [word_id_str, new_entries] : delta_json.items()) {
-        int word_id = std::stoi(word_id_str);
-        int barrel_id = get_barrel_id(word_id);
-        updates_by_barrel[barrel_id][word_id_str] = new_entries;
-    }
-
-    // Process each affected barrel
-    for (auto& [barrel_id, updates] : updates_by_barrel) {
-        std::string barrel_path = output_dir + "/inverted_barrel_" + std::to_string(barrel_id) + ".json";
-        json main_barrel;
-        
-        std::ifstream bf(barrel_path);
-        if (bf.good()) { try { bf >> main_barrel; } catch(...) {} }
-        bf.close();
-
-        for (auto& [w_id, entries] : updates) {
-            if (main_barrel.contains(w_id)) {
-                for(auto& e : entries) main_barrel[w_id].push_back(e);
-            } else {
-                main_barrel[w_id] = entries;
-            }
-        }
+bool InvertedIndexBuilder::append_delta(const std::vector<DeltaDocument>& documents) {
+    return delta_log_.append(documents);
+}
 
-        std::ofstream out(barrel_path);
-        out << main_barrel.dump(-1);
-        std::cout << "  Merged updates into Barrel " << barrel_id << "\n";
+// Add a single document to the Delta Barrel (for Dynamic Uploads)
+void InvertedIndexBuilder::update_delta_barrel(int doc_id, const std::map<int, WordStats>& doc_stats) {
+    if (append_delta({make_delta_document(doc_id, doc_stats)})) {
+        std::cout << "[InvertedIndex] Updated Delta Barrel for doc " << doc_id << std::endl;
     }
-
-    // Clear Delta File
-    std::ofstream clear(delta_path);
-    clear << "{}";
-    std::cout << "[Maintenance] Merge Complete. Delta barrel cleared.\n";
-}
\ No newline at end of file
+}
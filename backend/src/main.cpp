@@ -2,11 +2,14 @@
 #include "SearchService.hpp"
 #include "BatchIndexWriter.hpp"
 #include "PDFProcessingPool.hpp"
+#include "TokenizerWorkerPool.hpp"
+#include "MergeScheduler.hpp"
 #include "lexicon.hpp"
 #include "forward_index.hpp"
 #include "inverted_index.hpp"
 #include "DocumentMetadata.hpp"
 #include "doc_url_mapper.hpp"
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <filesystem>
@@ -28,7 +31,7 @@ static UploadProgress g_upload_progress;
 
 int main() {
     std::cout << "[Main] Initializing search engine...\n";
-    SearchService engine;
+    SearchService engine(256 * 1024 * 1024);  // Barrel cache budget (bytes)
     
     // Initialize components for PDF processing
     Lexicon lexicon;
@@ -42,6 +45,15 @@ int main() {
     DocumentMetadata metadata;
     metadata.load("data/processed/document_metadata.json");
     
+    // Doc ids for uploads come from this counter, never from the metadata
+    // file: the batch writer persists that in the background, after the
+    // documents are already searchable, so it can lag behind ids handed out
+    std::mutex doc_id_mutex;
+    int next_doc_id = 0;
+    metadata.for_each([&next_doc_id](const DocMetadata& meta) {
+        next_doc_id = std::max(next_doc_id, meta.doc_id + 1);
+    });
+    
     DocURLMapper url_mapper;
     url_mapper.load("data/processed/docid_to_url.json");
     
@@ -56,11 +68,32 @@ int main() {
         std::chrono::seconds(30)  // flush_interval
     );
     
+    // Flushed batches go straight into the engine's in-memory segment;
+    // the index files are written in the background
+    batch_writer.set_publisher([&engine](std::vector<SegmentDocument> documents) {
+        engine.add_documents(std::move(documents));
+    });
+    
+    // Flushes the delta log into on-disk segments and merges them in the background
+    MergeScheduler merge_scheduler(
+        "data/processed/barrels",
+        inverted_builder.delta_log(),
+        [&engine](const SegmentManifest& manifest, const std::unordered_set<int>& flushed_doc_ids,
+                  const std::vector<std::string>& merged_dirs) {
+            engine.publish_segments(manifest, flushed_doc_ids, merged_dirs);
+        },
+        [&engine]() { return engine.barrel_scoring(); }
+    );
+    
     // Initialize processing pool
     size_t num_workers = std::thread::hardware_concurrency();
     if (num_workers == 0) num_workers = 4;
     
-    PDFProcessingPool processing_pool(num_workers, batch_writer, lexicon);
+    // Python tokenizers for the PDFs the in-process extractor can't read;
+    // started in the background, ready before they are needed
+    TokenizerWorkerPool tokenizer_workers;
+    
+    PDFProcessingPool processing_pool(num_workers, batch_writer, lexicon, tokenizer_workers);
     
     std::cout << "[Main] Async processing pool ready with " << num_workers << " workers\n";
     
@@ -111,8 +144,8 @@ int main() {
     <p>Backend server is running successfully!</p>
     <h2>Available Endpoints:</h2>
     <div class="endpoint">
-        <span class="method">GET</span> <code>/search?q=&lt;query&gt;</code><br>
-        Search for documents matching the query<br>
+        <span class="method">GET</span> <code>/search?q=&lt;query&gt;&amp;mode=&lt;lexical|semantic|hybrid&gt;&amp;nprobe=&lt;num&gt;</code><br>
+        Search for documents matching the query (mode is optional, lexical by default; nprobe sets the IVF-PQ lists scanned)<br>
         <a href="/search?q=computer" target="_blank">Try example: /search?q=computer</a>
     </div>
     <div class="endpoint">
@@ -132,11 +165,28 @@ int main() {
         res.set_content(html, "text/html");
     });
 
-    // Define Route: /search?q=...
+    // Define Route: /search?q=...&mode=lexical|semantic|hybrid&nprobe=16
     svr.Get("/search", [&](const httplib::Request& req, httplib::Response& res) {
         if (req.has_param("q")) {
+            SearchMode mode = SearchMode::Lexical;
+            if (req.has_param("mode") && !parse_search_mode(req.get_param_value("mode"), mode)) {
+                res.status = 400;
+                res.set_content("{\"error\": \"Unknown 'mode' (expected lexical, semantic or hybrid)\"}", "application/json");
+                return;
+            }
+            // IVF-PQ lists to scan in semantic / hybrid mode (more: better recall, slower)
+            int nprobe = 0;
+            if (req.has_param("nprobe")) {
+                try {
+                    nprobe = std::stoi(req.get_param_value("nprobe"));
+                    if (nprobe < 1) nprobe = 1;
+                    if (nprobe > 1024) nprobe = 1024;
+                } catch (...) {
+                    nprobe = 0;
+                }
+            }
             std::string query = req.get_param_value("q");
-            std::string json_output = engine.search(query);
+            std::string json_output = engine.search(query, mode, static_cast<size_t>(nprobe));
             res.set_content(json_output, "application/json");
         } else {
             res.status = 400;
@@ -224,7 +274,7 @@ int main() {
     });
 
     // OPTIMIZED Route: /upload - Async PDF uploads with concurrent processing
-    svr.Post("/upload", [&processing_pool, &batch_writer, &metadata, &engine](
+    svr.Post("/upload", [&processing_pool, &batch_writer, &doc_id_mutex, &next_doc_id](
         const httplib::Request& req, httplib::Response& res) {
         
         try {
@@ -251,22 +301,6 @@ int main() {
             std::vector<std::future<int>> futures;
             std::vector<int> new_doc_ids;
             
-            // Get the ACTUAL highest doc_id from metadata file (not the cached count)
-            int next_doc_id = 0;
-            {
-                std::ifstream meta_file("data/processed/document_metadata.json");
-                if (meta_file.is_open()) {
-                    json meta_json;
-                    meta_file >> meta_json;
-                    for (auto& [key, value] : meta_json.items()) {
-                        int doc_id = std::stoi(key);
-                        if (doc_id >= next_doc_id) {
-                            next_doc_id = doc_id + 1;
-                        }
-                    }
-                }
-            }
-            
             if (req.form.has_file("files")) {
                 auto files = req.form.get_files("files");
                 
@@ -297,14 +331,19 @@ int main() {
                     out.write(file.content.data(), file.content.size());
                     out.close();
                     
+                    int doc_id;
+                    {
+                        std::lock_guard<std::mutex> lock(doc_id_mutex);
+                        doc_id = next_doc_id++;
+                    }
+                    
                     std::cout << "[Upload] Saved: " << filename << " (doc_id will be " 
-                              << next_doc_id << ")\n";
+                              << doc_id << ")\n";
                     
-                    auto future = processing_pool.submit_pdf(temp_path, next_doc_id);
+                    auto future = processing_pool.submit_pdf(temp_path, doc_id);
                     futures.push_back(std::move(future));
-                    new_doc_ids.push_back(next_doc_id);
+                    new_doc_ids.push_back(doc_id);
                     
-                    next_doc_id++;
                     uploaded_count++;
                 }
             }
@@ -341,19 +380,13 @@ int main() {
                 g_upload_progress.current_status.push_back("Building search indices...");
             }
             
-            // Force immediate batch flush to write indices
+            // Force immediate batch flush: publishes the documents to the search
+            // engine's in-memory segment, files are written in the background
             if (uploaded_count > 0) {
                 std::cout << "[Upload] Flushing batch to index...\n";
                 batch_writer.flush_now();
                 std::cout << "[Upload] ✅ Batch flush completed!\n";
                 
-                // Small delay to ensure all file writes are synced to disk
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                
-                std::cout << "[Upload] Reloading search engine indices...\n";
-                engine.reload_delta_index();
-                engine.reload_metadata();
-                
                 // Update progress: Done
                 {
                     std::lock_guard<std::mutex> lock(g_upload_progress.mutex);
@@ -404,7 +437,7 @@ int main() {
     });
 
     // Stats endpoint for monitoring
-    svr.Get("/stats", [&processing_pool, &batch_writer](
+    svr.Get("/stats", [&processing_pool, &tokenizer_workers, &batch_writer, &merge_scheduler, &engine](
         const httplib::Request&, httplib::Response& res) {
         
         auto pool_stats = processing_pool.get_stats();
@@ -415,14 +448,70 @@ int main() {
             {"active_workers", pool_stats.active_workers},
             {"queue_size", pool_stats.queue_size},
             {"completed_tasks", pool_stats.completed_tasks},
-            {"failed_tasks", pool_stats.failed_tasks}
+            {"failed_tasks", pool_stats.failed_tasks},
+            {"native_extractions", pool_stats.native_extractions},
+            {"fallback_extractions", pool_stats.fallback_extractions}
+        };
+        auto tokenizer_stats = tokenizer_workers.get_stats();
+        nlohmann::json workers_json = nlohmann::json::array();
+        for (const auto& worker : tokenizer_stats.workers) {
+            workers_json.push_back({
+                {"pid", worker.pid},
+                {"alive", worker.alive},
+                {"requests", worker.requests},
+                {"failures", worker.failures},
+                {"restarts", worker.restarts},
+                {"avg_latency_ms", worker.avg_latency_ms},
+                {"max_latency_ms", worker.max_latency_ms},
+                {"last_latency_ms", worker.last_latency_ms}
+            });
+        }
+        stats_json["tokenizer_workers"] = {
+            {"requests", tokenizer_stats.requests},
+            {"failures", tokenizer_stats.failures},
+            {"restarts", tokenizer_stats.restarts},
+            {"health_checks", tokenizer_stats.health_checks},
+            {"workers", workers_json}
         };
         stats_json["batch_writer"] = {
             {"documents_queued", batch_stats.documents_queued},
             {"documents_indexed", batch_stats.documents_indexed},
+            {"documents_persisted", batch_stats.documents_persisted},
             {"batches_flushed", batch_stats.batches_flushed},
             {"avg_batch_time_ms", batch_stats.avg_batch_time_ms},
-            {"current_queue_size", batch_stats.current_queue_size}
+            {"current_queue_size", batch_stats.current_queue_size},
+            {"pending_persist_batches", batch_stats.pending_persist_batches}
+        };
+        
+        auto cache_stats = engine.barrel_cache_stats();
+        stats_json["barrel_cache"] = {
+            {"hits", cache_stats.hits},
+            {"misses", cache_stats.misses},
+            {"evictions", cache_stats.evictions},
+            {"entries", cache_stats.entries},
+            {"bytes", cache_stats.bytes},
+            {"capacity_bytes", cache_stats.capacity_bytes}
+        };
+        
+        auto index = engine.snapshot();
+        stats_json["index"] = {
+            {"snapshot_generation", index->generation},
+            {"delta_words", index->delta->num_words()},
+            {"delta_documents", index->delta->num_documents()},
+            {"segments", index->segments.size()},
+            {"documents", index->doc_stats->size()},
+            {"doc_stats_rebuilding", engine.doc_stats_rebuilding()}
+        };
+        
+        auto merge_stats = merge_scheduler.get_stats();
+        stats_json["segments"] = {
+            {"segments", merge_stats.segments},
+            {"pending_documents", merge_stats.pending_documents},
+            {"flushes", merge_stats.flushes},
+            {"merges", merge_stats.merges},
+            {"documents_flushed", merge_stats.documents_flushed},
+            {"bytes_written", merge_stats.bytes_written},
+            {"throttled_ms", merge_stats.throttled_ms}
         };
         
         res.set_content(stats_json.dump(2), "application/json");
@@ -432,7 +521,7 @@ int main() {
     std::cout << "   DSA Search Engine - OPTIMIZED" << std::endl;
     std::cout << "======================================" << std::endl;
     std::cout << "API Endpoints:" << std::endl;
-    std::cout << "  - GET  /search?q=<query>" << std::endl;
+    std::cout << "  - GET  /search?q=<query>&mode=<lexical|semantic|hybrid>&nprobe=<num>" << std::endl;
     std::cout << "  - GET  /autocomplete?q=<prefix>&limit=<num>" << std::endl;
     std::cout << "  - POST /upload (multipart/form-data)" << std::endl;
     std::cout << "  - GET  /download/<doc_id>" << std::endl;
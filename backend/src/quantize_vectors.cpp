@@ -0,0 +1,141 @@
+#include "DocumentVectors.hpp"
+#include "WordEmbeddings.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Writes float16 / int8 copies of the semantic vector files. The server
+// prefers the _q files when they exist and keeps using the float32
+// document_vectors.bin for exact re-scoring of its final results.
+//
+//   quantize_vectors <float16|int8> [--docs IN OUT] [--words IN OUT]
+
+namespace {
+
+constexpr uint32_t EMBEDDING_DIM = 300;
+constexpr uint32_t SAMPLE_PAIRS = 2000;
+
+double megabytes(size_t bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+// Largest and mean |error| of document-document similarities after quantization,
+// over a fixed sample of row pairs
+void report_error(const DocumentVectors& original, const DocumentVectors& quantized) {
+    uint32_t rows = original.num_rows();
+    if (rows < 2) return;
+
+    std::vector<float> a(EMBEDDING_DIM), b(EMBEDDING_DIM);
+    double max_error = 0.0, total_error = 0.0;
+    uint32_t pairs = 0;
+    for (uint32_t i = 0; i < SAMPLE_PAIRS; ++i) {
+        uint32_t row_a = static_cast<uint32_t>((uint64_t{i} * 2654435761u) % rows);
+        uint32_t row_b = static_cast<uint32_t>((uint64_t{i} * 40503u + 1) % rows);
+        original.decode(row_a, a.data());
+        original.decode(row_b, b.data());
+        double exact = original.dot(a.data(), row_b);
+        double approximate = quantized.dot(a.data(), row_b);
+        double error = std::fabs(exact - approximate);
+        max_error = std::max(max_error, error);
+        total_error += error;
+        ++pairs;
+    }
+    std::cout << "  Similarity error over " << pairs << " pairs: max " << max_error
+              << ", mean " << total_error / pairs << "\n";
+}
+
+bool convert_documents(const std::string& in, const std::string& out, vector_format::Encoding encoding) {
+    DocumentVectors original;
+    if (!original.load(in, EMBEDDING_DIM)) {
+        std::cerr << "Could not load document vectors from " << in << "\n";
+        return false;
+    }
+    std::string error;
+    if (!DocumentVectors::write(out, original, encoding, error)) {
+        std::cerr << "Could not write " << out << ": " << error << "\n";
+        return false;
+    }
+
+    DocumentVectors quantized;
+    if (!quantized.load(out, EMBEDDING_DIM)) {
+        std::cerr << "Could not read back " << out << "\n";
+        return false;
+    }
+    std::cout << "Document vectors: " << original.num_documents() << " docs, "
+              << megabytes(original.data_bytes()) << " MB -> " << megabytes(quantized.data_bytes())
+              << " MB (" << out << ")\n";
+    report_error(original, quantized);
+    return true;
+}
+
+bool convert_words(const std::string& in, const std::string& out, vector_format::Encoding encoding) {
+    WordEmbeddings original;
+    if (!original.load(in, EMBEDDING_DIM)) {
+        std::cerr << "Could not load word embeddings from " << in << "\n";
+        return false;
+    }
+    std::string error;
+    if (!WordEmbeddings::write(out, original, encoding, error)) {
+        std::cerr << "Could not write " << out << ": " << error << "\n";
+        return false;
+    }
+
+    WordEmbeddings quantized;
+    if (!quantized.load(out, EMBEDDING_DIM)) {
+        std::cerr << "Could not read back " << out << "\n";
+        return false;
+    }
+    std::cout << "Word embeddings: " << original.size() << " words, "
+              << megabytes(original.data_bytes()) << " MB -> " << megabytes(quantized.data_bytes())
+              << " MB (" << out << ")\n";
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string docs_in = "data/processed/document_vectors.bin";
+    std::string docs_out = "data/processed/document_vectors_q.bin";
+    std::string words_in = "data/processed/word_embeddings.bin";
+    std::string words_out = "data/processed/word_embeddings_q.bin";
+
+    vector_format::Encoding encoding;
+    if (argc < 2 || !vector_format::parse_encoding(argv[1], encoding) ||
+        encoding == vector_format::Encoding::Float32) {
+        std::cerr << "Usage: " << argv[0] << " <float16|int8> [--docs IN OUT] [--words IN OUT]\n";
+        return 1;
+    }
+
+    bool docs = true, words = true;
+    bool explicit_files = false;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if ((arg == "--docs" || arg == "--words") && i + 2 < argc) {
+            if (!explicit_files) {
+                docs = words = false;
+                explicit_files = true;
+            }
+            if (arg == "--docs") {
+                docs = true;
+                docs_in = argv[i + 1];
+                docs_out = argv[i + 2];
+            } else {
+                words = true;
+                words_in = argv[i + 1];
+                words_out = argv[i + 2];
+            }
+            i += 2;
+        } else {
+            std::cerr << "Unknown or incomplete argument: " << arg << "\n";
+            return 1;
+        }
+    }
+
+    std::cout << "Encoding: " << vector_format::encoding_name(encoding) << "\n";
+    bool ok = true;
+    if (docs) ok = convert_documents(docs_in, docs_out, encoding) && ok;
+    if (words) ok = convert_words(words_in, words_out, encoding) && ok;
+    return ok ? 0 : 1;
+}
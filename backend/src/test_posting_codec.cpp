@@ -0,0 +1,191 @@
+#include "PostingCodec.hpp"
+#include "CpuFeatures.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Checks the dispatched Stream VByte decoder (SSSE3 where supported) and
+// prefix sum (SSE2) against the scalar versions and the encoder's input, and
+// encoded_size against the bytes written: 1, 2, 3 and 4 byte values and their
+// boundaries, lengths that leave a partial control byte at the end of a
+// block, streams that end right at the decoder padding, blocks decoded back
+// to back, and zigzag coded position gaps that go negative.
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const string& what) {
+    if (!ok) {
+        cerr << "FAIL: " << what << "\n";
+        ++failures;
+    }
+}
+
+const size_t LENGTHS[] = {0, 1, 2, 3, 4, 5, 7, 8, 15, 16, 17, 31, 64, 125, 126, 127, 128};
+
+// Values of byte length 1-4 (bytes == 0: any), boundaries included
+vector<uint32_t> random_values(mt19937& rng, size_t n, int bytes) {
+    const uint32_t low[] = {0, 1u << 8, 1u << 16, 1u << 24};
+    const uint32_t high[] = {(1u << 8) - 1, (1u << 16) - 1, (1u << 24) - 1, UINT32_MAX};
+    uniform_int_distribution<int> pick_length(0, 3);
+    uniform_int_distribution<int> pick_kind(0, 3);
+    vector<uint32_t> values(n);
+    for (uint32_t& v : values) {
+        int length = bytes ? bytes - 1 : pick_length(rng);
+        int kind = pick_kind(rng);
+        if (kind == 0) {
+            v = low[length];
+        } else if (kind == 1) {
+            v = high[length];
+        } else {
+            v = uniform_int_distribution<uint32_t>(low[length], high[length])(rng);
+        }
+    }
+    return values;
+}
+
+// Encodes values and decodes them with both decoders. The stream is copied
+// to the very end of a buffer holding just it and the padding, so reading
+// further than DECODE_PADDING would run off the allocation.
+void round_trip(const vector<uint32_t>& values, const string& name) {
+    size_t n = values.size();
+    vector<uint8_t> encoded;
+    size_t bytes = posting_codec::encode(values.data(), n, encoded);
+    check(bytes == encoded.size(), name + " encode size");
+    check(posting_codec::encoded_size(encoded.data(), n) == bytes, name + " encoded_size");
+
+    vector<uint8_t> padded(encoded.size() + posting_codec::DECODE_PADDING, 0xAB);
+    if (!encoded.empty()) memcpy(padded.data(), encoded.data(), encoded.size());
+
+    const uint32_t guard = 0xDEADBEEF;
+    for (bool simd : {false, true}) {
+        vector<uint32_t> out(n + 1, guard);
+        size_t consumed = simd ? posting_codec::decode(padded.data(), n, out.data())
+                               : posting_codec::decode_scalar(padded.data(), n, out.data());
+        string which = name + (simd ? " decode" : " scalar decode");
+        check(consumed == bytes, which + " consumed " + to_string(consumed) + " of " + to_string(bytes) + " bytes");
+        check(equal(values.begin(), values.end(), out.begin()), which + " values");
+        check(out[n] == guard, which + " wrote past the end");
+    }
+}
+
+void test_round_trip(mt19937& rng) {
+    for (size_t n : LENGTHS) {
+        for (int bytes = 0; bytes <= 4; ++bytes) {
+            round_trip(random_values(rng, n, bytes), "n=" + to_string(n) + " bytes=" + to_string(bytes));
+        }
+    }
+
+    // A wide value in every lane of a partial last control byte
+    for (size_t n : {size_t{125}, size_t{126}, size_t{127}}) {
+        for (size_t tail = 0; tail < n % 4; ++tail) {
+            vector<uint32_t> values = random_values(rng, n, 1);
+            values[n - n % 4 + tail] = UINT32_MAX;
+            round_trip(values, "n=" + to_string(n) + " wide tail lane " + to_string(tail));
+        }
+    }
+}
+
+// The streams of one block, back to back as BinaryBarrel writes them
+void test_consecutive_streams(mt19937& rng) {
+    vector<uint32_t> first = random_values(rng, 127, 0);
+    vector<uint32_t> second = random_values(rng, 5, 0);
+    vector<uint8_t> encoded;
+    size_t first_bytes = posting_codec::encode(first.data(), first.size(), encoded);
+    posting_codec::encode(second.data(), second.size(), encoded);
+    encoded.resize(encoded.size() + posting_codec::DECODE_PADDING, 0);
+
+    vector<uint32_t> out(first.size());
+    size_t consumed = posting_codec::decode(encoded.data(), first.size(), out.data());
+    check(consumed == first_bytes && out == first, "first of two streams");
+    out.resize(second.size());
+    posting_codec::decode(encoded.data() + consumed, second.size(), out.data());
+    check(out == second, "second of two streams");
+}
+
+void test_prefix_sum(mt19937& rng) {
+    for (size_t n : LENGTHS) {
+        // Sorted doc ids, some next to the top of the int range
+        vector<uint32_t> ids(n);
+        uniform_int_distribution<uint32_t> gap(1, 1000);
+        uint32_t base = n % 2 ? static_cast<uint32_t>(INT_MAX) - 1000 * static_cast<uint32_t>(n) - 1 : 17;
+        uint32_t next = base;
+        for (uint32_t& id : ids) id = next += gap(rng);
+
+        vector<uint32_t> gaps = ids;
+        posting_codec::delta_encode(gaps.data(), n, base);
+
+        vector<uint32_t> simd = gaps;
+        vector<uint32_t> scalar = gaps;
+        posting_codec::prefix_sum(simd.data(), n, base);
+        posting_codec::prefix_sum_scalar(scalar.data(), n, base);
+        check(scalar == ids, "scalar prefix sum n=" + to_string(n));
+        check(simd == ids, "prefix sum n=" + to_string(n));
+
+        // Gaps through the decoder, as a block's doc ids take them
+        round_trip(gaps, "doc id gaps n=" + to_string(n));
+    }
+}
+
+void test_zigzag(mt19937& rng) {
+    for (int32_t v : {0, 1, -1, 2, -2, 127, -128, INT_MAX, INT_MIN}) {
+        check(posting_codec::zigzag_decode(posting_codec::zigzag_encode(v)) == v, "zigzag " + to_string(v));
+    }
+    check(posting_codec::zigzag_encode(-1) == 1 && posting_codec::zigzag_encode(1) == 2, "zigzag order");
+
+    // Positions of a block: title positions, then body positions restarting
+    // at 0, so gaps go negative
+    for (size_t n : LENGTHS) {
+        uniform_int_distribution<int32_t> position(0, 1 << 20);
+        vector<int32_t> positions(n);
+        for (int32_t& p : positions) p = position(rng);
+
+        vector<uint32_t> gaps(n);
+        int32_t previous = 0;
+        for (size_t i = 0; i < n; ++i) {
+            gaps[i] = posting_codec::zigzag_encode(positions[i] - previous);
+            previous = positions[i];
+        }
+        vector<uint8_t> encoded;
+        posting_codec::encode(gaps.data(), n, encoded);
+        encoded.resize(encoded.size() + posting_codec::DECODE_PADDING, 0);
+
+        vector<uint32_t> decoded(n);
+        posting_codec::decode(encoded.data(), n, decoded.data());
+        vector<int32_t> restored(n);
+        previous = 0;
+        for (size_t i = 0; i < n; ++i) {
+            previous += posting_codec::zigzag_decode(decoded[i]);
+            restored[i] = previous;
+        }
+        check(restored == positions, "zigzag positions n=" + to_string(n));
+    }
+}
+
+} // namespace
+
+int main() {
+    mt19937 rng(42);
+
+    cout << "Decoder: " << (cpu::has_ssse3() ? "SSSE3" : "scalar") << "\n";
+
+    test_round_trip(rng);
+    test_consecutive_streams(rng);
+    test_prefix_sum(rng);
+    test_zigzag(rng);
+
+    if (failures > 0) {
+        cerr << failures << " check(s) failed\n";
+        return 1;
+    }
+    cout << "All posting codec checks passed\n";
+    return 0;
+}
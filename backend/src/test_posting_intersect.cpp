@@ -0,0 +1,158 @@
+#include "PostingIntersect.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Checks the dispatched lower_bound / intersect (AVX2 where supported)
+// against the scalar versions and std::lower_bound / std::set_intersection:
+// empty and single-element lists, lengths around multiples of 8, doc ids
+// next to INT_MAX, targets before the first and past the last value, and
+// intersecting in place. Also checks gallop() from every start position.
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const string& what) {
+    if (!ok) {
+        cerr << "FAIL: " << what << "\n";
+        ++failures;
+    }
+}
+
+const size_t LENGTHS[] = {0, 1, 2, 7, 8, 9, 15, 16, 17, 31, 64, 127, 128};
+
+// n sorted, distinct doc ids; high ones end at INT_MAX
+vector<int32_t> sorted_ids(mt19937& rng, size_t n, bool high, int32_t spread) {
+    uniform_int_distribution<int32_t> gap(1, spread);
+    vector<int32_t> ids(n);
+    int32_t next = 0;
+    for (size_t i = 0; i < n; ++i) {
+        next += gap(rng);
+        ids[i] = next;
+    }
+    if (high && n > 0) {
+        int32_t shift = INT_MAX - ids.back();
+        for (int32_t& id : ids) id += shift;
+    }
+    return ids;
+}
+
+void test_lower_bound(mt19937& rng) {
+    for (size_t n : LENGTHS) {
+        for (bool high : {false, true}) {
+            vector<int32_t> ids = sorted_ids(rng, n, high, 5);
+
+            vector<int32_t> targets = {INT_MIN, -1, 0, INT_MAX};
+            for (int32_t id : ids) {
+                targets.push_back(id);
+                targets.push_back(id - 1);
+                if (id < INT_MAX) targets.push_back(id + 1);
+            }
+            for (int32_t target : targets) {
+                size_t expected = static_cast<size_t>(lower_bound(ids.begin(), ids.end(), target) - ids.begin());
+                string name = "n=" + to_string(n) + (high ? " high" : "") + " target=" + to_string(target);
+                check(posting_intersect::lower_bound_scalar(ids.data(), n, target) == expected,
+                      "scalar lower_bound " + name);
+                check(posting_intersect::lower_bound(ids.data(), n, target) == expected,
+                      "lower_bound " + name);
+            }
+        }
+    }
+}
+
+void test_intersect(mt19937& rng) {
+    for (size_t na : LENGTHS) {
+        for (size_t nb : LENGTHS) {
+            for (bool high : {false, true}) {
+                // Dense lists overlap a lot, sparse ones hardly
+                for (int32_t spread : {2, 40}) {
+                    vector<int32_t> a = sorted_ids(rng, na, high, spread);
+                    vector<int32_t> b = sorted_ids(rng, nb, high, 3);
+                    vector<int32_t> expected;
+                    set_intersection(a.begin(), a.end(), b.begin(), b.end(), back_inserter(expected));
+
+                    string name = "na=" + to_string(na) + " nb=" + to_string(nb) + (high ? " high" : "") +
+                                  " spread=" + to_string(spread);
+
+                    // One guard value past the results
+                    const int32_t guard = -12345;
+                    vector<int32_t> out(min(na, nb) + 1, guard);
+                    size_t found = posting_intersect::intersect_scalar(a.data(), na, b.data(), nb, out.data());
+                    check(found == expected.size() && equal(expected.begin(), expected.end(), out.begin()),
+                          "scalar intersect " + name);
+
+                    fill(out.begin(), out.end(), guard);
+                    found = posting_intersect::intersect(a.data(), na, b.data(), nb, out.data());
+                    check(found == expected.size() && equal(expected.begin(), expected.end(), out.begin()),
+                          "intersect " + name);
+                    check(out[expected.size()] == guard, "intersect " + name + " wrote past the results");
+
+                    // Either side may be the shorter one
+                    found = posting_intersect::intersect(b.data(), nb, a.data(), na, out.data());
+                    check(found == expected.size() && equal(expected.begin(), expected.end(), out.begin()),
+                          "intersect swapped " + name);
+
+                    // In place, over a
+                    vector<int32_t> in_place = a;
+                    found = posting_intersect::intersect(in_place.data(), na, b.data(), nb, in_place.data());
+                    check(found == expected.size() && equal(expected.begin(), expected.end(), in_place.begin()),
+                          "intersect in place " + name);
+                }
+            }
+        }
+    }
+
+    // Every value shared, and none
+    vector<int32_t> ids = sorted_ids(rng, 100, true, 7);
+    vector<int32_t> out(ids.size());
+    check(posting_intersect::intersect(ids.data(), ids.size(), ids.data(), ids.size(), out.data()) == ids.size() &&
+          out == ids, "intersect with itself");
+    vector<int32_t> odd(ids.size()), even(ids.size());
+    for (size_t i = 0; i < ids.size(); ++i) {
+        odd[i] = static_cast<int32_t>(2 * i + 1);
+        even[i] = static_cast<int32_t>(2 * i);
+    }
+    check(posting_intersect::intersect(odd.data(), odd.size(), even.data(), even.size(), out.data()) == 0,
+          "intersect of disjoint lists");
+}
+
+void test_gallop(mt19937& rng) {
+    for (size_t n : LENGTHS) {
+        vector<int32_t> ids = sorted_ids(rng, n, false, 4);
+        for (size_t from = 0; from <= n; ++from) {
+            for (int32_t target : {-1, 0, 3, 50, 200, INT_MAX}) {
+                size_t expected = static_cast<size_t>(lower_bound(ids.begin() + from, ids.end(), target) - ids.begin());
+                size_t actual = posting_intersect::gallop(from, n, [&](size_t i) { return ids[i] < target; });
+                check(actual == expected, "gallop n=" + to_string(n) + " from=" + to_string(from) +
+                                          " target=" + to_string(target));
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    mt19937 rng(42);
+
+    cout << "Active path: " << (posting_intersect::simd_enabled() ? "AVX2" : "scalar") << "\n";
+
+    test_lower_bound(rng);
+    test_intersect(rng);
+    test_gallop(rng);
+
+    if (failures > 0) {
+        cerr << failures << " check(s) failed\n";
+        return 1;
+    }
+    cout << "All posting intersection checks passed\n";
+    return 0;
+}
@@ -0,0 +1,218 @@
+#include "VectorKernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace std;
+using vector_kernels::Isa;
+
+// Checks every SIMD kernel set this CPU supports against the scalar kernels:
+// float / float16 / int8 dot products over odd lengths and unaligned pointers,
+// normalization, the 4-bit PQ table scan (exact: it sums integers), and that
+// the tail handling never writes past the end of a vector. Also checks the
+// float16 conversion, including its rounding.
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const string& what) {
+    if (!ok) {
+        cerr << "FAIL: " << what << "\n";
+        ++failures;
+    }
+}
+
+vector<float> random_vector(mt19937& rng, size_t n) {
+    normal_distribution<float> dist(0.0f, 1.0f);
+    vector<float> v(n);
+    for (float& x : v) x = dist(rng);
+    return v;
+}
+
+void test_dot(Isa isa, mt19937& rng) {
+    const size_t lengths[] = {0, 1, 3, 4, 7, 15, 16, 17, 31, 32, 33, 63, 100, 300, 1000};
+    for (size_t n : lengths) {
+        // One extra float in front so the data starts unaligned
+        vector<float> a = random_vector(rng, n + 1);
+        vector<float> b = random_vector(rng, n + 1);
+        for (size_t offset : {size_t{0}, size_t{1}}) {
+            size_t len = n;
+            double expected = vector_kernels::dot(Isa::Scalar, a.data() + offset, b.data() + offset, len);
+            double actual = vector_kernels::dot(isa, a.data() + offset, b.data() + offset, len);
+
+            // Float lane sums: error grows with the sum of |a[i] * b[i]|
+            double magnitude = 0.0;
+            for (size_t i = 0; i < len; ++i) {
+                magnitude += fabs(a[offset + i] * b[offset + i]);
+            }
+            check(fabs(actual - expected) <= 1e-6 * magnitude + 1e-12,
+                  string(vector_kernels::isa_name(isa)) + " dot n=" + to_string(len) +
+                  " offset=" + to_string(offset) + ": " + to_string(actual) + " vs " + to_string(expected));
+        }
+    }
+}
+
+void test_normalize(Isa isa, mt19937& rng) {
+    const size_t lengths[] = {1, 5, 16, 19, 300, 301};
+    for (size_t n : lengths) {
+        vector<float> v = random_vector(rng, n + 1);
+        const float guard = 12345.0f;
+        v[n] = guard;
+
+        vector<float> expected(v.begin(), v.begin() + n);
+        vector_kernels::normalize(Isa::Scalar, expected.data(), n);
+        vector_kernels::normalize(isa, v.data(), n);
+
+        double max_diff = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            max_diff = max(max_diff, static_cast<double>(fabs(v[i] - expected[i])));
+        }
+        string name = string(vector_kernels::isa_name(isa)) + " normalize n=" + to_string(n);
+        check(max_diff <= 1e-6, name + " differs from scalar by " + to_string(max_diff));
+        check(fabs(vector_kernels::dot(Isa::Scalar, v.data(), v.data(), n) - 1.0) <= 1e-5, name + " not unit length");
+        check(v[n] == guard, name + " wrote past the end");
+    }
+
+    vector<float> zero(37, 0.0f);
+    vector_kernels::normalize(isa, zero.data(), zero.size());
+    bool all_zero = true;
+    for (float x : zero) all_zero = all_zero && x == 0.0f;
+    check(all_zero, string(vector_kernels::isa_name(isa)) + " normalize of zero vector");
+}
+
+void test_quantized_dot(Isa isa, mt19937& rng) {
+    uniform_int_distribution<int> byte(-127, 127);
+    const size_t lengths[] = {0, 1, 7, 8, 15, 16, 17, 33, 300, 301};
+    for (size_t n : lengths) {
+        vector<float> a = random_vector(rng, n + 1);
+        vector<float> b = random_vector(rng, n + 1);
+        vector<uint16_t> halves(n + 1);
+        vector<int8_t> bytes(n + 1);
+        for (size_t i = 0; i <= n; ++i) {
+            halves[i] = vector_kernels::float_to_half(b[i]);
+            bytes[i] = static_cast<int8_t>(byte(rng));
+        }
+        for (size_t offset : {size_t{0}, size_t{1}}) {
+            double half_magnitude = 0.0, byte_magnitude = 0.0;
+            for (size_t i = 0; i < n; ++i) {
+                half_magnitude += fabs(a[offset + i] * vector_kernels::half_to_float(halves[offset + i]));
+                byte_magnitude += fabs(a[offset + i] * bytes[offset + i]);
+            }
+            string name = string(vector_kernels::isa_name(isa)) + " n=" + to_string(n) + " offset=" + to_string(offset);
+
+            double expected = vector_kernels::dot_f16(Isa::Scalar, a.data() + offset, halves.data() + offset, n);
+            double actual = vector_kernels::dot_f16(isa, a.data() + offset, halves.data() + offset, n);
+            check(fabs(actual - expected) <= 1e-6 * half_magnitude + 1e-12, name + " dot_f16");
+
+            expected = vector_kernels::dot_i8(Isa::Scalar, a.data() + offset, bytes.data() + offset, n);
+            actual = vector_kernels::dot_i8(isa, a.data() + offset, bytes.data() + offset, n);
+            check(fabs(actual - expected) <= 1e-6 * byte_magnitude + 1e-12, name + " dot_i8");
+        }
+    }
+}
+
+void test_pq4_scan(Isa isa, mt19937& rng) {
+    using vector_kernels::PQ4_BLOCK;
+    uniform_int_distribution<int> byte(0, 255);
+    const size_t subspace_counts[] = {1, 2, 3, 16, 50, 75, vector_kernels::PQ4_MAX_SUBSPACES};
+    for (size_t m : subspace_counts) {
+        for (size_t blocks : {size_t{1}, size_t{3}}) {
+            // One extra byte in front so the data starts unaligned
+            vector<uint8_t> codes(blocks * m * 16 + 1), lut(m * 16 + 1);
+            for (uint8_t& b : codes) b = static_cast<uint8_t>(byte(rng));
+            for (uint8_t& b : lut) b = static_cast<uint8_t>(byte(rng));
+            if (m == vector_kernels::PQ4_MAX_SUBSPACES) fill(lut.begin(), lut.end(), 255);  // Largest sums
+
+            const uint16_t guard = 0xBEEF;
+            vector<uint16_t> expected(blocks * PQ4_BLOCK), actual(blocks * PQ4_BLOCK + 1, 0);
+            actual.back() = guard;
+            vector_kernels::pq4_scan(Isa::Scalar, codes.data() + 1, lut.data() + 1, m, blocks, expected.data());
+            vector_kernels::pq4_scan(isa, codes.data() + 1, lut.data() + 1, m, blocks, actual.data());
+
+            string name = string(vector_kernels::isa_name(isa)) + " pq4_scan m=" + to_string(m) +
+                          " blocks=" + to_string(blocks);
+            check(equal(expected.begin(), expected.end(), actual.begin()), name + " differs from scalar");
+            check(actual.back() == guard, name + " wrote past the end");
+
+            // The scalar scan itself, for one vector against a direct sum
+            size_t v = 17;
+            uint32_t total = 0;
+            for (size_t j = 0; j < m; ++j) {
+                uint8_t packed = codes[1 + j * 16 + v % 16];
+                total += lut[1 + j * 16 + (packed >> 4)];
+            }
+            check(expected[v] == total, name + " scalar sum of vector 17");
+        }
+    }
+}
+
+void test_half_conversion() {
+    // Every finite half survives the round trip through float
+    for (uint32_t bits = 0; bits <= 0xFFFF; ++bits) {
+        uint16_t half = static_cast<uint16_t>(bits);
+        if ((half & 0x7C00) == 0x7C00 && (half & 0x3FF) != 0) continue;  // NaN
+        if (vector_kernels::float_to_half(vector_kernels::half_to_float(half)) != half) {
+            check(false, "half round trip of " + to_string(bits));
+            return;
+        }
+    }
+
+    struct Case { float value; uint16_t bits; };
+    const Case cases[] = {
+        {1.0f, 0x3C00}, {-2.0f, 0xC000}, {65504.0f, 0x7BFF},
+        {65519.0f, 0x7BFF}, {65520.0f, 0x7C00}, {1e10f, 0x7C00},
+        {5.9604645e-8f, 0x0001},                 // Smallest subnormal
+        {2.9802322e-8f, 0x0000},                 // Half of it: tie to even (0)
+        {8.940697e-8f, 0x0002},                  // 1.5x: tie to even (2)
+        {1.0009765625f, 0x3C01},                 // 1 + 2^-10
+        {1.00048828125f, 0x3C00},                // 1 + 2^-11: tie to even (down)
+        {1.00146484375f, 0x3C02},                // 1 + 3 * 2^-11: tie to even (up)
+    };
+    for (const Case& c : cases) {
+        check(vector_kernels::float_to_half(c.value) == c.bits, "float_to_half(" + to_string(c.value) + ")");
+    }
+    check((vector_kernels::float_to_half(NAN) & 0x7C00) == 0x7C00 &&
+          (vector_kernels::float_to_half(NAN) & 0x3FF) != 0, "float_to_half(NaN)");
+}
+
+} // namespace
+
+int main() {
+    mt19937 rng(42);
+
+    cout << "Active kernels: " << vector_kernels::isa_name(vector_kernels::active_isa()) << "\n";
+    check(vector_kernels::isa_supported(vector_kernels::active_isa()), "active kernels unsupported");
+
+    for (Isa isa : {Isa::Scalar, Isa::SSE2, Isa::AVX2, Isa::AVX512}) {
+        if (!vector_kernels::isa_supported(isa)) {
+            cout << "  " << vector_kernels::isa_name(isa) << ": not supported here, skipped\n";
+            continue;
+        }
+        test_dot(isa, rng);
+        test_normalize(isa, rng);
+        test_quantized_dot(isa, rng);
+        test_pq4_scan(isa, rng);
+        cout << "  " << vector_kernels::isa_name(isa) << ": checked\n";
+    }
+
+    test_half_conversion();
+
+    // The dispatched entry points use the active kernels
+    vector<float> a = random_vector(rng, 300);
+    vector<float> b = random_vector(rng, 300);
+    check(vector_kernels::dot(a.data(), b.data(), 300) ==
+          vector_kernels::dot(vector_kernels::active_isa(), a.data(), b.data(), 300),
+          "dispatched dot differs from active kernels");
+
+    if (failures > 0) {
+        cerr << failures << " check(s) failed\n";
+        return 1;
+    }
+    cout << "All vector kernel checks passed\n";
+    return 0;
+}